@@ -0,0 +1,67 @@
+##################################
+## Reader for QFMCampaign result files
+##################################
+# Same layout as Source/QFMCore/Public/QFMCoreColumnFile.h (version 1, little-endian).
+# columns = QFMCampaign.load('Campaign.qfmc') gives a dict of numpy arrays, one entry per run,
+# e.g. columns['MaxAttitudeError'][columns['Failure'] != 0]
+##################################
+### Imports
+import sys
+import numpy as np
+
+### Constants
+MAGIC = 0x434D4651  # 'QFMC'
+VERSION = 1
+
+HEADER = np.dtype([('Magic', '<u4'), ('Version', '<u2'), ('NumColumns', '<u2')])
+COLUMN = np.dtype([('Name', 'S64'), ('Type', '<u4')])
+TYPES = {0: '<f4', 1: '<u4'}
+
+# Failure bits
+FAILURE_NON_FINITE = 1
+FAILURE_FLIP = 2
+FAILURE_ATTITUDE = 4
+FAILURE_ALTITUDE = 8
+
+
+# Column names and types, raises ValueError for foreign files
+def columns(path):
+    h = np.fromfile(path, dtype=HEADER, count=1)[0]
+    if h['Magic'] != MAGIC or h['Version'] != VERSION:
+        raise ValueError('{} is not a version {} column file'.format(path, VERSION))
+    c = np.fromfile(path, dtype=COLUMN, count=h['NumColumns'], offset=HEADER.itemsize)
+    return [(name.decode(), TYPES[int(t)]) for name, t in zip(c['Name'], c['Type'])]
+
+
+# Every complete row group, concatenated per column
+def load(path):
+    cols = columns(path)
+    data = np.memmap(path, dtype='u1', mode='r')
+    offset = HEADER.itemsize + COLUMN.itemsize * len(cols)
+    parts = {name: [] for name, _ in cols}
+    while offset + 4 <= len(data):
+        rows = int(data[offset:offset + 4].view('<u4')[0])
+        end = offset + 4 + 4 * rows * len(cols)
+        if rows == 0 or end > len(data):
+            break  # being written
+        offset += 4
+        for name, t in cols:
+            parts[name].append(np.frombuffer(data, dtype=t, count=rows, offset=offset))
+            offset += 4 * rows
+    return {name: np.concatenate(parts[name]) if parts[name] else np.zeros(0, dtype=t) for name, t in cols}
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('Usage: QFMCampaign.py File')
+        sys.exit(1)
+
+    c = load(sys.argv[1])
+    failed = c['Failure'] != 0
+    print('{} runs, {} failed'.format(len(c['Run']), int(np.count_nonzero(failed))))
+    print('{:52s} {:>10s} {:>10s} {:>10s} {:>10s}'.format('', 'min', 'mean', 'max', 'mean fail'))
+    for name, values in c.items():
+        if name in ('Run', 'Failure') or len(values) == 0:
+            continue
+        print('{:52s} {:10.4g} {:10.4g} {:10.4g} {:10.4g}'.format(name, float(np.min(values)), float(np.mean(values)), float(np.max(values)),
+                                                            float(np.mean(values[failed])) if np.any(failed) else float('nan')))
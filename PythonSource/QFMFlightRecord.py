@@ -0,0 +1,94 @@
+##################################
+## Reader for QFM flight recorder files
+##################################
+# Same layout as Source/QFMCore/Public/QFMCoreFlightRecord.h (version 6, little-endian).
+# The file is mapped, not read: records = QFMFlightRecord.load('Saved/FlightRecords/x.qfmr')
+# gives a numpy record array, e.g. records[records['VehicleId'] == 3]['Thrust'][:, 2]
+##################################
+### Imports
+import sys
+import numpy as np
+
+### Constants
+MAGIC = 0x524D4651  # 'QFMR'
+VERSION = 6
+MAX_ENGINES = 8
+GYRO_FILTER_STATE = 36          # FAHRSCore::FGyroFilter::NumStateValues
+ACCELERATION_FILTER_STATE = 24  # FAHRSCore::FAccelerationFilter::NumStateValues
+ESTIMATOR_COVARIANCE = 120      # FEstimatorCore::NumCovarianceValues, upper triangle of 15 x 15
+
+HEADER = np.dtype([
+    ('Magic', '<u4'), ('Version', '<u2'), ('Reserved0', '<u2'),
+    ('HeaderBytes', '<u4'), ('RecordBytes', '<u4'),
+    ('Capacity', '<u8'), ('NumRecords', '<u8'), ('DroppedRecords', '<u8'),
+])
+
+RECORD = np.dtype([
+    ('SimTime', '<f8'), ('VehicleId', '<u4'), ('Step', '<u4'),
+    ('DeltaTime', '<f4'), ('FlightMode', 'u1'), ('RotationControlLoop', 'u1'), ('NumEngines', 'u1'), ('Flags', 'u1'),
+    ('Rotation', '<f4', 4), ('Position', '<f4', 3), ('LinearVelocity', '<f4', 3), ('AngularVelocity', '<f4', 3),
+    ('PilotAxisInput', '<f4', 4), ('DesiredPilotInput', '<f4', 4),
+    ('AHRSPosition', '<f4', 3), ('AHRSRotation', '<f4', 3), ('AHRSLinearVelocity', '<f4'), ('AHRSVelocityVector', '<f4', 3),
+    ('AHRSLinearVelocity2D', '<f4'), ('AHRSLinearVelocityX', '<f4'), ('AHRSAngularVelocity', '<f4', 3),
+    ('AHRSLinearAcceleration', '<f4'), ('AHRSLinearAccelerationVector', '<f4', 3), ('AHRSAngularAcceleration', '<f4', 3),
+    ('AHRSWorldRotation', '<f4', 4), ('AHRSWorldTranslation', '<f4', 3), ('AHRSBodyAngularVelocity', '<f4', 3),
+    ('AHRSGyroFilterState', '<f4', GYRO_FILTER_STATE), ('AHRSAccelerationFilterState', '<f4', ACCELERATION_FILTER_STATE),
+    ('SensorImuTimer', '<f4'), ('SensorBaroTimer', '<f4'), ('SensorImuIndex', '<u4'), ('SensorBaroIndex', '<u4'),
+    ('SensorGyroBias', '<f4', 3), ('SensorAccelerometerBias', '<f4', 3), ('SensorBaroBias', '<f4'), ('SensorBaroAltitude', '<f4'),
+    ('SensorVibrationPhase', '<f4', MAX_ENGINES), ('SensorLastRotation', '<f4', 4), ('SensorLastAngularVelocity', '<f4', 3),
+    ('SensorLastVelocity', '<f4', 3), ('SensorPositionTimer', '<f4'), ('SensorPositionIndex', '<u4'),
+    ('EstimatorRotation', '<f4', 4), ('EstimatorVelocity', '<f4', 3), ('EstimatorPosition', '<f4', 3),
+    ('EstimatorGyroBias', '<f4', 3), ('EstimatorAccelerometerBias', '<f4', 3),
+    ('EstimatorCovariance', '<f4', ESTIMATOR_COVARIANCE), ('EstimatorRejected', '<u4'),
+    ('EstimatorReserved', '<f4'),
+    ('AttitudeTarget', '<f4', 4), ('RateIntegral', '<f4', 3), ('RatePreError', '<f4', 3), ('RateDerivative', '<f4', 3),
+    ('PosTargetZ', '<f4'), ('RateZIntegral', '<f4'), ('RateZPreError', '<f4'), ('RateZDerivative', '<f4'),
+    ('RotationRequest', '<f4', 3), ('ThrottleRequest', '<f4'),
+    ('EngineMixPercent', '<f4', MAX_ENGINES), ('EngineSpeed', '<f4', MAX_ENGINES),
+    ('EngineThrust', '<f4', 3), ('EngineTorque', '<f4', 3),
+    ('Thrust', '<f4', 3), ('Torque', '<f4', 3),
+    ('SchedulerAccumulator', '<f4'), ('Reserved0', '<u4'), ('SchedulerTickCount', '<u8'),
+])
+
+# Flags
+FLAG_MULTI_RATE = 1
+FLAG_POSITION_LOCKED_Z = 2
+FLAG_SENSORS_STARTED = 4
+FLAG_BARO_VALID = 8
+FLAG_ESTIMATOR_ALIGNED = 16
+
+assert RECORD.itemsize == 1368
+
+
+# Header as a dict, raises ValueError for foreign files
+def header(path):
+    h = np.memmap(path, dtype=HEADER, mode='r', shape=(1,))[0]
+    if h['Magic'] != MAGIC or h['Version'] != VERSION or h['RecordBytes'] != RECORD.itemsize:
+        raise ValueError('{} is not a version {} flight record'.format(path, VERSION))
+    return {name: int(h[name]) for name in HEADER.names}
+
+
+# All valid records, mapped read only
+def load(path):
+    h = header(path)
+    return np.memmap(path, dtype=RECORD, mode='r', offset=h['HeaderBytes'], shape=(h['NumRecords'],))
+
+
+# Records of one vehicle, in step order
+def vehicle(records, vehicleId):
+    return records[records['VehicleId'] == vehicleId]
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('Usage: QFMFlightRecord.py File')
+        sys.exit(1)
+
+    h = header(sys.argv[1])
+    records = load(sys.argv[1])
+    print('{} records ({} dropped), capacity {}'.format(h['NumRecords'], h['DroppedRecords'], h['Capacity']))
+    for vehicleId in np.unique(records['VehicleId']):
+        r = vehicle(records, vehicleId)
+        gaps = int(np.count_nonzero(np.diff(r['Step'].astype(np.int64)) != 1))
+        print('Vehicle {}: {} steps, {:.3f}..{:.3f} s, {} gaps, max thrust {:.2f} N'.format(
+            vehicleId, len(r), r['SimTime'][0], r['SimTime'][-1], gaps, float(np.max(r['Thrust'][:, 2]))))
@@ -0,0 +1,76 @@
+##################################
+## Decoder for the QFM telemetry wire format
+##################################
+# Same layout as Source/QFMCore/Public/QFMCoreWireFormat.h (version 1, little-endian)
+##################################
+### Imports
+import struct
+
+### Constants
+MAGIC = 0x544D4651  # 'QFMT'
+VERSION = 1
+HEADER = struct.Struct('<IHHIIdIHH')
+
+# Channel bit index -> name
+CHANNELS = ['ThrustZ', 'TorqueX', 'TorqueY', 'TorqueZ', 'DebugX', 'DebugY', 'DebugZ']
+
+
+# One decoded datagram
+class Packet:
+    def __init__(self, version, vehicleId, sequence, simTime, channelBitmap, channels, times, values):
+        self.version = version
+        self.vehicleId = vehicleId
+        self.sequence = sequence
+        self.simTime = simTime
+        self.channelBitmap = channelBitmap
+        self.channels = channels    # channel names, in record order
+        self.times = times          # one sim time per record
+        self.values = values        # one tuple per record, same order as channels
+
+    # all values of one channel, None if not in this packet
+    def channel(self, name):
+        if name not in self.channels:
+            return None
+        index = self.channels.index(name)
+        return [record[index] for record in self.values]
+
+
+def channelNames(bitmap):
+    return [CHANNELS[bit] if bit < len(CHANNELS) else 'Channel{}'.format(bit) for bit in range(32) if bitmap & (1 << bit)]
+
+
+# Decode one datagram. Returns None for foreign or truncated data
+def decode(data):
+    if len(data) < HEADER.size:
+        return None
+    magic, version, headerBytes, vehicleId, sequence, simTime, bitmap, count, recordBytes = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or headerBytes < HEADER.size:
+        return None
+
+    channels = channelNames(bitmap)
+    record = struct.Struct('<d' + 'f' * len(channels))
+    if recordBytes < record.size or headerBytes + count * recordBytes > len(data):
+        return None
+
+    times = []
+    values = []
+    for i in range(count):
+        unpacked = record.unpack_from(data, headerBytes + i * recordBytes)
+        times.append(unpacked[0])
+        values.append(unpacked[1:])
+
+    return Packet(version, vehicleId, sequence, simTime, bitmap, channels, times, values)
+
+
+# Tracks sequence numbers to count lost datagrams
+class SequenceTracker:
+    def __init__(self):
+        self.last = None
+        self.lost = 0
+
+    def update(self, sequence):
+        if self.last is not None:
+            gap = (sequence - self.last - 1) & 0xFFFFFFFF
+            if gap < 0x80000000:
+                self.lost += gap
+        self.last = sequence
@@ -10,6 +10,7 @@ import numpy as np
 from time import sleep 
 from collections import deque 
 from matplotlib import pyplot as plt 
+import QFMTelemetry 
 
 ### Constants 
 HOST = '' 
@@ -91,19 +92,19 @@ while 1:
 
     try:
         # Receive data from client (data, addr) 
-        d = socket.recvfrom(1024) 
-        data = str(d[0], "utf-8") 
+        d = socket.recvfrom(2048) 
+        packet = QFMTelemetry.decode(d[0]) 
         addr = d[1] 
 
         # Print to the server who made a connection. 
         #print("{} wrote:".format(addr)) 
         #print(data) 
 
-        # Now have our UDP handler handle the data 
-        values = [float(val) for val in data.split(",")] 
-        #print (values) 
-        if(len(values) == 2): 
-            udpData.add(values) 
+        # One datagram carries many records of one vehicle and channel set 
+        # Plot the pawns debug channel, skip the flight model force packets 
+        if packet is not None and packet.channels == ['DebugZ']: 
+            for time, values in zip(packet.times, packet.values): 
+                udpData.add([time, values[0]]) 
             udpPlot.update(udpData) 
 
     except KeyboardInterrupt: 
@@ -8,6 +8,7 @@ import socket
 import sys 
 import numpy as np 
 from time import sleep 
+import QFMTelemetry 
 
 
 ### Constants 
@@ -32,20 +33,26 @@ except:
     
 print("Socket bind complete.") 
 
+sequence = QFMTelemetry.SequenceTracker() 
+
 # Now keep talking to clients 
 
 while 1: 
 
     try:
         # Receive data from client (data, addr) 
-        d = socket.recvfrom(1024) 
-        data = str(d[0], "utf-8") 
-        #data = d[0]
+        d = socket.recvfrom(2048) 
+        packet = QFMTelemetry.decode(d[0]) 
         addr = d[1] 
 
         # Print to the server who made a connection. 
-        print("{} wrote:".format(addr)) 
-        print(data) 
+        if packet is None: 
+            print("{} sent {} bytes of unknown data".format(addr, len(d[0]))) 
+            continue 
+        sequence.update(packet.sequence) 
+        print("{} vehicle {} seq {} lost {}: {} records of {}".format(addr, packet.vehicleId, packet.sequence, sequence.lost, len(packet.times), ",".join(packet.channels))) 
+        for time, values in zip(packet.times, packet.values): 
+            print("  {:.4f} {}".format(time, " ".join("{:.6g}".format(v) for v in values))) 
 
     except KeyboardInterrupt: 
         print ('exiting') 
@@ -130,6 +130,9 @@ void AQCPawn::BeginPlay()
 
 	// Start UDP Sender
 	UDPSender->Start("Socket1","127.0.0.1",12345);
+
+	// Flight model streams its forces from the physics thread
+	QuadcopterFlightModel->SetTelemetryRing(UDPSender->GetTelemetryRing(QFM::TelemetryProducerPhysics), QuadcopterFlightModel->GetVehicleId());
 }
 
 // Called every frame
@@ -148,13 +151,19 @@ void AQCPawn::Tick(float DeltaTime)
 		break;
 	}
 
-	// Write some UDP Test Data
+	// Write some UDP Test Data. Only queued here, the telemetry thread packs and sends
 	DeltaTimeUDP += DeltaTime;
 	if (DeltaTimeUDP > UDPTimer)
 	{
 		FVector DebugData = QuadcopterFlightModel->GetUDPDebugOutput();
-		FString ToSend = FString::Printf(TEXT("%f,%f"), RunningTime, DebugData.Z);
-		UDPSender->SendData(ToSend);
+
+		QFM::FTelemetrySample Sample;
+		Sample.VehicleId = QuadcopterFlightModel->GetVehicleId();
+		Sample.SimTime = RunningTime;
+		Sample.ChannelBitmap = QFM::WireChannelBit(QFM::WireChannelDebugZ);
+		Sample.Values[0] = DebugData.Z;
+		UDPSender->PushSample(QFM::TelemetryProducerGame, Sample);
+
 		DeltaTimeUDP = 0.0f;
 	}
 	RunningTime += DeltaTime;
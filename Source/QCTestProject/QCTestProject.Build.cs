@@ -1,5 +1,6 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
+using System.IO;
 using UnrealBuildTool;
 
 public class QCTestProject : ModuleRules
@@ -17,6 +18,9 @@ public class QCTestProject : ModuleRules
         PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
 		PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
+
+		// Engine independent flight model core (plain C++, header only). Also builds standalone with CMake.
+		PublicIncludePaths.Add(Path.Combine(ModuleDirectory, "..", "QFMCore", "Public"));
 		
 		// Uncomment if you are using online features
 		// PrivateDependencyModuleNames.Add("OnlineSubsystem");
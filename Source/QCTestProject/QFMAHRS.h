@@ -6,6 +6,10 @@
 #include "Components/PrimitiveComponent.h"
 #include "PhysicsEngine/BodyInstance.h"
 
+#include "QFMEngineController.h"
+#include "QFMCoreAHRS.h"
+#include "QFMCoreBridge.h"
+
 #include "QFMAHRS.generated.h"
 
 
@@ -29,6 +33,157 @@ struct FAHRS
 	// Overthink old values above...
     
     UPROPERTY() FRotator BodyRotation; // NOT!! World Rotation
+
+
+	/*--- FILTERS ---*/
+	// Biquads of QFM::FAHRSCore, all off by default
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Gyro", meta = (ToolTip = "Gyro low pass in Hz, 0 = off", ClampMin = "0"))
+	float GyroLowPassHz = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Gyro", meta = (ToolTip = "Gyro low pass Q, 0.7071 = Butterworth", ClampMin = "0.1"))
+	float GyroLowPassQ = 0.7071f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Gyro", meta = (ToolTip = "Gyro notch center in Hz, 0 = off", ClampMin = "0"))
+	float GyroNotchHz = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Gyro", meta = (ToolTip = "Gyro notch Q, center / bandwidth", ClampMin = "0.1"))
+	float GyroNotchQ = 3.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Gyro", meta = (ToolTip = "One gyro notch per motor on its rotation frequency, EngineSpeed * EngineMaxRPM / 60"))
+	bool GyroRpmNotch = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Gyro", meta = (ToolTip = "RPM notch Q", ClampMin = "0.1"))
+	float GyroRpmNotchQ = 5.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Gyro", meta = (ToolTip = "RPM notches of slower motors pass through, in Hz", ClampMin = "0"))
+	float GyroRpmNotchMinHz = 20.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Acceleration", meta = (ToolTip = "Low pass of the linear and angular accelerations in Hz, 0 = off", ClampMin = "0"))
+	float AccelerationLowPassHz = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Acceleration", meta = (ToolTip = "Acceleration low pass Q, 0.7071 = Butterworth", ClampMin = "0.1"))
+	float AccelerationLowPassQ = 0.7071f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Acceleration", meta = (ToolTip = "Acceleration notch center in Hz, 0 = off", ClampMin = "0"))
+	float AccelerationNotchHz = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Filters|Acceleration", meta = (ToolTip = "Acceleration notch Q, center / bandwidth", ClampMin = "0.1"))
+	float AccelerationNotchQ = 3.0f;
+
+
+	/*--- SENSORS ---*/
+	// IMU and barometer model of QFM::FSensorCore, off by default
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors", meta = (ToolTip = "Sample an IMU and a barometer instead of reading the body state"))
+	bool SensorsEnabled = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors", meta = (ToolTip = "Internal IMU sample rate in Hz, the AHRS gets all samples of a step as one batch", ClampMin = "1000", ClampMax = "8000"))
+	float ImuRateHz = 2000.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors", meta = (ToolTip = "IMU sample delay in s", ClampMin = "0"))
+	float SensorLatency = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors", meta = (ToolTip = "Seed of the noise, equal seeds give equal noise"))
+	int32 SensorSeed = 1;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Gyro", meta = (ToolTip = "White noise in rad/s/sqrt(Hz)", ClampMin = "0"))
+	float GyroNoiseDensity = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Gyro", meta = (ToolTip = "Bias drift in rad/s/sqrt(s)", ClampMin = "0"))
+	float GyroBiasRandomWalk = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Gyro", meta = (ToolTip = "Std dev of the turn-on bias in rad/s", ClampMin = "0"))
+	float GyroInitialBias = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Gyro", meta = (ToolTip = "LSB in rad/s, 0 = not quantized", ClampMin = "0"))
+	float GyroResolution = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Gyro", meta = (ToolTip = "Saturation in rad/s, 0 = unlimited", ClampMin = "0"))
+	float GyroRange = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Gyro", meta = (ToolTip = "Vibration amplitude at full engine speed in rad/s", ClampMin = "0"))
+	float GyroVibration = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Accelerometer", meta = (ToolTip = "White noise in m/s^2/sqrt(Hz)", ClampMin = "0"))
+	float AccelerometerNoiseDensity = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Accelerometer", meta = (ToolTip = "Bias drift in m/s^2/sqrt(s)", ClampMin = "0"))
+	float AccelerometerBiasRandomWalk = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Accelerometer", meta = (ToolTip = "Std dev of the turn-on bias in m/s^2", ClampMin = "0"))
+	float AccelerometerInitialBias = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Accelerometer", meta = (ToolTip = "LSB in m/s^2, 0 = not quantized", ClampMin = "0"))
+	float AccelerometerResolution = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Accelerometer", meta = (ToolTip = "Saturation in m/s^2, 0 = unlimited", ClampMin = "0"))
+	float AccelerometerRange = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Accelerometer", meta = (ToolTip = "Vibration amplitude at full engine speed in m/s^2", ClampMin = "0"))
+	float AccelerometerVibration = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Baro", meta = (ToolTip = "Barometer readings per s, 0 = no barometer", ClampMin = "0"))
+	float BaroRateHz = 50.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Baro", meta = (ToolTip = "Std dev of a reading in m", ClampMin = "0"))
+	float BaroNoise = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Baro", meta = (ToolTip = "Bias drift in m/sqrt(s)", ClampMin = "0"))
+	float BaroBiasRandomWalk = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Baro", meta = (ToolTip = "LSB in m, 0 = not quantized", ClampMin = "0"))
+	float BaroResolution = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Position", meta = (ToolTip = "Position fixes per s, 0 = no position sensor", ClampMin = "0"))
+	float PositionRateHz = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Position", meta = (ToolTip = "Std dev of a fix per axis in m", ClampMin = "0"))
+	float PositionNoise = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Sensors|Position", meta = (ToolTip = "Std dev of the heading that comes with a fix in rad", ClampMin = "0"))
+	float HeadingNoise = 0.0f;
+
+	// Error state EKF of QFM::FEstimatorCore, off by default, needs the sensors
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Estimate attitude, velocity and position from the sensors with an EKF"))
+	bool EstimatorEnabled = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Assumed gyro white noise in rad/s/sqrt(Hz)", ClampMin = "0"))
+	float EstimatorGyroNoise = 0.005f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Assumed accelerometer white noise in m/s^2/sqrt(Hz)", ClampMin = "0"))
+	float EstimatorAccelerometerNoise = 0.05f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Assumed gyro bias drift in rad/s/sqrt(s)", ClampMin = "0"))
+	float EstimatorGyroBiasRandomWalk = 0.0001f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Assumed accelerometer bias drift in m/s^2/sqrt(s)", ClampMin = "0"))
+	float EstimatorAccelerometerBiasRandomWalk = 0.001f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Assumed std dev of a baro reading in m", ClampMin = "0"))
+	float EstimatorBaroNoise = 0.5f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Assumed std dev of a position fix in m", ClampMin = "0"))
+	float EstimatorPositionNoise = 0.5f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Assumed std dev of the heading in rad, 0 = heading not fused", ClampMin = "0"))
+	float EstimatorHeadingNoise = 0.05f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Initial std dev of the attitude in rad", ClampMin = "0"))
+	float EstimatorInitialAttitude = 0.02f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Initial std dev of the velocity in m/s", ClampMin = "0"))
+	float EstimatorInitialVelocity = 0.1f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Initial std dev of the position in m", ClampMin = "0"))
+	float EstimatorInitialPosition = 0.5f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Initial std dev of the gyro bias in rad/s", ClampMin = "0"))
+	float EstimatorInitialGyroBias = 0.01f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Initial std dev of the accelerometer bias in m/s^2", ClampMin = "0"))
+	float EstimatorInitialAccelerometerBias = 0.2f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Estimator", meta = (ToolTip = "Rejects measurements more than this many std devs off, 0 = no gate", ClampMin = "0"))
+	float EstimatorInnovationGate = 5.0f;
 	
 
 
@@ -43,43 +198,107 @@ struct FAHRS
 	FBodyInstance *BodyInstance;
 	UPrimitiveComponent *PrimitiveComponent;
 
+	// The estimation itself runs in QFM::FAHRSCore. The UPROPERTYs above are its published copy.
+	QFM::FAHRSCore Core;
 
-	void Init(FBodyInstance *BodyInstanceIn, UPrimitiveComponent *PrimitiveComponentIn)
+
+	void Init(FBodyInstance *BodyInstanceIn, UPrimitiveComponent *PrimitiveComponentIn, FEngineController *EngineControllerIn)
 	{
 		// Need these Vectors to read data from those components
 		BodyInstance = BodyInstanceIn;
 		PrimitiveComponent = PrimitiveComponentIn;
+
+		SyncCore();
+		Core.Init(&EngineControllerIn->Core);
 	}
 
 
 	void Tock(float DeltaTime)
 	{
-		FTransform bodyTransform = PrimitiveComponent->GetComponentTransform();
-		
-		Position = bodyTransform.GetTranslation() / 100.0f; // in m
-		Rotation = bodyTransform.GetRotation().Rotator(); // in deg
-		
-		float OldLinearVelocity = LinearVelocity;
-		LinearVelocity = BodyInstance->GetUnrealWorldVelocity().Size() / 100.0f; // TAS in m/s
-		
-		FVector OldLinearVelocityVector = VelocityVector;
-		VelocityVector = BodyInstance->GetUnrealWorldVelocity() / 100.0f; // in m / s  // WORLD
+		Tock(DeltaTime, QFMReadBodyState(PrimitiveComponent->GetComponentTransform(), BodyInstance));
+	}
 
-		LinearVelocity2D = BodyInstance->GetUnrealWorldVelocity().Size2D() / 100.0f; // Speed over ground
-		LinearVelocityX = BodyInstance->GetUnrealWorldVelocity().X / 100.0f; // Speed over ground Forward
-		
-		FVector OldAngularVelocity = FVector(AngularVelocity);
-		AngularVelocity = FMath::RadiansToDegrees(BodyInstance->GetUnrealWorldAngularVelocityInRadians());
 
-		LinearAcceleration = (OldLinearVelocity - LinearVelocity) / DeltaTime;  // This is the wrong direction of calc. Should be actual - old. check in code where I use it @ODO
-		AngularAcceleration = (OldAngularVelocity - AngularVelocity) / DeltaTime; // This is wrong as well! @ODO
+	// Tock on a given body state, e.g. predicted for a rate loop substep
+	void Tock(float DeltaTime, const QFM::FBodyState& Body)
+	{
+		Core.Tock(Body, DeltaTime);
+		
+		Position = QFMFromCore(Core.Position);
+		Rotation = QFMFromCore(Core.Rotation);
+		LinearVelocity = Core.LinearVelocity;
+		VelocityVector = QFMFromCore(Core.VelocityVector);
+		LinearVelocity2D = Core.LinearVelocity2D;
+		LinearVelocityX = Core.LinearVelocityX;
+		AngularVelocity = QFMFromCore(Core.AngularVelocity);
+		LinearAcceleration = Core.LinearAcceleration;
+		LinearAccelerationVector = QFMFromCore(Core.LinearAccelerationVector);
+		AngularAcceleration = QFMFromCore(Core.AngularAcceleration);
 		
-		LinearAccelerationVector = (VelocityVector - OldLinearVelocityVector) / DeltaTime;
+		WorldRotationQuat = QFMFromCore(Core.WorldRotationQuat);
+		WorldTranslationVect = QFMFromCore(Core.WorldTranslationVect);
+		BodyAngularVelocityVect = QFMFromCore(Core.BodyAngularVelocityVect);
+	}
+
 
-	///NEW
-		WorldRotationQuat = bodyTransform.GetRotation(); // in rad
-		WorldTranslationVect = bodyTransform.GetTranslation() / 100.0f; // in m	
-		BodyAngularVelocityVect = FMath::RadiansToDegrees(BodyInstance->GetUnrealWorldAngularVelocityInRadians()); // in deg/s
+	// Copy the editable settings into the core. In Init and on UQuadcopterFlightModel::ApplySettings
+	void SyncCore()
+	{
+		QFM::FFilterChainSettings& Gyro = Core.GyroFilter.Settings;
+		Gyro.LowPassHz = GyroLowPassHz;
+		Gyro.LowPassQ = GyroLowPassQ;
+		Gyro.NotchHz = GyroNotchHz;
+		Gyro.NotchQ = GyroNotchQ;
+		Gyro.bRpmNotch = GyroRpmNotch;
+		Gyro.RpmNotchQ = GyroRpmNotchQ;
+		Gyro.RpmNotchMinHz = GyroRpmNotchMinHz;
+
+		QFM::FFilterChainSettings& Acceleration = Core.AccelerationFilter.Settings;
+		Acceleration.LowPassHz = AccelerationLowPassHz;
+		Acceleration.LowPassQ = AccelerationLowPassQ;
+		Acceleration.NotchHz = AccelerationNotchHz;
+		Acceleration.NotchQ = AccelerationNotchQ;
+
+		QFM::FSensorSettings& Sensors = Core.Sensors.Settings;
+		Sensors.Enabled = SensorsEnabled;
+		Sensors.ImuRateHz = ImuRateHz;
+		Sensors.LatencySeconds = SensorLatency;
+		Sensors.Seed = SensorSeed;
+		Sensors.Gyro.NoiseDensity = GyroNoiseDensity;
+		Sensors.Gyro.BiasRandomWalk = GyroBiasRandomWalk;
+		Sensors.Gyro.InitialBias = GyroInitialBias;
+		Sensors.Gyro.Resolution = GyroResolution;
+		Sensors.Gyro.Range = GyroRange;
+		Sensors.Gyro.Vibration = GyroVibration;
+		Sensors.Accelerometer.NoiseDensity = AccelerometerNoiseDensity;
+		Sensors.Accelerometer.BiasRandomWalk = AccelerometerBiasRandomWalk;
+		Sensors.Accelerometer.InitialBias = AccelerometerInitialBias;
+		Sensors.Accelerometer.Resolution = AccelerometerResolution;
+		Sensors.Accelerometer.Range = AccelerometerRange;
+		Sensors.Accelerometer.Vibration = AccelerometerVibration;
+		Sensors.BaroRateHz = BaroRateHz;
+		Sensors.BaroNoise = BaroNoise;
+		Sensors.BaroBiasRandomWalk = BaroBiasRandomWalk;
+		Sensors.BaroResolution = BaroResolution;
+		Sensors.PositionRateHz = PositionRateHz;
+		Sensors.PositionNoise = PositionNoise;
+		Sensors.HeadingNoise = HeadingNoise;
+
+		QFM::FEstimatorSettings& Estimator = Core.Estimator.Settings;
+		Estimator.Enabled = EstimatorEnabled;
+		Estimator.GyroNoise = EstimatorGyroNoise;
+		Estimator.AccelerometerNoise = EstimatorAccelerometerNoise;
+		Estimator.GyroBiasRandomWalk = EstimatorGyroBiasRandomWalk;
+		Estimator.AccelerometerBiasRandomWalk = EstimatorAccelerometerBiasRandomWalk;
+		Estimator.BaroNoise = EstimatorBaroNoise;
+		Estimator.PositionNoise = EstimatorPositionNoise;
+		Estimator.HeadingNoise = EstimatorHeadingNoise;
+		Estimator.InitialAttitude = EstimatorInitialAttitude;
+		Estimator.InitialVelocity = EstimatorInitialVelocity;
+		Estimator.InitialPosition = EstimatorInitialPosition;
+		Estimator.InitialGyroBias = EstimatorInitialGyroBias;
+		Estimator.InitialAccelerometerBias = EstimatorInitialAccelerometerBias;
+		Estimator.InnovationGate = EstimatorInnovationGate;
 	}
 
 
@@ -153,21 +372,6 @@ struct FAHRS
 
 */
 
-	void Debug(FColor Color, FVector2D DebugFontSize)
-	{
-		
-		// Down to up on the debug screen
-		GEngine->AddOnScreenDebugMessage(-1, 0, Color, FString::Printf(TEXT("Angular Acceleration (deg/s^2): X=%f Y=%f Z=%f"), AngularAcceleration.X, AngularAcceleration.Y, AngularAcceleration.Z), true, DebugFontSize);
-		GEngine->AddOnScreenDebugMessage(-1, 0, Color, FString::Printf(TEXT("Linear Acceleration (m/s^2): %f"), LinearAcceleration), true, DebugFontSize);
-		GEngine->AddOnScreenDebugMessage(-1, 0, Color, FString::Printf(TEXT("Angular Velocity (deg/s): X=%f Y=%f Z=%f"), AngularVelocity.X, AngularVelocity.Y, AngularVelocity.Z), true, DebugFontSize);
-		GEngine->AddOnScreenDebugMessage(-1, 0, Color, FString::Printf(TEXT("Linear Velocity 2D (km/h): %f"), LinearVelocity2D * 3600.0f / 1000.0f), true, DebugFontSize);
-		GEngine->AddOnScreenDebugMessage(-1, 0, Color, FString::Printf(TEXT("Linear Velocity Vector (m/s): X=%f Y=%f Z=%f"), VelocityVector.X, VelocityVector.Y, VelocityVector.Z), true, DebugFontSize);
-		GEngine->AddOnScreenDebugMessage(-1, 0, Color, FString::Printf(TEXT("Linear Velocity (m/s): %f"), LinearVelocity), true, DebugFontSize);
-		GEngine->AddOnScreenDebugMessage(-1, 0, Color, FString::Printf(TEXT("Rotation (deg): R=%f P=%f Y=%f"), Rotation.Roll, Rotation.Pitch, Rotation.Yaw), true, DebugFontSize);
-		GEngine->AddOnScreenDebugMessage(-1, 0, Color, FString::Printf(TEXT("Position (m): X=%f Y=%f Z=%f"), Position.X, Position.Y, Position.Z), true, DebugFontSize);
-		
-	}
-
 
 };
 
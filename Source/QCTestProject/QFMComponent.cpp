@@ -1,5 +1,85 @@
 
 #include "QFMComponent.h"
+#include "QFMFleetManager.h"
+#include "QFMFlightRecorder.h"
+#include "QFMCoreFlightConfig.h"
+
+#include "Debug/DebugDrawService.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectIterator.h"
+
+
+// Stage histograms in `stat QuadcopterFlightModel`, in microseconds
+#define QFM_DECLARE_STAGE_TIMING_STATS(Stage) \
+	DECLARE_FLOAT_COUNTER_STAT(TEXT(#Stage " min (us)"), STAT_QFM_##Stage##_Min, STATGROUP_QuadcopterFlightModel); \
+	DECLARE_FLOAT_COUNTER_STAT(TEXT(#Stage " mean (us)"), STAT_QFM_##Stage##_Mean, STATGROUP_QuadcopterFlightModel); \
+	DECLARE_FLOAT_COUNTER_STAT(TEXT(#Stage " p99 (us)"), STAT_QFM_##Stage##_P99, STATGROUP_QuadcopterFlightModel);
+
+QFM_DECLARE_STAGE_TIMING_STATS(ReadPhysicsState)
+QFM_DECLARE_STAGE_TIMING_STATS(PilotInput)
+QFM_DECLARE_STAGE_TIMING_STATS(AHRS)
+QFM_DECLARE_STAGE_TIMING_STATS(AttitudeController)
+QFM_DECLARE_STAGE_TIMING_STATS(PositionController)
+QFM_DECLARE_STAGE_TIMING_STATS(EngineController)
+QFM_DECLARE_STAGE_TIMING_STATS(ApplyForces)
+QFM_DECLARE_STAGE_TIMING_STATS(Simulate)
+QFM_DECLARE_STAGE_TIMING_STATS(InputToForce)
+
+
+// QFM.ExportTimings [File]: one CSV with the stage timings of every flight model
+static void QFMExportAllTimings(const TArray<FString>& Args)
+{
+	const FString FilePath = Args.Num() > 0 ? Args[0] : FPaths::ProjectSavedDir() / TEXT("Profiling") / TEXT("QFMTimings.csv");
+
+	std::string Csv;
+	for (TObjectIterator<UQuadcopterFlightModel> It; It; ++It)
+	{
+		if (It->GetWorld() && It->HasBegunPlay()) {
+			Csv += It->GetTimings().FormatCsv(TCHAR_TO_UTF8(*It->GetOwner()->GetName()), Csv.empty());
+		}
+	}
+
+	if (FFileHelper::SaveStringToFile(FString(UTF8_TO_TCHAR(Csv.c_str())), *FilePath)) {
+		UE_LOG(LogTemp, Log, TEXT("QuadcopterFlightModel timings written to %s"), *FilePath);
+	}
+}
+
+static void QFMResetAllTimings(const TArray<FString>& Args)
+{
+	for (TObjectIterator<UQuadcopterFlightModel> It; It; ++It)
+	{
+		It->ResetTimings();
+	}
+}
+
+// QFM.BenchStateRead [Iterations]: read-once physics state vs. separate body queries, per flight model
+static void QFMBenchAllStateReads(const TArray<FString>& Args)
+{
+	const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10000;
+	for (TObjectIterator<UQuadcopterFlightModel> It; It; ++It)
+	{
+		if (It->GetWorld() && It->HasBegunPlay()) {
+			It->BenchmarkPhysicsStateRead(Iterations);
+		}
+	}
+}
+
+static FAutoConsoleCommand QFMExportTimingsCommand(
+	TEXT("QFM.ExportTimings"),
+	TEXT("Write min/mean/p50/p99/max of every flight model stage to a CSV file. Optional argument: file path"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&QFMExportAllTimings));
+
+static FAutoConsoleCommand QFMResetTimingsCommand(
+	TEXT("QFM.ResetTimings"),
+	TEXT("Clear the stage timing histograms of every flight model"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&QFMResetAllTimings));
+
+static FAutoConsoleCommand QFMBenchStateReadCommand(
+	TEXT("QFM.BenchStateRead"),
+	TEXT("Time reading the rigid body once per step against the separate queries of AHRS, controller and force application. Optional argument: iterations"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&QFMBenchAllStateReads));
 
 
 UQuadcopterFlightModel::UQuadcopterFlightModel()
@@ -41,10 +121,27 @@ void UQuadcopterFlightModel::BeginPlay()
 	// Init all our Subsystems
 	Vehicle.Init(BodyInstance, Parent);
 	PilotInput.Init(BodyInstance, Parent);
-	AHRS.Init(BodyInstance, Parent);
+	AHRS.Init(BodyInstance, Parent, &EngineController);
 	AttitudeController.Init(BodyInstance, Parent, &PilotInput, &AHRS, &PositionController, &EngineController);
 	PositionController.Init(BodyInstance, Parent, &AHRS, &Vehicle, &EngineController);
 	EngineController.Init(BodyInstance, Parent, &Vehicle);
+	Scheduler.Init();
+
+	// Tells the vehicles apart in flight records and telemetry (GetVehicleId)
+	static int32 NextRecorderVehicleId = 0;
+	RecorderVehicleId = NextRecorderVehicleId++;
+	RecorderStep = 0;
+	if (FQFMFlightRecorder::Get().IsRecording()) {
+		WriteFlightConfig();
+	}
+
+	// Histograms count FPlatformTime::Cycles64 ticks
+	Timings.NsPerTick = FPlatformTime::GetSecondsPerCycle64() * 1e9;
+	Timings.Reset();
+
+	// Debug overlay, drawn once per frame
+	DebugOverlay = MakeUnique<FQFMDebugOverlay>();
+	DebugDrawHandle = UDebugDrawService::Register(TEXT("Game"), FDebugDrawDelegate::CreateUObject(this, &UQuadcopterFlightModel::DrawDebugOverlay));
 
 	// Prepare Substepping, if requested
 	const UPhysicsSettings* Settings = GetDefault<UPhysicsSettings>();
@@ -56,6 +153,49 @@ void UQuadcopterFlightModel::BeginPlay()
 		bSubstep = false;
 	}
 
+	// One physics callback for all flight models of the scene
+	FPhysScene* PhysScene = GetWorld()->GetPhysicsScene();
+	if (FleetStep && PhysScene) {
+		FQFMFleetManager::Register(this, PhysScene, BodyInstance->UseAsyncScene(PhysScene) ? PST_Async : PST_Sync);
+		bFleetRegistered = true;
+
+		// Driven by the physics scene alone. The manager publishes the timing stats once per frame
+		SetComponentTickEnabled(false);
+	}
+
+}
+
+void UQuadcopterFlightModel::ApplySettings()
+{
+	bSettingsChanged = true;
+}
+
+
+#if WITH_EDITOR
+void UQuadcopterFlightModel::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	ApplySettings();
+}
+#endif
+
+
+// Called when the game ends or the component is destroyed
+void UQuadcopterFlightModel::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Waits for a fleet step that is running
+	if (bFleetRegistered) {
+		FQFMFleetManager::Unregister(this);
+		bFleetRegistered = false;
+	}
+
+	if (DebugDrawHandle.IsValid()) {
+		UDebugDrawService::Unregister(DebugDrawHandle);
+		DebugDrawHandle.Reset();
+	}
+	DebugOverlay.Reset();
+
+	Super::EndPlay(EndPlayReason);
 }
 
 //physics substep
@@ -74,11 +214,100 @@ void UQuadcopterFlightModel::TickComponent(float DeltaTime, ELevelTick TickType,
 
     //UE_LOG(LogTemp, Error, TEXT("TICK"));
   
-	if (bSubstep) {
-		BodyInstance->AddCustomPhysics(OnCalculateCustomPhysics);
+	// Otherwise the fleet manager steps us
+	if (!bFleetRegistered) {
+		if (bSubstep) {
+			BodyInstance->AddCustomPhysics(OnCalculateCustomPhysics);
+		}
+		else {
+			Simulate(DeltaTime, BodyInstance);
+		}
 	}
-	else {
-		Simulate(DeltaTime, BodyInstance);
+
+#if STATS
+	// Once per frame for all flight models stepping themselves, the first one to tick publishes
+	static uint64 LastPublishedFrame = 0;
+	if (!bFleetRegistered && LastPublishedFrame != GFrameCounter) {
+		LastPublishedFrame = GFrameCounter;
+		TArray<UQuadcopterFlightModel*> FlightModels;
+		for (TObjectIterator<UQuadcopterFlightModel> It; It; ++It)
+		{
+			if (It->GetWorld() == GetWorld() && It->HasBegunPlay() && !It->bFleetRegistered) {
+				FlightModels.Add(*It);
+			}
+		}
+		PublishTimingStats(FlightModels);
+	}
+#endif
+}
+
+
+// Lowest min, step weighted mean and highest p99 of one stage over the flight models
+static QFM::FTimingSummary QFMSummarizeTimings(const TArray<UQuadcopterFlightModel*>& FlightModels, QFM::ETimedStage Stage)
+{
+	QFM::FTimingSummary Out;
+	double Sum = 0.0;
+	for (const UQuadcopterFlightModel* FlightModel : FlightModels)
+	{
+		const QFM::FTimingSummary Summary = FlightModel->GetTimings().Summarize(Stage);
+		if (Summary.Count == 0) {
+			continue;
+		}
+		Out.MinNs = Out.Count == 0 ? Summary.MinNs : FMath::Min(Out.MinNs, Summary.MinNs);
+		Out.P99Ns = FMath::Max(Out.P99Ns, Summary.P99Ns);
+		Out.MaxNs = FMath::Max(Out.MaxNs, Summary.MaxNs);
+		Sum += Summary.MeanNs * Summary.Count;
+		Out.Count += Summary.Count;
+	}
+	if (Out.Count > 0) {
+		Out.MeanNs = Sum / Out.Count;
+	}
+	return Out;
+}
+
+
+void UQuadcopterFlightModel::PublishTimingStats(const TArray<UQuadcopterFlightModel*>& FlightModels)
+{
+	#define QFM_SET_STAGE_TIMING_STATS(Stage) \
+		{ \
+			const QFM::FTimingSummary Summary = QFMSummarizeTimings(FlightModels, QFM::ETimedStage::Stage); \
+			SET_FLOAT_STAT(STAT_QFM_##Stage##_Min, Summary.MinNs * 0.001); \
+			SET_FLOAT_STAT(STAT_QFM_##Stage##_Mean, Summary.MeanNs * 0.001); \
+			SET_FLOAT_STAT(STAT_QFM_##Stage##_P99, Summary.P99Ns * 0.001); \
+		}
+
+	QFM_SET_STAGE_TIMING_STATS(ReadPhysicsState)
+	QFM_SET_STAGE_TIMING_STATS(PilotInput)
+	QFM_SET_STAGE_TIMING_STATS(AHRS)
+	QFM_SET_STAGE_TIMING_STATS(AttitudeController)
+	QFM_SET_STAGE_TIMING_STATS(PositionController)
+	QFM_SET_STAGE_TIMING_STATS(EngineController)
+	QFM_SET_STAGE_TIMING_STATS(ApplyForces)
+	QFM_SET_STAGE_TIMING_STATS(Simulate)
+	QFM_SET_STAGE_TIMING_STATS(InputToForce)
+
+	#undef QFM_SET_STAGE_TIMING_STATS
+}
+
+
+bool UQuadcopterFlightModel::ExportTimingsCsv(const FString& FilePath)
+{
+	const FString Path = FilePath.IsEmpty() ? FPaths::ProjectSavedDir() / TEXT("Profiling") / FString::Printf(TEXT("QFMTimings_%s.csv"), *GetOwner()->GetName()) : FilePath;
+	const std::string Csv = Timings.FormatCsv(TCHAR_TO_UTF8(*GetOwner()->GetName()), true);
+	return FFileHelper::SaveStringToFile(FString(UTF8_TO_TCHAR(Csv.c_str())), *Path);
+}
+
+
+void UQuadcopterFlightModel::ResetTimings()
+{
+	Timings.Reset();
+}
+
+
+void UQuadcopterFlightModel::DrawDebugOverlay(UCanvas* Canvas, APlayerController* PlayerController)
+{
+	if (Debug.DebugScreen && DebugOverlay) {
+		DebugOverlay->Draw(Canvas, Debug, FPlatformTime::Seconds());
 	}
 }
 
@@ -86,135 +315,176 @@ void UQuadcopterFlightModel::TickComponent(float DeltaTime, ELevelTick TickType,
 
 
 // Pilot Input Related Stuff
+// Called on the game thread. Simulate may run on the physics thread, so commands only go through the exchange
 
 void UQuadcopterFlightModel::InputRoll(float InValue) 
 {	
-	PilotInput.RollAxisInput = InValue; 
+	Exchange.GetPendingCommand().RollAxisInput = InValue;
+	SendPilotCommand();
 }
 
 void UQuadcopterFlightModel::InputPitch(float InValue) 
 { 
-	PilotInput.PitchAxisInput = InValue; 
+	Exchange.GetPendingCommand().PitchAxisInput = InValue;
+	SendPilotCommand();
 }
 
 void UQuadcopterFlightModel::InputYaw(float InValue) 
 { 
-	PilotInput.YawAxisInput = InValue; 
+	Exchange.GetPendingCommand().YawAxisInput = InValue;
+	SendPilotCommand();
 }
 
 void UQuadcopterFlightModel::InputThrottle(float InValue) 
 { 
-	PilotInput.ThrottleAxisInput = InValue; 
+	Exchange.GetPendingCommand().ThrottleAxisInput = InValue;
+	SendPilotCommand();
 }
 
-// Reset all speeds and accelerations
+// Reset all speeds and accelerations. Done by the next physics step, see ReceivePilotCommands
 void UQuadcopterFlightModel::InputKillTrajectory()
 {
-	BodyInstance->SetAngularVelocityInRadians(FVector(0, 0, 0), false);
-	BodyInstance->SetLinearVelocity(FVector(0, 0, 0), false);
+	Exchange.GetPendingCommand().KillTrajectoryCount++;
+	SendPilotCommand();
+}
+
+void UQuadcopterFlightModel::SendPilotCommand()
+{
+	Exchange.GetPendingCommand().SentTicks = FPlatformTime::Cycles64();
+	Exchange.SendCommand();
 }
 
 
 // Engine related stuff. These are callable from Blueprint
+// The HUD getters read the state published by the last physics step, never the controllers
 
 float UQuadcopterFlightModel::GetEnginePercent(int engineNumber) 
 { 
-	return EngineController.GetEnginePercent(engineNumber); 
+	const QFM::FPublishedVehicleState& State = Exchange.ReadState();
+	return (engineNumber >= 0 && engineNumber < State.NumEngines) ? State.EnginePercent[engineNumber] : 0.0f;
 }
 
 
 float UQuadcopterFlightModel::GetEngineRPM(int engineNumber) 
 { 
-	return EngineController.GetEngineRPM(engineNumber);
+	const QFM::FPublishedVehicleState& State = Exchange.ReadState();
+	return (engineNumber >= 0 && engineNumber < State.NumEngines) ? State.EngineRPM[engineNumber] : 0.0f;
 }
 
 
 FVector UQuadcopterFlightModel::GetTotalThrust() 
 {	
-	return EngineController.GetTotalThrust(); 
+	return QFMFromCore(Exchange.ReadState().TotalThrust);
 }
 
 
 FVector UQuadcopterFlightModel::GetTotalTorque() 
 {	
-	return EngineController.GetTotalTorque(); 
+	return QFMFromCore(Exchange.ReadState().TotalTorque);
 }
 
 
 FVector UQuadcopterFlightModel::GetUDPDebugOutput()
 {
-	return AttitudeController.GetUDPDebugOutput();
+	return QFMFromCore(Exchange.ReadState().UDPDebugOutput);
+}
+
+
+void UQuadcopterFlightModel::SetTelemetryRing(QFM::FTelemetryRing* Ring, int32 VehicleId)
+{
+	TelemetryRing = Ring;
+	TelemetryVehicleId = VehicleId;
+}
+
+
+QFM::FFlightModelRefs UQuadcopterFlightModel::GetCoreRefs()
+{
+	QFM::FFlightModelRefs Refs;
+	Refs.Vehicle = &Vehicle.Core;
+	Refs.PilotInput = &PilotInput.Core;
+	Refs.AHRS = &AHRS.Core;
+	Refs.AttitudeController = &AttitudeController.Core;
+	Refs.PositionController = &PositionController.Core;
+	Refs.EngineController = &EngineController.Core;
+	Refs.Scheduler = &Scheduler.Core;
+	return Refs;
+}
+
+
+void UQuadcopterFlightModel::WriteFlightConfig()
+{
+	FQFMFlightRecorder::Get().AppendConfig(QFM::FormatFlightConfigSection(RecorderVehicleId, GetCoreRefs()));
 }
 
 
 float UQuadcopterFlightModel::GetSpeedOverGroundKmh()
 {
 	// 1 m/s = 3.6 km/h
-	return AHRS.LinearVelocity2D * 3.6;
+	return Exchange.ReadState().LinearVelocity2D * 3.6;
 }
 
 float UQuadcopterFlightModel::GetSpeedOverGroundMph()
 {
 	// 1 mph = 1,609344 kmh.
-	return AHRS.LinearVelocity2D / 1.609344 * 3.6;
+	return Exchange.ReadState().LinearVelocity2D / 1.609344 * 3.6;
 }
 
 
 float UQuadcopterFlightModel::GetTrueAirspeedKmh()
 {
 	// 1 m/s = 3.6 km/h
-	return AHRS.LinearVelocity * 3.6;
+	return Exchange.ReadState().LinearVelocity * 3.6;
 }
 
 float UQuadcopterFlightModel::GetTrueAirspeedMph()
 {
 	// 1 mph = 1,609344 kmh.
-	return AHRS.LinearVelocity / 1.609344 * 3.6;
+	return Exchange.ReadState().LinearVelocity / 1.609344 * 3.6;
 }
 
 float UQuadcopterFlightModel::GetForwardSpeedOverGroundKmh()
 {
-	return AHRS.LinearVelocityX * 3.6;
+	return Exchange.ReadState().LinearVelocityX * 3.6;
 }
 
 float UQuadcopterFlightModel::GetForwardSpeedOverGroundMph()
 {
 	// 1 mph = 1,609344 kmh.
-	return AHRS.LinearVelocityX / 1.609344 * 3.6;
+	return Exchange.ReadState().LinearVelocityX / 1.609344 * 3.6;
 }
 
 float UQuadcopterFlightModel::GetTrueAltitudeM()
 {
 	// 1 m = 3,28084 ft.
-	return AHRS.Position.Z * 3.28084;
+	return Exchange.ReadState().Position.Z * 3.28084;
 }
 
 
 float UQuadcopterFlightModel::GetTrueAltitudeFt()
 {
 	// 1 m = 3,28084 ft.
-	return AHRS.Position.Z * 3.28084;
+	return Exchange.ReadState().Position.Z * 3.28084;
 }
 
 float UQuadcopterFlightModel::GetCompassDirectionNorm()
 {
 	// Returns Z World Orientation in 0..1
 	//float NormAngle = FMath::ClampAngle(AHRS.Rotation.Yaw, 0, 360) / 360;
-	float NormAngle = fmod(AHRS.Rotation.Yaw + 360, 360) / 360 + 0.5;
+	float NormAngle = fmod(Exchange.ReadState().Rotation.Yaw + 360, 360) / 360 + 0.5;
 	//UE_LOG(LogTemp,Display, TEXT("%f"),NormAngle);
 	return NormAngle;
 }
 
 float UQuadcopterFlightModel::GetAttitudePitchNorm()
 {
-	float NormAngle = AHRS.Rotation.Pitch / 90 ; // -1: down, 1: up
+	float NormAngle = Exchange.ReadState().Rotation.Pitch / 90 ; // -1: down, 1: up
 	//UE_LOG(LogTemp,Display, TEXT("%f"),NormAngle);
 	return NormAngle;
 }
 
 float UQuadcopterFlightModel::GetAttitudeRollNorm()
 {
-	float NormAngle = fmod(AHRS.Rotation.Roll + 360, 360) / 360;
+	float NormAngle = fmod(Exchange.ReadState().Rotation.Roll + 360, 360) / 360;
 	//UE_LOG(LogTemp,Display, TEXT("%f"),NormAngle);
 	return NormAngle;
 }
@@ -7,9 +7,12 @@
 #include "PhysicsEngine/BodyInstance.h"
 
 #include "DrawDebugHelpers.h"
+#include "HAL/ThreadSafeBool.h"
 
 #include "QFMTypes.h"
 #include "QFMDebug.h"
+#include "QFMDebugOverlay.h"
+#include "QFMScheduler.h"
 
 #include "QFMInputController.h"
 #include "QFMVehicle.h"
@@ -18,6 +21,11 @@
 #include "QFMPositionController.h"
 #include "QFMEngineController.h"
 
+#include "QFMCoreExchange.h"
+#include "QFMCoreFlightRecord.h"
+#include "QFMCoreTelemetry.h"
+#include "QFMCoreTiming.h"
+
 #include "QFMComponent.generated.h"
 
 DECLARE_STATS_GROUP(TEXT("QuadcopterFlightModelComponent"), STATGROUP_QuadcopterFlightModel, STATCAT_Advanced);
@@ -42,10 +50,17 @@ public:
     UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta =(ToolTip="Disable to turn off simulation")) 
 	bool Enabled = true;
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Experimental, opt-in: step with all other flight models of the world in one physics callback, controllers in parallel (QFMFleetManager.h). Off steps from this components own substep delegate. Read at BeginPlay"))
+	bool FleetStep = false;
+
 	/*--- DEBUG CONTROLLER---*/
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Debug-Output"))
 	FQuadcopterFlightModelDebugStruct Debug;
 
+	/*--- SCHEDULER ---*/
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Fixed loop rates of the controller stages"))
+	FQuadcopterFlightModelSchedulerStruct Scheduler;
+
 	/*--- VEHICLE ---*/
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Vehicle Data"))
 	FVehicle Vehicle;
@@ -153,9 +168,22 @@ public:
     // Called when the game starts
     virtual void BeginPlay() override;
     
+    // Called when the game ends or the component is destroyed
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
     // Called every frame
     virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	// The controllers copy their settings into the cores in BeginPlay only. After changing them at runtime call this:
+	// the copy happens at the start of the next physics step, on the thread that steps. Vehicle and frame stay as at BeginPlay
+	UFUNCTION(BlueprintCallable, Category = "QuadcopterFlightModel")
+	void ApplySettings();
+
+#if WITH_EDITOR
+	// Details panel edits while playing
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
   
 	// We declare custom Physics to be called on Substep
 	FCalculateCustomPhysics OnCalculateCustomPhysics;
@@ -172,14 +200,65 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "QuadcopterFlightModel|Engine") 
 	FVector GetUDPDebugOutput();
 
+	// Per stage timing histograms (min/mean/p99 also in `stat QuadcopterFlightModel`). Empty FilePath: Saved/Profiling/QFMTimings_<Name>.csv
+	UFUNCTION(BlueprintCallable, Category = "QuadcopterFlightModel|Debug")
+	bool ExportTimingsCsv(const FString& FilePath);
+
+	UFUNCTION(BlueprintCallable, Category = "QuadcopterFlightModel|Debug")
+	void ResetTimings();
+
+	// Histograms of all timed stages. Recorded on the physics thread
+	const QFM::FStageTimings& GetTimings() const { return Timings; }
+
+	// Logs the cost of one QFMReadPhysicsState against the separate body queries a step made before it
+	void BenchmarkPhysicsStateRead(int32 Iterations);
+
+	// Push one sample (thrust, torque, UDP debug output) per physics step into this ring (nullptr: off).
+	// The ring must be the physics thread producer ring and outlive this component
+	void SetTelemetryRing(QFM::FTelemetryRing* Ring, int32 VehicleId);
+
+	// Unique per flight model of the session, set in BeginPlay. Vehicle id of its flight records and telemetry
+	uint32 GetVehicleId() const { return RecorderVehicleId; }
+
+	// The cores behind the USTRUCT adapters, for recorder, config and replay code
+	QFM::FFlightModelRefs GetCoreRefs();
+
+	// Parameters of every core as a section of the flight record config file (QFMCoreFlightConfig.h).
+	// Written once per vehicle when the recorder starts or the vehicle begins play during a recording
+	void WriteFlightConfig();
+
     
 private:
+
+	// Runs BeginStep, StepControllers and EndStep of all its flight models apart
+	friend class FQFMFleetManager;
     
 	// We declare custom Physics to be called on Substep
     void CustomPhysics(float DeltaTime, FBodyInstance* bodyInst);
 
 	// Simulation Step. Is called by Tick and by CustomPhysics
     void Simulate(float DeltaTime, FBodyInstance* bodyInst);
+
+	// The three parts of Simulate. BeginStep reads the body, false if there is nothing to simulate.
+	// StepControllers touches nothing but this component, EndStep writes the forces to the body
+	bool BeginStep();
+	void StepControllers(float DeltaTime);
+	void EndStep(float DeltaTime);
+
+	// Stepped by the fleet manager of our physics scene instead of Tick / CustomPhysics
+	bool bFleetRegistered = false;
+
+	// Set by ApplySettings, BeginStep syncs the controller settings into the cores
+	FThreadSafeBool bSettingsChanged;
+
+	// Simulate stage cycles of the current step, summed over its three parts
+	uint64 StepCycles = 0;
+
+	// Run all stages once with the physics DeltaTime (Scheduler disabled)
+	void SimulateSingleRate(float DeltaTime);
+
+	// Run the stages at their fixed rates, substepping the rate loop
+	void SimulateMultiRate(float DeltaTime);
     
 	// Our Body Instances Parent (Our Primitive Component)
 	UPrimitiveComponent *Parent;
@@ -190,6 +269,62 @@ private:
 	// Will be set True if we substep physics
 	bool bSubstep;
 
+	// Simulated time in s, advanced by every physics step
+	double SimulationTime = 0.0;
+
+	// Rigid body state of the current physics step, read once at the start of Simulate
+	QFM::FPhysicsState PhysicsState;
+
+	// Forces of the current physics step, applied by EndStep
+	FVector AppliedThrust = FVector::ZeroVector;
+	FVector AppliedTorque = FVector::ZeroVector;
+
+	// With async substepping Simulate runs on the physics thread: pilot commands come in and the HUD state goes out
+	// only through this exchange, never through the controller structs
+	QFM::FFlightModelExchange Exchange;
+	uint32 AppliedKillTrajectoryCount = 0;
+
+	// Physics thread side of the exchange, at the start and the end of Simulate
+	void ReceivePilotCommands();
+	void PublishVehicleState();
+
+	// Game thread side, stamps the command for the InputToForce timing
+	void SendPilotCommand();
+
+	// Send time of the command received this step, recorded once its forces are applied. 0: none
+	uint64 ReceivedCommandTicks = 0;
+
+	// Telemetry output, written on the physics thread
+	QFM::FTelemetryRing* TelemetryRing = nullptr;
+	uint32 TelemetryVehicleId = 0;
+
+	void PushTelemetry();
+
+	// Flight data recorder (QFM.Record.Start): one record per physics step, pushed on the thread Simulate runs on
+	uint32 RecorderVehicleId = 0;
+	uint32 RecorderStep = 0;
+
+	void PushFlightRecord(float DeltaTime);
+
+	// Stage timing histograms, see QFM_SCOPE_STAGE in QFMSimulation.cpp
+	QFM::FStageTimings Timings;
+
+public:
+
+	// Copy min/mean/p99 of every stage over these flight models into the float stats of STATGROUP_QuadcopterFlightModel:
+	// lowest min, mean over all their steps, highest p99. The stats are global, so game thread and once per frame:
+	// the fleet manager for its flight models, TickComponent for all that step themselves
+	static void PublishTimingStats(const TArray<UQuadcopterFlightModel*>& FlightModels);
+
+private:
+
+	// On-screen debug: a snapshot per physics step, formatted and drawn on the game thread (UDebugDrawService "Game")
+	TUniquePtr<FQFMDebugOverlay> DebugOverlay;
+	FDelegateHandle DebugDrawHandle;
+
+	void CaptureDebugSnapshot();
+	void DrawDebugOverlay(UCanvas* Canvas, APlayerController* PlayerController);
+
 	
 	
 	
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Components/PrimitiveComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+
+#include "QFMCoreTypes.h"
+
+
+/*--- Conversions between UE4 types and the engine independent flight model core ---*/
+
+FORCEINLINE QFM::FVec2 QFMToCore(const FVector2D& V) { return QFM::FVec2(V.X, V.Y); }
+FORCEINLINE QFM::FVec3 QFMToCore(const FVector& V) { return QFM::FVec3(V.X, V.Y, V.Z); }
+FORCEINLINE QFM::FVec4 QFMToCore(const FVector4& V) { return QFM::FVec4(V.X, V.Y, V.Z, V.W); }
+FORCEINLINE QFM::FQuatf QFMToCore(const FQuat& Q) { return QFM::FQuatf(Q.X, Q.Y, Q.Z, Q.W); }
+
+FORCEINLINE FVector QFMFromCore(const QFM::FVec3& V) { return FVector(V.X, V.Y, V.Z); }
+FORCEINLINE FVector4 QFMFromCore(const QFM::FVec4& V) { return FVector4(V.X, V.Y, V.Z, V.W); }
+FORCEINLINE FQuat QFMFromCore(const QFM::FQuatf& Q) { return FQuat(Q.X, Q.Y, Q.Z, Q.W); }
+FORCEINLINE FRotator QFMFromCore(const QFM::FRotatorf& R) { return FRotator(R.Pitch, R.Yaw, R.Roll); }
+
+
+// Read the body state the controllers need, converted to SI units
+FORCEINLINE QFM::FBodyState QFMReadBodyState(const FTransform& Transform, FBodyInstance* BodyInstance)
+{
+	QFM::FBodyState Body;
+	Body.Rotation = QFMToCore(Transform.GetRotation());
+	Body.Position = QFMToCore(Transform.GetTranslation() / 100.0f); // in m
+	Body.LinearVelocity = QFMToCore(BodyInstance->GetUnrealWorldVelocity() / 100.0f); // in m/s
+	Body.AngularVelocity = QFMToCore(BodyInstance->GetUnrealWorldAngularVelocityInRadians()); // in rad/s
+	return Body;
+}
+
+
+// One read of everything a physics step needs: transform, velocities, mass and inertia
+FORCEINLINE QFM::FPhysicsState QFMReadPhysicsState(FBodyInstance* BodyInstance)
+{
+	const QFM::FBodyState Body = QFMReadBodyState(BodyInstance->GetUnrealWorldTransform(), BodyInstance);
+	return QFM::MakePhysicsState(Body, QFMToCore(BodyInstance->GetBodyInertiaTensor()), BodyInstance->GetBodyMass());
+}
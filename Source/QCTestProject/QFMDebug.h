@@ -21,6 +21,15 @@ struct FQuadcopterFlightModelDebugStruct
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Debug: Font Color")) 
 	FColor Color = FColor::White;
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Debug: Top left corner of the overlay in pixels"))
+	FVector2D ScreenPosition = FVector2D(20.0f, 120.0f);
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Debug: Offset of the overlay of every further vehicle in pixels, so overlays do not overwrite each other"))
+	FVector2D VehicleOffset = FVector2D(0.0f, 320.0f);
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Debug: Overlay text updates per second. 0 = every rendered frame", ClampMin = "0"))
+	float OverlayHz = 10.0f;
+
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Debug: Display Pilot Input")) 
 	bool PrintInput = true;
@@ -39,6 +48,9 @@ struct FQuadcopterFlightModelDebugStruct
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Debug: Display EngineControl Data")) 
 	bool PrintEngineControl = true;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Debug: Display Scheduler Rates"))
+	bool PrintScheduler = true;
 	
     
 	/*
@@ -0,0 +1,131 @@
+
+#include "QFMDebugOverlay.h"
+
+#include "Engine/Canvas.h"
+#include "Engine/Engine.h"
+#include "Engine/Font.h"
+
+#include "QFMDebug.h"
+
+
+uint64 FQFMDebugOverlay::UsedSlots = 0;
+
+
+FQFMDebugOverlay::FQFMDebugOverlay()
+	: Slot(0)
+	, CapturedSteps(0)
+	, NumLines(0)
+	, LastFormatTime(0.0)
+{
+	check(IsInGameThread());
+	while (Slot < MaxSlots - 1 && (UsedSlots & (1ull << Slot))) {
+		Slot++;
+	}
+	UsedSlots |= 1ull << Slot;
+
+	for (FString& Line : Lines)
+	{
+		Line.Reset(LineCapacity);
+	}
+	FormatBuffer[0] = 0;
+}
+
+
+FQFMDebugOverlay::~FQFMDebugOverlay()
+{
+	check(IsInGameThread());
+	UsedSlots &= ~(1ull << Slot);
+}
+
+
+void FQFMDebugOverlay::Draw(UCanvas* Canvas, const FQuadcopterFlightModelDebugStruct& Settings, double Now)
+{
+	if (!Canvas) {
+		return;
+	}
+
+	// Rate limit the formatting, not the drawing: the last lines are drawn every frame
+	const bool bDue = Settings.OverlayHz <= 0.0f || Now - LastFormatTime >= 1.0 / Settings.OverlayHz;
+	if (bDue && Snapshots.Update()) {
+		Format(Settings);
+		LastFormatTime = Now;
+	}
+
+	UFont* Font = GEngine->GetSmallFont();
+	const float LineHeight = Font->GetMaxCharHeight() * Settings.FontSize.Y;
+	const FVector2D Position = Settings.ScreenPosition + Settings.VehicleOffset * (float)Slot;
+	float Y = Position.Y;
+
+	Canvas->SetDrawColor(Settings.Color);
+	for (int32 i = 0; i < NumLines; i++)
+	{
+		Canvas->DrawText(Font, Lines[i], Position.X, Y, Settings.FontSize.X, Settings.FontSize.Y);
+		Y += LineHeight;
+	}
+}
+
+
+void FQFMDebugOverlay::Format(const FQuadcopterFlightModelDebugStruct& Settings)
+{
+	const FQFMDebugSnapshot& S = Snapshots.GetReadBuffer();
+	NumLines = 0;
+
+	AddLine(TEXT("Time (s): %.3f  Physics Steps: %u"), S.SimulationTime, S.Steps);
+
+	if (Settings.PrintAHRS) {
+		AddLine(TEXT("Position (m): X=%f Y=%f Z=%f"), S.Position.X, S.Position.Y, S.Position.Z);
+		AddLine(TEXT("Rotation (deg): R=%f P=%f Y=%f"), S.Rotation.Roll, S.Rotation.Pitch, S.Rotation.Yaw);
+		AddLine(TEXT("Linear Velocity (m/s): %f"), S.LinearVelocity);
+		AddLine(TEXT("Linear Velocity Vector (m/s): X=%f Y=%f Z=%f"), S.VelocityVector.X, S.VelocityVector.Y, S.VelocityVector.Z);
+		AddLine(TEXT("Linear Velocity 2D (km/h): %f"), S.LinearVelocity2D * 3.6f);
+		AddLine(TEXT("Angular Velocity (deg/s): X=%f Y=%f Z=%f"), S.AngularVelocity.X, S.AngularVelocity.Y, S.AngularVelocity.Z);
+		AddLine(TEXT("Linear Acceleration (m/s^2): %f"), S.LinearAcceleration);
+		AddLine(TEXT("Angular Acceleration (deg/s^2): X=%f Y=%f Z=%f"), S.AngularAcceleration.X, S.AngularAcceleration.Y, S.AngularAcceleration.Z);
+	}
+
+	if (Settings.PrintVehicle) {
+		AddLine(TEXT("Mass (kg): %f"), S.Mass);
+		AddLine(TEXT("Moment of intertia (kg*m^2): X=%f Y=%f Z=%f"), S.InertiaTensor.X / 10000.0f, S.InertiaTensor.Y / 10000.0f, S.InertiaTensor.Z / 10000.0f);
+		AddLine(TEXT("Center of Mass (m): X=%f Y=%f Z=%f"), S.CenterOfMass.X, S.CenterOfMass.Y, S.CenterOfMass.Z);
+	}
+
+	if (Settings.PrintInput) {
+		AddLine(TEXT("Pilot Input (R,P,Y,T): %f %f %f %f"), S.DesiredPilotInput.X, S.DesiredPilotInput.Y, S.DesiredPilotInput.Z, S.DesiredPilotInput.W);
+	}
+
+	if (Settings.PrintEngineControl) {
+		AddEngineLine(TEXT("Mixer %  :"), S.EngineMixPercent, S.NumEngines);
+		AddEngineLine(TEXT("Engines %  :"), S.EnginePercent, S.NumEngines);
+		AddEngineLine(TEXT("Engines RPM:"), S.EngineRPM, S.NumEngines);
+		AddLine(TEXT("Thrust / Torque: X=%f Y=%f Z=%f / X=%f Y=%f Z=%f"), S.Thrust.X, S.Thrust.Y, S.Thrust.Z, S.Torque.X, S.Torque.Y, S.Torque.Z);
+	}
+
+	if (Settings.PrintScheduler && S.RateLoopHz > 0.0f) {
+		AddLine(TEXT("Scheduler Hz: Rate=%.0f Input=%.0f AHRS=%.0f Position=%.0f Ticks=%llu Dropped=%llu"),
+			S.RateLoopHz, S.InputHz, S.AHRSHz, S.PositionHz, (unsigned long long)S.TickCount, (unsigned long long)S.DroppedTicks);
+	}
+}
+
+
+void FQFMDebugOverlay::AddEngineLine(const TCHAR* Label, const float* Values, int32 NumValues)
+{
+	if (NumLines >= MaxLines) {
+		return;
+	}
+
+	// Up to 8 engines fit into LineCapacity, a longer line is cut
+	int32 Length = FMath::Max(0, FCString::Snprintf(FormatBuffer, LineCapacity, TEXT("%s"), Label));
+	for (int32 i = 0; i < NumValues && Length < LineCapacity - 1; i++)
+	{
+		const int32 Written = FCString::Snprintf(FormatBuffer + Length, LineCapacity - Length, TEXT(" %d=%f"), i + 1, Values[i]);
+		if (Written < 0) {
+			break;
+		}
+		Length += Written;
+	}
+	FormatBuffer[LineCapacity - 1] = 0;
+
+	FString& Line = Lines[NumLines++];
+	Line.Reset(LineCapacity);
+	Line.AppendChars(FormatBuffer, FCString::Strlen(FormatBuffer));
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "QFMCoreMixer.h"
+#include "QFMCoreTripleBuffer.h"
+
+class UCanvas;
+class UFont;
+struct FQuadcopterFlightModelDebugStruct;
+
+
+/*--- Values shown by the debug overlay, captured once per physics step ---*/
+// Plain copy of what the old per-struct Debug() calls printed. Trivially copyable, no strings.
+struct FQFMDebugSnapshot
+{
+	double SimulationTime = 0.0;
+	uint32 Steps = 0;				// physics steps captured so far
+
+	// AHRS
+	FVector Position = FVector::ZeroVector;
+	FRotator Rotation = FRotator::ZeroRotator;
+	FVector VelocityVector = FVector::ZeroVector;
+	float LinearVelocity = 0.0f;
+	float LinearVelocity2D = 0.0f;
+	float LinearAcceleration = 0.0f;
+	FVector AngularVelocity = FVector::ZeroVector;
+	FVector AngularAcceleration = FVector::ZeroVector;
+
+	// Vehicle
+	float Mass = 0.0f;
+	FVector InertiaTensor = FVector::ZeroVector;	// kg*cm^2
+	FVector CenterOfMass = FVector::ZeroVector;
+
+	// Pilot input
+	FVector4 DesiredPilotInput = FVector4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	// Engines, the first NumEngines are valid
+	int32 NumEngines = 0;
+	float EngineMixPercent[QFM::MaxEngines] = {};
+	float EnginePercent[QFM::MaxEngines] = {};
+	float EngineRPM[QFM::MaxEngines] = {};
+	FVector Thrust = FVector::ZeroVector;
+	FVector Torque = FVector::ZeroVector;
+
+	// Scheduler (zero when disabled)
+	float RateLoopHz = 0.0f;
+	float InputHz = 0.0f;
+	float AHRSHz = 0.0f;
+	float PositionHz = 0.0f;
+	uint64 TickCount = 0;
+	uint64 DroppedTicks = 0;
+};
+
+
+
+/*--- On-screen debug overlay of one flight model ---*/
+// The physics thread only copies a snapshot per step (Capture). The game thread formats the latest one into
+// preallocated lines once per rendered frame, or at most at the given rate, and draws them in one canvas callback.
+// Every overlay takes the lowest free slot and is drawn VehicleOffset * slot away from ScreenPosition.
+class FQFMDebugOverlay
+{
+public:
+
+	// Game thread
+	FQFMDebugOverlay();
+	~FQFMDebugOverlay();
+
+	// Physics thread: fill GetCaptureBuffer(), then Publish(). Never blocks
+	FORCEINLINE FQFMDebugSnapshot& GetCaptureBuffer()
+	{
+		return Snapshots.GetWriteBuffer();
+	}
+
+	FORCEINLINE void Publish()
+	{
+		Snapshots.GetWriteBuffer().Steps = ++CapturedSteps;
+		Snapshots.Publish();
+	}
+
+
+	// Game thread: re-format if the update interval is over (UpdateHz <= 0: every frame) and draw all lines
+	void Draw(UCanvas* Canvas, const FQuadcopterFlightModelDebugStruct& Settings, double Now);
+
+
+private:
+
+	// Formats the latest snapshot into Lines
+	void Format(const FQuadcopterFlightModelDebugStruct& Settings);
+
+	// "Label 1=.. 2=.." with one value per engine
+	void AddEngineLine(const TCHAR* Label, const float* Values, int32 NumValues);
+
+	// printf into the next preallocated line. Keeps the allocation of the previous frame
+	template <typename FmtType, typename... Types>
+	void AddLine(const FmtType& Fmt, Types... Args)
+	{
+		if (NumLines >= MaxLines) {
+			return;
+		}
+		FCString::Snprintf(FormatBuffer, LineCapacity, Fmt, Args...);
+		FormatBuffer[LineCapacity - 1] = 0;
+
+		FString& Line = Lines[NumLines++];
+		Line.Reset(LineCapacity);
+		Line.AppendChars(FormatBuffer, FCString::Strlen(FormatBuffer));
+	}
+
+	static const int32 MaxLines = 24;
+	static const int32 LineCapacity = 160;
+
+	QFM::TTripleBuffer<FQFMDebugSnapshot> Snapshots;
+
+	// Screen slot of this overlay, one bit per slot in UsedSlots. Game thread
+	static const int32 MaxSlots = 64;
+	static uint64 UsedSlots;
+	int32 Slot;
+
+	// Physics thread only
+	uint32 CapturedSteps;
+
+	// Game thread only
+	FString Lines[MaxLines];
+	int32 NumLines;
+	TCHAR FormatBuffer[LineCapacity];
+	double LastFormatTime;
+};
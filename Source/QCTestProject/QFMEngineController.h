@@ -8,6 +8,8 @@
 
 #include "QFMTypes.h"
 #include "QFMVehicle.h" // I must read Properties like FrameType and Gravity 
+#include "QFMCoreEngine.h"
+#include "QFMCoreBridge.h"
 
 
 #include "QFMEngineController.generated.h"
@@ -27,52 +29,29 @@
 // pitch down = +
 // yaw right = +
 
-USTRUCT()
-struct FQuadcopterFlightModelMixerStruct
+
+// One static thrust bench measurement
+USTRUCT(BlueprintType)
+struct FEngineCurvePoint
 {
 	GENERATED_BODY()
 
-	UPROPERTY() float Throttle = 0.0f;
-	UPROPERTY() float Roll = 0.0f;
-	UPROPERTY() float Pitch = 0.0f;
-	UPROPERTY() float Yaw = 0.0f;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|MeasuredCurve", meta = (ToolTip = "Engine RPM")) 
+	float RPM = 0.0f;
 
-	// constructor that takes parameters
-	FQuadcopterFlightModelMixerStruct(float InThrottle, float InRoll, float InPitch, float InYaw)
-		: Throttle(InThrottle), Roll(InRoll), Pitch(InPitch), Yaw(InYaw)
-	{};
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|MeasuredCurve", meta = (ToolTip = "Static thrust in N")) 
+	float Thrust = 0.0f;
 
-	// constructor that takes no parameters
-	FQuadcopterFlightModelMixerStruct()
-	{};
-	
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|MeasuredCurve", meta = (ToolTip = "Reaction torque in N*m")) 
+	float Torque = 0.0f;
 };
 
 
-
-
 /*--- Implementation of the EngineController ---*/
 USTRUCT(BlueprintType)
 struct FEngineController
 {
 	GENERATED_BODY()
-/*
-	UPROPERTY() 
-	float RollRequest; // -1..1
-
-	UPROPERTY() 
-	float PitchRequest; // -1..1
-
-	UPROPERTY() 
-	float YawRequest; // -1..1
-*/
-
-	UPROPERTY() 
-	FVector RotationRequest; // -1..1 
-
-	UPROPERTY() 
-	float ThrottleRequest; // 0..1
-
 
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings", meta = (ToolTip = "Engine Max RPM")) 
@@ -95,37 +74,38 @@ struct FEngineController
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings", meta = (ToolTip = "Calculate Engine_K with Thrust To lift PlanMaxLift * weight")) 
 	float PlanMaxLift = 2.0f;
-	
-	
-	// Mixer
-	UPROPERTY() 
-	FQuadcopterFlightModelMixerStruct MixerQuadCross[4] = {
-		{ +1, -1,  -1, -1 }, // RF-
-		{ +1, -1,  +1, +1 }, // RB+
-		{ +1, +1,  +1, -1 }, // LB-
-		{ +1, +1,  -1, +1 } // LF+
-	}; // TRPY
-		
-	UPROPERTY()
-	FQuadcopterFlightModelMixerStruct MixerQuadPlus[4] = {
-		{ +1, 0,  -1, -1 }, // F-
-		{ +1, -1,  0, +1 }, // R+
-		{ +1, 0,  +1, -1 }, // B-
-		{ +1, +1,  0, +1 } // L+
-	}; // TRPY
-	
-	UPROPERTY()
-	float EngineMixPercent[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-	
-	UPROPERTY()
-	float EngineSpeed[4] = {0.0f, 0.0f, 0.0f, 0.0f}; // 0..1
 
-	UPROPERTY()
-	FVector TotalThrust = FVector(0.0f, 0.0f, 0.0f);
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings", meta = (ToolTip = "Use MeasuredCurve instead of Engine_K/Q/B/QQ")) 
+	bool UseMeasuredCurve = false;
 
-	UPROPERTY()
-	FVector TotalTorque = FVector(0.0f, 0.0f, 0.0f);;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings", meta = (ToolTip = "Static thrust measurements sorted by RPM, at most 32, read at BeginPlay")) 
+	TArray<FEngineCurvePoint> MeasuredCurve;
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings", meta = (ToolTip = "Torque from mixer, engine speeds and frame instead of applying the rotation request directly. Needs a retuned attitude loop")) 
+	bool UseMixerTorque = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|Dynamics", meta = (ToolTip = "Engine speed lags behind the mixer (first order spin-up / spin-down). Off: instant")) 
+	bool MotorDynamics = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|Dynamics", meta = (ToolTip = "Spin-up time constant in s, 0 = instant", ClampMin = "0")) 
+	float SpinUpTimeConstant = 0.03f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|Dynamics", meta = (ToolTip = "Spin-down time constant in s, 0 = instant", ClampMin = "0")) 
+	float SpinDownTimeConstant = 0.06f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|Dynamics", meta = (ToolTip = "Max spin-up in speed (0..1) per s, 0 = unlimited", ClampMin = "0")) 
+	float MaxSpinUpRate = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|Dynamics", meta = (ToolTip = "Max spin-down in speed (0..1) per s, 0 = unlimited", ClampMin = "0")) 
+	float MaxSpinDownRate = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterEngineSettings|Dynamics", meta = (ToolTip = "Idle speed (0..1) the engines never fall below", ClampMin = "0", ClampMax = "1")) 
+	float IdleSpeed = 0.0f;
+	
+	
+	/*--- CORE ---*/
+	// Mixer, engine state and force calculation live in QFM::FEngineCore
+	QFM::FEngineCore Core;
 
 
 	/*--- INTERFACE DATA ---*/
@@ -142,10 +122,13 @@ struct FEngineController
 		BodyInstance = BodyInstanceIn;
 		PrimitiveComponent = PrimitiveComponentIn;
 		Vehicle = VehicleIn;
-		if(CalculateEngine_K)
-		{
-			Engine_K = (PlanMaxLift * Vehicle->Mass * -Vehicle->Gravity) / ( Vehicle->NumberOfEngines * FMath::Pow(1.0f, Engine_Q));
-		}
+
+		SyncCore();
+		SyncMeasuredCurve();
+		Core.Init(&Vehicle->Core);
+		
+		// Engine_K may have been calculated
+		Engine_K = Core.Engine_K;
 	}
 
 	
@@ -158,196 +141,53 @@ struct FEngineController
 	void Tock(float DeltaTimeIn)
 	{
 		DeltaTime = DeltaTimeIn;
-		
-		// Keep Throttle RPY Mix in a good range
-		UpdateThrottleRPYMix();
-
-		// Mix Pilot Input to meet Frame Mode 
 
-		//MixEngines();
-/// Here we fake. Engine Controller is still disfunctional!
-for(int i=0; i<4;i++)
-	EngineMixPercent[i]=ThrottleRequest;
-	
-		// Apply Engine RPM ... Now: Only Mixed but no Attitude Controller
-		SetEnginesFromMixer();
-		
-
-		// Calculate new Forces
-		GetEngineForces();
-
-		//PrimitiveComponent->SetPhysicsAngularVelocityInRadians(TotalTorque, true, NAME_None);
-/// Here we fake. Engine Controller is still disfunctional!3
-TotalTorque=RotationRequest;
-//TotalThrust=FVector::ZeroVector;
-
-	}
-
-	
-	// Update Throttle Mix to stay in controllable range
-	void UpdateThrottleRPYMix()
-	{
-
-	}
-
-
-
-	/* --- MIXER --- */
-
-	void MixEngines() 
-	{
-
-		if (Vehicle->FrameMode == EFrameMode::FrameModeCross)
-		{
-			for (int i = 0; i < 4; i++) {
-				EngineMixPercent[i] = (
-					ThrottleRequest   * MixerQuadCross[i].Throttle +
-					RotationRequest.X * MixerQuadCross[i].Roll +
-					RotationRequest.Y * MixerQuadCross[i].Pitch +
-					RotationRequest.Z * MixerQuadCross[i].Yaw
-					);
-				
-			}
-		}
-		else if (Vehicle->FrameMode == EFrameMode::FrameModePlus)
-		{
-			for (int i = 0; i < 4; i++) {
-				EngineMixPercent[i] = (
-					ThrottleRequest     * MixerQuadPlus[i].Throttle +
-					RotationRequest.X * MixerQuadPlus[i].Roll +
-					RotationRequest.Y * MixerQuadPlus[i].Pitch +
-					RotationRequest.Z * MixerQuadPlus[i].Yaw
-					);
-			}
-		}
-
-
-		float maxMotorPercent = EngineMixPercent[0];
-
-		for (int i = 1; i < 4; i++)
-			if (EngineMixPercent[i] > maxMotorPercent)
-				maxMotorPercent = EngineMixPercent[i];
-
-		for (int i = 0; i < 4; i++)
-		{
-			// This is a way to still have good gyro corrections if at least one motor reaches its max
-			if (EngineMixPercent[i] > 1) 
-			{
-				EngineMixPercent[i] -= EngineMixPercent[i] - 1;
-			}
-
-			// Keep motor values in interval [0,1]
-			EngineMixPercent[i] = FMath::Clamp<float>(EngineMixPercent[i], 0, 1);
-		}
-	
-	
+		Core.Tock(DeltaTime);
 	}
 
 
-
-
-
-	void SetEnginesFromMixer(void)
+	// Copy the editable settings into the core. In Init and on UQuadcopterFlightModel::ApplySettings
+	void SyncCore()
 	{
-		for (int i = 0; i < 4; i++)
-		{
-			EngineSpeed[i] = EngineMixPercent[i];
-		}
-		
+		Core.EngineMaxRPM = EngineMaxRPM;
+		Core.SetCoefficients(Engine_K, Engine_Q, Engine_B, Engine_QQ);
+		Core.CalculateEngine_K = CalculateEngine_K;
+		Core.UseMixerTorque = UseMixerTorque;
+		Core.PlanMaxLift = PlanMaxLift;
+
+		QFM::FMotorDynamicsSettings& Dynamics = Core.MotorDynamics.Settings;
+		Dynamics.Enabled = MotorDynamics;
+		Dynamics.SpinUpTimeConstant = SpinUpTimeConstant;
+		Dynamics.SpinDownTimeConstant = SpinDownTimeConstant;
+		Dynamics.MaxSpinUpRate = MaxSpinUpRate;
+		Dynamics.MaxSpinDownRate = MaxSpinDownRate;
+		Dynamics.IdleSpeed = IdleSpeed;
 	}
 
-
-	
-
-
-	void GetEngineForces()
+	// The curve is baked once in Init
+	void SyncMeasuredCurve()
 	{
-
-
-		// Calculate Thrust from all Engines
-		float sum = 0;
-		for (int i = 0; i<4; i++)
-			sum += FMath::Pow(EngineSpeed[i], Engine_Q);
-		TotalThrust = FVector(0.0f, 0.0f, Engine_K * sum);
-
-
-
-		// ODO: Verallgemeinern!!!
-		// Und in die Propertries
-		// Genauso: L (ArmLength: Array mit Wert pro Engine. Und in die Properties
-		float EngineAlpha[4];
-
-		if (Vehicle->FrameMode == EFrameMode::FrameModeCross)
-		{
-			EngineAlpha[0] = FMath::DegreesToRadians<float>(45);
-			EngineAlpha[1] = FMath::DegreesToRadians<float>(45);
-			EngineAlpha[2] = FMath::DegreesToRadians<float>(45);
-			EngineAlpha[3] = FMath::DegreesToRadians<float>(45);
-		}
-		else if (Vehicle->FrameMode == EFrameMode::FrameModePlus)
+		Core.UseMeasuredCurve = UseMeasuredCurve;
+		Core.NumMeasuredCurvePoints = FMath::Min(MeasuredCurve.Num(), QFM::MaxMotorCurvePoints);
+		for (int32 i = 0; i < Core.NumMeasuredCurvePoints; i++)
 		{
-			EngineAlpha[0] = FMath::DegreesToRadians<float>(0);
-			EngineAlpha[1] = FMath::DegreesToRadians<float>(90);
-			EngineAlpha[2] = FMath::DegreesToRadians<float>(0);
-			EngineAlpha[3] = FMath::DegreesToRadians<float>(90);
+			Core.MeasuredCurve[i].RPM = MeasuredCurve[i].RPM;
+			Core.MeasuredCurve[i].Thrust = MeasuredCurve[i].Thrust;
+			Core.MeasuredCurve[i].Torque = MeasuredCurve[i].Torque;
 		}
-
-		
-
-		
-		// Calculate Torque from all Engines
-		
-		float SpeedToThrust[4];
-		float SpeedToTorque[4];
-		for (int i = 0; i<4; i++)
-		{
-			SpeedToThrust[i] = FMath::Pow(EngineSpeed[i], Engine_Q);
-			SpeedToTorque[i] = FMath::Pow(EngineSpeed[i], Engine_QQ);
-		}
-		
-		
-		FVector EngineTorque = FVector(0.0f, 0.0f, 0.0f);
-
-		if (Vehicle->FrameMode == EFrameMode::FrameModeCross)
-		{
-			for (int i = 0; i < 4; i++)
-			{
-				EngineTorque.X += MixerQuadCross[i].Roll * SpeedToThrust[i] * sinf(EngineAlpha[i]) * Vehicle->ArmLength * Engine_K ;
-				EngineTorque.Y += MixerQuadCross[i].Pitch * SpeedToThrust[i] * cosf(EngineAlpha[i]) * Vehicle->ArmLength * Engine_K;
-				EngineTorque.Z += MixerQuadCross[i].Yaw * SpeedToTorque[i] * Engine_B;
-			}
-
-		}
-		else if (Vehicle->FrameMode == EFrameMode::FrameModePlus)
-		{
-			for (int i = 0; i < 4; i++)
-			{
-				EngineTorque.X += MixerQuadPlus[i].Roll * SpeedToThrust[i] * sinf(EngineAlpha[i]) * Vehicle->ArmLength * Engine_K;
-				EngineTorque.Y += MixerQuadPlus[i].Pitch * SpeedToThrust[i] * cosf(EngineAlpha[i]) * Vehicle->ArmLength * Engine_K;
-				EngineTorque.Z += MixerQuadPlus[i].Yaw * SpeedToTorque[i] * Engine_B;
-			}
-
-		}
-		TotalTorque = EngineTorque;
-
-		
 	}
 
 
 
-
-
 	void SetEnginePercent(int engineNumber, float inValue)
 	{
-		EngineSpeed[engineNumber] = inValue;
-		EngineSpeed[engineNumber] = FMath::Clamp<float>(EngineSpeed[engineNumber], 0.0f, 1.0f);
+		Core.SetEnginePercent(engineNumber, inValue);
 	}
 
 
 	void SetEngineRPM(int engineNumber, float inValue)
 	{
-		EngineSpeed[engineNumber] = inValue / EngineMaxRPM;
-		EngineSpeed[engineNumber] = FMath::Clamp<float>(EngineSpeed[engineNumber], 0.0f, 1.0f);
+		Core.SetEngineRPM(engineNumber, inValue);
 	}
 
 
@@ -357,26 +197,26 @@ TotalTorque=RotationRequest;
 	// MUST!! be in ]0..1]
 	float GetThrottleHover()
 	{
-		return FMath::Pow( (Vehicle->Mass * -Vehicle->Gravity) / (Vehicle->NumberOfEngines * Engine_K) , (1.0f / Engine_Q));     
+		return Core.GetThrottleHover();
 	}
 		
 
 	void SetDesiredThrottlePercent(float ThrottleIn)
 	{
-		ThrottleRequest = ThrottleIn;
+		Core.SetDesiredThrottlePercent(ThrottleIn);
 	}
 
 
 	void SetDesiredRotationForces(FVector inValue)
 	{
-		RotationRequest = inValue;
+		Core.SetDesiredRotationForces(QFMToCore(inValue));
 	}
 
 
 
 	bool IsLimitRollPitch()
 	{
-		return false;
+		return Core.IsLimitRollPitch();
 	}
 
 
@@ -385,36 +225,25 @@ TotalTorque=RotationRequest;
 
 	float GetEnginePercent(int engineNumber) 
 	{ 
-		return EngineSpeed[engineNumber]; 
+		return Core.GetEnginePercent(engineNumber); 
 	}
 	
 	
 	float GetEngineRPM(int engineNumber) 
 	{ 
-		return EngineSpeed[engineNumber] * EngineMaxRPM; 
+		return Core.GetEngineRPM(engineNumber); 
 	}
 	
 	
 	FVector GetTotalThrust() 
 	{	
-		return TotalThrust; 
+		return QFMFromCore(Core.GetTotalThrust()); 
 	}
 	
 	
 	FVector GetTotalTorque() 
 	{	
-		return TotalTorque; 
-	}
-
-
-
-	void Debug(FColor ColorIn, FVector2D DebugFontSizeIn)
-	{
-		GEngine->AddOnScreenDebugMessage(-1, 0, ColorIn, FString::Printf(TEXT("Mixer %%  : 1=%f 2=%f 3=%f 4=%f"), EngineMixPercent[0], EngineMixPercent[1], EngineMixPercent[2], EngineMixPercent[3]), true, DebugFontSizeIn);
-
-		GEngine->AddOnScreenDebugMessage(-1, 0, ColorIn, FString::Printf(TEXT("Engines %%  : 1=%f 2=%f 3=%f 4=%f"), GetEnginePercent(0), GetEnginePercent(1), GetEnginePercent(2), GetEnginePercent(3)), true, DebugFontSizeIn);
-		GEngine->AddOnScreenDebugMessage(-1, 0, ColorIn, FString::Printf(TEXT("Engines RPM: 1=%f 2=%f 3=%f 4=%f"), GetEngineRPM(0), GetEngineRPM(1), GetEngineRPM(2), GetEngineRPM(3)), true, DebugFontSizeIn);
-		GEngine->AddOnScreenDebugMessage(-1, 0, ColorIn, FString::Printf(TEXT("Thrust / Torque: %s / %s"), *TotalThrust.ToString(), *TotalTorque.ToString()), true, DebugFontSizeIn);
+		return QFMFromCore(Core.GetTotalTorque()); 
 	}
 
 
@@ -0,0 +1,154 @@
+
+#include "QFMFleetManager.h"
+
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+#include "QFMComponent.h"
+
+
+DECLARE_CYCLE_STAT(TEXT("Fleet Step"), STAT_QFM_FleetStep, STATGROUP_QuadcopterFlightModel);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fleet flight models"), STAT_QFM_FleetFlightModels, STATGROUP_QuadcopterFlightModel);
+
+// A worker takes this many consecutive flight models at once: few enough tasks to keep the scheduling cost down,
+// neighbouring components of one actor class stay on one core
+static TAutoConsoleVariable<int32> CVarQFMFleetChunkSize(
+	TEXT("QFM.Fleet.ChunkSize"),
+	8,
+	TEXT("Flight models per ParallelFor task of the fleet step"));
+
+static TAutoConsoleVariable<int32> CVarQFMFleetParallel(
+	TEXT("QFM.Fleet.Parallel"),
+	1,
+	TEXT("1: run the controllers of the fleet step on the task graph workers, 0: all on the physics thread"));
+
+
+TMap<FPhysScene*, FQFMFleetManager*> FQFMFleetManager::SceneToManager;
+FDelegateHandle FQFMFleetManager::OnWorldCleanupHandle;
+
+
+void FQFMFleetManager::Register(UQuadcopterFlightModel* FlightModel, FPhysScene* PhysScene, uint32 SceneType)
+{
+	check(IsInGameThread());
+
+	if (!OnWorldCleanupHandle.IsValid()) {
+		OnWorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddStatic(&FQFMFleetManager::OnWorldCleanup);
+	}
+
+	FQFMFleetManager*& Manager = SceneToManager.FindOrAdd(PhysScene);
+	if (!Manager) {
+		Manager = new FQFMFleetManager(PhysScene);
+	}
+
+	FScopeLock ScopeLock(&Manager->Lock);
+	Manager->Entries.Add(FEntry{ FlightModel, SceneType });
+}
+
+
+void FQFMFleetManager::Unregister(UQuadcopterFlightModel* FlightModel)
+{
+	check(IsInGameThread());
+
+	// Only the entry goes: a step may be broadcast to the manager right now
+	for (const TPair<FPhysScene*, FQFMFleetManager*>& Pair : SceneToManager)
+	{
+		FQFMFleetManager* Manager = Pair.Value;
+		FScopeLock ScopeLock(&Manager->Lock);
+		Manager->Entries.RemoveAll([FlightModel](const FEntry& Entry) { return Entry.FlightModel == FlightModel; });
+	}
+}
+
+
+void FQFMFleetManager::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	check(IsInGameThread());
+
+	FPhysScene* PhysScene = World->GetPhysicsScene();
+	FQFMFleetManager* Manager = nullptr;
+	if (PhysScene && SceneToManager.RemoveAndCopyValue(PhysScene, Manager)) {
+		delete Manager;
+	}
+}
+
+
+FQFMFleetManager::FQFMFleetManager(FPhysScene* PhysSceneIn)
+	: PhysScene(PhysSceneIn)
+{
+	OnPhysScenePreTickHandle = PhysScene->OnPhysScenePreTick.AddRaw(this, &FQFMFleetManager::PreTick);
+	OnPhysSceneStepHandle = PhysScene->OnPhysSceneStep.AddRaw(this, &FQFMFleetManager::Step);
+}
+
+
+FQFMFleetManager::~FQFMFleetManager()
+{
+	PhysScene->OnPhysScenePreTick.Remove(OnPhysScenePreTickHandle);
+	PhysScene->OnPhysSceneStep.Remove(OnPhysSceneStepHandle);
+}
+
+
+void FQFMFleetManager::PreTick(FPhysScene* Scene, uint32 SceneType, float DeltaTime)
+{
+#if STATS
+	if (SceneType != PST_Sync) {
+		return;
+	}
+
+	// The stats are global: one set over the whole fleet, not one vehicle overwriting the next.
+	// An empty manager leaves them to the flight models of other scenes
+	FScopeLock ScopeLock(&Lock);
+	if (Entries.Num() == 0) {
+		return;
+	}
+	StatsFlightModels.Reset();
+	for (const FEntry& Entry : Entries)
+	{
+		StatsFlightModels.Add(Entry.FlightModel);
+	}
+	UQuadcopterFlightModel::PublishTimingStats(StatsFlightModels);
+#endif
+}
+
+
+void FQFMFleetManager::Step(FPhysScene* Scene, uint32 SceneType, float DeltaTime)
+{
+	if (DeltaTime <= 0.0f) {
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_QFM_FleetStep);
+	FScopeLock ScopeLock(&Lock);
+
+	// 1. Gather. Pilot commands and the one rigid body read per flight model
+	Active.Reset();
+	for (const FEntry& Entry : Entries)
+	{
+		if (Entry.SceneType == SceneType && Entry.FlightModel->BeginStep()) {
+			Active.Add(Entry.FlightModel);
+		}
+	}
+	SET_DWORD_STAT(STAT_QFM_FleetFlightModels, Active.Num());
+	if (Active.Num() == 0) {
+		return;
+	}
+
+	// 2. Controllers. Every flight model only touches its own state here
+	const int32 ChunkSize = FMath::Max(1, CVarQFMFleetChunkSize.GetValueOnAnyThread());
+	const int32 NumChunks = (Active.Num() + ChunkSize - 1) / ChunkSize;
+	UQuadcopterFlightModel* const* const Models = Active.GetData();
+	const int32 NumModels = Active.Num();
+	ParallelFor(NumChunks, [Models, NumModels, ChunkSize, DeltaTime](int32 Chunk)
+	{
+		const int32 End = FMath::Min(NumModels, (Chunk + 1) * ChunkSize);
+		for (int32 i = Chunk * ChunkSize; i < End; i++)
+		{
+			Models[i]->StepControllers(DeltaTime);
+		}
+	}, NumChunks < 2 || CVarQFMFleetParallel.GetValueOnAnyThread() == 0);
+
+	// 3. Forces and outputs, in registration order
+	for (UQuadcopterFlightModel* FlightModel : Active)
+	{
+		FlightModel->EndStep(DeltaTime);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "PhysicsPublic.h"
+
+class UQuadcopterFlightModel;
+class UWorld;
+
+
+/*--- Fleet manager: one physics step callback for every flight model of a physics scene ---*/
+// Same pattern as FPhysXVehicleManager: registered once on FPhysScene::OnPhysSceneStep, which the scene
+// broadcasts before every physics step and every substep, instead of one AddCustomPhysics per component and tick.
+// A step has three passes:
+//   1. serial: pilot commands and the rigid body read of every flight model (PhysX reads)
+//   2. ParallelFor over chunks of consecutive flight models: the controller pipelines, core math only
+//   3. serial: forces into PhysX, HUD state, telemetry and flight records (single producer rings)
+// The flight models do not tick: the manager also publishes their timing stats, aggregated over the fleet, once per
+// frame before the scene ticks.
+// Created with the first flight model of a scene and kept until its world is cleaned up: the last flight model
+// leaving must not delete it under a step the physics thread may be broadcasting. At world cleanup physics is idle
+// and the scene still exists. UWorldSubsystem does not exist in UE 4.18, the scene is the per world object here.
+class FQFMFleetManager
+{
+public:
+
+	// Adds the flight model to the manager of its scene. Game thread, BeginPlay
+	static void Register(UQuadcopterFlightModel* FlightModel, FPhysScene* PhysScene, uint32 SceneType);
+
+	// Removes it, after a step that is running. The manager stays registered on the scene. Game thread, EndPlay
+	static void Unregister(UQuadcopterFlightModel* FlightModel);
+
+	int32 Num() const { return Entries.Num(); }
+
+
+private:
+
+	explicit FQFMFleetManager(FPhysScene* PhysSceneIn);
+	~FQFMFleetManager();
+
+	// Deletes the manager of the worlds scene. Game thread, FWorldDelegates::OnWorldCleanup
+	static void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
+
+	// Game thread, once per frame and scene type
+	void PreTick(FPhysScene* Scene, uint32 SceneType, float DeltaTime);
+
+	void Step(FPhysScene* Scene, uint32 SceneType, float DeltaTime);
+
+	struct FEntry
+	{
+		UQuadcopterFlightModel* FlightModel;
+		uint32 SceneType;
+	};
+
+	static TMap<FPhysScene*, FQFMFleetManager*> SceneToManager;
+	static FDelegateHandle OnWorldCleanupHandle;
+
+	FPhysScene* PhysScene;
+	FDelegateHandle OnPhysScenePreTickHandle;
+	FDelegateHandle OnPhysSceneStepHandle;
+
+	// Register / Unregister against a step running on the physics thread
+	FCriticalSection Lock;
+	TArray<FEntry> Entries;
+
+	// Flight models of the running step and scene type, in registration order
+	TArray<UQuadcopterFlightModel*> Active;
+
+	// Flight models whose timings PreTick publishes, game thread
+	TArray<UQuadcopterFlightModel*> StatsFlightModels;
+};
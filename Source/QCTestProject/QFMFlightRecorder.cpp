@@ -0,0 +1,203 @@
+
+#include "QFMFlightRecorder.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectIterator.h"
+
+#include "QFMComponent.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#endif
+#include "QFMCoreFlightRecorder.h"
+#if PLATFORM_WINDOWS
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+
+// Publish the record count and hand the written pages to the OS this often
+static const double FlightRecorderCommitInterval = 0.05;
+
+// Idle wait of the flush thread
+static const float FlightRecorderIdleSleep = 0.001f;
+
+
+FQFMFlightRecorder& FQFMFlightRecorder::Get()
+{
+	static FQFMFlightRecorder Recorder;
+	return Recorder;
+}
+
+
+FQFMFlightRecorder::FQFMFlightRecorder()
+	: Core(MakeUnique<QFM::FFlightRecorderCore>())
+	, Thread(nullptr)
+{
+	for (int32 i = 0; i < QFM::TelemetryProducerNum; i++)
+	{
+		Rings[i] = Core->GetRing(static_cast<QFM::ETelemetryProducer>(i));
+	}
+}
+
+
+FQFMFlightRecorder::~FQFMFlightRecorder()
+{
+	StopAndWait();
+}
+
+
+bool FQFMFlightRecorder::Start(const FString& FilePathIn, uint64 Capacity)
+{
+	if (Thread)
+	{
+		return false;
+	}
+
+	// Records a flight model pushed while the last recording stopped
+	Core->Drain();
+
+	FilePath = FPaths::ConvertRelativePathToFull(FilePathIn);
+	FPaths::MakePlatformFilename(FilePath);
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(FilePath), true);
+	if (!Core->Open(TCHAR_TO_UTF8(*FilePath), Capacity))
+	{
+		return false;
+	}
+
+	// Sections are appended per vehicle
+	FFileHelper::SaveStringToFile(FString(), *GetConfigFilePath());
+
+	bStopRequested = false;
+	Thread = FRunnableThread::Create(this, TEXT("QFMFlightRecorder"), 0, TPri_BelowNormal);
+	if (!Thread)
+	{
+		Core->Close();
+		return false;
+	}
+	bRecording = true;
+	return true;
+}
+
+
+void FQFMFlightRecorder::StopAndWait()
+{
+	bRecording = false;
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+		Core->Close();
+	}
+}
+
+
+void FQFMFlightRecorder::AppendConfig(const std::string& Section)
+{
+	if (bRecording)
+	{
+		FFileHelper::SaveStringToFile(FString(UTF8_TO_TCHAR(Section.c_str())), *GetConfigFilePath(),
+			FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+	}
+}
+
+
+uint64 FQFMFlightRecorder::GetNumRecords() const
+{
+	return Core->GetNumRecords();
+}
+
+
+uint64 FQFMFlightRecorder::GetDroppedRecords() const
+{
+	return Core->GetDroppedRecords();
+}
+
+
+void FQFMFlightRecorder::Stop()
+{
+	bStopRequested = true;
+}
+
+
+uint32 FQFMFlightRecorder::Run()
+{
+	double LastCommitTime = FPlatformTime::Seconds();
+
+	while (!bStopRequested)
+	{
+		const uint32 Records = Core->Drain();
+
+		const double Now = FPlatformTime::Seconds();
+		if (Now - LastCommitTime >= FlightRecorderCommitInterval)
+		{
+			Core->Commit();
+			LastCommitTime = Now;
+		}
+
+		if (Records == 0)
+		{
+			FPlatformProcess::Sleep(FlightRecorderIdleSleep);
+		}
+	}
+	return 0;
+}
+
+
+
+// QFM.Record.Start [File] [MaxMB]: record every flight model, one record per physics step
+static void QFMStartFlightRecorder(const TArray<FString>& Args)
+{
+	const FString FilePath = Args.Num() > 0 ? Args[0] : FPaths::ProjectSavedDir() / TEXT("FlightRecords") / FString::Printf(TEXT("QFM_%s.qfmr"), *FDateTime::Now().ToString());
+	const uint64 MaxMegabytes = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 1024;
+	const uint64 Capacity = MaxMegabytes * 1024 * 1024 / sizeof(QFM::FFlightRecord);
+
+	FQFMFlightRecorder& Recorder = FQFMFlightRecorder::Get();
+	if (Recorder.IsRecording())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Flight recorder already writes %s"), *Recorder.GetFilePath());
+		return;
+	}
+	if (Recorder.Start(FilePath, Capacity))
+	{
+		// Vehicles that begin play later write their own section
+		for (TObjectIterator<UQuadcopterFlightModel> It; It; ++It)
+		{
+			if (It->GetWorld() && It->HasBegunPlay()) {
+				It->WriteFlightConfig();
+			}
+		}
+		UE_LOG(LogTemp, Log, TEXT("Flight recorder: %s, room for %llu records"), *Recorder.GetFilePath(), Capacity);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Error, TEXT("Flight recorder: cannot create %s"), *FilePath);
+	}
+}
+
+static void QFMStopFlightRecorder(const TArray<FString>& Args)
+{
+	FQFMFlightRecorder& Recorder = FQFMFlightRecorder::Get();
+	if (Recorder.IsRecording())
+	{
+		Recorder.StopAndWait();
+		UE_LOG(LogTemp, Log, TEXT("Flight recorder stopped: %s, %llu records, %llu dropped"),
+			*Recorder.GetFilePath(), Recorder.GetNumRecords(), Recorder.GetDroppedRecords());
+	}
+}
+
+static FAutoConsoleCommand QFMStartFlightRecorderCommand(
+	TEXT("QFM.Record.Start"),
+	TEXT("Record the full state of every flight model after each physics step into a memory mapped file. Optional arguments: file path, max size in MB"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&QFMStartFlightRecorder));
+
+static FAutoConsoleCommand QFMStopFlightRecorderCommand(
+	TEXT("QFM.Record.Stop"),
+	TEXT("Stop the flight data recorder and close its file"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&QFMStopFlightRecorder));
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeBool.h"
+
+#include <string>
+
+#include "QFMCoreFlightRecord.h"
+#include "QFMCoreTelemetry.h"
+
+namespace QFM { class FFlightRecorderCore; }
+
+
+/*--- Flight data recorder ---*/
+// Every flight model pushes one FFlightRecord per physics step into the ring of the thread it simulates on.
+// This thread drains the rings into a preallocated, memory mapped file (QFMCoreFlightRecord.h) and lets the OS
+// write the pages back. Neither the game nor the physics thread ever touches the file.
+// One recorder per process, started and stopped with QFM.Record.Start / QFM.Record.Stop.
+// The parameters of the vehicles go to a text file next to it, so QFMReplay can run the record again.
+class FQFMFlightRecorder : public FRunnable
+{
+public:
+
+	static FQFMFlightRecorder& Get();
+
+	FQFMFlightRecorder();
+	virtual ~FQFMFlightRecorder();
+
+	// Creates the file with room for Capacity records and starts the flush thread. Game thread only
+	bool Start(const FString& FilePath, uint64 Capacity);
+
+	// Writes what is left, closes the file and joins the thread. Game thread only
+	void StopAndWait();
+
+	FORCEINLINE bool IsRecording() const { return bRecording; }
+
+	FORCEINLINE bool Push(QFM::ETelemetryProducer Producer, const QFM::FFlightRecord& Record)
+	{
+		return Rings[Producer]->Push(Record);
+	}
+
+	const FString& GetFilePath() const { return FilePath; }
+
+	// <file>.cfg next to the record: the parameters of every vehicle, for QFMReplay
+	FString GetConfigFilePath() const { return FilePath + TEXT(".cfg"); }
+
+	// Appends one vehicle section (QFM::FormatFlightConfigSection). Game thread only, while recording
+	void AppendConfig(const std::string& Section);
+
+	// Of the current or last recording. Exact once stopped
+	uint64 GetNumRecords() const;
+	uint64 GetDroppedRecords() const;
+
+
+	// FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+
+private:
+
+	TUniquePtr<QFM::FFlightRecorderCore> Core;
+	QFM::FFlightRecordRing* Rings[QFM::TelemetryProducerNum];
+
+	FString FilePath;
+	FRunnableThread* Thread;
+	FThreadSafeBool bStopRequested;
+	FThreadSafeBool bRecording;
+};
@@ -6,6 +6,9 @@
 #include "Components/PrimitiveComponent.h"
 #include "PhysicsEngine/BodyInstance.h"
 
+#include "QFMCoreInput.h"
+#include "QFMCoreBridge.h"
+
 #include "QFMInputController.generated.h"
 
 USTRUCT(BlueprintType)
@@ -48,6 +51,11 @@ struct FInputController
 	FVector4 DesiredPilotInput = FVector4(0.0f, 0.0f, 0.0f, 0.0f);
 	
 
+	/*--- CORE ---*/
+	// Input mapping lives in QFM::FInputCore. This struct only holds the editable settings.
+	QFM::FInputCore Core;
+
+
 	/*--- INTERFACE DATA ---*/
 	// Copy of Parent Data. Put inside here during Init and Tock 
 	UPROPERTY() 
@@ -61,11 +69,13 @@ struct FInputController
 	{
 		BodyInstance = BodyInstanceIn;
 		PrimitiveComponent = PrimitiveComponentIn;
+		SyncCore();
 	}
 
 	
 	void Reset()
 	{
+		Core.Reset();
 		DesiredPilotInput = FVector4(0.0f, 0.0f, 0.0f, 0.0f);
 	}
 
@@ -74,50 +84,37 @@ struct FInputController
 	{
 		DeltaTime = DeltaTimeIn;
 
-		// Convert Pilot Input to standard intervals (R,P,Y: -1..1, T 0..1)
-		FVector4 NewInputStick = FVector4(
-			GetMappedAndClampedValueNormal(RollAxisInputInterval, RollAxisInput * InputAxisScale.X),
-			GetMappedAndClampedValueNormal(PitchAxisInputInterval, PitchAxisInput * InputAxisScale.Y),
-			GetMappedAndClampedValueNormal(YawAxisInputInterval, YawAxisInput * InputAxisScale.Z),
-			GetMappedAndClampedValueNormal(ThrottleAxisInputInterval, ThrottleAxisInput * InputAxisScale.W)
-		);
+		// The sticks change every step, the settings only with SyncCore
+		Core.RollAxisInput = RollAxisInput;
+		Core.PitchAxisInput = PitchAxisInput;
+		Core.YawAxisInput = YawAxisInput;
+		Core.ThrottleAxisInput = ThrottleAxisInput;
+		Core.Tock(DeltaTime);
 		
-		DesiredPilotInput = NewInputStick;
-
-		// Normalize Throttle input to [0..1]
-		DesiredPilotInput.W = DesiredPilotInput.W / 2.0f + 0.5f; 
+		DesiredPilotInput = QFMFromCore(Core.GetDesiredInput());
 	}
 
 
-
-	FVector4 GetDesiredInput()
+	// Copy the editable settings into the core. In Init and on UQuadcopterFlightModel::ApplySettings
+	void SyncCore()
 	{
-		return DesiredPilotInput;
+		Core.RollAxisInputInterval = QFMToCore(RollAxisInputInterval);
+		Core.PitchAxisInputInterval = QFMToCore(PitchAxisInputInterval);
+		Core.YawAxisInputInterval = QFMToCore(YawAxisInputInterval);
+		Core.ThrottleAxisInputInterval = QFMToCore(ThrottleAxisInputInterval);
+		Core.InputAxisScale = QFMToCore(InputAxisScale);
 	}
 
 
-	float GetThrottleMidStick()
-	{
-		return 0.5f; //return (ThrottleAxisInputInterval.X + (ThrottleAxisInputInterval.Y - ThrottleAxisInputInterval.X) / 2.0);
-	}
-
-	// Helper Function to Map Pilot Input to [-1..1]
-	float GetMappedAndClampedValueNormal(const FVector2D& InputRange, const float Value)
+	FVector4 GetDesiredInput()
 	{
-		return ( ( Value - InputRange.X ) / ( InputRange.Y - InputRange.X ) ) * 2.0f -1.0f;
-		
+		return DesiredPilotInput;
 	}
 
-	// Helper Function to Map Pilot Input to [OutRange]
-	float GetMappedAndClampedValue(const FVector2D& InputRange, const FVector2D& OutputRange, const float Value)
-	{
-		return ((Value - InputRange.X) / (InputRange.Y - InputRange.X)) * (OutputRange.Y - OutputRange.X) + OutputRange.X;
-	}
 
-	
-	void Debug(FColor ColorIn, FVector2D DebugFontSizeIn)
+	float GetThrottleMidStick()
 	{
-		//GEngine->AddOnScreenDebugMessage(-1, 0, ColorIn, TEXT("Pilot Input: (R,P,Y,T) ") + DesiredPilotInput.ToString(), true, DebugFontSizeIn);		
+		return Core.GetThrottleMidStick();
 	}
 
 
@@ -13,6 +13,8 @@
 #include "QFMAHRS.h"
 #include "QFMEngineController.h"
 #include "QFMVehicle.h"
+#include "QFMCorePosition.h"
+#include "QFMCoreBridge.h"
 
 #include "QFMPositionController.generated.h"
 
@@ -42,6 +44,18 @@ struct FPositionController
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Yaw Rate PID"))
 	FVector RateZPidSettings = FVector(0.1f, 0.0f, 0.001f);
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Z PID feed-forward, times the normalized acceleration target"))
+	float RateZPidFeedForward = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Z PID derivative low pass in Hz, 0 = off"))
+	float RateZPidDFilterHz = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Z PID back-calculation anti-windup gain, 0 = off"))
+	float RateZPidAntiWindup = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Z PID derivative on the measured acceleration instead of the error, no kick on target steps"))
+	bool bRateZPidDOnMeasurement = false;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "FPD Damping. 1=crit damped, <1 = underdamped, >1 = overdamped"))
 	float SPDDamping = 6.0f;	
 	
@@ -50,12 +64,9 @@ struct FPositionController
 
 
 
-	/*--- PARAMETERS ---*/
-	UPROPERTY() float PosTargetZ = 0.0f;
-	UPROPERTY() bool bIsLockedZ = false;
-	
-	// PIDs
-	UPROPERTY() FPIDController RateZPid;
+	/*--- CORE ---*/
+	// Targets, PIDs and the Z loop live in QFM::FPositionCore
+	QFM::FPositionCore Core;
 
 
 	/*--- INTERFACE DATA ---*/
@@ -75,39 +86,49 @@ struct FPositionController
 		EngineController = EngineControllerIn;
 		Vehicle = VehicleIn;
 
-		//bIsActiveZ = true;
-		bIsLockedZ = false;
-
-		// Init Pids with min,max = -1..1. We normalize Rates in RunZController, so we allways have values from 0..1
-		RateZPid.Init(-1, 1, RateZPidSettings.X, RateZPidSettings.Y, RateZPidSettings.Z);
-
+		SyncCore();
+		Core.Init(&AHRS->Core, &Vehicle->Core, &EngineController->Core);
 	}
 
 
 	void Reset()
 	{
-		//bIsActiveZ = true;
-		bIsLockedZ = false;
-
-		// ResetPids
-		RateZPid.Reset();
+		Core.Reset();
 	}
 
 	
 	void Tock(float DeltaTimeIn)
 	{
 		DeltaTime = DeltaTimeIn;
+
+		Core.Tock(DeltaTime);
 	}
 
 
+	// Copy the editable settings into the core. In Init and on UQuadcopterFlightModel::ApplySettings
+	void SyncCore()
+	{
+		Core.bIsActiveZ = bIsActiveZ;
+		Core.MaxClimbVelocityZ = MaxClimbVelocityZ;
+		Core.MaxDescentVelocityZ = MaxDescentVelocityZ;
+		Core.MaxAccelerationZ = MaxAccelerationZ;
+		Core.TranslationControlLoop = static_cast<QFM::EControlLoop>(TranslationControlLoop);
+		Core.RateZPidSettings = QFMToCore(RateZPidSettings);
+		Core.RateZPidFeedForward = RateZPidFeedForward;
+		Core.RateZPidDFilterHz = RateZPidDFilterHz;
+		Core.RateZPidAntiWindup = RateZPidAntiWindup;
+		Core.bRateZPidDOnMeasurement = bRateZPidDOnMeasurement;
+		Core.SPDDamping = SPDDamping;
+		Core.SPDFrequency = SPDFrequency;
+	}
+
 
 
 	/* --- Check Active ---*/	
 
 	bool IsActiveZ()
 	{
-		// pos_control->is_active_z() 
-		return bIsActiveZ;
+		return Core.IsActiveZ();
 	}
 
 
@@ -116,37 +137,19 @@ struct FPositionController
 
 	void SetAltTarget(float AltIn)
 	{
-		PosTargetZ = AltIn;
-		bIsLockedZ = true;
+		Core.SetAltTarget(AltIn);
 	}
 
 
 	void SetAltTargetToCurrentAlt()
 	{
-		//pos_control->set_alt_target_to_current_alt(); 
-		PosTargetZ = AHRS->GetWorldAltitude();
-		bIsLockedZ = true;
+		Core.SetAltTargetToCurrentAlt();
 	}
 	
 
 	void SetAltTargetFromClimbRate(float TargetClimbRate)
 	{
-		//set_alt_target_from_climb_rate_ff 
-		TargetClimbRate = FMath::Clamp<float>(TargetClimbRate, -MaxDescentVelocityZ, MaxClimbVelocityZ);
-
-		if (FMath::Abs(TargetClimbRate) < 0.001f  ) {
-			if(!bIsLockedZ)
-			{
-				SetAltTargetToCurrentAlt(); // Will lock bIsLockedZ
-				return;
-			}
-			else
-			{
-				return;
-			}
-		}
-		bIsLockedZ = false;
-		PosTargetZ = AHRS->GetWorldAltitude() + TargetClimbRate * DeltaTime;
+		Core.SetAltTargetFromClimbRate(TargetClimbRate);
 	}
 
 
@@ -157,6 +160,7 @@ struct FPositionController
 		//sets maximum climb and descent rates 
 		MaxClimbVelocityZ = SpeedUpIn;
 		MaxDescentVelocityZ = SpeedDownIn;
+		Core.SetMaxVelocityZ(SpeedDownIn, SpeedUpIn);
 	}
 
 
@@ -164,142 +168,16 @@ struct FPositionController
 	{
 		//sets maximum climb and descent acceleration 
 		MaxAccelerationZ = AccelIn;
+		Core.SetMaxAccelerationZ(AccelIn);
 	}
 
 
 
 	/* --- Update Loop ---*/
 
-
 	void UpdateZController()
 	{
-
-		float PosErrorZ = 0.0f;
-		float VelocityTargetZ = 0.0f;
-		float AccelerationTargetZ = 0.0f;
-
-		// Get current altitude in m
-		float CurrentAlt = AHRS->GetWorldAltitude();
-
-		// get position error in m
-    	PosErrorZ = PosTargetZ - CurrentAlt;
-
-		// calculate Velocity Target for actual position based on PosError using Linear Function
-    	VelocityTargetZ = PosErrorZ / DeltaTime;
-
-    	// check speed limits
-        if (VelocityTargetZ > MaxClimbVelocityZ) 
-		{
-        	VelocityTargetZ = MaxClimbVelocityZ;
-   		}
-    	if (VelocityTargetZ < -MaxDescentVelocityZ) 
-		{
-        	VelocityTargetZ = -MaxDescentVelocityZ;
-        }
-
-    	// the following section calculates acceleration required to achieve the velocity target
-
-    	float VelocityCurrentZ = AHRS->GetWorldVelocity().Z;
-
-		AccelerationTargetZ = (VelocityTargetZ - VelocityCurrentZ); // / DeltaTime;
-		float AccelerationCurrentZ = AHRS->GetWorldAccelerationXYZ().Z;// + Vehicle->GetGravity();
-		
-
-		// First draft: Without any Loop Controllers.
-
-		// ... LoopController would be called here
-
-		//
-
-		//float AccelerationToApplyZ = AccelerationTargetZ;
-
-/*
-		// check accel limits
-		if (AccelerationToApplyZ > 0)
-		{
-			if (AccelerationToApplyZ > MaxAccelerationZ)
-			{
-				AccelerationToApplyZ = MaxAccelerationZ;
-			}
-		}
-		else if (AccelerationToApplyZ < 0) 
-		{
-			if (AccelerationToApplyZ < -MaxAccelerationZ)
-			{
-				AccelerationToApplyZ = -MaxAccelerationZ;
-			}
-		}
-*/
-
-		// the following section calculates a desired throttle needed to achieve the acceleration target
-		// Normalize Accel Request
-				
-		//Trying Workaround...
-		// Works with Stable PD 100/10
-		//AccelerationTargetZ = VelocityTargetZ / MaxClimbVelocityZ * MaxAccelerationZ;
-		//AccelerationCurrentZ = VelocityCurrentZ / MaxClimbVelocityZ * MaxAccelerationZ;
-		
-
-		float ThrottleOut = 0.0f;
-
-		if(TranslationControlLoop == EControlLoop::ControlLoop_P)
-		{
-			// P-Controller
-			ThrottleOut = (AccelerationTargetZ - AccelerationCurrentZ) / MaxAccelerationZ;;
-			//ThrottleOut += EngineController->GetThrottleHover();
-		}
-		else if (TranslationControlLoop == EControlLoop::ControlLoop_PID)
-		{
-			// PID Controller
-			ThrottleOut = RateZPid.Calculate(AccelerationTargetZ / MaxAccelerationZ, AccelerationCurrentZ / MaxAccelerationZ, DeltaTime);
-			ThrottleOut += EngineController->GetThrottleHover();
-		}
-		else if (TranslationControlLoop == EControlLoop::ControlLoop_SPD)
-		{
-			// FPD-Controller 
-    	    ThrottleOut = StepAccelZSpd(AccelerationTargetZ / MaxAccelerationZ,  AccelerationCurrentZ / MaxAccelerationZ);
-			//ThrottleOut += EngineController->GetThrottleHover();
-		}
-
-
-		// ThrottleOut += EngineController->GetThrottleHover();
-
-		// Sanity Check
-		ThrottleOut = FMath::Clamp(ThrottleOut, 0.0f, 1.0f);
-
-
-/*
-		UE_LOG(LogTemp,Display,TEXT("ALT: ZA %f\tZT %f\tZE %f\t\t %d"),CurrentAlt, PosTargetZ, PosErrorZ, bIsLockedZ);
-		UE_LOG(LogTemp,Display,TEXT("VEL: VA %f\tVT %f"),VelocityCurrentZ, VelocityTargetZ);
-		UE_LOG(LogTemp,Display,TEXT("ACC: AA %f\tAT %f"),AccelerationCurrentZ, AccelerationTargetZ);
-		UE_LOG(LogTemp,Display,TEXT("THR: TO %f\t"),ThrottleOut);
-*/
-
-		EngineController->SetDesiredThrottlePercent(ThrottleOut);
-	}
-
-
-	// Run the TZranslational Z Acceleration FPD controller and return the output detla w -1..1
-	float StepAccelZSpd(float Target, float Current)
-	{
-		float kp = SPDFrequency * SPDFrequency * 9.0f; 
-		float kd = 4.5f * SPDFrequency * SPDDamping; 
-		float dt = DeltaTime; 
-		
-		float g = 1.0f / (1.0f + kd * dt + kp * dt * dt); 
-		float kpg = kp * g; 
-		float kdg = (kd + kp * dt) * g; 
-
-		return (kpg * Target - kdg * Current);
-	}
-
-
-
-
-	void Debug(FColor ColorIn, FVector2D DebugFontSizeIn)
-	{
-		// Down to up on the debug screen
-		
+		Core.UpdateZController();
 	}
 
 
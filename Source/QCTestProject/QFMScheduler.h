@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "QFMCoreScheduler.h"
+
+#include "QFMScheduler.generated.h"
+
+USTRUCT(BlueprintType)
+struct FQuadcopterFlightModelSchedulerStruct
+{
+	GENERATED_BODY()
+
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Run every stage at its own fixed rate. Disable to run all stages once per physics step"))
+	bool Enabled = true;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Rate loop (attitude + engine) in Hz. Substepped inside each physics step", ClampMin = "50", ClampMax = "8000"))
+	float RateLoopHz = 1000.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Pilot input sampling in Hz", ClampMin = "1"))
+	float InputHz = 100.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "AHRS update in Hz", ClampMin = "1"))
+	float AHRSHz = 500.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Position loop in Hz", ClampMin = "1"))
+	float PositionHz = 50.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel", meta = (ToolTip = "Max rate loop ticks per physics step. Time beyond is dropped", ClampMin = "1"))
+	int32 MaxRateLoopSubsteps = 64;
+
+
+	// Accumulator and stage dividers
+	QFM::FMultiRateSchedulerCore Core;
+
+
+	void Init()
+	{
+		Core.RateLoopHz = RateLoopHz;
+		Core.InputHz = InputHz;
+		Core.AHRSHz = AHRSHz;
+		Core.PositionHz = PositionHz;
+		Core.MaxTicksPerStep = MaxRateLoopSubsteps;
+		Core.Init();
+	}
+
+};
@@ -1,5 +1,61 @@
 
 #include "QFMComponent.h"
+#include "QFMFlightRecorder.h"
+
+
+/*--- Stage timing: `stat QuadcopterFlightModel` cycle counters plus our own histograms ---*/
+
+DECLARE_CYCLE_STAT(TEXT("Simulate"), STAT_QFM_Simulate, STATGROUP_QuadcopterFlightModel);
+DECLARE_CYCLE_STAT(TEXT("Read Physics State"), STAT_QFM_ReadPhysicsState, STATGROUP_QuadcopterFlightModel);
+DECLARE_CYCLE_STAT(TEXT("PilotInput Tock"), STAT_QFM_PilotInput, STATGROUP_QuadcopterFlightModel);
+DECLARE_CYCLE_STAT(TEXT("AHRS Tock"), STAT_QFM_AHRS, STATGROUP_QuadcopterFlightModel);
+DECLARE_CYCLE_STAT(TEXT("AttitudeController Tock"), STAT_QFM_AttitudeController, STATGROUP_QuadcopterFlightModel);
+DECLARE_CYCLE_STAT(TEXT("PositionController Tock"), STAT_QFM_PositionController, STATGROUP_QuadcopterFlightModel);
+DECLARE_CYCLE_STAT(TEXT("EngineController Tock"), STAT_QFM_EngineController, STATGROUP_QuadcopterFlightModel);
+DECLARE_CYCLE_STAT(TEXT("Apply Forces"), STAT_QFM_ApplyForces, STATGROUP_QuadcopterFlightModel);
+
+// Records one stage run into the components histograms
+struct FQFMScopedStageTimer
+{
+	QFM::FStageTimings& Timings;
+	const QFM::ETimedStage Stage;
+	const uint64 StartCycles;
+
+	FORCEINLINE FQFMScopedStageTimer(QFM::FStageTimings& TimingsIn, QFM::ETimedStage StageIn)
+		: Timings(TimingsIn), Stage(StageIn), StartCycles(FPlatformTime::Cycles64())
+	{
+	}
+
+	FORCEINLINE ~FQFMScopedStageTimer()
+	{
+		Timings.Record(Stage, FPlatformTime::Cycles64() - StartCycles);
+	}
+};
+
+#define QFM_SCOPE_STAGE(Stage) \
+	SCOPE_CYCLE_COUNTER(STAT_QFM_##Stage); \
+	FQFMScopedStageTimer QFMStageTimer_##Stage(Timings, QFM::ETimedStage::Stage)
+
+// The Simulate stage of a step is the sum of its three parts, which the fleet manager runs apart
+struct FQFMScopedStepTimer
+{
+	uint64& StepCycles;
+	const uint64 StartCycles;
+
+	FORCEINLINE FQFMScopedStepTimer(uint64& StepCyclesIn)
+		: StepCycles(StepCyclesIn), StartCycles(FPlatformTime::Cycles64())
+	{
+	}
+
+	FORCEINLINE ~FQFMScopedStepTimer()
+	{
+		StepCycles += FPlatformTime::Cycles64() - StartCycles;
+	}
+};
+
+#define QFM_SCOPE_STEP() \
+	SCOPE_CYCLE_COUNTER(STAT_QFM_Simulate); \
+	FQFMScopedStepTimer QFMStepTimer(StepCycles)
 
 
 //Actual simulation
@@ -8,70 +64,372 @@ void UQuadcopterFlightModel::Simulate(float DeltaTime, FBodyInstance* bodyInst)
     // only do something if time ellapsed
     if (DeltaTime <= 0.0f) { return; }
 
-	//double start = FPlatformTime::Seconds();
-	//UE_LOG(LogTemp, Warning, TEXT("timestamp %f"), FPlatformTime::Seconds());
+	if (BeginStep()) {
+		StepControllers(DeltaTime);
+		EndStep(DeltaTime);
+	}
+}
+
+
+// Latest sticks from the game thread and the only read of the rigid body in this step. Everything after works on this copy
+bool UQuadcopterFlightModel::BeginStep()
+{
+	if (!Enabled || !BodyInstance) {
+		return false;
+	}
+
+	StepCycles = 0;
+	QFM_SCOPE_STEP();
+
+	ReceivePilotCommands();
+
+	// Settings changed since the last step (ApplySettings). Serial in the fleet step, before any controller runs
+	if (bSettingsChanged.AtomicSet(false)) {
+		PilotInput.SyncCore();
+		AHRS.SyncCore();
+		AttitudeController.SyncCore();
+		PositionController.SyncCore();
+		EngineController.SyncCore();
+	}
+
+	{
+		QFM_SCOPE_STAGE(ReadPhysicsState);
+		PhysicsState = QFMReadPhysicsState(BodyInstance);
+	}
+	return true;
+}
+
 
+// The controller pipeline. No PhysX and no shared state: the fleet manager runs many of these in parallel
+void UQuadcopterFlightModel::StepControllers(float DeltaTime)
+{
+	QFM_SCOPE_STEP();
+
+	if (Scheduler.Enabled) {
+		SimulateMultiRate(DeltaTime);
+	}
+	else {
+		SimulateSingleRate(DeltaTime);
+	}
+}
 
+
+// Forces into PhysX and the outputs of the step
+void UQuadcopterFlightModel::EndStep(float DeltaTime)
+{
+	{
+		QFM_SCOPE_STEP();
+
+		{
+			QFM_SCOPE_STAGE(ApplyForces);
+			AddLocalForceZ(AppliedThrust);
+			AddLocalTorque(AppliedTorque);
+		}
+		if (ReceivedCommandTicks != 0) {
+			Timings.Record(QFM::ETimedStage::InputToForce, FPlatformTime::Cycles64() - ReceivedCommandTicks);
+			ReceivedCommandTicks = 0;
+		}
+
+		SimulationTime += DeltaTime;
+		PublishVehicleState();
+		if (TelemetryRing) {
+			PushTelemetry();
+		}
+		if (FQFMFlightRecorder::Get().IsRecording()) {
+			PushFlightRecord(DeltaTime);
+		}
+		RecorderStep++;
+	}
+	Timings.Record(QFM::ETimedStage::Simulate, StepCycles);
+
+
+    #ifdef WITH_EDITOR
+	// Only a copy here, the text is formatted and drawn on the game thread (see FQFMDebugOverlay)
+	if (Debug.DebugScreen && DebugOverlay) {
+		CaptureDebugSnapshot();
+	}
+    #endif
+    
+}
+
+
+
+// All stages once per physics step, with the physics DeltaTime
+void UQuadcopterFlightModel::SimulateSingleRate(float DeltaTime)
+{
 	// read new Pilot Input
-    PilotInput.Tock(DeltaTime);
+	{
+		QFM_SCOPE_STAGE(PilotInput);
+		PilotInput.Tock(DeltaTime);
+	}
 
 	// Update the Attitude & Heading Reference System
-	AHRS.Tock(DeltaTime);
+	{
+		QFM_SCOPE_STAGE(AHRS);
+		AHRS.Tock(DeltaTime, PhysicsState.Body);
+	}
 
 	// Call Flight Controller to calculate angine outputs based on actual attitude and pilot input
-	AttitudeController.Tock(DeltaTime);
-
-	// update Position Controller
-	PositionController.Tock(DeltaTime);
+	{
+		QFM_SCOPE_STAGE(AttitudeController);
+		AttitudeController.Tock(DeltaTime, PhysicsState.Body);
+	}
+
+	// update Position Controller. The Z controller runs before the stage takes the new DeltaTime, as it always did
+	{
+		QFM_SCOPE_STAGE(PositionController);
+		AttitudeController.TockPositionLoop();
+		PositionController.Tock(DeltaTime);
+	}
 
 	// update EngineController
-	EngineController.Tock(DeltaTime);
+	{
+		QFM_SCOPE_STAGE(EngineController);
+		EngineController.Tock(DeltaTime);
+	}
+
+	// Forces calculated in Engine Control, applied by EndStep
+	AppliedThrust = EngineController.GetTotalThrust();
+	AppliedTorque = EngineController.GetTotalTorque();
+}
 
-	// And Apply Forces calculated in Engine Control
-	AddLocalForceZ(EngineController.GetTotalThrust());
-	AddLocalTorque(EngineController.GetTotalTorque());
 
+// Every stage at its own fixed rate. The rate loop is substepped inside this physics step,
+// the slower stages only run on their ticks. See QFM::FMultiRateSchedulerCore
+void UQuadcopterFlightModel::SimulateMultiRate(float DeltaTime)
+{
+	QFM::FMultiRateSchedulerCore& Core = Scheduler.Core;
+
+	const int32 Ticks = Core.Advance(DeltaTime);
+
+	// Not a full rate loop tick yet: keep applying the last forces
+	if (Ticks == 0) {
+		AppliedThrust = EngineController.GetTotalThrust();
+		AppliedTorque = EngineController.GetTotalTorque();
+		return;
+	}
+
+	// Body state at the start of this physics step
+	const QFM::FBodyState& Body = PhysicsState.Body;
+
+	FVector ThrustSum = FVector::ZeroVector;
+	FVector TorqueSum = FVector::ZeroVector;
+
+	for (int32 i = 0; i < Ticks; i++, Core.NextTick())
+	{
+		const QFM::FBodyState TickBody = QFM::PredictBodyState(Body, i * Core.TickPeriod);
+
+		if (Core.IsDue(QFM::EControlStage::Input)) {
+			QFM_SCOPE_STAGE(PilotInput);
+			PilotInput.Tock(Core.GetStageDeltaTime(QFM::EControlStage::Input));
+		}
+
+		if (Core.IsDue(QFM::EControlStage::AHRS)) {
+			QFM_SCOPE_STAGE(AHRS);
+			AHRS.Tock(Core.GetStageDeltaTime(QFM::EControlStage::AHRS), TickBody);
+		}
+
+		{
+			QFM_SCOPE_STAGE(AttitudeController);
+			AttitudeController.Tock(Core.TickPeriod, TickBody);
+		}
+
+		if (Core.IsDue(QFM::EControlStage::Position)) {
+			QFM_SCOPE_STAGE(PositionController);
+			PositionController.Tock(Core.GetStageDeltaTime(QFM::EControlStage::Position));
+			AttitudeController.TockPositionLoop();
+		}
+
+		{
+			QFM_SCOPE_STAGE(EngineController);
+			EngineController.Tock(Core.TickPeriod);
+		}
+
+		ThrustSum += EngineController.GetTotalThrust();
+		TorqueSum += EngineController.GetTotalTorque();
+	}
+
+	// PhysX integrates one force over the whole step: apply the mean of the rate loop outputs
+	AppliedThrust = ThrustSum / Ticks;
+	AppliedTorque = TorqueSum / Ticks;
+}
 
-    #ifdef WITH_EDITOR
-    
-        if (Debug.DebugScreen) {
-		
-
-			if (Debug.PrintAHRS) {
-				AHRS.Debug(Debug.Color, Debug.FontSize);
-            }
-
-			if (Debug.PrintVehicle) {
-				Vehicle.Debug(Debug.Color, Debug.FontSize);
-			}
-
-			if (Debug.PrintInput) {
-				PilotInput.Debug(Debug.Color, Debug.FontSize);
-			}
-
-			if (Debug.PrintAttitudeControl) {
-				AttitudeController.Debug(Debug.Color, Debug.FontSize);
-			}
-			
-			if (Debug.PrintPositionControl) {
-				PositionController.Debug(Debug.Color, Debug.FontSize);
-			}
-
-			if (Debug.PrintEngineControl) {
-				EngineController.Debug(Debug.Color, Debug.FontSize);
-			}
-			
-			//Debug.Debug(Debug.Color, Debug.FontSize);
-
-			//GEngine->AddOnScreenDebugMessage(-1, 0, Debug.Color, TEXT("Phyics Object") + Parent->GetName(), true, Debug.FontSize);
-
-        }
-    #endif
-    
-	//double end = FPlatformTime::Seconds();
-	//UE_LOG(LogTemp, Warning, TEXT("code executed in %f seconds."), end-start);
 
-    
+
+// Take the newest pilot command, if the game thread sent one since the last step
+void UQuadcopterFlightModel::ReceivePilotCommands()
+{
+	QFM::FPilotCommand Command;
+	if (!Exchange.ReceiveCommand(Command)) {
+		return;
+	}
+
+	ReceivedCommandTicks = Command.SentTicks;
+
+	PilotInput.RollAxisInput = Command.RollAxisInput;
+	PilotInput.PitchAxisInput = Command.PitchAxisInput;
+	PilotInput.YawAxisInput = Command.YawAxisInput;
+	PilotInput.ThrottleAxisInput = Command.ThrottleAxisInput;
+
+	// Reset all speeds and accelerations, once per request
+	if (Command.KillTrajectoryCount != AppliedKillTrajectoryCount) {
+		AppliedKillTrajectoryCount = Command.KillTrajectoryCount;
+		BodyInstance->SetAngularVelocityInRadians(FVector(0, 0, 0), false);
+		BodyInstance->SetLinearVelocity(FVector(0, 0, 0), false);
+	}
+}
+
+
+// Everything the HUD getters read, published as one consistent snapshot per physics step
+void UQuadcopterFlightModel::PublishVehicleState()
+{
+	QFM::FPublishedVehicleState State;
+	State.SimulationTime = SimulationTime;
+
+	const QFM::FAHRSCore& AHRSCore = AHRS.Core;
+	State.Position = AHRSCore.Position;
+	State.Rotation = AHRSCore.Rotation;
+	State.LinearVelocity = AHRSCore.LinearVelocity;
+	State.LinearVelocity2D = AHRSCore.LinearVelocity2D;
+	State.LinearVelocityX = AHRSCore.LinearVelocityX;
+
+	const QFM::FEngineCore& EngineCore = EngineController.Core;
+	State.NumEngines = EngineCore.GetNumEngines();
+	for (int32 i = 0; i < State.NumEngines; i++)
+	{
+		State.EnginePercent[i] = EngineCore.GetEnginePercent(i);
+		State.EngineRPM[i] = EngineCore.GetEngineRPM(i);
+	}
+	State.TotalThrust = QFMToCore(AppliedThrust);
+	State.TotalTorque = QFMToCore(AppliedTorque);
+	State.UDPDebugOutput = AttitudeController.Core.UDPDebugOutput;
+
+	Exchange.PublishState(State);
+}
+
+
+
+// One sample per physics step. Only fills and pushes a fixed size struct, the telemetry thread sends it
+void UQuadcopterFlightModel::PushTelemetry()
+{
+	const FVector DebugOutput = AttitudeController.GetUDPDebugOutput();
+
+	QFM::FTelemetrySample Sample;
+	Sample.SimTime = SimulationTime;
+	Sample.VehicleId = TelemetryVehicleId;
+	Sample.ChannelBitmap =
+		QFM::WireChannelBit(QFM::WireChannelThrustZ) |
+		QFM::WireChannelBit(QFM::WireChannelTorqueX) | QFM::WireChannelBit(QFM::WireChannelTorqueY) | QFM::WireChannelBit(QFM::WireChannelTorqueZ) |
+		QFM::WireChannelBit(QFM::WireChannelDebugX) | QFM::WireChannelBit(QFM::WireChannelDebugY) | QFM::WireChannelBit(QFM::WireChannelDebugZ);
+	Sample.Values[0] = AppliedThrust.Z;
+	Sample.Values[1] = AppliedTorque.X;
+	Sample.Values[2] = AppliedTorque.Y;
+	Sample.Values[3] = AppliedTorque.Z;
+	Sample.Values[4] = DebugOutput.X;
+	Sample.Values[5] = DebugOutput.Y;
+	Sample.Values[6] = DebugOutput.Z;
+
+	TelemetryRing->Push(Sample);
+}
+
+
+
+// Full state after this step for the flight data recorder. Fixed size copy into the recorders ring, nothing else
+void UQuadcopterFlightModel::PushFlightRecord(float DeltaTime)
+{
+	QFM::FFlightRecord Record;
+	QFM::FillFlightRecord(Record, GetCoreRefs(), DeltaTime, PhysicsState.Body, Scheduler.Enabled,
+		QFMToCore(AppliedThrust), QFMToCore(AppliedTorque));
+	Record.SimTime = SimulationTime;
+	Record.VehicleId = RecorderVehicleId;
+	Record.Step = RecorderStep;
+
+	FQFMFlightRecorder::Get().Push(bSubstep ? QFM::TelemetryProducerPhysics : QFM::TelemetryProducerGame, Record);
+}
+
+
+
+// Per step body access before and after the physics state snapshot, on the live body.
+// Separate: AHRS (component transform + velocities), attitude controller (body transform + velocities),
+// thrust (component up vector) and torque (body transform + inertia tensor)
+void UQuadcopterFlightModel::BenchmarkPhysicsStateRead(int32 Iterations)
+{
+	if (!BodyInstance || Iterations <= 0) {
+		return;
+	}
+
+	float Sink = 0.0f;
+
+	const uint64 SeparateStart = FPlatformTime::Cycles64();
+	for (int32 i = 0; i < Iterations; i++)
+	{
+		const QFM::FBodyState AHRSBody = QFMReadBodyState(Parent->GetComponentTransform(), BodyInstance);
+		const QFM::FBodyState ControllerBody = QFMReadBodyState(BodyInstance->GetUnrealWorldTransform(), BodyInstance);
+		const FVector UpVector = Parent->GetUpVector();
+		const FTransform TorqueTransform = BodyInstance->GetUnrealWorldTransform();
+		const FVector Inertia = BodyInstance->GetBodyInertiaTensor();
+		Sink += AHRSBody.Position.Z + ControllerBody.AngularVelocity.X + UpVector.Z + TorqueTransform.GetRotation().W + Inertia.X;
+	}
+	const uint64 SeparateCycles = FPlatformTime::Cycles64() - SeparateStart;
+
+	const uint64 OnceStart = FPlatformTime::Cycles64();
+	for (int32 i = 0; i < Iterations; i++)
+	{
+		const QFM::FPhysicsState State = QFMReadPhysicsState(BodyInstance);
+		Sink += State.Body.Position.Z + State.Body.AngularVelocity.X + State.UpVector.Z + State.Body.Rotation.W + State.InertiaTensor.X;
+	}
+	const uint64 OnceCycles = FPlatformTime::Cycles64() - OnceStart;
+
+	const double SeparateNs = SeparateCycles * Timings.NsPerTick / Iterations;
+	const double OnceNs = OnceCycles * Timings.NsPerTick / Iterations;
+	UE_LOG(LogTemp, Log, TEXT("%s physics state read: separate %.1f ns/step, once %.1f ns/step, saved %.1f ns/step (%d iterations, sink %f)"),
+		*GetOwner()->GetName(), SeparateNs, OnceNs, SeparateNs - OnceNs, Iterations, Sink);
+}
+
+
+
+// Copy the values of the debug overlay. Runs once per physics step, so no strings and no allocations
+void UQuadcopterFlightModel::CaptureDebugSnapshot()
+{
+	FQFMDebugSnapshot& S = DebugOverlay->GetCaptureBuffer();
+
+	S.SimulationTime = SimulationTime;
+
+	S.Position = AHRS.Position;
+	S.Rotation = AHRS.Rotation;
+	S.VelocityVector = AHRS.VelocityVector;
+	S.LinearVelocity = AHRS.LinearVelocity;
+	S.LinearVelocity2D = AHRS.LinearVelocity2D;
+	S.LinearAcceleration = AHRS.LinearAcceleration;
+	S.AngularVelocity = AHRS.AngularVelocity;
+	S.AngularAcceleration = AHRS.AngularAcceleration;
+
+	S.Mass = Vehicle.Mass;
+	S.InertiaTensor = Vehicle.InertiaTensor;
+	S.CenterOfMass = Vehicle.CenterOfMass;
+
+	S.DesiredPilotInput = PilotInput.DesiredPilotInput;
+
+	S.NumEngines = FMath::Min(EngineController.Core.GetNumEngines(), QFM::MaxEngines);
+	for (int32 i = 0; i < S.NumEngines; i++)
+	{
+		S.EngineMixPercent[i] = EngineController.Core.EngineMixPercent[i];
+		S.EnginePercent[i] = EngineController.GetEnginePercent(i);
+		S.EngineRPM[i] = EngineController.GetEngineRPM(i);
+	}
+	S.Thrust = AppliedThrust;
+	S.Torque = AppliedTorque;
+
+	const QFM::FMultiRateSchedulerCore& Core = Scheduler.Core;
+	const bool bScheduler = Scheduler.Enabled;
+	S.RateLoopHz = bScheduler ? Core.GetStageRateHz(QFM::EControlStage::Attitude) : 0.0f;
+	S.InputHz = bScheduler ? Core.GetStageRateHz(QFM::EControlStage::Input) : 0.0f;
+	S.AHRSHz = bScheduler ? Core.GetStageRateHz(QFM::EControlStage::AHRS) : 0.0f;
+	S.PositionHz = bScheduler ? Core.GetStageRateHz(QFM::EControlStage::Position) : 0.0f;
+	S.TickCount = Core.TickCount;
+	S.DroppedTicks = Core.DroppedTicks;
+
+	DebugOverlay->Publish();
 }
 
 
@@ -83,9 +441,8 @@ void UQuadcopterFlightModel::Simulate(float DeltaTime, FBodyInstance* bodyInst)
 // Call this to add Linear force to our parent
 void UQuadcopterFlightModel::AddLocalForceZ(FVector forceToApply)
 {
-
 	//UE_LOG(LogTemp, Display, TEXT("%f"), forceToApply.Z);
-	FVector finalLocalForce = Parent->GetUpVector() * forceToApply.Z * 100.0f; // F = ma, so kg * ((cm/s)/s), so it's actually kg cm s^-2 => multiply by 100 to convert from m to cm
+	FVector finalLocalForce = QFMFromCore(PhysicsState.UpVector) * forceToApply.Z * 100.0f; // F = ma, so kg * ((cm/s)/s), so it's actually kg cm s^-2 => multiply by 100 to convert from m to cm
 	BodyInstance->AddForce(finalLocalForce, false, false);
 	//Trajectory.LinearAcceleration = forceToApply.Z / Mass / 100.0f; // To Set it in m/s
 }
@@ -94,11 +451,10 @@ void UQuadcopterFlightModel::AddLocalForceZ(FVector forceToApply)
 void UQuadcopterFlightModel::AddLocalTorque(FVector torqueToApply)
 {
 	// OPTION #5 adapted: Simulate Acceleration-Change in rads by Torque, use Inertia Tensor 
-	FTransform bodyTransform =  BodyInstance->GetUnrealWorldTransform();
-	//FVector AngularAccelerationGlobal = bodyTransform.TransformVectorNoScale(torqueToApply);
+	const FQuat BodyRotation = QFMFromCore(PhysicsState.Body.Rotation);
 	FVector AngularAccelerationLocal = torqueToApply; 
-	AngularAccelerationLocal *= BodyInstance->GetBodyInertiaTensor(); 
-	FVector TorqueWorld = bodyTransform.TransformVectorNoScale(AngularAccelerationLocal); 
+	AngularAccelerationLocal *= QFMFromCore(PhysicsState.InertiaTensor); 
+	FVector TorqueWorld = BodyRotation.RotateVector(AngularAccelerationLocal); 
 	BodyInstance->AddTorqueInRadians(TorqueWorld, false, false);  
 }
 
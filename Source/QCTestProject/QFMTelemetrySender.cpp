@@ -0,0 +1,198 @@
+
+#include "QFMTelemetrySender.h"
+
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+
+
+// Send a partly filled datagram after this long, so slow channels still arrive in time
+static const double TelemetryFlushInterval = 0.01;
+
+// Idle wait of the sender thread
+static const float TelemetryIdleSleep = 0.001f;
+
+
+FQFMTelemetrySender::FQFMTelemetrySender()
+	: Socket(nullptr)
+	, Thread(nullptr)
+	, NextEvict(0)
+	, Sequence(0)
+	, LastFlushTime(0.0)
+	, SentDatagrams(0)
+{
+}
+
+
+FQFMTelemetrySender::~FQFMTelemetrySender()
+{
+	StopAndWait();
+}
+
+
+bool FQFMTelemetrySender::Start(FSocket* SocketIn, TSharedPtr<FInternetAddr> RemoteAddrIn)
+{
+	if (Thread || !SocketIn || !RemoteAddrIn.IsValid())
+	{
+		return false;
+	}
+
+	Socket = SocketIn;
+	RemoteAddr = RemoteAddrIn;
+	bStopRequested = false;
+	LastFlushTime = FPlatformTime::Seconds();
+
+	Thread = FRunnableThread::Create(this, TEXT("QFMTelemetrySender"), 0, TPri_BelowNormal);
+	return Thread != nullptr;
+}
+
+
+void FQFMTelemetrySender::StopAndWait()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+
+void FQFMTelemetrySender::Stop()
+{
+	bStopRequested = true;
+}
+
+
+uint64 FQFMTelemetrySender::GetDroppedSamples() const
+{
+	uint64 Dropped = 0;
+	for (const QFM::FTelemetryRing& Ring : Rings)
+	{
+		Dropped += Ring.GetDropped();
+	}
+	return Dropped;
+}
+
+
+uint32 FQFMTelemetrySender::Run()
+{
+	while (!bStopRequested)
+	{
+		const int32 Samples = Drain();
+
+		if (FPlatformTime::Seconds() - LastFlushTime >= TelemetryFlushInterval)
+		{
+			FlushAll();
+		}
+
+		if (Samples == 0)
+		{
+			FPlatformProcess::Sleep(TelemetryIdleSleep);
+		}
+	}
+
+	// Whatever is still queued
+	Drain();
+	FlushAll();
+	return 0;
+}
+
+
+int32 FQFMTelemetrySender::Drain()
+{
+	QFM::FTelemetrySample Batch[PopBatch];
+	int32 Total = 0;
+
+	for (QFM::FTelemetryRing& Ring : Rings)
+	{
+		uint32 Count;
+		while ((Count = Ring.Pop(Batch, PopBatch)) > 0)
+		{
+			for (uint32 i = 0; i < Count; i++)
+			{
+				AppendSample(Batch[i]);
+			}
+			Total += Count;
+		}
+	}
+	return Total;
+}
+
+
+// A sample joins the open datagram of its vehicle and channel set, which is sent when full
+void FQFMTelemetrySender::AppendSample(const QFM::FTelemetrySample& Sample)
+{
+	if (QFM::WireCountChannels(Sample.ChannelBitmap) > QFM::TelemetryMaxValues)
+	{
+		return;
+	}
+
+	FStream& Stream = FindStream(Sample.VehicleId, Sample.ChannelBitmap);
+	if (Stream.Writer.IsOpen() && !Stream.Writer.HasRoom())
+	{
+		Flush(Stream);
+	}
+	if (!Stream.Writer.IsOpen())
+	{
+		Stream.Writer.Begin(Stream.Datagram, MaxDatagramBytes, Sample.VehicleId, Sequence++, Sample.ChannelBitmap);
+	}
+
+	Stream.Writer.AddRecord(Sample.SimTime, Sample.Values);
+}
+
+
+// The open stream of this vehicle and channel set, else a closed slot, else the next one round robin is sent and reused
+FQFMTelemetrySender::FStream& FQFMTelemetrySender::FindStream(uint32 VehicleId, uint32 ChannelBitmap)
+{
+	FStream* Free = nullptr;
+	for (FStream& Stream : Streams)
+	{
+		if (Stream.Writer.IsOpen())
+		{
+			if (Stream.Writer.Matches(VehicleId, ChannelBitmap))
+			{
+				return Stream;
+			}
+		}
+		else if (!Free)
+		{
+			Free = &Stream;
+		}
+	}
+	if (Free)
+	{
+		return *Free;
+	}
+
+	FStream& Evicted = Streams[NextEvict];
+	NextEvict = (NextEvict + 1) % MaxOpenStreams;
+	Flush(Evicted);
+	return Evicted;
+}
+
+
+void FQFMTelemetrySender::Flush(FStream& Stream)
+{
+	if (!Stream.Writer.IsOpen())
+	{
+		return;
+	}
+
+	const int32 DatagramBytes = (int32)Stream.Writer.End();
+	int32 BytesSent = 0;
+	if (Socket->SendTo(Stream.Datagram, DatagramBytes, BytesSent, *RemoteAddr))
+	{
+		SentDatagrams++;
+	}
+}
+
+
+void FQFMTelemetrySender::FlushAll()
+{
+	LastFlushTime = FPlatformTime::Seconds();
+	for (FStream& Stream : Streams)
+	{
+		Flush(Stream);
+	}
+}
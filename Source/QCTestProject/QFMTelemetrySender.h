@@ -0,0 +1,83 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Sockets.h"
+#include "IPAddress.h"
+
+#include "QFMCoreTelemetry.h"
+
+
+/*--- Background telemetry sender ---*/
+// Game and physics thread push FTelemetrySamples into their own lock-free ring (a few ns, never blocks).
+// This thread drains the rings, packs many samples into one datagram (QFMCoreWireFormat.h) and sends it.
+class FQFMTelemetrySender : public FRunnable
+{
+public:
+
+	FQFMTelemetrySender();
+	virtual ~FQFMTelemetrySender();
+
+	// Starts the thread. Socket and address stay owned by the caller and must outlive Stop()
+	bool Start(FSocket* SocketIn, TSharedPtr<FInternetAddr> RemoteAddrIn);
+
+	// Sends what is left and joins the thread
+	void StopAndWait();
+
+	FORCEINLINE bool Push(QFM::ETelemetryProducer Producer, const QFM::FTelemetrySample& Sample)
+	{
+		return Rings[Producer].Push(Sample);
+	}
+
+	FORCEINLINE QFM::FTelemetryRing* GetRing(QFM::ETelemetryProducer Producer)
+	{
+		return &Rings[Producer];
+	}
+
+	uint64 GetDroppedSamples() const;
+	uint64 GetSentDatagrams() const { return SentDatagrams; }
+
+
+	// FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+
+private:
+
+	// Stays below a typical MTU
+	static const int32 MaxDatagramBytes = 1400;
+	static const int32 PopBatch = 64;
+
+	// Open datagrams, one per (vehicle, channel set) stream, so interleaved streams still batch
+	static const int32 MaxOpenStreams = 16;
+
+	struct FStream
+	{
+		uint8 Datagram[MaxDatagramBytes];
+		QFM::FWirePacketWriter Writer;
+	};
+
+	// Drain all rings into the open datagrams, sending full datagrams. Returns number of samples
+	int32 Drain();
+	void AppendSample(const QFM::FTelemetrySample& Sample);
+	FStream& FindStream(uint32 VehicleId, uint32 ChannelBitmap);
+	void Flush(FStream& Stream);
+	void FlushAll();
+
+	QFM::FTelemetryRing Rings[QFM::TelemetryProducerNum];
+
+	FSocket* Socket;
+	TSharedPtr<FInternetAddr> RemoteAddr;
+	FRunnableThread* Thread;
+	FThreadSafeBool bStopRequested;
+
+	// Sender thread only
+	FStream Streams[MaxOpenStreams];
+	int32 NextEvict;
+	uint32 Sequence;
+	double LastFlushTime;
+	uint64 SentDatagrams;
+};
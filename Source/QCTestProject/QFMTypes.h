@@ -34,7 +34,12 @@ UENUM(BlueprintType)
 enum class EFrameMode : uint8
 {
     FrameModeCross 	UMETA(DisplayName="Cross"),
-	FrameModePlus 	UMETA(DisplayName="Plus")
+	FrameModePlus 	UMETA(DisplayName="Plus"),
+	FrameModeHexaX 	UMETA(DisplayName="Hexa X"),
+	FrameModeOctoX 	UMETA(DisplayName="Octo X"),
+	FrameModeCoaxX8 	UMETA(DisplayName="Coaxial X8"),
+	FrameModeY6 	UMETA(DisplayName="Y6"),
+	FrameModeCustom 	UMETA(DisplayName="Custom (Vehicle CustomMotors)")
 };
 
 
@@ -10,9 +10,6 @@ struct FUDPCustomData
 { 
 	GENERATED_USTRUCT_BODY()
  
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Joy Color")
-	FString Separator = FString(TEXT(","));
-
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="UDP Custom Data")
 	float XValue = 1.f;
  
@@ -26,8 +23,8 @@ struct FUDPCustomData
 FORCEINLINE FArchive& operator<<(FArchive &Ar, FUDPCustomData& TheStruct )
 {
 
+	// Binary floats, no separator. Streamed telemetry uses QFMCoreWireFormat.h
 	Ar << TheStruct.XValue; 
-    Ar << TheStruct.Separator;
 	Ar << TheStruct.YValue;
  
 	return Ar;
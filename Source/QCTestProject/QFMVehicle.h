@@ -15,9 +15,29 @@
 #include "Runtime/Engine/Private/PhysicsEngine/PhysXSupport.h"
 
 #include "QFMTypes.h"
+#include "QFMCoreVehicle.h"
+#include "QFMCoreBridge.h"
 
 #include "QFMVehicle.generated.h"
 
+
+// One motor of a custom frame, body space
+USTRUCT(BlueprintType)
+struct FVehicleMotor
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CustomFrame", meta = (ToolTip = "Motor position in m (X forward, Y right, Z up)")) 
+	FVector Position = FVector(0.5f, 0.0f, 0.0f);
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CustomFrame", meta = (ToolTip = "Thrust direction, normalized on use")) 
+	FVector ThrustAxis = FVector(0.0f, 0.0f, 1.0f);
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CustomFrame", meta = (ToolTip = "+1: reaction torque yaws right, -1: yaws left")) 
+	float SpinDirection = 1.0f;
+};
+
+
 USTRUCT(BlueprintType)
 struct FVehicle
 {
@@ -25,6 +45,9 @@ struct FVehicle
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle", meta = (ToolTip = "Frame Mode")) 
 	EFrameMode FrameMode = EFrameMode::FrameModeCross;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle", meta = (ToolTip = "Motors of the Custom frame mode, at most 8")) 
+	TArray<FVehicleMotor> CustomMotors;
 	
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CalculateSetting", meta = (ToolTip = "Calculate bodies mass and inertia")) 
 	bool CalculateMassProperties = false;
@@ -35,10 +58,10 @@ struct FVehicle
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CalculateSetting", meta = (ToolTip = "Central mass radius (m)")) 
 	float CentralRadius = 0.25f;
 	
-	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CalculateSetting", meta = (ToolTip = "NumberOfEngines")) 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CalculateSetting", meta = (ToolTip = "Number of engines for the mass calculation")) 
 	float NumberOfEngines = 4.0;
 	
-	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CalculateSetting", meta = (ToolTip = "Motor mass (kg), one of 4 motors")) 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CalculateSetting", meta = (ToolTip = "Motor mass (kg), one of NumberOfEngines motors")) 
 	float MotorMass = 5.0f;
 	
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "QuadcopterFlightModel|Vehicle|CalculateSetting", meta = (ToolTip = "Arm length of each arm (m)")) 
@@ -69,6 +92,9 @@ struct FVehicle
 	FBodyInstance *BodyInstance;
 	UPrimitiveComponent *PrimitiveComponent;
 
+	// Vehicle properties as seen by the controllers
+	QFM::FVehicleCore Core;
+
 
 	void Init(FBodyInstance *BodyInstanceIn, UPrimitiveComponent *PrimitiveComponentIn)
 	{
@@ -91,10 +117,11 @@ struct FVehicle
 		{
 			// Calculate new Mass and Inertia Tensor based on Vehicle Properties
 			float facCentralMass = 2.0f / 5.0f * CentralMass * CentralRadius * CentralRadius;
-			InertiaTensor.X = facCentralMass + 2 * ArmLength * ArmLength * MotorMass * 10000.0f;
-			InertiaTensor.Y = facCentralMass + 2 * ArmLength * ArmLength * MotorMass * 10000.0f;
-			InertiaTensor.Z = facCentralMass + 4 * ArmLength * ArmLength * MotorMass * 10000.0f;
-			Mass = CentralMass + 4 * MotorMass;
+			// Motors evenly spread on a circle: half of them count for roll and pitch
+			InertiaTensor.X = facCentralMass + 0.5f * NumberOfEngines * ArmLength * ArmLength * MotorMass * 10000.0f;
+			InertiaTensor.Y = facCentralMass + 0.5f * NumberOfEngines * ArmLength * ArmLength * MotorMass * 10000.0f;
+			InertiaTensor.Z = facCentralMass + NumberOfEngines * ArmLength * ArmLength * MotorMass * 10000.0f;
+			Mass = CentralMass + NumberOfEngines * MotorMass;
 			CenterOfMass = FVector(0.0f, 0.0f, 0.0f);
 		}
 		if (EnterMassProperties || CalculateMassProperties)
@@ -125,19 +152,35 @@ struct FVehicle
 			CenterOfMass = (BodyInstance->GetCOMPosition() - transform.GetTranslation()) / 100.0f; // To set it in m
 		}
 
+		SyncCore();
 	}
 
 	void Tock(float DeltaTimeIn)
 	{
 		DeltaTime = DeltaTimeIn;
+		Core.Tock(DeltaTime);
 	}
 
 
-	void Debug(FColor ColorIn, FVector2D DebugFontSizeIn)
+	// Copy the vehicle properties into the core. Once in Init: the control allocation is compiled from them there
+	void SyncCore()
 	{
-		GEngine->AddOnScreenDebugMessage(-1, 0, ColorIn, FString::Printf(TEXT("Center of Mass (m): X=%f Y=%f Z=%f"), CenterOfMass.X, CenterOfMass.Y, CenterOfMass.Z), true, DebugFontSizeIn);
-		GEngine->AddOnScreenDebugMessage(-1, 0, ColorIn, FString::Printf(TEXT("Moment of intertia (kg*m^2): X=%f Y=%f Z=%f"), InertiaTensor.X / 10000.0f, InertiaTensor.Y / 10000.0f, InertiaTensor.Z / 10000.0f), true, DebugFontSizeIn);
-		GEngine->AddOnScreenDebugMessage(-1, 0, ColorIn, FString::Printf(TEXT("Mass (kg): %f"), Mass), true, DebugFontSizeIn);
+		Core.FrameMode = static_cast<QFM::EFrameMode>(FrameMode);
+		Core.ArmLength = ArmLength;
+		Core.Mass = Mass;
+		Core.InertiaTensor = QFMToCore(InertiaTensor);
+		Core.CenterOfMass = QFMToCore(CenterOfMass);
+		Core.Gravity = Gravity;
+
+		Core.CustomFrame.NumMotors = 0;
+		for (const FVehicleMotor& Motor : CustomMotors)
+		{
+			QFM::FMotorGeometry CoreMotor;
+			CoreMotor.Position = QFMToCore(Motor.Position);
+			CoreMotor.ThrustAxis = QFMToCore(Motor.ThrustAxis.GetSafeNormal());
+			CoreMotor.SpinDirection = Motor.SpinDirection;
+			Core.CustomFrame.AddMotor(CoreMotor);
+		}
 	}
 	
 	float GetGravity()
@@ -14,6 +14,7 @@ URamaUDPSender::URamaUDPSender()
 {	
 	SenderSocket = NULL; 
 	ShowOnScreenDebugMessages = true;
+	Telemetry = MakeUnique<FQFMTelemetrySender>();
 }
  
 void URamaUDPSender::EndPlay(const EEndPlayReason::Type EndPlayReason)
@@ -21,10 +22,14 @@ void URamaUDPSender::EndPlay(const EEndPlayReason::Type EndPlayReason)
 	Super::EndPlay(EndPlayReason);
 	//~~~~~~~~~~~~~~~~
  
+	// Sender thread uses the socket, stop it first
+	Telemetry->StopAndWait();
+
 	if(SenderSocket)
 	{
 		SenderSocket->Close();
 		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(SenderSocket);
+		SenderSocket = NULL;
 	}
 }
  
@@ -58,6 +63,12 @@ bool URamaUDPSender::Start(
 	int32 SendSize = 2*1024*1024;
 	SenderSocket->SetSendBufferSize(SendSize,SendSize);
 	SenderSocket->SetReceiveBufferSize(SendSize, SendSize);
+
+	// Telemetry samples are sent from their own thread
+	if (!Telemetry->Start(SenderSocket, RemoteAddr))
+	{
+		ScreenMsg("Rama UDP Sender>> Telemetry thread could not be started");
+	}
  
 	UE_LOG(LogTemp,Log,TEXT("\n\n\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~"));
 	UE_LOG(LogTemp,Log,TEXT("Rama ****UDP**** Sender Initialized Successfully!!!"));
@@ -66,7 +77,7 @@ bool URamaUDPSender::Start(
 	return true;
 }
  
-bool URamaUDPSender::SendData(FString ToSend)
+bool URamaUDPSender::SendData(const FString& ToSend)
 {
 	if(!SenderSocket) 
 	{
@@ -90,7 +101,8 @@ bool URamaUDPSender::SendData(FString ToSend)
 	*/
 
 	
-	SenderSocket->SendTo((uint8*)TCHAR_TO_UTF8(*ToSend), sizeof(ToSend), BytesSent, *RemoteAddr);
+	FTCHARToUTF8 Utf8(*ToSend);
+	SenderSocket->SendTo((const uint8*)Utf8.Get(), Utf8.Length(), BytesSent, *RemoteAddr);
 	
 	if(BytesSent <= 0)
 	{
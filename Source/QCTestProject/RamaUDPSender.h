@@ -14,6 +14,8 @@
 #include "UObject/UObjectGlobals.h"
 #include "Serialization/Archive.h"
 
+#include "QFMTelemetrySender.h"
+
 
 //Base
 #include "RamaUDPSender.generated.h"
@@ -27,7 +29,19 @@ public:
 	URamaUDPSender();
  
 	//UFUNCTION(BlueprintCallable, Category=RamaUDPSender)
-	bool SendData(FString ToSend);
+	bool SendData(const FString& ToSend);
+
+	// Queue a sample for the telemetry thread. Lock-free, callable from the producers thread only
+	FORCEINLINE bool PushSample(QFM::ETelemetryProducer Producer, const QFM::FTelemetrySample& Sample)
+	{
+		return Telemetry->Push(Producer, Sample);
+	}
+
+	// Ring of one producing thread, e.g. to hand it to the flight model on the physics thread
+	FORCEINLINE QFM::FTelemetryRing* GetTelemetryRing(QFM::ETelemetryProducer Producer)
+	{
+		return Telemetry->GetRing(Producer);
+	}
  
 	TSharedPtr<FInternetAddr>	RemoteAddr;
 	FSocket* SenderSocket;
@@ -65,4 +79,9 @@ public:
  
 	/** Called whenever this actor is being removed from a level */
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+
+	// Rings and sender thread. Outlives EndPlay, late pushes are simply not sent
+	TUniquePtr<FQFMTelemetrySender> Telemetry;
 };
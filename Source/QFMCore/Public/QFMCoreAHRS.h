@@ -0,0 +1,219 @@
+#pragma once
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreFilter.h"
+#include "QFMCoreEngine.h"
+#include "QFMCoreSensors.h"
+#include "QFMCoreEstimator.h"
+
+
+namespace QFM
+{
+
+	/*--- Attitude and Heading Reference System ---*/
+	// The velocities are the body state, the accelerations their differences over the step. Both filters
+	// (QFMCoreFilter.h) are off by default, the values are then raw as before:
+	//  - GyroFilter: AngularVelocity in the body frame, where the motor vibration is, with the RPM notches on the
+	//    engine speeds of the last step. AngularAcceleration is the difference of the filtered rates
+	//  - AccelerationFilter: LinearAccelerationVector and AngularAcceleration
+	// With Sensors enabled (QFMCoreSensors.h) the angular velocity and acceleration come from a batch of IMU samples
+	// instead, the gyro filter running at the sample rate, and the altitude from the barometer. Attitude, horizontal
+	// position and velocities are still the body state, unless the Estimator (QFMCoreEstimator.h) is enabled as well:
+	// then attitude, velocity and position are its estimate from IMU, barometer and position fixes, and rates and
+	// accelerations are corrected by its bias estimates.
+	struct FAHRSCore
+	{
+		typedef TFilterChain<3, MaxFilterStages> FGyroFilter;
+		typedef TFilterChain<6, 2> FAccelerationFilter;
+
+		/*--- PARAMETERS ---*/
+		FGyroFilter GyroFilter;
+		FAccelerationFilter AccelerationFilter;
+		FSensorCore Sensors;
+		FEstimatorCore Estimator;
+
+		/*--- STATE ---*/
+		FVec3 Position;					// in m
+		FRotatorf Rotation;				// in deg
+		float LinearVelocity = 0.0f;	// TAS in m/s
+		FVec3 VelocityVector;			// in m/s, world
+		float LinearVelocity2D = 0.0f;	// Speed over ground in m/s
+		float LinearVelocityX = 0.0f;	// Speed over ground forward in m/s
+		FVec3 AngularVelocity;			// in deg/s
+		float LinearAcceleration = 0.0f;	// in m/s^2, direction of VelocityVector
+		FVec3 LinearAccelerationVector;	// in m/s^2, world
+		FVec3 AngularAcceleration;		// in deg/s^2
+
+		FQuatf WorldRotationQuat;
+		FVec3 WorldTranslationVect;		// in m
+		FVec3 BodyAngularVelocityVect;	// in deg/s
+
+		// Engine speeds for the RPM notches and the sensor vibration, optional
+		const FEngineCore* EngineController = nullptr;
+
+		// Samples of the last step
+		FImuBatch SensorBatch;
+
+
+		void Init(const FEngineCore* EngineControllerIn)
+		{
+			EngineController = EngineControllerIn;
+			GyroFilter.Reset();
+			AccelerationFilter.Reset();
+			Sensors.Reset();
+			Estimator.Reset();
+		}
+
+
+		void Tock(const FBodyState& Body, float DeltaTime)
+		{
+			if (Sensors.Settings.Enabled)
+			{
+				Sensors.Sample(Body, DeltaTime, EngineController, SensorBatch);
+				TockSamples(Body, SensorBatch, DeltaTime);
+				return;
+			}
+
+			Position = Body.Position;
+			Rotation = Body.Rotation.Rotator();
+
+			float OldLinearVelocity = LinearVelocity;
+			LinearVelocity = Body.LinearVelocity.Size();
+
+			FVec3 OldLinearVelocityVector = VelocityVector;
+			VelocityVector = Body.LinearVelocity;
+
+			LinearVelocity2D = Body.LinearVelocity.Size2D();
+			LinearVelocityX = Body.LinearVelocity.X;
+
+			FVec3 OldAngularVelocity = AngularVelocity;
+			AngularVelocity = Body.AngularVelocity * RadiansToDegrees(1.0f);
+			if (GyroFilter.Settings.IsEnabled())
+			{
+				const FVec3 Rate = Body.Rotation.UnrotateVector(AngularVelocity);
+				float Values[3] = { Rate.X, Rate.Y, Rate.Z };
+				if (EngineController)
+				{
+					GyroFilter.Step(Values, DeltaTime, EngineController->EngineSpeed, EngineController->GetNumEngines(), EngineController->EngineMaxRPM / 60.0f);
+				}
+				else
+				{
+					GyroFilter.Step(Values, DeltaTime);
+				}
+				AngularVelocity = Body.Rotation.RotateVector(FVec3(Values[0], Values[1], Values[2]));
+			}
+
+			LinearAcceleration = (OldLinearVelocity - LinearVelocity) / DeltaTime;  // This is the wrong direction of calc. Should be actual - old. check in code where I use it @ODO
+			AngularAcceleration = (OldAngularVelocity - AngularVelocity) / DeltaTime; // This is wrong as well! @ODO
+
+			LinearAccelerationVector = (VelocityVector - OldLinearVelocityVector) / DeltaTime;
+
+			FilterAccelerations(DeltaTime);
+
+			WorldRotationQuat = Body.Rotation;
+			WorldTranslationVect = Body.Position;
+			BodyAngularVelocityVect = AngularVelocity;
+		}
+
+
+		// Tock on IMU samples (body frame, oldest first) instead of the body velocities. The gyro filter runs on every
+		// sample, the last one is the angular velocity. The linear acceleration is the mean specific force of the batch
+		// in the world frame, plus gravity. An empty batch keeps both. With the Estimator the samples are bias corrected
+		// and rotated with the estimated attitude
+		void TockSamples(const FBodyState& Body, const FImuBatch& Batch, float DeltaTime)
+		{
+			FQuatf Attitude = Body.Rotation;
+			FVec3 Velocity = Body.LinearVelocity;
+			float GyroBias[3] = {};
+			float AccelerometerBias[3] = {};
+			if (Estimator.Settings.Enabled)
+			{
+				Estimator.Step(Batch, Body, Sensors.Settings.Gravity);
+				Attitude = Estimator.Rotation;
+				Velocity = Estimator.Velocity;
+				Position = Estimator.Position;
+				const FVec3& Gyro = Estimator.GyroBias;
+				const FVec3& Accelerometer = Estimator.AccelerometerBias;
+				GyroBias[0] = Gyro.X; GyroBias[1] = Gyro.Y; GyroBias[2] = Gyro.Z;
+				AccelerometerBias[0] = Accelerometer.X; AccelerometerBias[1] = Accelerometer.Y; AccelerometerBias[2] = Accelerometer.Z;
+			}
+			else
+			{
+				Position = Body.Position;
+				if (Batch.bBaroValid)
+				{
+					Position.Z = Batch.BaroAltitude;
+				}
+			}
+			Rotation = Attitude.Rotator();
+
+			float OldLinearVelocity = LinearVelocity;
+			LinearVelocity = Velocity.Size();
+			VelocityVector = Velocity;
+			LinearVelocity2D = Velocity.Size2D();
+			LinearVelocityX = Velocity.X;
+
+			FVec3 OldAngularVelocity = AngularVelocity;
+			if (Batch.Count > 0)
+			{
+				const bool bFilter = GyroFilter.Settings.IsEnabled();
+				float Rate[3] = {};
+				float ForceSum[3] = {};
+				for (int k = 0; k < Batch.Count; k++)
+				{
+					for (int a = 0; a < 3; a++)
+					{
+						Rate[a] = Batch.Gyro[a][k] - GyroBias[a];
+						ForceSum[a] += Batch.Accelerometer[a][k] - AccelerometerBias[a];
+					}
+					if (bFilter)
+					{
+						if (EngineController)
+						{
+							GyroFilter.Step(Rate, Batch.SamplePeriod, EngineController->EngineSpeed, EngineController->GetNumEngines(), EngineController->EngineMaxRPM / 60.0f);
+						}
+						else
+						{
+							GyroFilter.Step(Rate, Batch.SamplePeriod);
+						}
+					}
+				}
+
+				AngularVelocity = Attitude.RotateVector(FVec3(Rate[0], Rate[1], Rate[2])) * RadiansToDegrees(1.0f);
+				const FVec3 SpecificForce = FVec3(ForceSum[0], ForceSum[1], ForceSum[2]) * (1.0f / Batch.Count);
+				LinearAccelerationVector = Attitude.RotateVector(SpecificForce) + FVec3(0.0f, 0.0f, Sensors.Settings.Gravity);
+			}
+
+			LinearAcceleration = (OldLinearVelocity - LinearVelocity) / DeltaTime;  // same sign as Tock
+			AngularAcceleration = (OldAngularVelocity - AngularVelocity) / DeltaTime;
+
+			FilterAccelerations(DeltaTime);
+
+			WorldRotationQuat = Attitude;
+			WorldTranslationVect = Position;
+			BodyAngularVelocityVect = AngularVelocity;
+		}
+
+
+		void FilterAccelerations(float DeltaTime)
+		{
+			if (AccelerationFilter.Settings.IsEnabled())
+			{
+				float Values[6] = { LinearAccelerationVector.X, LinearAccelerationVector.Y, LinearAccelerationVector.Z,
+					AngularAcceleration.X, AngularAcceleration.Y, AngularAcceleration.Z };
+				AccelerationFilter.Step(Values, DeltaTime);
+				LinearAccelerationVector = FVec3(Values[0], Values[1], Values[2]);
+				AngularAcceleration = FVec3(Values[3], Values[4], Values[5]);
+			}
+		}
+
+
+		FQuatf GetWorldRotationQuat() const { return WorldRotationQuat; }
+		FVec3 GetWorldTranslationVect() const { return WorldTranslationVect; }
+		FVec3 GetBodyAngularVelocityVect() const { return BodyAngularVelocityVect; }
+		float GetWorldAltitude() const { return WorldTranslationVect.Z; }
+		FVec3 GetWorldVelocity() const { return VelocityVector; }
+		FVec3 GetWorldAccelerationXYZ() const { return LinearAccelerationVector; }
+	};
+
+}
@@ -0,0 +1,650 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreQuatKernels.h"
+#include "QFMCorePID.h"
+#include "QFMCoreInput.h"
+#include "QFMCoreAHRS.h"
+#include "QFMCorePosition.h"
+#include "QFMCoreEngine.h"
+
+
+namespace QFM
+{
+
+	/*--- Implementation of the Attitude Flight-Controller ---*/
+	struct FAttitudeCore
+	{
+		/*--- PARAMETERS ---*/
+		EFlightMode FlightMode = EFlightMode::Stabilize;
+		float AngleMax = 45.0f;				// Max Lean Angle Deg in Stab Mode
+		float SmoothingGain = 0.5f;
+		float AccroThrottleMid = 0.5f;
+		float PilotSpeedDown = 20.0f;		// m/s
+		float PilotSpeedUp = 20.0f;			// m/s
+		float YawPGain = 200.0f;			// deg/s
+		float AccroRollPitchPGain = 200.0f;	// deg/s
+		float AccroYawExpo = 0.0f;
+		float AccroRollPitchExpo = 0.0f;
+		float ThrottleDeadzone = 0.1f;
+		EControlLoop RotationControlLoop = EControlLoop::P;
+		FVec3 RateRollPidSettings = FVec3(1.0f, 1.0f, 1.0f);
+		FVec3 RatePitchPidSettings = FVec3(0.0f, 0.0f, 0.0f);
+		FVec3 RateYawPidSettings = FVec3(0.0f, 0.0f, 0.0f);
+		FVec3 RatePidFeedForward = FVec3(0.0f, 0.0f, 0.0f);	// Roll Pitch Yaw, times the normalized rate target
+		float RatePidDFilterHz = 0.0f;						// derivative low pass, 0 = off
+		float RatePidAntiWindup = 0.0f;						// back-calculation gain, 0 = off
+		bool bRatePidDOnMeasurement = false;				// derivative of the body rate instead of the error
+		float SPDDamping = 1.0f;
+		float SPDFrequency = 0.1f;
+
+		/*--- STATE ---*/
+
+		// Targets
+		FQuatf AttitudeTargetQuat;
+
+		// UpdateAngleTarget: tilt of the last roll / pitch input, rate limit of the last DeltaTime / gain
+		// (cos, sin, sin^2 of the half angle)
+		FVec2 TiltInput = FVec2(NAN, NAN);
+		FQuatf TiltQuat;
+		FVec2 RateLimitInput = FVec2(NAN, NAN);
+		FVec3 RateLimit;
+
+		// Roll, pitch and yaw rate PIDs in one. Normalized by the max rates of RatePidRanges
+		FPID3Core RatePid;
+		FVec2 RatePidRanges = FVec2(NAN, NAN);	// AccroRollPitchPGain, YawPGain
+
+		/*--- INTERFACE DATA ---*/
+		float DeltaTime = 0.0f;
+		FVec4 PilotInput;
+		FBodyState Body;
+
+		const FInputCore* InputController = nullptr;
+		const FAHRSCore* AHRS = nullptr;
+		FPositionCore* PositionController = nullptr;
+		FEngineCore* EngineController = nullptr;
+
+		/*--- UDP PID DEBUG ---*/
+		FVec3 UDPDebugOutput;
+
+
+		/*--- INIT FLIGHT MODES ---*/
+
+		void Init(const FBodyState& BodyIn, const FInputCore* InputControllerIn, const FAHRSCore* AHRSIn, FPositionCore* PositionControllerIn, FEngineCore* EngineControllerIn)
+		{
+			UDPDebugOutput = FVec3();
+
+			Body = BodyIn;
+			InputController = InputControllerIn;
+			AHRS = AHRSIn;
+			PositionController = PositionControllerIn;
+			EngineController = EngineControllerIn;
+
+			// Init Pids with min,max = -1..1. We normalize velocities in StepRatePid(). So we allways have the same PID-Settinghs, regardeless of Max Rates
+			const FVec3 Settings[3] = { RateRollPidSettings, RatePitchPidSettings, RateYawPidSettings };
+			const float FeedForward[3] = { RatePidFeedForward.X, RatePidFeedForward.Y, RatePidFeedForward.Z };
+			for (int Axis = 0; Axis < 3; Axis++)
+			{
+				RatePid.Init(Axis, -1, 1, Settings[Axis].X, Settings[Axis].Y, Settings[Axis].Z);
+				RatePid.Kff[Axis] = FeedForward[Axis];
+			}
+			RatePid.AntiWindup = RatePidAntiWindup;
+			RatePid.DFilterHz = RatePidDFilterHz;
+			RatePid.bDerivativeOnMeasurement = bRatePidDOnMeasurement;
+			RatePidRanges = FVec2(NAN, NAN);
+
+			Reset();
+
+			SelectFlightMode(FlightMode);
+		}
+
+
+		void Reset()
+		{
+			AttitudeTargetQuat = Body.Rotation;
+
+			RatePid.Reset();
+		}
+
+
+		void SelectFlightMode(EFlightMode FlightModeIn)
+		{
+			FlightMode = FlightModeIn;
+
+			switch (FlightMode)
+			{
+			case EFlightMode::Direct:
+				// Nothing to do here
+				break;
+			case EFlightMode::Stabilize:
+				PositionController->SetAltTarget(0.0f);
+				break;
+			case EFlightMode::AltHold:
+				if (!PositionController->IsActiveZ())
+				{
+					PositionController->SetAltTargetToCurrentAlt();
+				}
+				break;
+			case EFlightMode::Accro:
+				PositionController->SetAltTarget(0.0f);
+				break;
+			default:
+				break;
+			}
+		}
+
+
+		/*--- Tock Method. Call this from parents Tick() ---*/
+
+		void Tock(float DeltaTimeIn, const FBodyState& BodyIn)
+		{
+			DeltaTime = DeltaTimeIn;
+			Body = BodyIn;
+			PilotInput = InputController->GetDesiredInput();
+
+			switch (FlightMode)
+			{
+			case EFlightMode::Direct:
+				TockModeDirect();
+				break;
+			case EFlightMode::Stabilize:
+				TockModeStabilize();
+				break;
+			case EFlightMode::AltHold:
+				TockModeAltHold();
+				break;
+			case EFlightMode::Accro:
+				TockModeAccro();
+				break;
+			default:
+				break;
+			}
+		}
+
+
+		void TockModeDirect()
+		{
+			EngineController->SetDesiredThrottlePercent(GetPilotDesiredThrottle(PilotInput.W));
+			EngineController->SetDesiredRotationForces(FVec3(PilotInput.X, PilotInput.Y, PilotInput.Z));
+		}
+
+
+		void TockModeStabilize()
+		{
+			float TargetRoll;
+			float TargetPitch;
+
+			GetPilotDesiredLeanAngles(PilotInput.X, PilotInput.Y, TargetRoll, TargetPitch);
+			float TargetYawRate = GetPilotDesiredYawRate(PilotInput.Z);
+			float ThrottleScaled = GetPilotDesiredThrottle(PilotInput.W);
+
+			InputAngleRollPitchRateYaw(TargetRoll, TargetPitch, TargetYawRate);
+			EngineController->SetDesiredThrottlePercent(ThrottleScaled);
+		}
+
+
+		void TockModeAltHold()
+		{
+			float TargetRoll;
+			float TargetPitch;
+
+			GetPilotDesiredLeanAngles(PilotInput.X, PilotInput.Y, TargetRoll, TargetPitch);
+			float TargetYawRate = GetPilotDesiredYawRate(PilotInput.Z);
+
+			InputAngleRollPitchRateYaw(TargetRoll, TargetPitch, TargetYawRate);
+			// Altitude is held by TockPositionLoop(), which runs at the position rate
+		}
+
+
+		/*--- Position stage ---*/
+		// The single rate steps (Simulate, SimulateSingleRate) call it before PositionController->Tock(), so the Z
+		// controller still sees the DeltaTime of the last step. SimulateMultiRate calls it after: the Z loop has to run
+		// with the DeltaTime of the position stage, which only PositionController->Tock() sets.
+
+		void TockPositionLoop()
+		{
+			if (FlightMode != EFlightMode::AltHold) { return; }
+
+			float TargetClimbRate = GetPilotDesiredClimbRate(PilotInput.W);
+
+			PositionController->SetAltTargetFromClimbRate(TargetClimbRate);
+			PositionController->UpdateZController();
+		}
+
+
+		void TockModeAccro()
+		{
+			float TargetRollRate;
+			float TargetPitchRate;
+			float TargetYawRate;
+
+			GetPilotDesiredAngleRates(PilotInput.X, PilotInput.Y, PilotInput.Z, TargetRollRate, TargetPitchRate, TargetYawRate);
+			float ThrottleScaled = GetPilotDesiredThrottle(PilotInput.W);
+
+			InputRateBodyRollPitchYaw(TargetRollRate, TargetPitchRate, TargetYawRate);
+			EngineController->SetDesiredThrottlePercent(ThrottleScaled);
+		}
+
+
+		// Accro without the attitude target: the pilots stick rates are the body rate targets of the rate loop.
+		// This is what FFleetCore steps, QFMFleetBench checks the fleet against it
+		void TockRateLoop(float DeltaTimeIn, const FBodyState& BodyIn)
+		{
+			DeltaTime = DeltaTimeIn;
+			Body = BodyIn;
+			PilotInput = InputController->GetDesiredInput();
+
+			float TargetRollRate;
+			float TargetPitchRate;
+			float TargetYawRate;
+
+			GetPilotDesiredAngleRates(PilotInput.X, PilotInput.Y, PilotInput.Z, TargetRollRate, TargetPitchRate, TargetYawRate);
+			EngineController->SetDesiredThrottlePercent(GetPilotDesiredThrottle(PilotInput.W));
+
+			const FVec3 AngularVelocityTgt(DegreesToRadians(TargetRollRate), DegreesToRadians(TargetPitchRate), DegreesToRadians(TargetYawRate));
+			RunRateLoop(AngularVelocityTgt, Body.Rotation.UnrotateVector(Body.AngularVelocity));
+		}
+
+
+		/*--- CALCULATE PILOTs DESIRE ---*/
+
+		// GetPilotDesiredLeanAngles - transform pilot's roll or pitch input into a desired lean angle
+		// returns desired angles in degrees
+		void GetPilotDesiredLeanAngles(float RollIn, float PitchIn, float& RollOut, float& PitchOut)
+		{
+			// Limit AngleMax
+			AngleMax = Clamp<float>(AngleMax, 0.0f, 80.0f);
+
+			// Circular limit Roll and Pitch Inputs
+			float TotalIn = FVec2(RollIn, PitchIn).Size();
+			if (TotalIn > 1.0f)
+			{
+				float Ratio = 1.0f / TotalIn;
+				RollIn *= Ratio;
+				PitchIn *= Ratio;
+			}
+
+			// scale RollIn, PitchIn to AngleMax range
+			RollOut = RollIn * AngleMax;
+			PitchOut = PitchIn * AngleMax;
+		}
+
+
+		// GetPilotDesiredAngleRates - transform pilot's roll pitch and yaw input into a desired lean angle rates
+		// returns desired angle rates in degrees-per-second
+		void GetPilotDesiredAngleRates(float RollIn, float PitchIn, float YawIn, float& RollRateOut, float& PitchRateOut, float& YawRateOut)
+		{
+			// Circular limit Roll and Pitch Inputs
+			float TotalIn = FVec2(RollIn, PitchIn).Size();
+			if (TotalIn > 1.0f)
+			{
+				float Ratio = 1.0f / TotalIn;
+				RollIn *= Ratio;
+				PitchIn *= Ratio;
+			}
+
+			// range check expo
+			AccroRollPitchExpo = Clamp(AccroRollPitchExpo, -0.5f, 1.0f);
+
+			// roll expo
+			float RPIn3 = RollIn * RollIn * RollIn;
+			RollRateOut = ((AccroRollPitchExpo * RPIn3) + ((1.0f - AccroRollPitchExpo) * RollIn)) * AccroRollPitchPGain;
+
+			// pitch expo
+			RPIn3 = PitchIn * PitchIn * PitchIn;
+			PitchRateOut = ((AccroRollPitchExpo * RPIn3) + ((1.0f - AccroRollPitchExpo) * PitchIn)) * AccroRollPitchPGain;
+
+			// calculate yaw rate request
+			YawRateOut = GetPilotDesiredYawRate(YawIn);
+		}
+
+
+		// GetPilotDesiredYawRate - transform pilot's yaw input into a desired yaw rate
+		// returns desired yaw rate in degrees per second
+		float GetPilotDesiredYawRate(float YawIn)
+		{
+			// range check expo
+			AccroYawExpo = Clamp(AccroYawExpo, -0.5f, 1.0f);
+
+			// yaw expo
+			float YawIn3 = YawIn * YawIn * YawIn;
+			float YawOut = (AccroYawExpo * YawIn3) + ((1.0f - AccroYawExpo) * YawIn);
+			return YawOut * YawPGain;
+		}
+
+
+		// GetPilotDesiredThrottle transform pilot's manual throttle input to make hover throttle mid stick
+		// used only for manual throttle modes
+		// returns throttle output 0 to 1
+		float GetPilotDesiredThrottle(float ThrottleIn) const
+		{
+			float MidStick = InputController->GetThrottleMidStick();
+			float ThrottleMidIn = EngineController->GetThrottleHover();
+
+			// ensure reasonable throttle values
+			ThrottleIn = Clamp<float>(ThrottleIn, 0.0f, 1.0f);
+
+			// calculate normalised throttle input 0..1 and mid = 0.5
+			if (ThrottleIn < MidStick)
+			{
+				// below the deadband
+				ThrottleIn = ThrottleIn * 0.5f / MidStick;
+			}
+			else if (ThrottleIn > MidStick)
+			{
+				// above the deadband
+				ThrottleIn = 0.5f + (ThrottleIn - MidStick) * 0.5f / (1.0f - MidStick);
+			}
+			else
+			{
+				// must be in the deadband
+				ThrottleIn = 0.5f;
+			}
+
+			// Expo
+			//!!! We have a  problem with the Expo function. If we clamp it, we dont hover, if we dont: ThrottleOut(1) != 1
+			float Expo = -(ThrottleMidIn - 0.5) / 0.375;
+
+			return (ThrottleIn * (1 - Expo) + Expo * ThrottleIn * ThrottleIn * ThrottleIn);
+		}
+
+
+		// GetPilotDesiredClimbRate - transform pilot's throttle input to climb rate in m/s
+		// without any deadzone at the bottom
+		float GetPilotDesiredClimbRate(float ThrottleIn)
+		{
+			float MidStick = InputController->GetThrottleMidStick();
+
+			// ensure a reasonable deadzone
+			ThrottleDeadzone = Clamp<float>(ThrottleDeadzone, 0.0f, 0.4f);
+
+			float DeadbandTop = MidStick + ThrottleDeadzone;
+			float DeadbandBottom = MidStick - ThrottleDeadzone;
+
+			// ensure a reasonable throttle value
+			ThrottleIn = Clamp<float>(ThrottleIn, 0.0f, 1.0f);
+
+			// check throttle is above, below or in the deadband
+			if (ThrottleIn < DeadbandBottom)
+			{
+				return PilotSpeedDown * (ThrottleIn - DeadbandBottom) / DeadbandBottom;
+			}
+			else if (ThrottleIn > DeadbandTop)
+			{
+				return PilotSpeedUp * (ThrottleIn - DeadbandTop) / (1.0f - DeadbandTop);
+			}
+			return 0.0f;
+		}
+
+
+		/*--- INPUT FUNCTIONS: INPUT DATA INTO FLIGHT CONTROLLER ---*/
+
+		// Command an angular roll, pitch and rate yaw with angular velocity feedforward
+		void InputAngleRollPitchRateYaw(float RollIn, float PitchIn, float YawRateIn)
+		{
+			UpdateAngleTarget(RollIn, PitchIn, YawRateIn);
+
+			//
+			// Perform Calculated Rotation from AttitudeQuat to AttitudeTargetQuat
+			//
+
+			RunQuat();
+		}
+
+
+		// Turns AttitudeTargetQuat by the yaw rate and towards RollIn, PitchIn (deg) with <= AccroRollPitchPGain.
+		// Quaternion algebra only: the heading is taken from the target's forward axis, the tilt and the rate limit
+		// depend on the inputs alone and are cached, they hold over all substeps of a physics step
+		void UpdateAngleTarget(float RollIn, float PitchIn, float YawRateIn)
+		{
+			// Rotate for Yaw around World (z) axis. Both are unit quaternions, no need to normalize
+			AttitudeTargetQuat = GetWorldYawQuat(DegreesToRadians(YawRateIn * DeltaTime)) * AttitudeTargetQuat;
+
+			// Desired attitude: the heading of the target, tilted by the inputs (FRotatorf order: yaw after pitch and roll)
+			if (RollIn != TiltInput.X || PitchIn != TiltInput.Y)
+			{
+				// FRotatorf(-PitchIn, 0, -RollIn).Quaternion() without the yaw terms
+				TiltInput = FVec2(RollIn, PitchIn);
+				const float SP = std::sin(DegreesToRadians(-0.5f * PitchIn)), CP = std::cos(DegreesToRadians(-0.5f * PitchIn));
+				const float SR = std::sin(DegreesToRadians(-0.5f * RollIn)), CR = std::cos(DegreesToRadians(-0.5f * RollIn));
+				TiltQuat = FQuatf(-SR * CP, -CR * SP, -SR * SP, CR * CP);
+			}
+			const FQuatf AttitudeDesiredTargetQuat = GetHeadingQuat(AttitudeTargetQuat) * TiltQuat;
+
+			// Shortest arc to the desired attitude. Its W is the cosine of half the angle
+			const float Direction = ((AttitudeDesiredTargetQuat | AttitudeTargetQuat) >= 0) ? 1.0f : -1.0f;
+			FQuatf DeltaQuat = (AttitudeDesiredTargetQuat * Direction) * AttitudeTargetQuat.Inverse();
+
+			// Speed limit: AccroRollPitchPGain * DeltaTime as half angle cosine / sine. Compared by the sine, the cosine
+			// of the small angles here is too close to 1 for a float
+			if (DeltaTime != RateLimitInput.X || AccroRollPitchPGain != RateLimitInput.Y)
+			{
+				RateLimitInput = FVec2(DeltaTime, AccroRollPitchPGain);
+				const float HalfMax = 0.5f * DegreesToRadians(std::max(AccroRollPitchPGain * DeltaTime, 0.0f));
+				RateLimit = FVec3(std::cos(HalfMax), std::sin(HalfMax), HalfMax < 0.5f * Pi ? std::sin(HalfMax) * std::sin(HalfMax) : 2.0f);
+			}
+			const float SinSquared = DeltaQuat.X * DeltaQuat.X + DeltaQuat.Y * DeltaQuat.Y + DeltaQuat.Z * DeltaQuat.Z;
+			if (SinSquared <= RateLimit.Z)
+			{
+				// Reached. Heading and tilt are unit quaternions, so is their product
+				AttitudeTargetQuat = AttitudeDesiredTargetQuat * Direction;
+				return;
+			}
+
+			// Same axis, limited angle
+			const float AxisScale = RateLimit.Y / std::sqrt(SinSquared);
+			DeltaQuat = FQuatf(DeltaQuat.X * AxisScale, DeltaQuat.Y * AxisScale, DeltaQuat.Z * AxisScale, RateLimit.X);
+			AttitudeTargetQuat = DeltaQuat * AttitudeTargetQuat;
+
+			// Unit up to rounding: one Newton step of 1 / sqrt around 1 keeps it there without sqrt and division
+			AttitudeTargetQuat = AttitudeTargetQuat * (1.5f - 0.5f * (AttitudeTargetQuat | AttitudeTargetQuat));
+		}
+
+
+		// Former UpdateAngleTarget through FRotatorf and axis / angle, unchanged. Reference for QFMAttitudeBench
+		void UpdateAngleTargetRotator(float RollIn, float PitchIn, float YawRateIn)
+		{
+			//
+			// Rotate Target around Yaw Rate Quat
+			//
+
+			//Yaw Rate World Rotation increment
+			FQuatf YawRateUpdateQuat = FQuatf(FRotatorf(0.0f, YawRateIn * DeltaTime, 0.0f).Clamp());
+			// Rotate for Yaw around World (z) axis
+			AttitudeTargetQuat = YawRateUpdateQuat * AttitudeTargetQuat;
+			AttitudeTargetQuat.Normalize();
+
+			//
+			// Rotate towards RollIn, PitchIn with <= MaxSpeed
+			//
+
+			//  Calculate desired Attitude from Roll and pitch angles
+			FRotatorf AttitudeTargetRotator = AttitudeTargetQuat.Rotator();
+			AttitudeTargetRotator.Roll = -RollIn;
+			AttitudeTargetRotator.Pitch = -PitchIn;
+			AttitudeTargetRotator = AttitudeTargetRotator.Clamp();
+			// Compute quaternion target attitude
+			FQuatf AttitudeDesiredTargetQuat = FQuatf(AttitudeTargetRotator);
+			AttitudeDesiredTargetQuat.Normalize();
+
+			// Speed limit the rotation from Targe Attitude to new desired target Attitude
+
+			// 1.) Get shortest arc Delta Rot and Limit Rota Speed to AccroRollPitchPGain
+			float Direction = ((AttitudeDesiredTargetQuat | AttitudeTargetQuat) >= 0) ? 1.0f : -1.0f;
+			FQuatf DeltaQuat = (AttitudeDesiredTargetQuat * Direction) * AttitudeTargetQuat.Inverse();
+			DeltaQuat.Normalize();
+
+			// 2.) Calc  Desired Velocity for Delta Rot from 1)
+			FVec3 Axis;
+			float Angle = 0.0f;
+			DeltaQuat.ToAxisAndAngle(Axis, Angle);
+			Axis.Normalize();
+
+			// We need the max RP turn rates in rads for clamping angular velocities
+			float MaxRPVelocityRads = DegreesToRadians(AccroRollPitchPGain * DeltaTime);
+
+			// We speed limit the velocity
+			float ClampedAngle = Clamp(Angle, 0.0f, MaxRPVelocityRads);
+			// Recreate DeltaQuat, now with limited speed
+			DeltaQuat = FQuatf(Axis, ClampedAngle);
+			DeltaQuat.Normalize();
+
+			// Calculate new TargetQuat
+			AttitudeTargetQuat = DeltaQuat * AttitudeTargetQuat;
+			AttitudeTargetQuat.Normalize();
+		}
+
+
+		// Rotation about world Z by Angle (rad). Taylor series for the small per-substep angles
+		static FQuatf GetWorldYawQuat(float Angle)
+		{
+			const float Half = 0.5f * Angle;
+			const float Half2 = Half * Half;
+			if (Half2 < 0.01f)
+			{
+				// Truncation below 2e-9 for |Half| < 0.1
+				return FQuatf(0.0f, 0.0f, Half * (1.0f - Half2 * (1.0f / 6.0f) * (1.0f - Half2 * (1.0f / 20.0f))),
+					1.0f - Half2 * 0.5f * (1.0f - Half2 * (1.0f / 12.0f)));
+			}
+			return FQuatf(0.0f, 0.0f, std::sin(Half), std::cos(Half));
+		}
+
+
+		// Yaw of Q (as Q.Rotator().Yaw) as a rotation about world Z. The forward axis projected to the ground gives
+		// cos / sin of the yaw (times Size), the half angle follows from the half angle identities
+		static FQuatf GetHeadingQuat(const FQuatf& Q)
+		{
+			const float ForwardX = 1.0f - 2.0f * (Q.Y * Q.Y + Q.Z * Q.Z);
+			const float ForwardY = 2.0f * (Q.W * Q.Z + Q.X * Q.Y);
+			const float Size = std::sqrt(ForwardX * ForwardX + ForwardY * ForwardY);
+			if (Size < 1e-6f)
+			{
+				// Pointing straight up or down
+				return FQuatf(FRotatorf(0.0f, Q.Rotator().Yaw, 0.0f));
+			}
+			// (W, Z) is (1 + cos, sin) normalized, or (sin, 1 - cos) for yaws past 90 deg where 1 + cos cancels
+			if (ForwardX >= 0.0f)
+			{
+				const float Scale = 1.0f / std::sqrt(2.0f * Size * (Size + ForwardX));
+				return FQuatf(0.0f, 0.0f, ForwardY * Scale, (Size + ForwardX) * Scale);
+			}
+			const float Scale = std::copysign(1.0f / std::sqrt(2.0f * Size * (Size - ForwardX)), ForwardY);
+			return FQuatf(0.0f, 0.0f, (Size - ForwardX) * Scale, ForwardY * Scale);
+		}
+
+
+		void InputRateBodyRollPitchYaw(float RollRateIn, float PitchRateIn, float YawRateIn)
+		{
+			FRotatorf RateRotator = FRotatorf(-PitchRateIn * DeltaTime, YawRateIn * DeltaTime, -RollRateIn * DeltaTime).Clamp();
+			FQuatf AttitudeTargetUpdateQuat = FQuatf(RateRotator);
+
+			AttitudeTargetQuat = AttitudeTargetQuat * AttitudeTargetUpdateQuat;
+			AttitudeTargetQuat.Normalize();
+
+			// Call quaternion attitude controller
+			RunQuat();
+		}
+
+
+		/* --- RUN QUAT --- */
+
+		void RunQuat()
+		{
+			// Get vehicles current orientation
+			const FQuatf& AttitudeVehicleQuat = Body.Rotation;
+
+			// Rotation from our current rotation to the desired one, the short way round, as axis * angle.
+			// Without acos: exact for small errors too
+			const FVec3 AttitudeError = QuatToRotationVector(QuatRelative(AttitudeTargetQuat, AttitudeVehicleQuat));
+
+			// AngularVelocityTgt is the w we need to achieve in Rads
+			FVec3 AngularVelocityTgt = AttitudeError / DeltaTime;
+
+			// Make all Velocity Vectors local space
+			AngularVelocityTgt = AttitudeVehicleQuat.UnrotateVector(AngularVelocityTgt);
+			FVec3 AngularVelocityNow = AttitudeVehicleQuat.UnrotateVector(Body.AngularVelocity);
+
+			RunRateLoop(AngularVelocityTgt, AngularVelocityNow);
+		}
+
+
+		// Rate loop of RunQuat: local target and current angular velocity in rads to the rotation request of the engines
+		void RunRateLoop(const FVec3& AngularVelocityTgt, const FVec3& AngularVelocityNow)
+		{
+			float MaxRPVelocityRad = DegreesToRadians(AccroRollPitchPGain);
+			float MaxYVelocityRad = DegreesToRadians(YawPGain);
+
+			// AngularVelocityToApply is the w we need to Apply to physx directly or after torque calculation
+			FVec3 AngularVelocityToApply;
+
+			// AngularVelocityToApply depends on the choosen ControlLoop
+			if (RotationControlLoop == EControlLoop::P)
+			{
+				// For Option a) Calculate the (raw) Velocity we have to apply by taking into account, that we have Velocity allready
+				AngularVelocityToApply = AngularVelocityTgt - AngularVelocityNow;
+			}
+			else if (RotationControlLoop == EControlLoop::PID)
+			{
+				// For Option b) Run the PID-Controllers to find PID Angular Velocity to Apply in rads
+				AngularVelocityToApply = StepRatePid(AngularVelocityNow, AngularVelocityTgt);
+			}
+			else if (RotationControlLoop == EControlLoop::SPD)
+			{
+				// For Option c) Run the FPD-Controllers to find SPD Angular Velocity to Apply in rads
+				AngularVelocityToApply = StepRateRollSpd(AngularVelocityNow, AngularVelocityTgt);
+			}
+
+			// We clamp Angular Velocity to the requested max
+			AngularVelocityToApply.X = Clamp(AngularVelocityToApply.X, -MaxRPVelocityRad, MaxRPVelocityRad);
+			AngularVelocityToApply.Y = Clamp(AngularVelocityToApply.Y, -MaxRPVelocityRad, MaxRPVelocityRad);
+			AngularVelocityToApply.Z = Clamp(AngularVelocityToApply.Z, -MaxYVelocityRad, MaxYVelocityRad);
+
+			// Send Calculated Roll Acceleration in rads to the Engine Controller
+			FVec3 DesiredEngineRotation = FVec3(
+				AngularVelocityToApply.X / MaxRPVelocityRad,
+				AngularVelocityToApply.Y / MaxRPVelocityRad,
+				AngularVelocityToApply.Z / MaxYVelocityRad
+			);
+			DesiredEngineRotation /= DeltaTime;
+			EngineController->SetDesiredRotationForces(DesiredEngineRotation); // local space !!
+		}
+
+
+		// Run the angular velocity PIDs of all three axes and return the output in rads.
+		// They work on rates normalized by the max rates, the factors only change with the gains
+		FVec3 StepRatePid(const FVec3& RateActualRads, const FVec3& RateTargetRads)
+		{
+			if (RatePidRanges.X != AccroRollPitchPGain || RatePidRanges.Y != YawPGain)
+			{
+				RatePidRanges = FVec2(AccroRollPitchPGain, YawPGain);
+				RatePid.SetNormalization(0, DegreesToRadians(AccroRollPitchPGain), DegreesToRadians(AccroRollPitchPGain));
+				RatePid.SetNormalization(1, DegreesToRadians(AccroRollPitchPGain), DegreesToRadians(AccroRollPitchPGain));
+				RatePid.SetNormalization(2, DegreesToRadians(YawPGain), DegreesToRadians(YawPGain));
+			}
+
+			const float Target[3] = { RateTargetRads.X, RateTargetRads.Y, RateTargetRads.Z };
+			const float Actual[3] = { RateActualRads.X, RateActualRads.Y, RateActualRads.Z };
+			float Out[3];
+			RatePid.Calculate(Target, Actual, DeltaTime, Out);
+			return FVec3(Out[0], Out[1], Out[2]);
+		}
+
+		// Run the rotational angular velocity FPD controller and return the output detla w in rads
+		FVec3 StepRateRollSpd(const FVec3& Current, const FVec3& Target) const
+		{
+			float kp = SPDFrequency * SPDFrequency * 9.0f;
+			float kd = 4.5f * SPDFrequency * SPDDamping;
+			float dt = DeltaTime;
+
+			float g = 1.0f / (1.0f + kd * dt + kp * dt * dt);
+			float kpg = kp * g;
+			float kdg = (kd + kp * dt) * g;
+
+			return Target * kpg - Current * kdg;
+		}
+	};
+
+}
@@ -0,0 +1,420 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "QFMCoreColumnFile.h"
+#include "QFMCoreFlightConfig.h"
+#include "QFMCoreFlightModel.h"
+#include "QFMCoreFlightRecorder.h"
+#include "QFMCoreRandom.h"
+#include "QFMCoreRigidBody.h"
+#include "QFMCoreThreadPool.h"
+
+
+namespace QFM
+{
+
+	/*--- Monte-Carlo robustness campaign ---*/
+	// Every run samples its parameters, flies a short scripted manoeuvre with the complete controller chain on an
+	// FRigidBodyCore and is scored on attitude tracking, tilt, rates and altitude loss. Runs are spread over an
+	// FThreadPool and written to a column file in run order, one row group per batch.
+	// Run N draws from FRandomStream(Seed, N): its parameters, noise and result do not depend on the thread count
+	// or on the other runs, so a failed run is flown again bit exact with a flight recorder attached.
+	//
+	// A parameter is either a QFMCoreFlightConfig name (what the controller believes, e.g. motor lag or gains)
+	// or a plant parameter the controller does not know about:
+	//	Plant.MassScale				true mass / Vehicle.Mass
+	//	Plant.InertiaScale.X/Y/Z	true inertia / Vehicle.InertiaTensor (the engine scales torque by the configured one)
+	//	Plant.EngineKScale			true Engine_K / the allocated one, scales the thrust
+	//	Noise.Gyro					sensor noise standard deviation, rad/s
+	//	Noise.Attitude				deg
+	//	Noise.Velocity				m/s
+	//	Noise.Position				m
+
+	enum class ECampaignDistribution : uint8_t
+	{
+		Uniform,		// A..B
+		Normal			// mean A, standard deviation B
+	};
+
+	struct FCampaignParam
+	{
+		std::string Name;
+		ECampaignDistribution Distribution = ECampaignDistribution::Uniform;
+		float A = 0.0f;
+		float B = 0.0f;
+		bool bRelative = false;		// config parameters: the sample multiplies the value of the base model
+	};
+
+	constexpr int MaxCampaignParams = 32;
+
+
+	enum ECampaignMetric
+	{
+		CampaignMaxAttitudeError,		// deg, body to the attitude target of the controller
+		CampaignRmsAttitudeError,		// deg
+		CampaignMaxTilt,				// deg from level
+		CampaignMaxRate,				// deg/s
+		CampaignAltitudeLoss,			// m below the start
+		CampaignMetricNum
+	};
+
+	inline const char* GetCampaignMetricName(int Metric)
+	{
+		static const char* const Names[CampaignMetricNum] = { "MaxAttitudeError", "RmsAttitudeError", "MaxTilt", "MaxRate", "AltitudeLoss" };
+		return Names[Metric];
+	}
+
+	// Failure bits
+	enum ECampaignFailure : uint32_t
+	{
+		CampaignFailureNonFinite = 1,
+		CampaignFailureFlip = 2,
+		CampaignFailureAttitude = 4,
+		CampaignFailureAltitude = 8
+	};
+
+
+	struct FCampaignSettings
+	{
+		uint32_t Seed = 1;
+		float PhysicsHz = 250.0f;
+		bool bMultiRate = true;				// as UQuadcopterFlightModel with Scheduler.Enabled
+		float Duration = 4.0f;				// s per run
+
+		// Manoeuvre in the flight mode of the base model (AltHold): hover, then the stick on roll, pitch
+		// and yaw for SegmentTime each, then hover again
+		float SettleTime = 0.5f;			// s
+		float SegmentTime = 1.0f;			// s
+		float Stick = 0.5f;					// -1..1
+
+		float MaxTilt = 90.0f;				// deg, flipped above
+		float MaxAttitudeError = 30.0f;		// deg
+		float MaxAltitudeLoss = 5.0f;		// m
+
+		int BatchRuns = 4096;				// runs per row group
+	};
+
+
+	// Values drawn for one run, the plant side of it
+	struct FCampaignTruth
+	{
+		float MassScale = 1.0f;
+		FVec3 InertiaScale = FVec3(1.0f, 1.0f, 1.0f);
+		float EngineKScale = 1.0f;
+		float GyroNoise = 0.0f;
+		float AttitudeNoise = 0.0f;
+		float VelocityNoise = 0.0f;
+		float PositionNoise = 0.0f;
+
+		float* Find(const std::string& Name)
+		{
+			if (Name == "Plant.MassScale") { return &MassScale; }
+			if (Name == "Plant.InertiaScale.X") { return &InertiaScale.X; }
+			if (Name == "Plant.InertiaScale.Y") { return &InertiaScale.Y; }
+			if (Name == "Plant.InertiaScale.Z") { return &InertiaScale.Z; }
+			if (Name == "Plant.EngineKScale") { return &EngineKScale; }
+			if (Name == "Noise.Gyro") { return &GyroNoise; }
+			if (Name == "Noise.Attitude") { return &AttitudeNoise; }
+			if (Name == "Noise.Velocity") { return &VelocityNoise; }
+			if (Name == "Noise.Position") { return &PositionNoise; }
+			return nullptr;
+		}
+	};
+
+
+	struct FCampaignResult
+	{
+		uint32_t Run = 0;
+		uint32_t Failure = 0;					// ECampaignFailure bits
+		float Values[MaxCampaignParams] = {};	// as applied, per FCampaignParam
+		float Metrics[CampaignMetricNum] = {};
+	};
+
+
+	inline std::vector<FCampaignParam> GetDefaultCampaignParams()
+	{
+		return {
+			{ "Plant.MassScale", ECampaignDistribution::Normal, 1.0f, 0.1f, false },
+			{ "Plant.InertiaScale.X", ECampaignDistribution::Normal, 1.0f, 0.15f, false },
+			{ "Plant.InertiaScale.Y", ECampaignDistribution::Normal, 1.0f, 0.15f, false },
+			{ "Plant.InertiaScale.Z", ECampaignDistribution::Normal, 1.0f, 0.15f, false },
+			{ "Plant.EngineKScale", ECampaignDistribution::Normal, 1.0f, 0.05f, false },
+			{ "EngineController.MotorDynamics.SpinUpTimeConstant", ECampaignDistribution::Uniform, 0.01f, 0.08f, false },
+			{ "EngineController.MotorDynamics.SpinDownTimeConstant", ECampaignDistribution::Uniform, 0.02f, 0.12f, false },
+			{ "Noise.Gyro", ECampaignDistribution::Uniform, 0.0f, 0.05f, false },
+			{ "Noise.Attitude", ECampaignDistribution::Uniform, 0.0f, 0.5f, false },
+			{ "Noise.Velocity", ECampaignDistribution::Uniform, 0.0f, 0.05f, false },
+			{ "Noise.Position", ECampaignDistribution::Uniform, 0.0f, 0.05f, false } };
+	}
+
+
+
+	class FCampaignRunner
+	{
+	public:
+
+		// Vehicle and every parameter that is not sampled
+		FFlightModelCore Base;
+		FCampaignSettings Settings;
+		std::vector<FCampaignParam> Params = GetDefaultCampaignParams();
+
+
+		FCampaignRunner()
+		{
+			// The default parameters sample the motor lag. AltHold: in Stabilize any mass error is an altitude loss
+			Base.EngineController.MotorDynamics.Settings.Enabled = true;
+			Base.AttitudeController.FlightMode = EFlightMode::AltHold;
+		}
+
+
+		// Number of Params that name neither a config nor a plant parameter
+		int GetNumUnknownParams() const
+		{
+			FFlightModelCore Model = Base;
+			FCampaignTruth Truth;
+			int Unknown = 0;
+			for (const FCampaignParam& Param : Params)
+			{
+				bool bFound = Truth.Find(Param.Name) != nullptr;
+				VisitFlightModelParams(Model.GetRefs(), [&Param, &bFound](const std::string& Name, auto&)
+				{
+					bFound |= Name == Param.Name;
+				});
+				Unknown += bFound ? 0 : 1;
+			}
+			return Unknown;
+		}
+
+
+		// Runs First .. First + Num - 1. Rows go to Out (may be null), OnBatch sees every finished batch in run order.
+		// Returns the failed runs
+		template <typename FOnBatch>
+		std::vector<uint32_t> Run(FThreadPool& Pool, uint32_t First, uint32_t Num, FColumnFileWriter* Out, FOnBatch&& OnBatch) const
+		{
+			std::vector<uint32_t> Failed;
+			std::vector<FCampaignResult> Batch;
+			const uint32_t BatchRuns = static_cast<uint32_t>(std::max(1, Settings.BatchRuns));
+			for (uint32_t Done = 0; Done < Num; Done += BatchRuns)
+			{
+				const uint32_t Count = std::min(BatchRuns, Num - Done);
+				Batch.resize(Count);
+				Pool.ParallelFor(static_cast<int>(Count), [this, &Batch, First, Done](int i)
+				{
+					Batch[i] = Fly(First + Done + i);
+				});
+
+				for (const FCampaignResult& Result : Batch)
+				{
+					if (Result.Failure)
+					{
+						Failed.push_back(Result.Run);
+					}
+				}
+				if (Out)
+				{
+					WriteRowGroup(*Out, Batch);
+				}
+				OnBatch(Batch);
+			}
+			return Failed;
+		}
+
+
+		// Columns of the result file: Run, Failure, the parameters, the metrics
+		void AddColumns(FColumnFileWriter& Out) const
+		{
+			Out.AddColumn("Run", EColumnType::UInt);
+			Out.AddColumn("Failure", EColumnType::UInt);
+			for (const FCampaignParam& Param : Params)
+			{
+				Out.AddColumn(Param.Name, EColumnType::Float);
+			}
+			for (int m = 0; m < CampaignMetricNum; m++)
+			{
+				Out.AddColumn(GetCampaignMetricName(m), EColumnType::Float);
+			}
+		}
+
+
+		// Controller chain of a run, ready for Init. Truth and Values (MaxCampaignParams) receive the drawn values
+		void Sample(uint32_t RunIndex, FFlightModelCore& Model, FCampaignTruth& Truth, float* Values) const
+		{
+			FRandomStream Random(Settings.Seed, RunIndex, 0);
+			const int NumParams = std::min(static_cast<int>(Params.size()), MaxCampaignParams);
+			for (int p = 0; p < NumParams; p++)
+			{
+				const FCampaignParam& Param = Params[p];
+				Values[p] = Param.Distribution == ECampaignDistribution::Normal ? Random.Normal(Param.A, Param.B) : Random.Uniform(Param.A, Param.B);
+			}
+
+			Model = Base;
+			Truth = FCampaignTruth();
+			VisitFlightModelParams(Model.GetRefs(), [this, NumParams, Values](const std::string& Name, auto& Value)
+			{
+				for (int p = 0; p < NumParams; p++)
+				{
+					if (Params[p].Name == Name)
+					{
+						FlightParamFromDouble(Value, Params[p].bRelative ? FlightParamToDouble(Value) * Values[p] : Values[p]);
+						Values[p] = static_cast<float>(FlightParamToDouble(Value));
+					}
+				}
+			});
+			for (int p = 0; p < NumParams; p++)
+			{
+				if (float* Value = Truth.Find(Params[p].Name))
+				{
+					*Value = Values[p];
+				}
+			}
+		}
+
+
+		// One run. With a Recorder the controller side of every step is recorded, for QFMReplay
+		FCampaignResult Fly(uint32_t RunIndex, FFlightRecorderCore* Recorder = nullptr) const
+		{
+			FCampaignResult Result;
+			Result.Run = RunIndex;
+
+			FFlightModelCore Model;
+			FCampaignTruth Truth;
+			Sample(RunIndex, Model, Truth, Result.Values);
+
+			FRigidBodyCore Plant;
+			Plant.Body.Position = FVec3(0.0f, 0.0f, 100.0f);
+			Plant.Mass = Model.Vehicle.Mass * Truth.MassScale;
+			Plant.InertiaTensor = FVec3(Model.Vehicle.InertiaTensor.X * Truth.InertiaScale.X,
+				Model.Vehicle.InertiaTensor.Y * Truth.InertiaScale.Y, Model.Vehicle.InertiaTensor.Z * Truth.InertiaScale.Z);
+			Plant.Gravity = Model.Vehicle.Gravity;
+			Model.Init(Plant.Body);
+
+			FRandomStream Noise(Settings.Seed, RunIndex, 1);
+			const FInputCore& Input = Model.PilotInput;
+			const float DeltaTime = 1.0f / Settings.PhysicsHz;
+			const int Steps = static_cast<int>(Settings.Duration * Settings.PhysicsHz);
+			const float StartZ = Plant.Body.Position.Z;
+			double ErrorSquared = 0.0;
+			bool bFinite = true;
+
+			for (int i = 0; i < Steps; i++)
+			{
+				const float Time = i * DeltaTime;
+				const int Segment = Time < Settings.SettleTime ? -1 : static_cast<int>((Time - Settings.SettleTime) / Settings.SegmentTime);
+				Model.PilotInput.RollAxisInput = FInputCore::GetRawValueForDesired(Input.RollAxisInputInterval, Input.InputAxisScale.X, Segment == 0 ? Settings.Stick : 0.0f);
+				Model.PilotInput.PitchAxisInput = FInputCore::GetRawValueForDesired(Input.PitchAxisInputInterval, Input.InputAxisScale.Y, Segment == 1 ? -Settings.Stick : 0.0f);
+				Model.PilotInput.YawAxisInput = FInputCore::GetRawValueForDesired(Input.YawAxisInputInterval, Input.InputAxisScale.Z, Segment == 2 ? Settings.Stick : 0.0f);
+				Model.PilotInput.ThrottleAxisInput = FInputCore::GetRawValueForDesired(Input.ThrottleAxisInputInterval, Input.InputAxisScale.W, Input.GetThrottleMidStick() * 2.0f - 1.0f);
+
+				// What the sensors deliver
+				FBodyState Sensed = Plant.Body;
+				const FVec3 AttitudeError = FVec3(Noise.Normal(), Noise.Normal(), Noise.Normal()) * DegreesToRadians(Truth.AttitudeNoise);
+				const float AttitudeErrorAngle = AttitudeError.Size();
+				if (AttitudeErrorAngle > SmallNumber)
+				{
+					Sensed.Rotation = FQuatf(AttitudeError * (1.0f / AttitudeErrorAngle), AttitudeErrorAngle) * Sensed.Rotation;
+				}
+				Sensed.AngularVelocity = Sensed.AngularVelocity + FVec3(Noise.Normal(), Noise.Normal(), Noise.Normal()) * Truth.GyroNoise;
+				Sensed.LinearVelocity = Sensed.LinearVelocity + FVec3(Noise.Normal(), Noise.Normal(), Noise.Normal()) * Truth.VelocityNoise;
+				Sensed.Position = Sensed.Position + FVec3(Noise.Normal(), Noise.Normal(), Noise.Normal()) * Truth.PositionNoise;
+
+				if (Settings.bMultiRate)
+				{
+					Model.SimulateMultiRate(Sensed, DeltaTime);
+				}
+				else
+				{
+					Model.Simulate(Sensed, DeltaTime);
+				}
+
+				if (Recorder)
+				{
+					FFlightRecord Record;
+					FillFlightRecord(Record, Model.GetRefs(), DeltaTime, Sensed, Settings.bMultiRate, Model.GetTotalThrust(), Model.GetTotalTorque());
+					Record.SimTime = (i + 1) * DeltaTime;
+					Record.Step = static_cast<uint32_t>(i);
+					Recorder->Push(TelemetryProducerPhysics, Record);
+					Recorder->Drain();
+				}
+
+				// The engine scales the torque by the configured inertia, the body divides by its own
+				const FVec3 Torque = Model.GetTotalTorque();
+				Plant.Step(Model.GetTotalThrust() * Truth.EngineKScale,
+					FVec3(Torque.X / Truth.InertiaScale.X, Torque.Y / Truth.InertiaScale.Y, Torque.Z / Truth.InertiaScale.Z), DeltaTime);
+
+				const float Dot = std::fabs(Model.AttitudeController.AttitudeTargetQuat | Plant.Body.Rotation);
+				const float Error = RadiansToDegrees(2.0f * std::acos(std::min(Dot, 1.0f)));
+				const float Tilt = RadiansToDegrees(std::acos(Clamp(Plant.Body.Rotation.GetUpVector().Z, -1.0f, 1.0f)));
+				const float Rate = RadiansToDegrees(Plant.Body.AngularVelocity.Size());
+				bFinite &= std::isfinite(Error) && std::isfinite(Rate) && std::isfinite(Plant.Body.Position.Z);
+
+				Result.Metrics[CampaignMaxAttitudeError] = std::max(Result.Metrics[CampaignMaxAttitudeError], Error);
+				Result.Metrics[CampaignMaxTilt] = std::max(Result.Metrics[CampaignMaxTilt], Tilt);
+				Result.Metrics[CampaignMaxRate] = std::max(Result.Metrics[CampaignMaxRate], Rate);
+				Result.Metrics[CampaignAltitudeLoss] = std::max(Result.Metrics[CampaignAltitudeLoss], StartZ - Plant.Body.Position.Z);
+				ErrorSquared += static_cast<double>(Error) * Error;
+				if (!bFinite)
+				{
+					break;
+				}
+			}
+			Result.Metrics[CampaignRmsAttitudeError] = Steps > 0 ? static_cast<float>(std::sqrt(ErrorSquared / Steps)) : 0.0f;
+
+			if (!bFinite)
+			{
+				Result.Failure |= CampaignFailureNonFinite;
+			}
+			if (Result.Metrics[CampaignMaxTilt] > Settings.MaxTilt)
+			{
+				Result.Failure |= CampaignFailureFlip;
+			}
+			if (Result.Metrics[CampaignMaxAttitudeError] > Settings.MaxAttitudeError)
+			{
+				Result.Failure |= CampaignFailureAttitude;
+			}
+			if (Result.Metrics[CampaignAltitudeLoss] > Settings.MaxAltitudeLoss)
+			{
+				Result.Failure |= CampaignFailureAltitude;
+			}
+			return Result;
+		}
+
+
+	private:
+
+		void WriteRowGroup(FColumnFileWriter& Out, const std::vector<FCampaignResult>& Batch) const
+		{
+			const size_t Rows = Batch.size();
+			const int NumParams = std::min(static_cast<int>(Params.size()), MaxCampaignParams);
+			std::vector<uint32_t> Columns((2 + NumParams + CampaignMetricNum) * Rows);
+			std::vector<const void*> Data;
+			for (size_t c = 0; c < Columns.size() / Rows; c++)
+			{
+				Data.push_back(&Columns[c * Rows]);
+			}
+
+			for (size_t r = 0; r < Rows; r++)
+			{
+				const FCampaignResult& Result = Batch[r];
+				size_t c = 0;
+				Columns[c++ * Rows + r] = Result.Run;
+				Columns[c++ * Rows + r] = Result.Failure;
+				for (int p = 0; p < NumParams; p++)
+				{
+					std::memcpy(&Columns[c++ * Rows + r], &Result.Values[p], 4);
+				}
+				for (int m = 0; m < CampaignMetricNum; m++)
+				{
+					std::memcpy(&Columns[c++ * Rows + r], &Result.Metrics[m], 4);
+				}
+			}
+			Out.WriteRowGroup(Data.data(), static_cast<uint32_t>(Rows));
+		}
+	};
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace QFM
+{
+
+	/*--- Columnar result file ---*/
+	// Header with the column names, then row groups appended as results come in: the row count,
+	// then every column as one contiguous array. A reader maps whole columns (PythonSource/QFMCampaign.py)
+	// and the file is usable while it is still being written, up to the last complete row group.
+	// Host byte order, 4 byte values.
+
+	constexpr uint32_t ColumnFileMagic = 0x434D4651;	// 'QFMC'
+	constexpr uint16_t ColumnFileVersion = 1;
+	constexpr int ColumnNameBytes = 64;
+
+	enum class EColumnType : uint32_t
+	{
+		Float,
+		UInt
+	};
+
+	struct FColumnFileHeader
+	{
+		uint32_t Magic = ColumnFileMagic;
+		uint16_t Version = ColumnFileVersion;
+		uint16_t NumColumns = 0;
+		// followed by NumColumns FColumnDesc
+	};
+
+	struct FColumnDesc
+	{
+		char Name[ColumnNameBytes];
+		EColumnType Type;
+	};
+
+	static_assert(sizeof(FColumnFileHeader) == 8 && sizeof(FColumnDesc) == 68, "Column file layout");
+
+
+	class FColumnFileWriter
+	{
+	public:
+
+		~FColumnFileWriter() { Close(); }
+
+		void AddColumn(const std::string& Name, EColumnType Type)
+		{
+			FColumnDesc Desc;
+			std::memset(&Desc, 0, sizeof(Desc));
+			std::strncpy(Desc.Name, Name.c_str(), ColumnNameBytes - 1);
+			Desc.Type = Type;
+			Columns.push_back(Desc);
+		}
+
+		int GetNumColumns() const { return static_cast<int>(Columns.size()); }
+
+		bool Open(const char* Path)
+		{
+			Close();
+			File = std::fopen(Path, "wb");
+			if (!File)
+			{
+				return false;
+			}
+			FColumnFileHeader Header;
+			Header.NumColumns = static_cast<uint16_t>(Columns.size());
+			std::fwrite(&Header, sizeof(Header), 1, File);
+			std::fwrite(Columns.data(), sizeof(FColumnDesc), Columns.size(), File);
+			return true;
+		}
+
+		// Column c of the group is Data[c], NumRows values of 4 bytes each
+		void WriteRowGroup(const void* const* Data, uint32_t NumRows)
+		{
+			if (!File || NumRows == 0)
+			{
+				return;
+			}
+			std::fwrite(&NumRows, sizeof(NumRows), 1, File);
+			for (size_t c = 0; c < Columns.size(); c++)
+			{
+				std::fwrite(Data[c], 4, NumRows, File);
+			}
+			std::fflush(File);
+		}
+
+		void Close()
+		{
+			if (File)
+			{
+				std::fclose(File);
+				File = nullptr;
+			}
+		}
+
+	private:
+		std::vector<FColumnDesc> Columns;
+		std::FILE* File = nullptr;
+	};
+
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <cmath>
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreVehicle.h"
+#include "QFMCoreMixer.h"
+#include "QFMCoreMotorCurve.h"
+#include "QFMCoreMotorDynamics.h"
+
+
+namespace QFM
+{
+
+	/*--- Implementation of the EngineController ---*/
+	struct FEngineCore
+	{
+		/*--- PARAMETERS ---*/
+		float EngineMaxRPM = 1000.0f;
+		float Engine_K = 147.0f;
+		float Engine_Q = 2.0f;
+		float Engine_B = 25.0f;
+		float Engine_QQ = 2.0f;
+		bool CalculateEngine_K = true;
+		float PlanMaxLift = 2.0f;
+
+		// Measured static thrust curve instead of Engine_K/Q/B/QQ. Taken at Init, RPM up to EngineMaxRPM
+		bool UseMeasuredCurve = false;
+		int NumMeasuredCurvePoints = 0;
+		FMotorCurvePoint MeasuredCurve[MaxMotorCurvePoints];
+
+		// Spin-up / spin-down lag between mixer output and engine speed
+		FMotorDynamics MotorDynamics;
+
+		// Torque from the mixer, the engine speeds and the frame instead of the rotation request itself.
+		// Off by default: the attitude loop asks for the whole correction within one step (up to 1 / DeltaTime
+		// rad/s^2), far beyond what a frame can produce, and needs retuning before it flies on real torque
+		bool UseMixerTorque = false;
+
+		/*--- STATE ---*/
+		FVec3 RotationRequest;			// angular acceleration in rad/s^2
+		float ThrottleRequest = 0.0f;	// 0..1
+
+		float EngineMixPercent[MaxEngines] = {};
+		float EngineSpeed[MaxEngines] = {}; // 0..1
+
+		// Mixer and effectiveness of the vehicles frame, compiled in Init
+		FControlAllocation Allocation;
+
+		// Thrust/torque over speed, baked in Init and whenever Engine_Q / Engine_QQ change
+		FMotorCurve Curve;
+		float ThrottleHover = 0.5f;
+		float HoverThrustPerMotor = 0.0f;
+
+		// Torque in N*m of a unit roll/pitch/yaw mixer request at hover throttle, through curve and effectiveness,
+		// and its inverse (0: the frame cannot produce that axis)
+		FVec3 TorquePerRequest;
+		FVec3 RequestPerTorque;
+
+		FVec3 TotalThrust;
+		FVec3 TotalTorque;
+
+		/*--- INTERFACE DATA ---*/
+		float DeltaTime = 0.0f;
+		const FVehicleCore* Vehicle = nullptr;
+
+
+		void Init(const FVehicleCore* VehicleIn)
+		{
+			Vehicle = VehicleIn;
+			const FFrameGeometry Frame = Vehicle->GetFrameGeometry();
+			if (CalculateEngine_K && Frame.NumMotors > 0)
+			{
+				Engine_K = (PlanMaxLift * Vehicle->Mass * -Vehicle->Gravity) / Frame.NumMotors;
+			}
+
+			if (UseMeasuredCurve && Curve.BakeMeasured(MeasuredCurve, NumMeasuredCurvePoints, EngineMaxRPM))
+			{
+				// Table values are N and N*m already
+				Allocation.Compile(Frame, 1.0f, 1.0f);
+			}
+			else
+			{
+				Curve.BakeParametric(Engine_Q, Engine_QQ);
+				Allocation.Compile(Frame, Engine_K, Engine_B);
+			}
+			UpdateThrottleHover();
+		}
+
+
+		// Engine_K/Q/B/QQ are editable at runtime: set them here, which rebuilds whatever depends on them when they
+		// changed. Before Init it only stores them. A measured curve ignores them
+		void SetCoefficients(float EngineK, float EngineQ, float EngineB, float EngineQQ)
+		{
+			Engine_K = EngineK;
+			Engine_Q = EngineQ;
+			Engine_B = EngineB;
+			Engine_QQ = EngineQQ;
+			if (!Vehicle || Curve.bMeasured)
+			{
+				return;
+			}
+
+			bool bChanged = false;
+			if (Engine_Q != Curve.Q || Engine_QQ != Curve.QQ)
+			{
+				Curve.BakeParametric(Engine_Q, Engine_QQ);
+				bChanged = true;
+			}
+			if (Engine_K != Allocation.K || Engine_B != Allocation.B)
+			{
+				Allocation.SetCoefficients(Engine_K, Engine_B);
+				bChanged = true;
+			}
+			if (bChanged)
+			{
+				UpdateThrottleHover();
+			}
+		}
+
+
+		// Hover throttle and the torque per mixer request around it
+		void UpdateThrottleHover()
+		{
+			if (Allocation.NumMotors == 0)
+			{
+				return;
+			}
+			const float Weight = Vehicle->Mass * -Vehicle->Gravity;
+			HoverThrustPerMotor = Weight / Allocation.NumMotors;
+			ThrottleHover = Curve.InverseThrust(Weight / (Allocation.NumMotors * Allocation.K));
+			UpdateTorquePerRequest();
+		}
+
+
+		// Central difference of the torque around hover for a small request on each axis
+		void UpdateTorquePerRequest()
+		{
+			const float Step = 0.01f;
+			const float Hover = Clamp(ThrottleHover, Step, 1.0f - Step);
+			float PerRequest[3];
+			for (int a = 0; a < 3; a++)
+			{
+				float Torque[2];
+				for (int s = 0; s < 2; s++)
+				{
+					const float Request = s == 0 ? Step : -Step;
+					float Speed[MaxEngines];
+					float SpeedToThrust[MaxEngines];
+					float SpeedToTorque[MaxEngines];
+					float Wrench[NumWrenchAxes];
+					for (int i = 0; i < Allocation.NumMotors; i++)
+					{
+						Speed[i] = Clamp(Hover + Request * Allocation.Mixer[i][1 + a], 0.0f, 1.0f);
+					}
+					Curve.Evaluate(Speed, Allocation.NumMotors, SpeedToThrust, SpeedToTorque);
+					Allocation.Evaluate(SpeedToThrust, SpeedToTorque, Wrench);
+					Torque[s] = Wrench[1 + a];
+				}
+				PerRequest[a] = (Torque[0] - Torque[1]) / (2.0f * Step);
+			}
+
+			TorquePerRequest = FVec3(PerRequest[0], PerRequest[1], PerRequest[2]);
+			RequestPerTorque = FVec3(
+				std::fabs(PerRequest[0]) > 1.e-6f ? 1.0f / PerRequest[0] : 0.0f,
+				std::fabs(PerRequest[1]) > 1.e-6f ? 1.0f / PerRequest[1] : 0.0f,
+				std::fabs(PerRequest[2]) > 1.e-6f ? 1.0f / PerRequest[2] : 0.0f);
+		}
+
+		int GetNumEngines() const { return Allocation.NumMotors; }
+
+
+		void Tock(float DeltaTimeIn)
+		{
+			DeltaTime = DeltaTimeIn;
+
+			// Keep Throttle RPY Mix in a good range
+			UpdateThrottleRPYMix();
+
+			if (UseMixerTorque)
+			{
+				// Throttle and rotation request through the mixer of the frame
+				MixEngines();
+			}
+			else
+			{
+				// All engines at the throttle, the rotation request is applied as it is
+				for (int i = 0; i < Allocation.NumMotors; i++)
+				{
+					EngineMixPercent[i] = ThrottleRequest;
+				}
+			}
+
+			// Engine speeds follow the mixer, with lag if MotorDynamics is enabled
+			SetEnginesFromMixer();
+
+			// Thrust, and with UseMixerTorque the torque, of all engines through the effectiveness of the frame
+			GetEngineForces();
+		}
+
+
+		// Update Throttle Mix to stay in controllable range
+		void UpdateThrottleRPYMix()
+		{
+		}
+
+
+		/* --- MIXER --- */
+
+		// Throttle is a motor command already. The rotation request is an angular acceleration in rad/s^2 (what the
+		// rate loop is tuned for): times the inertia it is the torque the mixer request is scaled to
+		void MixEngines()
+		{
+			const FVec3 Inertia = GetInertia();
+			const float Request[NumWrenchAxes] = { ThrottleRequest, RotationRequest.X * Inertia.X * RequestPerTorque.X,
+				RotationRequest.Y * Inertia.Y * RequestPerTorque.Y, RotationRequest.Z * Inertia.Z * RequestPerTorque.Z };
+			Allocation.Mix(Request, EngineMixPercent);
+
+			for (int i = 0; i < Allocation.NumMotors; i++)
+			{
+				// This is a way to still have good gyro corrections if at least one motor reaches its max
+				if (EngineMixPercent[i] > 1)
+				{
+					EngineMixPercent[i] -= EngineMixPercent[i] - 1;
+				}
+
+				// Keep motor values in interval [0,1]
+				EngineMixPercent[i] = Clamp<float>(EngineMixPercent[i], 0, 1);
+			}
+		}
+
+
+		void SetEnginesFromMixer()
+		{
+			if (MotorDynamics.Settings.Enabled)
+			{
+				MotorDynamics.Step(EngineMixPercent, EngineSpeed, Allocation.NumMotors, DeltaTime);
+				return;
+			}
+			for (int i = 0; i < Allocation.NumMotors; i++)
+			{
+				EngineSpeed[i] = EngineMixPercent[i];
+			}
+		}
+
+
+		void GetEngineForces()
+		{
+			if (!UseMixerTorque)
+			{
+				float SpeedToThrust[MaxEngines];
+				Curve.EvaluateThrust(EngineSpeed, Allocation.NumMotors, SpeedToThrust);
+				TotalThrust = FVec3(0.0f, 0.0f, Allocation.EvaluateThrust(SpeedToThrust));
+				TotalTorque = RotationRequest;
+				return;
+			}
+
+			float SpeedToThrust[MaxEngines];
+			float Wrench[NumWrenchAxes];
+			if (Curve.IsTorqueSameAsThrust())
+			{
+				Curve.EvaluateThrust(EngineSpeed, Allocation.NumMotors, SpeedToThrust);
+				Allocation.Evaluate(SpeedToThrust, Wrench);
+			}
+			else
+			{
+				float SpeedToTorque[MaxEngines];
+				Curve.Evaluate(EngineSpeed, Allocation.NumMotors, SpeedToThrust, SpeedToTorque);
+				Allocation.Evaluate(SpeedToThrust, SpeedToTorque, Wrench);
+			}
+
+			// Torque as angular acceleration, the body applies it times its inertia (see MixEngines)
+			const FVec3 Inertia = GetInertia();
+			TotalThrust = FVec3(0.0f, 0.0f, Wrench[0]);
+			TotalTorque = FVec3(
+				Inertia.X > 0.0f ? Wrench[1] / Inertia.X : 0.0f,
+				Inertia.Y > 0.0f ? Wrench[2] / Inertia.Y : 0.0f,
+				Inertia.Z > 0.0f ? Wrench[3] / Inertia.Z : 0.0f);
+		}
+
+
+		// Inertia of the vehicle in kg * m^2
+		FVec3 GetInertia() const
+		{
+			return Vehicle->InertiaTensor * 0.0001f;
+		}
+
+
+		void SetEnginePercent(int EngineNumber, float InValue)
+		{
+			EngineSpeed[EngineNumber] = Clamp<float>(InValue, 0.0f, 1.0f);
+		}
+
+		void SetEngineRPM(int EngineNumber, float InValue)
+		{
+			EngineSpeed[EngineNumber] = Clamp<float>(InValue / EngineMaxRPM, 0.0f, 1.0f);
+		}
+
+
+		// Return Hover Throttle in range 0..1
+		// MUST!! be in ]0..1]
+		// Cached, see UpdateThrottleHover
+		float GetThrottleHover() const
+		{
+			return ThrottleHover;
+		}
+
+		void SetDesiredThrottlePercent(float ThrottleIn)
+		{
+			ThrottleRequest = ThrottleIn;
+		}
+
+		void SetDesiredRotationForces(const FVec3& InValue)
+		{
+			RotationRequest = InValue;
+		}
+
+		bool IsLimitRollPitch() const
+		{
+			return false;
+		}
+
+
+		/* --- RETURN ENGINE DATA --- */
+
+		float GetEnginePercent(int EngineNumber) const { return EngineSpeed[EngineNumber]; }
+		float GetEngineRPM(int EngineNumber) const { return EngineSpeed[EngineNumber] * EngineMaxRPM; }
+		FVec3 GetTotalThrust() const { return TotalThrust; }
+		FVec3 GetTotalTorque() const { return TotalTorque; }
+	};
+
+}
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreSimd.h"
+#include "QFMCoreMatrix.h"
+#include "QFMCoreSensors.h"
+
+
+namespace QFM
+{
+
+	/*--- Tuning of the estimator: what it assumes about the sensors, not what they do (FSensorSettings) ---*/
+	struct FEstimatorSettings
+	{
+		bool Enabled = false;						// runs on the IMU batches, needs FSensorSettings::Enabled
+		float GyroNoise = 0.005f;					// rad/s/sqrt(Hz)
+		float AccelerometerNoise = 0.05f;			// m/s^2/sqrt(Hz)
+		float GyroBiasRandomWalk = 0.0001f;			// rad/s/sqrt(s)
+		float AccelerometerBiasRandomWalk = 0.001f;	// m/s^2/sqrt(s)
+		float BaroNoise = 0.5f;						// m, std dev of a reading
+		float PositionNoise = 0.5f;					// m, std dev of a fix per axis
+		float HeadingNoise = 0.05f;					// rad, 0 = the heading of a fix is not fused
+		float InitialAttitude = 0.02f;				// rad, std dev of the alignment
+		float InitialVelocity = 0.1f;				// m/s
+		float InitialPosition = 0.5f;				// m
+		float InitialGyroBias = 0.01f;				// rad/s
+		float InitialAccelerometerBias = 0.2f;		// m/s^2
+		float InnovationGate = 5.0f;				// a measurement further off than this many std devs is rejected, 0 = off
+	};
+
+
+
+	/*--- Error state extended Kalman filter: attitude, velocity, position, gyro and accelerometer bias ---*/
+	// The nominal state is integrated through every IMU sample of a batch (body rates and specific force minus the
+	// biases). The 15 x 15 covariance of the error state (attitude error as a body frame rotation vector) is propagated
+	// once per step with the mean rate and force of the batch. Its transition only has the blocks
+	//   attitude <- attitude (I - T [w]x), gyro bias (-T)
+	//   velocity <- velocity, attitude (-T R [f]x), accelerometer bias (-T R)
+	//   position <- position, velocity (T)
+	// so P' = F P F^T is two passes of cross products and one rotation over the rows of P (SIMD over the columns)
+	// instead of two dense products. Baro, position fix and heading are fused one scalar at a time: H has at most 3
+	// nonzero entries, there is no matrix inverse, and the correction goes into the nominal state right away.
+	// Fixed size, no heap, the same work every step: the cost only depends on which measurements arrived.
+	// Aligns on the body state of its first step, as after a ground alignment.
+	struct FEstimatorCore
+	{
+		enum EErrorState
+		{
+			ErrorAttitude = 0,
+			ErrorVelocity = 3,
+			ErrorPosition = 6,
+			ErrorGyroBias = 9,
+			ErrorAccelerometerBias = 12,
+			NumErrorStates = 15
+		};
+
+		typedef TMatrix<NumErrorStates, NumErrorStates> FCovariance;
+		static constexpr int NumCovarianceValues = NumErrorStates * (NumErrorStates + 1) / 2;		// upper triangle
+
+		/*--- PARAMETERS ---*/
+		FEstimatorSettings Settings;
+
+		/*--- STATE ---*/
+		bool bInitialized = false;
+		FQuatf Rotation;					// body to world
+		FVec3 Velocity;						// m/s, world
+		FVec3 Position;						// m, world
+		FVec3 GyroBias;						// rad/s, body
+		FVec3 AccelerometerBias;			// m/s^2, body
+		FCovariance Covariance;
+
+		uint32_t NumRejected = 0;			// measurements the gate rejected since Reset
+
+
+		void Reset()
+		{
+			bInitialized = false;
+			NumRejected = 0;
+		}
+
+
+		// One step: predict through the samples of Batch, then fuse the baro reading and position fix it holds.
+		// Body is only read on the first step, to align
+		void Step(const FImuBatch& Batch, const FBodyState& Body, float Gravity)
+		{
+			if (!bInitialized)
+			{
+				Align(Body);
+			}
+
+			Predict(Batch, Gravity);
+
+			if (Batch.bBaroNew)
+			{
+				FuseAxis(ErrorPosition + 2, Batch.BaroAltitude - Position.Z, Settings.BaroNoise);
+			}
+			if (Batch.bPositionNew)
+			{
+				FuseAxis(ErrorPosition, Batch.Position.X - Position.X, Settings.PositionNoise);
+				FuseAxis(ErrorPosition + 1, Batch.Position.Y - Position.Y, Settings.PositionNoise);
+				FuseAxis(ErrorPosition + 2, Batch.Position.Z - Position.Z, Settings.PositionNoise);
+				if (Settings.HeadingNoise > 0.0f)
+				{
+					FuseHeading(Batch.Heading);
+				}
+			}
+
+			Covariance.Symmetrize();
+		}
+
+
+		void Align(const FBodyState& Body)
+		{
+			Rotation = Body.Rotation;
+			Velocity = Body.LinearVelocity;
+			Position = Body.Position;
+			GyroBias = FVec3();
+			AccelerometerBias = FVec3();
+
+			Covariance = FCovariance();
+			const float Sigma[5] = { Settings.InitialAttitude, Settings.InitialVelocity, Settings.InitialPosition,
+				Settings.InitialGyroBias, Settings.InitialAccelerometerBias };
+			for (int i = 0; i < NumErrorStates; i++)
+			{
+				Covariance.M[i][i] = Sigma[i / 3] * Sigma[i / 3];
+			}
+			bInitialized = true;
+		}
+
+
+		// Nominal state through every sample, covariance once with the batch means
+		void Predict(const FImuBatch& Batch, float Gravity)
+		{
+			if (Batch.Count <= 0)
+			{
+				return;
+			}
+
+			const float Dt = Batch.SamplePeriod;
+			const FVec3 GravityVector(0.0f, 0.0f, Gravity);
+			FVec3 RateSum;
+			FVec3 ForceSum;
+			for (int k = 0; k < Batch.Count; k++)
+			{
+				const FVec3 Rate = FVec3(Batch.Gyro[0][k], Batch.Gyro[1][k], Batch.Gyro[2][k]) - GyroBias;
+				const FVec3 Force = FVec3(Batch.Accelerometer[0][k], Batch.Accelerometer[1][k], Batch.Accelerometer[2][k]) - AccelerometerBias;
+				RateSum += Rate;
+				ForceSum += Force;
+
+				const FVec3 Acceleration = Rotation.RotateVector(Force) + GravityVector;
+				Position += Velocity * Dt + Acceleration * (0.5f * Dt * Dt);
+				Velocity += Acceleration * Dt;
+
+				// Second order exponential of the body rate, renormalized once per batch
+				const FVec3 Half = Rate * (0.5f * Dt);
+				Rotation = Rotation * FQuatf(Half.X, Half.Y, Half.Z, 1.0f - 0.5f * Half.SizeSquared());
+			}
+			Rotation.Normalize();
+
+			const float T = Dt * Batch.Count;
+			const float InvCount = 1.0f / Batch.Count;
+			PropagateCovariance(RateSum * InvCount, ForceSum * InvCount, RotationMatrix(Rotation), T);
+		}
+
+
+		// P = F P F^T + Q. F P works on block rows; F (F P)^T = F P F^T for a symmetric P, so the second pass is the
+		// same on the transpose
+		void PropagateCovariance(const FVec3& Rate, const FVec3& Force, const FMatrix3& R, float T)
+		{
+			FCovariance FP;
+			ApplyTransition(Covariance, FP, Rate, Force, R, T);
+			FCovariance FPt;
+			for (int r = 0; r < NumErrorStates; r++)
+			{
+				for (int c = 0; c < NumErrorStates; c++)
+				{
+					FPt.M[c][r] = FP.M[r][c];
+				}
+			}
+			ApplyTransition(FPt, Covariance, Rate, Force, R, T);
+
+			const float Noise[5] = {
+				Settings.GyroNoise * Settings.GyroNoise * T,
+				Settings.AccelerometerNoise * Settings.AccelerometerNoise * T,
+				0.0f,
+				Settings.GyroBiasRandomWalk * Settings.GyroBiasRandomWalk * T,
+				Settings.AccelerometerBiasRandomWalk * Settings.AccelerometerBiasRandomWalk * T };
+			for (int i = 0; i < NumErrorStates; i++)
+			{
+				Covariance.M[i][i] += Noise[i / 3];
+			}
+		}
+
+
+		// Out = F In, column lanes at a time. Bias rows are unchanged
+		static void ApplyTransition(const FCovariance& In, FCovariance& Out, const FVec3& Rate, const FVec3& Force, const FMatrix3& R, float T)
+		{
+			const FSimdFloat Wx(Rate.X), Wy(Rate.Y), Wz(Rate.Z);
+			const FSimdFloat Fx(Force.X), Fy(Force.Y), Fz(Force.Z);
+			const FSimdFloat Time(T);
+			const FSimdFloat R00(R.M[0][0]), R01(R.M[0][1]), R02(R.M[0][2]);
+			const FSimdFloat R10(R.M[1][0]), R11(R.M[1][1]), R12(R.M[1][2]);
+			const FSimdFloat R20(R.M[2][0]), R21(R.M[2][1]), R22(R.M[2][2]);
+
+			for (int c = 0; c < FCovariance::Stride; c += SimdWidth)
+			{
+				FSimdFloat X[NumErrorStates];
+				for (int r = 0; r < NumErrorStates; r++)
+				{
+					X[r] = FSimdFloat::LoadUnaligned(&In.M[r][c]);
+				}
+				const FSimdFloat* A = X + ErrorAttitude;
+				const FSimdFloat* V = X + ErrorVelocity;
+				const FSimdFloat* P = X + ErrorPosition;
+				const FSimdFloat* G = X + ErrorGyroBias;
+				const FSimdFloat* B = X + ErrorAccelerometerBias;
+
+				// Attitude: A - T (w x A + G)
+				const FSimdFloat A0 = A[0] - Time * (Wy * A[2] - Wz * A[1] + G[0]);
+				const FSimdFloat A1 = A[1] - Time * (Wz * A[0] - Wx * A[2] + G[1]);
+				const FSimdFloat A2 = A[2] - Time * (Wx * A[1] - Wy * A[0] + G[2]);
+
+				// Velocity: V - T R (f x A + B)
+				const FSimdFloat U0 = Fy * A[2] - Fz * A[1] + B[0];
+				const FSimdFloat U1 = Fz * A[0] - Fx * A[2] + B[1];
+				const FSimdFloat U2 = Fx * A[1] - Fy * A[0] + B[2];
+				const FSimdFloat V0 = V[0] - Time * (R00 * U0 + R01 * U1 + R02 * U2);
+				const FSimdFloat V1 = V[1] - Time * (R10 * U0 + R11 * U1 + R12 * U2);
+				const FSimdFloat V2 = V[2] - Time * (R20 * U0 + R21 * U1 + R22 * U2);
+
+				// Position: P + T V
+				const FSimdFloat P0 = SimdMulAdd(Time, V[0], P[0]);
+				const FSimdFloat P1 = SimdMulAdd(Time, V[1], P[1]);
+				const FSimdFloat P2 = SimdMulAdd(Time, V[2], P[2]);
+
+				const FSimdFloat Rows[9] = { A0, A1, A2, V0, V1, V2, P0, P1, P2 };
+				for (int r = 0; r < 9; r++)
+				{
+					Rows[r].StoreUnaligned(&Out.M[r][c]);
+				}
+				for (int r = ErrorGyroBias; r < NumErrorStates; r++)
+				{
+					X[r].StoreUnaligned(&Out.M[r][c]);
+				}
+			}
+		}
+
+
+		// Scalar measurement with H nonzero in error states First .. First + 2 only. Residual is measured - predicted.
+		// Returns false if the gate rejected it
+		bool FuseScalar(int First, const float H[3], float Residual, float Sigma)
+		{
+			// P H^T from the rows, P is symmetric
+			alignas(SimdAlignment) float PHt[FCovariance::Stride];
+			const FSimdFloat H0(H[0]), H1(H[1]), H2(H[2]);
+			for (int c = 0; c < FCovariance::Stride; c += SimdWidth)
+			{
+				const FSimdFloat Sum = H0 * FSimdFloat::LoadUnaligned(&Covariance.M[First][c])
+					+ H1 * FSimdFloat::LoadUnaligned(&Covariance.M[First + 1][c])
+					+ H2 * FSimdFloat::LoadUnaligned(&Covariance.M[First + 2][c]);
+				Sum.Store(&PHt[c]);
+			}
+
+			const float Innovation = H[0] * PHt[First] + H[1] * PHt[First + 1] + H[2] * PHt[First + 2] + Sigma * Sigma;
+			if (!(Innovation > 0.0f))
+			{
+				NumRejected++;
+				return false;
+			}
+			const float Gate = Settings.InnovationGate;
+			if (Gate > 0.0f && Residual * Residual > Gate * Gate * Innovation)
+			{
+				NumRejected++;
+				return false;
+			}
+
+			// P -= K (P H^T)^T with K = P H^T / S, row by row
+			const float InvInnovation = 1.0f / Innovation;
+			float Correction[NumErrorStates];
+			for (int r = 0; r < NumErrorStates; r++)
+			{
+				const float Gain = PHt[r] * InvInnovation;
+				Correction[r] = Gain * Residual;
+				const FSimdFloat RowGain(Gain);
+				for (int c = 0; c < FCovariance::Stride; c += SimdWidth)
+				{
+					const FSimdFloat Row = FSimdFloat::LoadUnaligned(&Covariance.M[r][c]) - RowGain * FSimdFloat::Load(&PHt[c]);
+					Row.StoreUnaligned(&Covariance.M[r][c]);
+				}
+			}
+
+			Inject(Correction);
+			return true;
+		}
+
+
+		// One error state measured directly (State + 2 < NumErrorStates)
+		bool FuseAxis(int State, float Residual, float Sigma)
+		{
+			const float H[3] = { 1.0f, 0.0f, 0.0f };
+			return FuseScalar(State, H, Residual, Sigma);
+		}
+
+
+		// Yaw = atan2(R10, R00) of the body to world rotation, derivative by the body frame attitude error
+		bool FuseHeading(float Heading)
+		{
+			const FMatrix3 R = RotationMatrix(Rotation);
+			const float X = R.M[0][0];
+			const float Y = R.M[1][0];
+			const float Norm = X * X + Y * Y;
+			if (Norm < 0.01f)
+			{
+				// Pointing straight up or down, the heading is undefined
+				return false;
+			}
+
+			float Residual = Heading - std::atan2(Y, X);
+			Residual -= 2.0f * Pi * std::floor((Residual + Pi) / (2.0f * Pi));
+			const float InvNorm = 1.0f / Norm;
+			const float H[3] = { 0.0f, (Y * R.M[0][2] - X * R.M[1][2]) * InvNorm, (X * R.M[1][1] - Y * R.M[0][1]) * InvNorm };
+			return FuseScalar(ErrorAttitude, H, Residual, Settings.HeadingNoise);
+		}
+
+
+		// Error state into the nominal state. The error covariance is not rotated along (small correction)
+		void Inject(const float Error[NumErrorStates])
+		{
+			const FVec3 Half = FVec3(Error[ErrorAttitude], Error[ErrorAttitude + 1], Error[ErrorAttitude + 2]) * 0.5f;
+			Rotation = Rotation * FQuatf(Half.X, Half.Y, Half.Z, 1.0f);
+			Rotation.Normalize();
+			Velocity += FVec3(Error[ErrorVelocity], Error[ErrorVelocity + 1], Error[ErrorVelocity + 2]);
+			Position += FVec3(Error[ErrorPosition], Error[ErrorPosition + 1], Error[ErrorPosition + 2]);
+			GyroBias += FVec3(Error[ErrorGyroBias], Error[ErrorGyroBias + 1], Error[ErrorGyroBias + 2]);
+			AccelerometerBias += FVec3(Error[ErrorAccelerometerBias], Error[ErrorAccelerometerBias + 1], Error[ErrorAccelerometerBias + 2]);
+		}
+
+
+		// Upper triangle row by row, NumCovarianceValues, as in the flight record
+		void SaveCovariance(float* Out) const
+		{
+			for (int r = 0; r < NumErrorStates; r++)
+			{
+				for (int c = r; c < NumErrorStates; c++)
+				{
+					*Out++ = Covariance.M[r][c];
+				}
+			}
+		}
+
+		void LoadCovariance(const float* In)
+		{
+			Covariance = FCovariance();
+			for (int r = 0; r < NumErrorStates; r++)
+			{
+				for (int c = r; c < NumErrorStates; c++)
+				{
+					Covariance.M[r][c] = *In;
+					Covariance.M[c][r] = *In++;
+				}
+			}
+		}
+	};
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreMixer.h"
+#include "QFMCoreTripleBuffer.h"
+#include "QFMCoreSeqLock.h"
+
+
+namespace QFM
+{
+
+	/*--- Pilot commands, game thread -> physics thread ---*/
+	struct FPilotCommand
+	{
+		float RollAxisInput = 0.0f;
+		float PitchAxisInput = 0.0f;
+		float YawAxisInput = 0.0f;
+		float ThrottleAxisInput = 0.0f;
+
+		// Incremented per request, the physics thread acts once per change
+		uint32_t KillTrajectoryCount = 0;
+
+		// Timer ticks when it was sent, for the InputToForce timing. 0: not timed
+		uint64_t SentTicks = 0;
+	};
+
+
+
+	/*--- Vehicle state and engine outputs, physics thread -> game thread ---*/
+	// Everything the HUD getters need, published once per physics step
+	struct FPublishedVehicleState
+	{
+		double SimulationTime = 0.0;
+
+		// AHRS
+		FVec3 Position;					// in m
+		FRotatorf Rotation;				// in deg
+		float LinearVelocity = 0.0f;	// in m/s
+		float LinearVelocity2D = 0.0f;
+		float LinearVelocityX = 0.0f;
+
+		// Engines
+		int32_t NumEngines = 0;
+		float EnginePercent[MaxEngines] = {};
+		float EngineRPM[MaxEngines] = {};
+		FVec3 TotalThrust;
+		FVec3 TotalTorque;
+
+		FVec3 UDPDebugOutput;
+	};
+
+
+
+	/*--- Data exchange of one flight model whose physics runs on another thread ---*/
+	// Commands go in through a triple buffer, the state comes back through a seqlock.
+	// Neither side blocks the other, both sides only ever see complete values.
+	class FFlightModelExchange
+	{
+	public:
+
+		/*--- Game thread ---*/
+
+		// Edit the pending command, then SendCommand()
+		FPilotCommand& GetPendingCommand() { return PendingCommand; }
+
+		void SendCommand()
+		{
+			Commands.Write(PendingCommand);
+		}
+
+		// Latest published state. Keeps the previous copy if the physics thread was writing
+		const FPublishedVehicleState& ReadState()
+		{
+			const uint32_t Version = State.GetVersion();
+			if (Version != LastReadVersion && State.Read(LastState))
+			{
+				LastReadVersion = Version;
+			}
+			return LastState;
+		}
+
+
+		/*--- Physics thread ---*/
+
+		// Returns true and fills Out if a new command arrived since the last call
+		bool ReceiveCommand(FPilotCommand& Out)
+		{
+			if (!Commands.Update())
+			{
+				return false;
+			}
+			Out = Commands.GetReadBuffer();
+			return true;
+		}
+
+		void PublishState(const FPublishedVehicleState& Published)
+		{
+			State.Write(Published);
+		}
+
+
+	private:
+
+		TTripleBuffer<FPilotCommand> Commands;
+		TSeqLock<FPublishedVehicleState> State;
+
+		// Game thread owned
+		FPilotCommand PendingCommand;
+		FPublishedVehicleState LastState;
+		uint32_t LastReadVersion = 0;
+	};
+
+}
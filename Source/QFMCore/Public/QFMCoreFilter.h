@@ -0,0 +1,525 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreSimd.h"
+#include "QFMCoreQuatKernels.h"
+
+
+namespace QFM
+{
+
+	/*--- Biquad filters: low pass, notch and RPM tracking notch ---*/
+	// Second order sections of the RBJ audio EQ cookbook (bilinear transform, prewarped at the cutoff), run in
+	// transposed direct form II with two state values per stage and channel:
+	//   Y = B0 X + Z1,  Z1 = B1 X - A1 Y + Z2,  Z2 = B2 X - A2 Y
+	// A chain is a cascade of stages: the low pass, the static notch and one notch per motor at its rotation
+	// frequency (EngineSpeed * EngineMaxRPM / 60). Channels are SoA lanes, SimdWidth of them per instruction, and
+	// the sample stays in a register through all stages.
+	// sin and cos of W0 = 2 Pi Hz DeltaTime come from the half angle polynomials of QFMCoreQuatKernels.h:
+	// H = W0 / 2 is in 0..Pi/2 below Nyquist, sin(W0) = 2 sin(H) cos(H) and 1 - cos(W0) = 2 sin(H)^2.
+	// Coefficients are only recomputed when a frequency, a Q or DeltaTime changes.
+
+	constexpr int MaxRpmNotches = 4;						// motors 0..3, the motors of a quad
+	constexpr int MaxFilterStages = 2 + MaxRpmNotches;		// low pass, static notch, RPM notches
+
+	// Frequencies at or above 0.49 of the sample rate pass through
+	constexpr float BiquadMaxHalfAngle = 0.49f * Pi;
+
+
+	enum class EBiquadType : uint8_t
+	{
+		LowPass,
+		Notch,
+	};
+
+
+	struct FFilterChainSettings
+	{
+		float LowPassHz = 0.0f;			// second order low pass, 0: off
+		float LowPassQ = 0.7071f;		// 0.7071: Butterworth
+		float NotchHz = 0.0f;			// static notch, 0: off
+		float NotchQ = 3.0f;			// center / bandwidth
+		bool bRpmNotch = false;			// one notch per motor on its rotation frequency
+		float RpmNotchQ = 5.0f;
+		float RpmNotchMinHz = 20.0f;	// below: the notch of that motor passes through
+
+		bool IsEnabled() const
+		{
+			return LowPassHz > 0.0f || NotchHz > 0.0f || bRpmNotch;
+		}
+
+		bool Equals(const FFilterChainSettings& Other) const
+		{
+			return LowPassHz == Other.LowPassHz && LowPassQ == Other.LowPassQ && NotchHz == Other.NotchHz && NotchQ == Other.NotchQ
+				&& bRpmNotch == Other.bRpmNotch && RpmNotchQ == Other.RpmNotchQ && RpmNotchMinHz == Other.RpmNotchMinHz;
+		}
+	};
+
+
+	// One stage of a chain. Motor >= 0: an RPM notch, Hz is set every step
+	struct FBiquadStage
+	{
+		EBiquadType Type = EBiquadType::LowPass;
+		float Hz = 0.0f;
+		float Q = 0.7071f;
+		int Motor = -1;
+	};
+
+	// Stages of Settings in chain order, at most MaxStages. Returns their number
+	inline int GetFilterChainStages(const FFilterChainSettings& Settings, int NumMotors, int MaxStages, FBiquadStage* Stages)
+	{
+		int Num = 0;
+		if (Settings.LowPassHz > 0.0f && Num < MaxStages)
+		{
+			Stages[Num++] = FBiquadStage{ EBiquadType::LowPass, Settings.LowPassHz, Settings.LowPassQ, -1 };
+		}
+		if (Settings.NotchHz > 0.0f && Num < MaxStages)
+		{
+			Stages[Num++] = FBiquadStage{ EBiquadType::Notch, Settings.NotchHz, Settings.NotchQ, -1 };
+		}
+		if (Settings.bRpmNotch)
+		{
+			for (int m = 0; m < NumMotors && m < MaxRpmNotches && Num < MaxStages; m++)
+			{
+				Stages[Num++] = FBiquadStage{ EBiquadType::Notch, 0.0f, Settings.RpmNotchQ, m };
+			}
+		}
+		return Num;
+	}
+
+
+
+	/*--- Coefficients ---*/
+
+	// Normalized by A0. The default passes the signal through
+	struct FBiquadCoefficients
+	{
+		float B0 = 1.0f;
+		float B1 = 0.0f;
+		float B2 = 0.0f;
+		float A1 = 0.0f;
+		float A2 = 0.0f;
+	};
+
+	// Hz <= 0, Q <= 0, DeltaTime <= 0 or Hz from 0.49 of the sample rate up: pass through
+	inline FBiquadCoefficients ComputeBiquad(EBiquadType Type, float Hz, float Q, float DeltaTime)
+	{
+		FBiquadCoefficients C;
+		const float H = Pi * Hz * DeltaTime;
+		if (!(H > 0.0f && H < BiquadMaxHalfAngle && Q > 0.0f))
+		{
+			return C;
+		}
+
+		const float H2 = H * H;
+		const float SinH = H * QuatSinOverX(H2);
+		const float CosH = QuatCos(H2);
+		const float SinH2 = SinH * SinH;
+		const float CosW = 1.0f - 2.0f * SinH2;
+		const float Alpha = SinH * CosH / Q;		// sin(W0) / 2Q
+		const float InvA0 = 1.0f / (1.0f + Alpha);
+
+		if (Type == EBiquadType::LowPass)
+		{
+			C.B0 = SinH2 * InvA0;					// (1 - cos(W0)) / 2
+			C.B1 = 2.0f * C.B0;
+			C.B2 = C.B0;
+		}
+		else
+		{
+			C.B0 = InvA0;
+			C.B1 = -2.0f * CosW * InvA0;
+			C.B2 = InvA0;
+		}
+		C.A1 = -2.0f * CosW * InvA0;
+		C.A2 = (1.0f - Alpha) * InvA0;
+		return C;
+	}
+
+
+	// The same for SimdWidth frequencies at once, B[0..4] = B0 B1 B2 A1 A2
+	inline void ComputeBiquad(EBiquadType Type, FSimdFloat Hz, float Q, float DeltaTime, FSimdFloat B[5])
+	{
+		const FSimdFloat Zero(0.0f), One(1.0f), Two(2.0f);
+		const FSimdFloat H = Hz * FSimdFloat(Pi * DeltaTime);
+		const FSimdFloat MaxH(BiquadMaxHalfAngle);
+		const FSimdFloat HC = SimdClamp(H, Zero, MaxH);
+
+		const FSimdFloat H2 = HC * HC;
+		const FSimdFloat SinH = HC * QuatSinOverX(H2);
+		const FSimdFloat CosH = QuatCos(H2);
+		const FSimdFloat SinH2 = SinH * SinH;
+		const FSimdFloat CosW = One - Two * SinH2;
+		const FSimdFloat Alpha = SinH * CosH * FSimdFloat(Q > 0.0f ? 1.0f / Q : 0.0f);
+		const FSimdFloat InvA0 = One / (One + Alpha);
+		const FSimdFloat A1 = (Zero - Two) * CosW * InvA0;
+
+		FSimdFloat Out[5];
+		if (Type == EBiquadType::LowPass)
+		{
+			Out[0] = SinH2 * InvA0;
+			Out[1] = Two * Out[0];
+			Out[2] = Out[0];
+		}
+		else
+		{
+			Out[0] = InvA0;
+			Out[1] = A1;
+			Out[2] = InvA0;
+		}
+		Out[3] = A1;
+		Out[4] = (One - Alpha) * InvA0;
+
+		// Pass through outside 0 < H < MaxH
+		const bool bValid = Q > 0.0f && DeltaTime > 0.0f;
+		const FSimdFloat Inside = bValid ? SimdGreater(H, Zero) : Zero;
+		const FSimdFloat Below = SimdLess(H, MaxH);
+		for (int k = 0; k < 5; k++)
+		{
+			const FSimdFloat Pass = k == 0 ? One : Zero;
+			B[k] = SimdSelect(Inside, SimdSelect(Below, Out[k], Pass), Pass);
+		}
+	}
+
+
+
+	/*--- Kernel ---*/
+
+	// Coefficients and state of one stage over the lanes of a chain, SoA
+	struct FBiquadLanes
+	{
+		const float* B[5];		// B0 B1 B2 A1 A2
+		float* Z1;
+		float* Z2;
+	};
+
+	// Out = the NumStages cascade of In, lanes 0..Count with Count padded to SimdWidth. In and Out may be the same.
+	// Unaligned loads: the fixed chains live inside cores, which new does not over-align
+	inline void RunBiquadChain(const FBiquadLanes* Stages, int NumStages, const float* In, float* Out, size_t Count)
+	{
+		for (size_t b = 0; b < Count; b += SimdWidth)
+		{
+			FSimdFloat X = FSimdFloat::LoadUnaligned(In + b);
+			for (int s = 0; s < NumStages; s++)
+			{
+				const FBiquadLanes& S = Stages[s];
+				const FSimdFloat Y = SimdMulAdd(FSimdFloat::LoadUnaligned(S.B[0] + b), X, FSimdFloat::LoadUnaligned(S.Z1 + b));
+				const FSimdFloat Z1 = SimdMulAdd(FSimdFloat::LoadUnaligned(S.B[1] + b), X, FSimdFloat::LoadUnaligned(S.Z2 + b))
+					- FSimdFloat::LoadUnaligned(S.B[3] + b) * Y;
+				const FSimdFloat Z2 = FSimdFloat::LoadUnaligned(S.B[2] + b) * X - FSimdFloat::LoadUnaligned(S.B[4] + b) * Y;
+				Z1.StoreUnaligned(S.Z1 + b);
+				Z2.StoreUnaligned(S.Z2 + b);
+				X = Y;
+			}
+			X.StoreUnaligned(Out + b);
+		}
+	}
+
+
+
+	/*--- Filter chain of one vehicle: NumChannels signals, e.g. the 3 gyro axes ---*/
+	// Fixed size and copyable, so it can live in the cores and their USTRUCT adapters. All channels share the
+	// coefficients, the stages of Settings beyond MaxStages are left out.
+	template <int NumChannels, int MaxStages>
+	struct TFilterChain
+	{
+		static constexpr int NumLanes = (NumChannels + SimdWidth - 1) / SimdWidth * SimdWidth;
+
+		// Z1 and Z2 of every stage and channel, the layout of SaveState / LoadState
+		static constexpr int NumStateValues = MaxStages * 2 * NumChannels;
+
+		FFilterChainSettings Settings;
+
+
+		// Filters Values (NumChannels) in place. EngineSpeed (0..1) of NumMotors motors times SpeedToHz gives the
+		// RPM notch frequencies, nullptr: none. DeltaTime <= 0 leaves values and state alone
+		void Step(float* Values, float DeltaTime, const float* EngineSpeed = nullptr, int NumMotors = 0, float SpeedToHz = 0.0f)
+		{
+			if (!EngineSpeed)
+			{
+				NumMotors = 0;
+			}
+			UpdateCoefficients(DeltaTime, EngineSpeed, NumMotors, SpeedToHz);
+			if (NumStages == 0 || DeltaTime <= 0.0f)
+			{
+				return;
+			}
+
+			FBiquadLanes Lanes[MaxStages];
+			for (int s = 0; s < NumStages; s++)
+			{
+				for (int k = 0; k < 5; k++)
+				{
+					Lanes[s].B[k] = Coefficients[s][k];
+				}
+				Lanes[s].Z1 = Z1[s];
+				Lanes[s].Z2 = Z2[s];
+			}
+
+			float Signal[NumLanes] = {};
+			for (int c = 0; c < NumChannels; c++)
+			{
+				Signal[c] = Values[c];
+			}
+			RunBiquadChain(Lanes, NumStages, Signal, Signal, NumLanes);
+			for (int c = 0; c < NumChannels; c++)
+			{
+				Values[c] = Signal[c];
+			}
+		}
+
+
+		void Reset()
+		{
+			for (int s = 0; s < MaxStages; s++)
+			{
+				for (int i = 0; i < NumLanes; i++)
+				{
+					Z1[s][i] = 0.0f;
+					Z2[s][i] = 0.0f;
+				}
+			}
+		}
+
+		// NumStateValues floats: per stage Z1 of all channels, then Z2
+		void SaveState(float* Out) const
+		{
+			for (int s = 0; s < MaxStages; s++)
+			{
+				for (int c = 0; c < NumChannels; c++)
+				{
+					*Out++ = Z1[s][c];
+				}
+				for (int c = 0; c < NumChannels; c++)
+				{
+					*Out++ = Z2[s][c];
+				}
+			}
+		}
+
+		void LoadState(const float* In)
+		{
+			for (int s = 0; s < MaxStages; s++)
+			{
+				for (int c = 0; c < NumChannels; c++)
+				{
+					Z1[s][c] = *In++;
+				}
+				for (int c = 0; c < NumChannels; c++)
+				{
+					Z2[s][c] = *In++;
+				}
+			}
+		}
+
+
+	private:
+
+		void UpdateCoefficients(float DeltaTime, const float* EngineSpeed, int NumMotors, float SpeedToHz)
+		{
+			FBiquadStage Stages[MaxFilterStages];
+			const int Num = GetFilterChainStages(Settings, NumMotors, MaxStages, Stages);
+			if (Num != NumStages)
+			{
+				// Stages out of use are kept at rest, so they start from it when they come back. Stages in use keep
+				// their state, which may have been loaded from a flight record before the first step
+				for (int s = Num; s < NumStages; s++)
+				{
+					for (int i = 0; i < NumLanes; i++)
+					{
+						Z1[s][i] = 0.0f;
+						Z2[s][i] = 0.0f;
+					}
+				}
+				NumStages = Num;
+				CachedDeltaTime = -1.0f;
+			}
+
+			for (int s = 0; s < Num; s++)
+			{
+				FBiquadStage& Stage = Stages[s];
+				if (Stage.Motor >= 0)
+				{
+					const float Hz = EngineSpeed[Stage.Motor] * SpeedToHz;
+					Stage.Hz = Hz >= Settings.RpmNotchMinHz ? Hz : 0.0f;
+				}
+				if (DeltaTime == CachedDeltaTime && Stage.Type == CachedStages[s].Type && Stage.Hz == CachedStages[s].Hz && Stage.Q == CachedStages[s].Q)
+				{
+					continue;
+				}
+				CachedStages[s] = Stage;
+
+				const FBiquadCoefficients C = ComputeBiquad(Stage.Type, Stage.Hz, Stage.Q, DeltaTime);
+				const float Values[5] = { C.B0, C.B1, C.B2, C.A1, C.A2 };
+				for (int k = 0; k < 5; k++)
+				{
+					for (int c = 0; c < NumChannels; c++)
+					{
+						Coefficients[s][k][c] = Values[k];
+					}
+				}
+			}
+			CachedDeltaTime = DeltaTime;
+		}
+
+		// Padding lanes stay 0
+		float Coefficients[MaxStages][5][NumLanes] = {};
+		float Z1[MaxStages][NumLanes] = {};
+		float Z2[MaxStages][NumLanes] = {};
+
+		int NumStages = 0;
+		float CachedDeltaTime = -1.0f;
+		FBiquadStage CachedStages[MaxStages];
+	};
+
+
+
+	/*--- Filter chains of 3 axes x N vehicles, SoA ---*/
+	// The state of axis a and vehicle i is lane a * Stride + i with Stride = SimdPadded(N): every axis is one block
+	// of vehicle lanes, as the per axis arrays of FFleetCore. All vehicles share the settings. Coefficients are per
+	// vehicle: the static stages are recomputed when the settings or DeltaTime change, the RPM notches every step
+	// from the engine speeds, SimdWidth vehicles at a time.
+	class FFilterBank
+	{
+	public:
+
+		static constexpr int NumAxes = 3;
+
+		FFilterChainSettings Settings;
+
+
+		// Room for NumVehicles, resets the state
+		void Resize(int NumVehiclesIn)
+		{
+			NumVehicles = NumVehiclesIn;
+			Stride = SimdPadded(NumVehicles);
+			for (int s = 0; s < MaxFilterStages; s++)
+			{
+				for (int k = 0; k < 5; k++)
+				{
+					Coefficients[s][k].Reserve(Stride);
+				}
+				Z1[s].Reserve(NumAxes * Stride);
+				Z2[s].Reserve(NumAxes * Stride);
+			}
+			Reset();
+			CachedDeltaTime = -1.0f;
+		}
+
+		void Reset()
+		{
+			for (int s = 0; s < MaxFilterStages; s++)
+			{
+				Z1[s].Fill(0.0f);
+				Z2[s].Fill(0.0f);
+			}
+		}
+
+		// Out[a] = filtered In[a], per axis NumVehicles values padded to SimdWidth. In and Out may be the same.
+		// EngineSpeed[m] holds the speeds (0..1) of motor m of every vehicle, SpeedToHz per vehicle
+		void Step(const float* const In[NumAxes], float* const Out[NumAxes], float DeltaTime,
+			const float* const EngineSpeed[], int NumMotors, const float* SpeedToHz)
+		{
+			if (DeltaTime <= 0.0f || NumVehicles == 0)
+			{
+				return;
+			}
+			if (!EngineSpeed || !SpeedToHz)
+			{
+				NumMotors = 0;
+			}
+
+			FBiquadStage Stages[MaxFilterStages];
+			const int Num = GetFilterChainStages(Settings, NumMotors, MaxFilterStages, Stages);
+			if (Num != NumStages)
+			{
+				NumStages = Num;
+				Reset();
+				CachedDeltaTime = -1.0f;
+			}
+			UpdateCoefficients(Stages, DeltaTime, EngineSpeed, SpeedToHz);
+
+			for (int a = 0; a < NumAxes; a++)
+			{
+				FBiquadLanes Lanes[MaxFilterStages];
+				for (int s = 0; s < NumStages; s++)
+				{
+					for (int k = 0; k < 5; k++)
+					{
+						Lanes[s].B[k] = Coefficients[s][k].GetData();
+					}
+					Lanes[s].Z1 = Z1[s].GetData() + a * Stride;
+					Lanes[s].Z2 = Z2[s].GetData() + a * Stride;
+				}
+				if (NumStages > 0)
+				{
+					RunBiquadChain(Lanes, NumStages, In[a], Out[a], Stride);
+				}
+				else if (In[a] != Out[a])
+				{
+					for (size_t i = 0; i < Stride; i++)
+					{
+						Out[a][i] = In[a][i];
+					}
+				}
+			}
+		}
+
+
+	private:
+
+		void UpdateCoefficients(const FBiquadStage* Stages, float DeltaTime, const float* const EngineSpeed[], const float* SpeedToHz)
+		{
+			const bool bStatic = DeltaTime != CachedDeltaTime || !Settings.Equals(CachedSettings);
+			CachedDeltaTime = DeltaTime;
+			CachedSettings = Settings;
+
+			for (int s = 0; s < NumStages; s++)
+			{
+				const FBiquadStage& Stage = Stages[s];
+				if (Stage.Motor < 0)
+				{
+					if (bStatic)
+					{
+						const FBiquadCoefficients C = ComputeBiquad(Stage.Type, Stage.Hz, Stage.Q, DeltaTime);
+						const float Values[5] = { C.B0, C.B1, C.B2, C.A1, C.A2 };
+						for (int k = 0; k < 5; k++)
+						{
+							Coefficients[s][k].Fill(Values[k]);
+						}
+					}
+					continue;
+				}
+
+				// RPM notch: the frequencies move every step
+				const FSimdFloat MinHz(Settings.RpmNotchMinHz);
+				const float* Speed = EngineSpeed[Stage.Motor];
+				for (size_t b = 0; b < Stride; b += SimdWidth)
+				{
+					const FSimdFloat Hz = FSimdFloat::Load(Speed + b) * FSimdFloat::Load(SpeedToHz + b);
+					FSimdFloat B[5];
+					ComputeBiquad(Stage.Type, SimdSelect(SimdLess(Hz, MinHz), FSimdFloat(0.0f), Hz), Stage.Q, DeltaTime, B);
+					for (int k = 0; k < 5; k++)
+					{
+						B[k].Store(Coefficients[s][k].GetData() + b);
+					}
+				}
+			}
+		}
+
+		int NumVehicles = 0;
+		size_t Stride = 0;
+		int NumStages = 0;
+
+		float CachedDeltaTime = -1.0f;
+		FFilterChainSettings CachedSettings;
+
+		FAlignedFloatArray Coefficients[MaxFilterStages][5];	// per vehicle
+		FAlignedFloatArray Z1[MaxFilterStages];					// per axis and vehicle
+		FAlignedFloatArray Z2[MaxFilterStages];
+	};
+
+}
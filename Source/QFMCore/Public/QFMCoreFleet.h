@@ -0,0 +1,606 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreSimd.h"
+#include "QFMCoreFilter.h"
+#include "QFMCoreFlightModel.h"
+
+
+namespace QFM
+{
+
+	/*--- Structure-of-Arrays Fleet Simulator ---*/
+	// Steps input mapping, the body rate loop, the mixer of 4 motor frames and the thrust/torque evaluation
+	// for N vehicles at once, SimdWidth vehicles per instruction.
+	//
+	// The rate loop is FAttitudeCore::TockRateLoop: the pilots stick rates (GetPilotDesiredAngleRates) are the
+	// body rate targets of RunRateLoop, there is no attitude target integration.
+	// Mixing is FEngineCore::MixEngines followed by FEngineCore::GetEngineForces, as FEngineCore runs them
+	// with UseMixerTorque: the torque comes from the engine speeds and is an angular acceleration too.
+	//
+	// All vehicles share DeltaTime, the rate loop type and the gyro filter, all other parameters are per vehicle.
+	// The gyro filter (FFilterBank, off by default) runs on the body rates before the rate loop, its RPM notches
+	// on the engine speeds of the last step.
+	class FFleetCore
+	{
+	public:
+
+		static constexpr int NumAxes = 3;
+		static constexpr int NumMotors = 4;
+
+		// Rate loop used by the whole fleet
+		EControlLoop RateControlLoop = EControlLoop::PID;
+
+		// Set GyroFilter.Settings, used by the whole fleet
+		FFilterBank GyroFilter;
+
+
+		int Num() const { return NumVehicles; }
+
+
+		// Add a vehicle and take its parameters from a configured (not necessarily initialized) flight model.
+		// Returns the vehicle index, or -1 if the vehicles frame does not have NumMotors motors.
+		int AddVehicle(const FFlightModelCore& Model)
+		{
+			const FInputCore& In = Model.PilotInput;
+			const FAttitudeCore& Att = Model.AttitudeController;
+			const FEngineCore& Eng = Model.EngineController;
+			const FVehicleCore& Veh = Model.Vehicle;
+
+			const FFrameGeometry Frame = Veh.GetFrameGeometry();
+			if (Frame.NumMotors != NumMotors)
+			{
+				return -1;
+			}
+
+			const int i = NumVehicles++;
+			Grow(SimdPadded(NumVehicles));
+			GyroFilter.Resize(NumVehicles);
+
+			const FVec2 Intervals[4] = { In.RollAxisInputInterval, In.PitchAxisInputInterval, In.YawAxisInputInterval, In.ThrottleAxisInputInterval };
+			const float Scales[4] = { In.InputAxisScale.X, In.InputAxisScale.Y, In.InputAxisScale.Z, In.InputAxisScale.W };
+			for (int a = 0; a < 4; a++)
+			{
+				InputScale[a][i] = Scales[a];
+				InputMin[a][i] = Intervals[a].X;
+				InputInvRange2[a][i] = 2.0f / (Intervals[a].Y - Intervals[a].X);
+			}
+
+			RollPitchExpo[i] = Clamp(Att.AccroRollPitchExpo, -0.5f, 1.0f);
+			YawExpo[i] = Clamp(Att.AccroYawExpo, -0.5f, 1.0f);
+			RateGainDeg[0][i] = Att.AccroRollPitchPGain;
+			RateGainDeg[1][i] = Att.AccroRollPitchPGain;
+			RateGainDeg[2][i] = Att.YawPGain;
+
+			const FVec3 Pids[3] = { Att.RateRollPidSettings, Att.RatePitchPidSettings, Att.RateYawPidSettings };
+			for (int a = 0; a < NumAxes; a++)
+			{
+				MaxRate[a][i] = DegreesToRadians(RateGainDeg[a][i]);
+				InvMaxRate[a][i] = 1.0f / MaxRate[a][i];
+				Kp[a][i] = Pids[a].X;
+				Ki[a][i] = Pids[a].Y;
+				Kd[a][i] = Pids[a].Z;
+				Integral[a][i] = 0.0f;
+				PreError[a][i] = 0.0f;
+			}
+			SPDFrequency[i] = Att.SPDFrequency;
+			SPDDamping[i] = Att.SPDDamping;
+
+			// Same as FEngineCore::Init
+			float EngineK = Eng.Engine_K;
+			if (Eng.CalculateEngine_K)
+			{
+				EngineK = (Eng.PlanMaxLift * Veh.Mass * -Veh.Gravity) / NumMotors;
+			}
+			EngineKArray[i] = EngineK;
+			SpeedToHz[i] = Eng.EngineMaxRPM / 60.0f;
+			ThrottleExpo[i] = -(std::pow((Veh.Mass * -Veh.Gravity) / (NumMotors * EngineK), 1.0f / Eng.Engine_Q) - 0.5f) / 0.375f;
+
+			// The kernels add the throttle unscaled, which the normalized mixer of a quad frame guarantees.
+			// The inertia and the torque per request of FEngineCore::MixEngines are folded into the mixer columns,
+			// the division by the inertia of FEngineCore::GetEngineForces into the torque columns
+			FEngineCore Mixing = Eng;
+			Mixing.UseMeasuredCurve = false;
+			Mixing.Init(&Veh);
+			const FControlAllocation& Allocation = Mixing.Allocation;
+			const FVec3 Inertia = Mixing.GetInertia();
+			const FVec3 RequestScale(Inertia.X * Mixing.RequestPerTorque.X, Inertia.Y * Mixing.RequestPerTorque.Y,
+				Inertia.Z * Mixing.RequestPerTorque.Z);
+			const FVec3 InvInertia(Inertia.X > 0.0f ? 1.0f / Inertia.X : 0.0f, Inertia.Y > 0.0f ? 1.0f / Inertia.Y : 0.0f,
+				Inertia.Z > 0.0f ? 1.0f / Inertia.Z : 0.0f);
+			for (int m = 0; m < NumMotors; m++)
+			{
+				MixRoll[m][i] = Allocation.Mixer[m][1] * RequestScale.X;
+				MixPitch[m][i] = Allocation.Mixer[m][2] * RequestScale.Y;
+				MixYaw[m][i] = Allocation.Mixer[m][3] * RequestScale.Z;
+				TorqueRoll[m][i] = Allocation.ThrustEffect[1][m] * InvInertia.X;
+				TorquePitch[m][i] = Allocation.ThrustEffect[2][m] * InvInertia.Y;
+				TorqueYaw[m][i] = Allocation.DragEffect[3][m] * InvInertia.Z;
+				EngineSpeed[m][i] = 0.0f;
+			}
+
+			MotorSettings[i] = Eng.MotorDynamics.Settings;
+			if (MotorSettings[i].Enabled)
+			{
+				bMotorDynamics = true;
+			}
+			CachedDeltaTime = -1.0f;
+
+			if (Eng.Engine_Q != 2.0f || Eng.Engine_QQ != 2.0f)
+			{
+				bQuadraticEngines = false;
+			}
+			EngineQ[i] = Eng.Engine_Q;
+			EngineQQ[i] = Eng.Engine_QQ;
+
+			return i;
+		}
+
+
+		/*--- Per step input ---*/
+
+		void SetStickInput(int Index, float Roll, float Pitch, float Yaw, float Throttle)
+		{
+			RawInput[0][Index] = Roll;
+			RawInput[1][Index] = Pitch;
+			RawInput[2][Index] = Yaw;
+			RawInput[3][Index] = Throttle;
+		}
+
+		// Body (local) angular velocity in rad/s
+		void SetBodyRates(int Index, const FVec3& Rates)
+		{
+			BodyRate[0][Index] = Rates.X;
+			BodyRate[1][Index] = Rates.Y;
+			BodyRate[2][Index] = Rates.Z;
+		}
+
+
+		/*--- Per step output ---*/
+
+		float GetThrust(int Index) const { return Thrust[Index]; }
+		FVec3 GetTorque(int Index) const { return FVec3(Torque[0][Index], Torque[1][Index], Torque[2][Index]); }
+		float GetEngineSpeed(int Index, int Motor) const { return EngineSpeed[Motor][Index]; }
+
+
+		/*--- Step all vehicles, SimdWidth at a time ---*/
+
+		void Step(float DeltaTime)
+		{
+			if (DeltaTime <= 0.0f) { return; }
+
+			const FSimdFloat Zero(0.0f), One(1.0f), Half(0.5f), MinusOne(-1.0f);
+			const FSimdFloat Dt(DeltaTime), InvDt(1.0f / DeltaTime);
+			const FSimdFloat DegToRadDt(DegreesToRadians(1.0f));
+			const size_t Padded = SimdPadded(NumVehicles);
+			UpdateMotorCoefficients(DeltaTime);
+			const FAlignedFloatArray* Rates = FilterBodyRates(DeltaTime);
+
+			for (size_t b = 0; b < Padded; b += SimdWidth)
+			{
+				/*--- Input mapping (FInputCore::Tock) ---*/
+				FSimdFloat Stick[4];
+				for (int a = 0; a < 4; a++)
+				{
+					const FSimdFloat Raw = FSimdFloat::Load(&RawInput[a][b]) * FSimdFloat::Load(&InputScale[a][b]);
+					Stick[a] = SimdMulAdd(Raw - FSimdFloat::Load(&InputMin[a][b]), FSimdFloat::Load(&InputInvRange2[a][b]), MinusOne);
+				}
+				Stick[3] = SimdMulAdd(Stick[3], Half, Half);
+
+				/*--- Pilot desired rates in deg/s (FAttitudeCore::GetPilotDesiredAngleRates) ---*/
+				const FSimdFloat Total = SimdSqrt(Stick[0] * Stick[0] + Stick[1] * Stick[1]);
+				const FSimdFloat Ratio = SimdSelect(SimdGreater(Total, One), One / Total, One);
+				Stick[0] = Stick[0] * Ratio;
+				Stick[1] = Stick[1] * Ratio;
+
+				FSimdFloat Target[3];
+				const FSimdFloat RPExpo = FSimdFloat::Load(&RollPitchExpo[b]);
+				const FSimdFloat YExpo = FSimdFloat::Load(&YawExpo[b]);
+				for (int a = 0; a < NumAxes; a++)
+				{
+					const FSimdFloat Expo = (a == 2) ? YExpo : RPExpo;
+					const FSimdFloat X = Stick[a];
+					const FSimdFloat Shaped = Expo * X * X * X + (One - Expo) * X;
+					// deg/s -> rad/s
+					Target[a] = Shaped * FSimdFloat::Load(&RateGainDeg[a][b]) * DegToRadDt;
+				}
+
+				/*--- Rate loop (FAttitudeCore::RunRateLoop) ---*/
+				FSimdFloat SpdKpg, SpdKdg;
+				if (RateControlLoop == EControlLoop::SPD)
+				{
+					const FSimdFloat Freq = FSimdFloat::Load(&SPDFrequency[b]);
+					const FSimdFloat SpdKp = Freq * Freq * FSimdFloat(9.0f);
+					const FSimdFloat SpdKd = FSimdFloat(4.5f) * Freq * FSimdFloat::Load(&SPDDamping[b]);
+					const FSimdFloat G = One / (One + SpdKd * Dt + SpdKp * Dt * Dt);
+					SpdKpg = SpdKp * G;
+					SpdKdg = (SpdKd + SpdKp * Dt) * G;
+				}
+
+				FSimdFloat Request[3];
+				for (int a = 0; a < NumAxes; a++)
+				{
+					const FSimdFloat Now = FSimdFloat::Load(&Rates[a][b]);
+					const FSimdFloat MaxR = FSimdFloat::Load(&MaxRate[a][b]);
+					const FSimdFloat InvMaxR = FSimdFloat::Load(&InvMaxRate[a][b]);
+					FSimdFloat Apply;
+
+					if (RateControlLoop == EControlLoop::PID)
+					{
+						const FSimdFloat Error = (Target[a] - Now) * InvMaxR;
+						const FSimdFloat I = SimdMulAdd(Error, Dt, FSimdFloat::Load(&Integral[a][b]));
+						const FSimdFloat D = (Error - FSimdFloat::Load(&PreError[a][b])) * InvDt;
+						FSimdFloat Out = FSimdFloat::Load(&Kp[a][b]) * Error;
+						Out = SimdMulAdd(FSimdFloat::Load(&Ki[a][b]), I, Out);
+						Out = SimdMulAdd(FSimdFloat::Load(&Kd[a][b]), D, Out);
+						I.Store(&Integral[a][b]);
+						Error.Store(&PreError[a][b]);
+						Apply = SimdClamp(Out, MinusOne, One) * MaxR;
+					}
+					else if (RateControlLoop == EControlLoop::SPD)
+					{
+						Apply = SpdKpg * Target[a] - SpdKdg * Now;
+					}
+					else
+					{
+						Apply = Target[a] - Now;
+					}
+
+					Apply = SimdClamp(Apply, Zero - MaxR, MaxR);
+					Request[a] = Apply * InvMaxR * InvDt;
+				}
+
+				/*--- Throttle (FAttitudeCore::GetPilotDesiredThrottle, mid stick 0.5) ---*/
+				const FSimdFloat Thr = SimdClamp(Stick[3], Zero, One);
+				const FSimdFloat TExpo = FSimdFloat::Load(&ThrottleExpo[b]);
+				const FSimdFloat Throttle = Thr * (One - TExpo) + TExpo * Thr * Thr * Thr;
+
+				/*--- Mixer (FEngineCore::MixEngines) and forces (FEngineCore::GetEngineForces) ---*/
+				FSimdFloat ThrustSum = Zero;
+				FSimdFloat TorqueSum[3] = { Zero, Zero, Zero };
+				FSimdFloat Speed[NumMotors];
+				for (int m = 0; m < NumMotors; m++)
+				{
+					FSimdFloat Mix = Throttle;
+					Mix = SimdMulAdd(Request[0], FSimdFloat::Load(&MixRoll[m][b]), Mix);
+					Mix = SimdMulAdd(Request[1], FSimdFloat::Load(&MixPitch[m][b]), Mix);
+					Mix = SimdMulAdd(Request[2], FSimdFloat::Load(&MixYaw[m][b]), Mix);
+					Speed[m] = SimdClamp(Mix, Zero, One);
+				}
+
+				/*--- Motor lag (FMotorLagCoefficients::Step) ---*/
+				if (bMotorDynamics)
+				{
+					const FSimdFloat AlphaUp = FSimdFloat::Load(&MotorAlphaUp[b]);
+					const FSimdFloat AlphaDown = FSimdFloat::Load(&MotorAlphaDown[b]);
+					const FSimdFloat MaxStepUp = FSimdFloat::Load(&MotorMaxStepUp[b]);
+					const FSimdFloat MinStep = Zero - FSimdFloat::Load(&MotorMaxStepDown[b]);
+					const FSimdFloat Idle = FSimdFloat::Load(&MotorIdle[b]);
+					for (int m = 0; m < NumMotors; m++)
+					{
+						const FSimdFloat Previous = FSimdFloat::Load(&EngineSpeed[m][b]);
+						const FSimdFloat Delta = SimdMax(Speed[m], Idle) - Previous;
+						const FSimdFloat Alpha = SimdSelect(SimdGreater(Delta, Zero), AlphaUp, AlphaDown);
+						Speed[m] = Previous + SimdClamp(Alpha * Delta, MinStep, MaxStepUp);
+					}
+				}
+
+				for (int m = 0; m < NumMotors; m++)
+				{
+					Speed[m].Store(&EngineSpeed[m][b]);
+				}
+
+				if (bQuadraticEngines)
+				{
+					for (int m = 0; m < NumMotors; m++)
+					{
+						const FSimdFloat Sq = Speed[m] * Speed[m];
+						ThrustSum = ThrustSum + Sq;
+						TorqueSum[0] = SimdMulAdd(Sq, FSimdFloat::Load(&TorqueRoll[m][b]), TorqueSum[0]);
+						TorqueSum[1] = SimdMulAdd(Sq, FSimdFloat::Load(&TorquePitch[m][b]), TorqueSum[1]);
+						TorqueSum[2] = SimdMulAdd(Sq, FSimdFloat::Load(&TorqueYaw[m][b]), TorqueSum[2]);
+					}
+				}
+				else
+				{
+					// Arbitrary exponents have no vector pow, evaluate these lanes one by one
+					alignas(SimdAlignment) float ThrustPow[SimdWidth];
+					alignas(SimdAlignment) float TorquePow[SimdWidth];
+					for (int m = 0; m < NumMotors; m++)
+					{
+						for (int l = 0; l < SimdWidth; l++)
+						{
+							ThrustPow[l] = std::pow(EngineSpeed[m][b + l], EngineQ[b + l]);
+							TorquePow[l] = std::pow(EngineSpeed[m][b + l], EngineQQ[b + l]);
+						}
+						const FSimdFloat PT = FSimdFloat::Load(ThrustPow);
+						const FSimdFloat PQ = FSimdFloat::Load(TorquePow);
+						ThrustSum = ThrustSum + PT;
+						TorqueSum[0] = SimdMulAdd(PT, FSimdFloat::Load(&TorqueRoll[m][b]), TorqueSum[0]);
+						TorqueSum[1] = SimdMulAdd(PT, FSimdFloat::Load(&TorquePitch[m][b]), TorqueSum[1]);
+						TorqueSum[2] = SimdMulAdd(PQ, FSimdFloat::Load(&TorqueYaw[m][b]), TorqueSum[2]);
+					}
+				}
+
+				(ThrustSum * FSimdFloat::Load(&EngineKArray[b])).Store(&Thrust[b]);
+				for (int a = 0; a < NumAxes; a++)
+				{
+					TorqueSum[a].Store(&Torque[a][b]);
+				}
+			}
+		}
+
+
+		/*--- Reference implementation: the same math, one vehicle at a time ---*/
+		// Used to verify the SIMD path and as the per vehicle baseline in QFMFleetBench.
+
+		void StepScalar(float DeltaTime)
+		{
+			if (DeltaTime <= 0.0f) { return; }
+			UpdateMotorCoefficients(DeltaTime);
+			const FAlignedFloatArray* Rates = FilterBodyRates(DeltaTime);
+
+			for (int i = 0; i < NumVehicles; i++)
+			{
+				float Stick[4];
+				for (int a = 0; a < 4; a++)
+				{
+					Stick[a] = (RawInput[a][i] * InputScale[a][i] - InputMin[a][i]) * InputInvRange2[a][i] - 1.0f;
+				}
+				Stick[3] = Stick[3] / 2.0f + 0.5f;
+
+				const float Total = FVec2(Stick[0], Stick[1]).Size();
+				if (Total > 1.0f)
+				{
+					Stick[0] /= Total;
+					Stick[1] /= Total;
+				}
+
+				float Request[3];
+				for (int a = 0; a < NumAxes; a++)
+				{
+					const float Expo = (a == 2) ? YawExpo[i] : RollPitchExpo[i];
+					const float X = Stick[a];
+					const float Target = DegreesToRadians((Expo * X * X * X + (1.0f - Expo) * X) * RateGainDeg[a][i]);
+					const float Now = Rates[a][i];
+					float Apply;
+
+					if (RateControlLoop == EControlLoop::PID)
+					{
+						const float Error = (Target - Now) * InvMaxRate[a][i];
+						Integral[a][i] += Error * DeltaTime;
+						const float D = (Error - PreError[a][i]) / DeltaTime;
+						PreError[a][i] = Error;
+						Apply = Clamp(Kp[a][i] * Error + Ki[a][i] * Integral[a][i] + Kd[a][i] * D, -1.0f, 1.0f) * MaxRate[a][i];
+					}
+					else if (RateControlLoop == EControlLoop::SPD)
+					{
+						const float SpdKp = SPDFrequency[i] * SPDFrequency[i] * 9.0f;
+						const float SpdKd = 4.5f * SPDFrequency[i] * SPDDamping[i];
+						const float G = 1.0f / (1.0f + SpdKd * DeltaTime + SpdKp * DeltaTime * DeltaTime);
+						Apply = SpdKp * G * Target - (SpdKd + SpdKp * DeltaTime) * G * Now;
+					}
+					else
+					{
+						Apply = Target - Now;
+					}
+					Request[a] = Clamp(Apply, -MaxRate[a][i], MaxRate[a][i]) / MaxRate[a][i] / DeltaTime;
+				}
+
+				const float Thr = Clamp(Stick[3], 0.0f, 1.0f);
+				const float Throttle = Thr * (1.0f - ThrottleExpo[i]) + ThrottleExpo[i] * Thr * Thr * Thr;
+
+				float ThrustSum = 0.0f;
+				float TorqueSum[3] = { 0.0f, 0.0f, 0.0f };
+				for (int m = 0; m < NumMotors; m++)
+				{
+					const float Mix = Throttle + Request[0] * MixRoll[m][i] + Request[1] * MixPitch[m][i] + Request[2] * MixYaw[m][i];
+					float Speed = Clamp(Mix, 0.0f, 1.0f);
+					if (bMotorDynamics)
+					{
+						FMotorLagCoefficients Lag;
+						Lag.AlphaUp = MotorAlphaUp[i];
+						Lag.AlphaDown = MotorAlphaDown[i];
+						Lag.MaxStepUp = MotorMaxStepUp[i];
+						Lag.MaxStepDown = MotorMaxStepDown[i];
+						Lag.IdleSpeed = MotorIdle[i];
+						Speed = Lag.Step(Speed, EngineSpeed[m][i]);
+					}
+					EngineSpeed[m][i] = Speed;
+
+					const float PT = std::pow(Speed, EngineQ[i]);
+					const float PQ = std::pow(Speed, EngineQQ[i]);
+					ThrustSum += PT;
+					TorqueSum[0] += PT * TorqueRoll[m][i];
+					TorqueSum[1] += PT * TorquePitch[m][i];
+					TorqueSum[2] += PQ * TorqueYaw[m][i];
+				}
+				Thrust[i] = ThrustSum * EngineKArray[i];
+				for (int a = 0; a < NumAxes; a++)
+				{
+					Torque[a][i] = TorqueSum[a];
+				}
+			}
+		}
+
+
+		void ResetControllers()
+		{
+			for (int m = 0; m < NumMotors; m++)
+			{
+				EngineSpeed[m].Fill(0.0f);
+			}
+			for (int a = 0; a < NumAxes; a++)
+			{
+				Integral[a].Fill(0.0f);
+				PreError[a].Fill(0.0f);
+			}
+			GyroFilter.Reset();
+		}
+
+
+	private:
+
+		// Motor lag coefficients of every vehicle, only recomputed when DeltaTime changes.
+		// Vehicles without motor dynamics get the identity (Alpha 1, no limits, no idle)
+		void UpdateMotorCoefficients(float DeltaTime)
+		{
+			if (!bMotorDynamics || DeltaTime == CachedDeltaTime)
+			{
+				return;
+			}
+			CachedDeltaTime = DeltaTime;
+
+			for (int i = 0; i < NumVehicles; i++)
+			{
+				FMotorLagCoefficients Lag;
+				if (MotorSettings[i].Enabled)
+				{
+					Lag.Compute(MotorSettings[i], DeltaTime);
+				}
+				MotorAlphaUp[i] = Lag.AlphaUp;
+				MotorAlphaDown[i] = Lag.AlphaDown;
+				MotorMaxStepUp[i] = Lag.MaxStepUp;
+				MotorMaxStepDown[i] = Lag.MaxStepDown;
+				MotorIdle[i] = Lag.IdleSpeed;
+			}
+		}
+
+
+		// Body rates the rate loop runs on: FilteredRate when the gyro filter is on, else BodyRate
+		const FAlignedFloatArray* FilterBodyRates(float DeltaTime)
+		{
+			if (!GyroFilter.Settings.IsEnabled())
+			{
+				return BodyRate;
+			}
+			const float* In[NumAxes] = { BodyRate[0].GetData(), BodyRate[1].GetData(), BodyRate[2].GetData() };
+			float* const Out[NumAxes] = { FilteredRate[0].GetData(), FilteredRate[1].GetData(), FilteredRate[2].GetData() };
+			const float* Speed[NumMotors];
+			for (int m = 0; m < NumMotors; m++)
+			{
+				Speed[m] = EngineSpeed[m].GetData();
+			}
+			GyroFilter.Step(In, Out, DeltaTime, Speed, NumMotors, SpeedToHz.GetData());
+			return FilteredRate;
+		}
+
+
+		void Grow(size_t Count)
+		{
+			FAlignedFloatArray* PerVehicle[] = {
+				&RollPitchExpo, &YawExpo, &SPDFrequency, &SPDDamping, &EngineKArray, &EngineQ, &EngineQQ, &ThrottleExpo, &Thrust, &SpeedToHz,
+				&MotorAlphaUp, &MotorAlphaDown, &MotorMaxStepUp, &MotorMaxStepDown, &MotorIdle
+			};
+			for (FAlignedFloatArray* Array : PerVehicle)
+			{
+				Array->Reserve(Count);
+			}
+			for (int a = 0; a < 4; a++)
+			{
+				RawInput[a].Reserve(Count);
+				InputScale[a].Reserve(Count);
+				InputMin[a].Reserve(Count);
+				InputInvRange2[a].Reserve(Count);
+			}
+			for (int a = 0; a < NumAxes; a++)
+			{
+				FAlignedFloatArray* PerAxis[] = {
+					&RateGainDeg[a], &MaxRate[a], &InvMaxRate[a], &Kp[a], &Ki[a], &Kd[a], &Integral[a], &PreError[a], &BodyRate[a], &FilteredRate[a], &Torque[a]
+				};
+				for (FAlignedFloatArray* Array : PerAxis)
+				{
+					Array->Reserve(Count);
+				}
+			}
+			for (int m = 0; m < NumMotors; m++)
+			{
+				FAlignedFloatArray* PerMotor[] = {
+					&MixRoll[m], &MixPitch[m], &MixYaw[m], &TorqueRoll[m], &TorquePitch[m], &TorqueYaw[m], &EngineSpeed[m]
+				};
+				for (FAlignedFloatArray* Array : PerMotor)
+				{
+					Array->Reserve(Count);
+				}
+			}
+			// Padding lanes must stay finite
+			for (size_t i = NumVehicles; i < Count; i++)
+			{
+				for (int a = 0; a < 4; a++)
+				{
+					InputInvRange2[a][i] = 1.0f;
+				}
+				for (int a = 0; a < NumAxes; a++)
+				{
+					MaxRate[a][i] = 1.0f;
+					InvMaxRate[a][i] = 1.0f;
+				}
+				EngineQ[i] = 2.0f;
+				EngineQQ[i] = 2.0f;
+				MotorAlphaUp[i] = 1.0f;
+				MotorAlphaDown[i] = 1.0f;
+			}
+			MotorSettings.resize(Count);
+		}
+
+
+		int NumVehicles = 0;
+		bool bQuadraticEngines = true;
+
+		// Input mapping
+		FAlignedFloatArray RawInput[4];
+		FAlignedFloatArray InputScale[4];
+		FAlignedFloatArray InputMin[4];
+		FAlignedFloatArray InputInvRange2[4];
+
+		// Pilot desired rates
+		FAlignedFloatArray RollPitchExpo;
+		FAlignedFloatArray YawExpo;
+		FAlignedFloatArray RateGainDeg[NumAxes];
+
+		// Rate loop
+		FAlignedFloatArray MaxRate[NumAxes];
+		FAlignedFloatArray InvMaxRate[NumAxes];
+		FAlignedFloatArray Kp[NumAxes];
+		FAlignedFloatArray Ki[NumAxes];
+		FAlignedFloatArray Kd[NumAxes];
+		FAlignedFloatArray Integral[NumAxes];
+		FAlignedFloatArray PreError[NumAxes];
+		FAlignedFloatArray SPDFrequency;
+		FAlignedFloatArray SPDDamping;
+		FAlignedFloatArray BodyRate[NumAxes];
+		FAlignedFloatArray FilteredRate[NumAxes];
+
+		// Mixer and engines
+		FAlignedFloatArray ThrottleExpo;
+		FAlignedFloatArray MixRoll[NumMotors];
+		FAlignedFloatArray MixPitch[NumMotors];
+		FAlignedFloatArray MixYaw[NumMotors];
+		FAlignedFloatArray TorqueRoll[NumMotors];
+		FAlignedFloatArray TorquePitch[NumMotors];
+		FAlignedFloatArray TorqueYaw[NumMotors];
+		FAlignedFloatArray EngineKArray;
+		FAlignedFloatArray EngineQ;
+		FAlignedFloatArray EngineQQ;
+		FAlignedFloatArray EngineSpeed[NumMotors];
+		FAlignedFloatArray SpeedToHz;			// EngineMaxRPM / 60, for the RPM notches
+
+		// Motor lag
+		bool bMotorDynamics = false;
+		float CachedDeltaTime = -1.0f;
+		std::vector<FMotorDynamicsSettings> MotorSettings;
+		FAlignedFloatArray MotorAlphaUp;
+		FAlignedFloatArray MotorAlphaDown;
+		FAlignedFloatArray MotorMaxStepUp;
+		FAlignedFloatArray MotorMaxStepDown;
+		FAlignedFloatArray MotorIdle;
+
+		// Results
+		FAlignedFloatArray Thrust;
+		FAlignedFloatArray Torque[NumAxes];
+	};
+
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <type_traits>
+
+#include "QFMCoreFlightModel.h"
+
+
+namespace QFM
+{
+
+	/*--- Every parameter of the controller chain by name ---*/
+	// Visit(Name, Value) is called with a reference to each float, int, bool or enum parameter.
+	// Names are "<Core>.<Member>" ("AttitudeController.RateRollPidSettings.X"), vectors per component.
+	// Used to store the configuration next to a flight record and to set it up again for a replay.
+
+	template <typename FVisitor>
+	void VisitFlightParamVec(FVisitor& Visit, const std::string& Name, FVec2& V)
+	{
+		Visit(Name + ".X", V.X);
+		Visit(Name + ".Y", V.Y);
+	}
+
+	template <typename FVisitor>
+	void VisitFlightParamVec(FVisitor& Visit, const std::string& Name, FVec3& V)
+	{
+		Visit(Name + ".X", V.X);
+		Visit(Name + ".Y", V.Y);
+		Visit(Name + ".Z", V.Z);
+	}
+
+	template <typename FVisitor>
+	void VisitFlightParamVec(FVisitor& Visit, const std::string& Name, FVec4& V)
+	{
+		Visit(Name + ".X", V.X);
+		Visit(Name + ".Y", V.Y);
+		Visit(Name + ".Z", V.Z);
+		Visit(Name + ".W", V.W);
+	}
+
+
+	template <typename FVisitor>
+	void VisitFlightParamFilter(FVisitor& Visit, const std::string& Name, FFilterChainSettings& Settings)
+	{
+		Visit(Name + ".LowPassHz", Settings.LowPassHz);
+		Visit(Name + ".LowPassQ", Settings.LowPassQ);
+		Visit(Name + ".NotchHz", Settings.NotchHz);
+		Visit(Name + ".NotchQ", Settings.NotchQ);
+		Visit(Name + ".bRpmNotch", Settings.bRpmNotch);
+		Visit(Name + ".RpmNotchQ", Settings.RpmNotchQ);
+		Visit(Name + ".RpmNotchMinHz", Settings.RpmNotchMinHz);
+	}
+
+
+	template <typename FVisitor>
+	void VisitFlightParamSensor(FVisitor& Visit, const std::string& Name, FInertialSensorSettings& Settings)
+	{
+		Visit(Name + ".NoiseDensity", Settings.NoiseDensity);
+		Visit(Name + ".BiasRandomWalk", Settings.BiasRandomWalk);
+		Visit(Name + ".InitialBias", Settings.InitialBias);
+		Visit(Name + ".Resolution", Settings.Resolution);
+		Visit(Name + ".Range", Settings.Range);
+		Visit(Name + ".Vibration", Settings.Vibration);
+	}
+
+
+	template <typename FVisitor>
+	void VisitFlightModelParams(const FFlightModelRefs& M, FVisitor&& Visit)
+	{
+		FVehicleCore& Vehicle = *M.Vehicle;
+		Visit("Vehicle.FrameMode", Vehicle.FrameMode);
+		Visit("Vehicle.ArmLength", Vehicle.ArmLength);
+		Visit("Vehicle.Mass", Vehicle.Mass);
+		VisitFlightParamVec(Visit, "Vehicle.InertiaTensor", Vehicle.InertiaTensor);
+		VisitFlightParamVec(Visit, "Vehicle.CenterOfMass", Vehicle.CenterOfMass);
+		Visit("Vehicle.Gravity", Vehicle.Gravity);
+		Visit("Vehicle.CustomFrame.NumMotors", Vehicle.CustomFrame.NumMotors);
+		for (int i = 0; i < MaxEngines; i++)
+		{
+			const std::string Motor = "Vehicle.CustomFrame.Motor" + std::to_string(i);
+			VisitFlightParamVec(Visit, Motor + ".Position", Vehicle.CustomFrame.Motors[i].Position);
+			VisitFlightParamVec(Visit, Motor + ".ThrustAxis", Vehicle.CustomFrame.Motors[i].ThrustAxis);
+			Visit(Motor + ".SpinDirection", Vehicle.CustomFrame.Motors[i].SpinDirection);
+		}
+
+		FInputCore& Input = *M.PilotInput;
+		VisitFlightParamVec(Visit, "PilotInput.RollAxisInputInterval", Input.RollAxisInputInterval);
+		VisitFlightParamVec(Visit, "PilotInput.PitchAxisInputInterval", Input.PitchAxisInputInterval);
+		VisitFlightParamVec(Visit, "PilotInput.YawAxisInputInterval", Input.YawAxisInputInterval);
+		VisitFlightParamVec(Visit, "PilotInput.ThrottleAxisInputInterval", Input.ThrottleAxisInputInterval);
+		VisitFlightParamVec(Visit, "PilotInput.InputAxisScale", Input.InputAxisScale);
+
+		FAHRSCore& AHRS = *M.AHRS;
+		VisitFlightParamFilter(Visit, "AHRS.GyroFilter", AHRS.GyroFilter.Settings);
+		VisitFlightParamFilter(Visit, "AHRS.AccelerationFilter", AHRS.AccelerationFilter.Settings);
+		FSensorSettings& Sensors = AHRS.Sensors.Settings;
+		Visit("AHRS.Sensors.Enabled", Sensors.Enabled);
+		Visit("AHRS.Sensors.ImuRateHz", Sensors.ImuRateHz);
+		Visit("AHRS.Sensors.LatencySeconds", Sensors.LatencySeconds);
+		Visit("AHRS.Sensors.Seed", Sensors.Seed);
+		Visit("AHRS.Sensors.Gravity", Sensors.Gravity);
+		VisitFlightParamSensor(Visit, "AHRS.Sensors.Gyro", Sensors.Gyro);
+		VisitFlightParamSensor(Visit, "AHRS.Sensors.Accelerometer", Sensors.Accelerometer);
+		Visit("AHRS.Sensors.BaroRateHz", Sensors.BaroRateHz);
+		Visit("AHRS.Sensors.BaroNoise", Sensors.BaroNoise);
+		Visit("AHRS.Sensors.BaroBiasRandomWalk", Sensors.BaroBiasRandomWalk);
+		Visit("AHRS.Sensors.BaroResolution", Sensors.BaroResolution);
+		Visit("AHRS.Sensors.PositionRateHz", Sensors.PositionRateHz);
+		Visit("AHRS.Sensors.PositionNoise", Sensors.PositionNoise);
+		Visit("AHRS.Sensors.HeadingNoise", Sensors.HeadingNoise);
+		FEstimatorSettings& Estimator = AHRS.Estimator.Settings;
+		Visit("AHRS.Estimator.Enabled", Estimator.Enabled);
+		Visit("AHRS.Estimator.GyroNoise", Estimator.GyroNoise);
+		Visit("AHRS.Estimator.AccelerometerNoise", Estimator.AccelerometerNoise);
+		Visit("AHRS.Estimator.GyroBiasRandomWalk", Estimator.GyroBiasRandomWalk);
+		Visit("AHRS.Estimator.AccelerometerBiasRandomWalk", Estimator.AccelerometerBiasRandomWalk);
+		Visit("AHRS.Estimator.BaroNoise", Estimator.BaroNoise);
+		Visit("AHRS.Estimator.PositionNoise", Estimator.PositionNoise);
+		Visit("AHRS.Estimator.HeadingNoise", Estimator.HeadingNoise);
+		Visit("AHRS.Estimator.InitialAttitude", Estimator.InitialAttitude);
+		Visit("AHRS.Estimator.InitialVelocity", Estimator.InitialVelocity);
+		Visit("AHRS.Estimator.InitialPosition", Estimator.InitialPosition);
+		Visit("AHRS.Estimator.InitialGyroBias", Estimator.InitialGyroBias);
+		Visit("AHRS.Estimator.InitialAccelerometerBias", Estimator.InitialAccelerometerBias);
+		Visit("AHRS.Estimator.InnovationGate", Estimator.InnovationGate);
+
+		FAttitudeCore& Attitude = *M.AttitudeController;
+		Visit("AttitudeController.FlightMode", Attitude.FlightMode);
+		Visit("AttitudeController.AngleMax", Attitude.AngleMax);
+		Visit("AttitudeController.SmoothingGain", Attitude.SmoothingGain);
+		Visit("AttitudeController.AccroThrottleMid", Attitude.AccroThrottleMid);
+		Visit("AttitudeController.PilotSpeedDown", Attitude.PilotSpeedDown);
+		Visit("AttitudeController.PilotSpeedUp", Attitude.PilotSpeedUp);
+		Visit("AttitudeController.YawPGain", Attitude.YawPGain);
+		Visit("AttitudeController.AccroRollPitchPGain", Attitude.AccroRollPitchPGain);
+		Visit("AttitudeController.AccroYawExpo", Attitude.AccroYawExpo);
+		Visit("AttitudeController.AccroRollPitchExpo", Attitude.AccroRollPitchExpo);
+		Visit("AttitudeController.ThrottleDeadzone", Attitude.ThrottleDeadzone);
+		Visit("AttitudeController.RotationControlLoop", Attitude.RotationControlLoop);
+		VisitFlightParamVec(Visit, "AttitudeController.RateRollPidSettings", Attitude.RateRollPidSettings);
+		VisitFlightParamVec(Visit, "AttitudeController.RatePitchPidSettings", Attitude.RatePitchPidSettings);
+		VisitFlightParamVec(Visit, "AttitudeController.RateYawPidSettings", Attitude.RateYawPidSettings);
+		VisitFlightParamVec(Visit, "AttitudeController.RatePidFeedForward", Attitude.RatePidFeedForward);
+		Visit("AttitudeController.RatePidDFilterHz", Attitude.RatePidDFilterHz);
+		Visit("AttitudeController.RatePidAntiWindup", Attitude.RatePidAntiWindup);
+		Visit("AttitudeController.bRatePidDOnMeasurement", Attitude.bRatePidDOnMeasurement);
+		Visit("AttitudeController.SPDDamping", Attitude.SPDDamping);
+		Visit("AttitudeController.SPDFrequency", Attitude.SPDFrequency);
+
+		FPositionCore& Position = *M.PositionController;
+		Visit("PositionController.bIsActiveZ", Position.bIsActiveZ);
+		Visit("PositionController.MaxClimbVelocityZ", Position.MaxClimbVelocityZ);
+		Visit("PositionController.MaxDescentVelocityZ", Position.MaxDescentVelocityZ);
+		Visit("PositionController.MaxAccelerationZ", Position.MaxAccelerationZ);
+		Visit("PositionController.TranslationControlLoop", Position.TranslationControlLoop);
+		VisitFlightParamVec(Visit, "PositionController.RateZPidSettings", Position.RateZPidSettings);
+		Visit("PositionController.RateZPidFeedForward", Position.RateZPidFeedForward);
+		Visit("PositionController.RateZPidDFilterHz", Position.RateZPidDFilterHz);
+		Visit("PositionController.RateZPidAntiWindup", Position.RateZPidAntiWindup);
+		Visit("PositionController.bRateZPidDOnMeasurement", Position.bRateZPidDOnMeasurement);
+		Visit("PositionController.SPDDamping", Position.SPDDamping);
+		Visit("PositionController.SPDFrequency", Position.SPDFrequency);
+
+		FEngineCore& Engine = *M.EngineController;
+		Visit("EngineController.EngineMaxRPM", Engine.EngineMaxRPM);
+		Visit("EngineController.Engine_K", Engine.Engine_K);
+		Visit("EngineController.Engine_Q", Engine.Engine_Q);
+		Visit("EngineController.Engine_B", Engine.Engine_B);
+		Visit("EngineController.Engine_QQ", Engine.Engine_QQ);
+		Visit("EngineController.CalculateEngine_K", Engine.CalculateEngine_K);
+		Visit("EngineController.PlanMaxLift", Engine.PlanMaxLift);
+		Visit("EngineController.UseMeasuredCurve", Engine.UseMeasuredCurve);
+		Visit("EngineController.UseMixerTorque", Engine.UseMixerTorque);
+		Visit("EngineController.NumMeasuredCurvePoints", Engine.NumMeasuredCurvePoints);
+		for (int i = 0; i < MaxMotorCurvePoints; i++)
+		{
+			const std::string Point = "EngineController.MeasuredCurve" + std::to_string(i);
+			Visit(Point + ".RPM", Engine.MeasuredCurve[i].RPM);
+			Visit(Point + ".Thrust", Engine.MeasuredCurve[i].Thrust);
+			Visit(Point + ".Torque", Engine.MeasuredCurve[i].Torque);
+		}
+		FMotorDynamicsSettings& Dynamics = Engine.MotorDynamics.Settings;
+		Visit("EngineController.MotorDynamics.Enabled", Dynamics.Enabled);
+		Visit("EngineController.MotorDynamics.SpinUpTimeConstant", Dynamics.SpinUpTimeConstant);
+		Visit("EngineController.MotorDynamics.SpinDownTimeConstant", Dynamics.SpinDownTimeConstant);
+		Visit("EngineController.MotorDynamics.MaxSpinUpRate", Dynamics.MaxSpinUpRate);
+		Visit("EngineController.MotorDynamics.MaxSpinDownRate", Dynamics.MaxSpinDownRate);
+		Visit("EngineController.MotorDynamics.IdleSpeed", Dynamics.IdleSpeed);
+
+		FMultiRateSchedulerCore& Scheduler = *M.Scheduler;
+		Visit("Scheduler.RateLoopHz", Scheduler.RateLoopHz);
+		Visit("Scheduler.InputHz", Scheduler.InputHz);
+		Visit("Scheduler.AHRSHz", Scheduler.AHRSHz);
+		Visit("Scheduler.PositionHz", Scheduler.PositionHz);
+		Visit("Scheduler.MaxTicksPerStep", Scheduler.MaxTicksPerStep);
+	}
+
+
+
+	/*--- Parameter values as text ---*/
+	// One "Name=Value" per line. Floats with 9 significant digits, so they read back bit exact
+
+	template <typename T>
+	typename std::enable_if<std::is_enum<T>::value, double>::type FlightParamToDouble(T Value) { return static_cast<double>(static_cast<int>(Value)); }
+
+	template <typename T>
+	typename std::enable_if<!std::is_enum<T>::value, double>::type FlightParamToDouble(T Value) { return static_cast<double>(Value); }
+
+	template <typename T>
+	typename std::enable_if<std::is_enum<T>::value>::type FlightParamFromDouble(T& Value, double In) { Value = static_cast<T>(static_cast<int>(In)); }
+
+	inline void FlightParamFromDouble(float& Value, double In) { Value = static_cast<float>(In); }
+	inline void FlightParamFromDouble(int& Value, double In) { Value = static_cast<int>(In); }
+	inline void FlightParamFromDouble(bool& Value, double In) { Value = In != 0.0; }
+
+
+	inline std::string FormatFlightModelConfig(const FFlightModelRefs& M)
+	{
+		std::string Text;
+		VisitFlightModelParams(M, [&Text](const std::string& Name, auto& Value)
+		{
+			char Buffer[32];
+			std::snprintf(Buffer, sizeof(Buffer), "%.9g", FlightParamToDouble(Value));
+			Text += Name;
+			Text += '=';
+			Text += Buffer;
+			Text += '\n';
+		});
+		return Text;
+	}
+
+
+	// Sets every parameter found in Text, the others keep their values. Returns the number of lines that
+	// name no parameter (written by another version). Call Init() on the cores afterwards
+	inline int ApplyFlightModelConfig(const std::string& Text, const FFlightModelRefs& M)
+	{
+		std::map<std::string, double> Values;
+		size_t Start = 0;
+		while (Start < Text.size())
+		{
+			size_t End = Text.find('\n', Start);
+			End = (End == std::string::npos) ? Text.size() : End;
+			const size_t Equals = Text.find('=', Start);
+			if (Equals != std::string::npos && Equals < End)
+			{
+				Values[Text.substr(Start, Equals - Start)] = std::strtod(Text.c_str() + Equals + 1, nullptr);
+			}
+			Start = End + 1;
+		}
+
+		size_t Found = 0;
+		VisitFlightModelParams(M, [&Values, &Found](const std::string& Name, auto& Value)
+		{
+			const auto It = Values.find(Name);
+			if (It != Values.end())
+			{
+				FlightParamFromDouble(Value, It->second);
+				Found++;
+			}
+		});
+		return static_cast<int>(Values.size() - Found);
+	}
+
+
+
+	/*--- Configuration file of a flight record: one section per vehicle ---*/
+	//	[Vehicle 3]
+	//	AttitudeController.AngleMax=45
+	//	...
+
+	inline std::string FormatFlightConfigSection(uint32_t VehicleId, const FFlightModelRefs& M)
+	{
+		return "[Vehicle " + std::to_string(VehicleId) + "]\n" + FormatFlightModelConfig(M) + "\n";
+	}
+
+	// Section text by vehicle id. The last section of a vehicle wins
+	inline std::map<uint32_t, std::string> ParseFlightConfigFile(const std::string& Text)
+	{
+		std::map<uint32_t, std::string> Sections;
+		std::string* Current = nullptr;
+		size_t Start = 0;
+		while (Start < Text.size())
+		{
+			size_t End = Text.find('\n', Start);
+			End = (End == std::string::npos) ? Text.size() : End;
+			const std::string Line = Text.substr(Start, End - Start);
+			if (Line.compare(0, 9, "[Vehicle ") == 0)
+			{
+				const uint32_t VehicleId = static_cast<uint32_t>(std::strtoul(Line.c_str() + 9, nullptr, 10));
+				Current = &Sections[VehicleId];
+				Current->clear();
+			}
+			else if (Current && !Line.empty())
+			{
+				*Current += Line;
+				*Current += '\n';
+			}
+			Start = End + 1;
+		}
+		return Sections;
+	}
+
+}
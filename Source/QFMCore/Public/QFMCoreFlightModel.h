@@ -0,0 +1,144 @@
+#pragma once
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreVehicle.h"
+#include "QFMCoreInput.h"
+#include "QFMCoreAHRS.h"
+#include "QFMCoreAttitude.h"
+#include "QFMCorePosition.h"
+#include "QFMCoreEngine.h"
+#include "QFMCoreScheduler.h"
+
+
+namespace QFM
+{
+
+	/*--- The cores of one vehicle, wherever they live ---*/
+	// FFlightModelCore owns them in one struct, UQuadcopterFlightModel in its USTRUCT adapters.
+	// Recorder, config and replay work on this so both can use them.
+	struct FFlightModelRefs
+	{
+		FVehicleCore* Vehicle = nullptr;
+		FInputCore* PilotInput = nullptr;
+		FAHRSCore* AHRS = nullptr;
+		FAttitudeCore* AttitudeController = nullptr;
+		FPositionCore* PositionController = nullptr;
+		FEngineCore* EngineController = nullptr;
+		FMultiRateSchedulerCore* Scheduler = nullptr;
+	};
+
+
+	/*--- Complete controller chain of one vehicle, without any engine ---*/
+	// Same wiring and Tock order as UQuadcopterFlightModel::BeginPlay / Simulate.
+	// Headless tools use this directly. Parameters are set on the members before Init().
+	struct FFlightModelCore
+	{
+		FVehicleCore Vehicle;
+		FInputCore PilotInput;
+		FAHRSCore AHRS;
+		FAttitudeCore AttitudeController;
+		FPositionCore PositionController;
+		FEngineCore EngineController;
+		FMultiRateSchedulerCore Scheduler;
+
+		// Forces to apply over the last physics step
+		FVec3 StepThrust;
+		FVec3 StepTorque;
+
+
+		void Init(const FBodyState& Body)
+		{
+			AHRS.Init(&EngineController);
+			AttitudeController.Init(Body, &PilotInput, &AHRS, &PositionController, &EngineController);
+			PositionController.Init(&AHRS, &Vehicle, &EngineController);
+			EngineController.Init(&Vehicle);
+			Scheduler.Init();
+		}
+
+
+		// Runs every stage once with the physics DeltaTime. Resulting forces are available from GetTotalThrust / GetTotalTorque
+		void Simulate(const FBodyState& Body, float DeltaTime)
+		{
+			// only do something if time ellapsed
+			if (DeltaTime <= 0.0f) { return; }
+
+			PilotInput.Tock(DeltaTime);
+			AHRS.Tock(Body, DeltaTime);
+			AttitudeController.Tock(DeltaTime, Body);
+			// Z controller before the position stage takes the new DeltaTime, in the order of the original Simulate()
+			AttitudeController.TockPositionLoop();
+			PositionController.Tock(DeltaTime);
+			EngineController.Tock(DeltaTime);
+
+			StepThrust = EngineController.GetTotalThrust();
+			StepTorque = EngineController.GetTotalTorque();
+		}
+
+
+		// Runs each stage at its own fixed rate (see FMultiRateSchedulerCore), rates are taken at Init().
+		// Thrust and torque are averaged over the rate loop ticks inside this physics step.
+		void SimulateMultiRate(const FBodyState& Body, float DeltaTime)
+		{
+			const int Ticks = Scheduler.Advance(DeltaTime);
+			if (Ticks == 0)
+			{
+				// keep applying the forces of the last rate loop tick
+				StepThrust = EngineController.GetTotalThrust();
+				StepTorque = EngineController.GetTotalTorque();
+				return;
+			}
+
+			FVec3 ThrustSum;
+			FVec3 TorqueSum;
+
+			for (int i = 0; i < Ticks; i++, Scheduler.NextTick())
+			{
+				const FBodyState TickBody = PredictBodyState(Body, i * Scheduler.TickPeriod);
+
+				if (Scheduler.IsDue(EControlStage::Input))
+				{
+					PilotInput.Tock(Scheduler.GetStageDeltaTime(EControlStage::Input));
+				}
+				if (Scheduler.IsDue(EControlStage::AHRS))
+				{
+					AHRS.Tock(TickBody, Scheduler.GetStageDeltaTime(EControlStage::AHRS));
+				}
+
+				AttitudeController.Tock(Scheduler.TickPeriod, TickBody);
+
+				if (Scheduler.IsDue(EControlStage::Position))
+				{
+					PositionController.Tock(Scheduler.GetStageDeltaTime(EControlStage::Position));
+					AttitudeController.TockPositionLoop();
+				}
+
+				EngineController.Tock(Scheduler.TickPeriod);
+
+				ThrustSum += EngineController.GetTotalThrust();
+				TorqueSum += EngineController.GetTotalTorque();
+			}
+
+			StepThrust = ThrustSum * (1.0f / Ticks);
+			StepTorque = TorqueSum * (1.0f / Ticks);
+		}
+
+
+		FFlightModelRefs GetRefs()
+		{
+			FFlightModelRefs Refs;
+			Refs.Vehicle = &Vehicle;
+			Refs.PilotInput = &PilotInput;
+			Refs.AHRS = &AHRS;
+			Refs.AttitudeController = &AttitudeController;
+			Refs.PositionController = &PositionController;
+			Refs.EngineController = &EngineController;
+			Refs.Scheduler = &Scheduler;
+			return Refs;
+		}
+
+
+		FVec3 GetTotalThrust() const { return StepThrust; }
+		FVec3 GetTotalTorque() const { return StepTorque; }
+	};
+
+}
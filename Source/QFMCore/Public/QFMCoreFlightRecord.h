@@ -0,0 +1,430 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "QFMCoreRing.h"
+#include "QFMCoreFlightModel.h"
+
+
+namespace QFM
+{
+
+	/*--- Flight data recorder file, version 6 ---*/
+	// One header page, then Capacity fixed size records in the order they were recorded (all vehicles interleaved).
+	// Host byte order (little-endian on every platform we build for), plain structs: map the file and index it.
+	// The file is preallocated, NumRecords in the header counts the valid records and only grows after they are written.
+	// Every record holds the complete controller state after its step, so a replay can start at any record
+	// (QFMCoreReplay.h). The parameters go to a text file next to it (QFMCoreFlightConfig.h).
+	// PythonSource/QFMFlightRecord.py reads the same layout with numpy.
+
+	constexpr uint32_t FlightRecordMagic = 0x524D4651;		// 'QFMR'
+	constexpr uint16_t FlightRecordVersion = 6;
+	constexpr uint32_t FlightRecordHeaderBytes = 4096;		// one page, records stay page aligned
+
+
+	struct FFlightRecordFileHeader
+	{
+		uint32_t Magic = FlightRecordMagic;
+		uint16_t Version = FlightRecordVersion;
+		uint16_t Reserved0 = 0;
+		uint32_t HeaderBytes = FlightRecordHeaderBytes;		// records start here
+		uint32_t RecordBytes = 0;							// record stride
+		uint64_t Capacity = 0;								// records the file has room for
+		uint64_t NumRecords = 0;							// valid records
+		uint64_t DroppedRecords = 0;						// lost because the file or a producer ring was full
+	};
+
+
+	// FFlightRecord::Flags
+	enum EFlightRecordFlags : uint8_t
+	{
+		FlightRecordMultiRate = 1 << 0,			// stages ran through the multi-rate scheduler
+		FlightRecordPositionLockedZ = 1 << 1,	// FPositionCore::bIsLockedZ
+		FlightRecordSensorsStarted = 1 << 2,	// FSensorCore::bHasLast
+		FlightRecordBaroValid = 1 << 3,			// FSensorCore::bBaroValid
+		FlightRecordEstimatorAligned = 1 << 4,	// FEstimatorCore::bInitialized
+	};
+
+
+	// One vehicle after one physics step. Values in the units of the cores
+	struct FFlightRecord
+	{
+		double SimTime;					// s, end of the step
+		uint32_t VehicleId;
+		uint32_t Step;					// physics steps of this vehicle before this one, gaps = lost records
+		float DeltaTime;				// s
+		uint8_t FlightMode;				// EFlightMode
+		uint8_t RotationControlLoop;	// EControlLoop
+		uint8_t NumEngines;
+		uint8_t Flags;					// EFlightRecordFlags
+
+		// Rigid body snapshot the step ran on, SI units, world space
+		float Rotation[4];				// X Y Z W
+		float Position[3];
+		float LinearVelocity[3];
+		float AngularVelocity[3];
+
+		// Pilot
+		float PilotAxisInput[4];		// raw Roll Pitch Yaw Throttle as received
+		float DesiredPilotInput[4];		// mapped by FInputCore
+
+		// AHRS, as FAHRSCore
+		float AHRSPosition[3];
+		float AHRSRotation[3];			// Pitch Yaw Roll, deg
+		float AHRSLinearVelocity;
+		float AHRSVelocityVector[3];
+		float AHRSLinearVelocity2D;
+		float AHRSLinearVelocityX;
+		float AHRSAngularVelocity[3];
+		float AHRSLinearAcceleration;
+		float AHRSLinearAccelerationVector[3];
+		float AHRSAngularAcceleration[3];
+		float AHRSWorldRotation[4];
+		float AHRSWorldTranslation[3];
+		float AHRSBodyAngularVelocity[3];
+		float AHRSGyroFilterState[FAHRSCore::FGyroFilter::NumStateValues];					// TFilterChain::SaveState
+		float AHRSAccelerationFilterState[FAHRSCore::FAccelerationFilter::NumStateValues];
+
+		// IMU, barometer and position sensor model, as FSensorCore. All 0 while it is off. The latency ring is not recorded
+		float SensorImuTimer;
+		float SensorBaroTimer;
+		uint32_t SensorImuIndex;
+		uint32_t SensorBaroIndex;
+		float SensorGyroBias[3];
+		float SensorAccelerometerBias[3];
+		float SensorBaroBias;
+		float SensorBaroAltitude;
+		float SensorVibrationPhase[MaxEngines];
+		float SensorLastRotation[4];		// X Y Z W
+		float SensorLastAngularVelocity[3];
+		float SensorLastVelocity[3];
+		float SensorPositionTimer;
+		uint32_t SensorPositionIndex;
+
+		// Estimator, as FEstimatorCore. All 0 until it aligned
+		float EstimatorRotation[4];		// X Y Z W
+		float EstimatorVelocity[3];
+		float EstimatorPosition[3];
+		float EstimatorGyroBias[3];
+		float EstimatorAccelerometerBias[3];
+		float EstimatorCovariance[FEstimatorCore::NumCovarianceValues];	// upper triangle row by row
+		uint32_t EstimatorRejected;		// measurements the gate rejected
+		float EstimatorReserved;
+
+		// Attitude controller
+		float AttitudeTarget[4];		// X Y Z W
+		float RateIntegral[3];			// Roll Pitch Yaw rate PIDs
+		float RatePreError[3];
+		float RateDerivative[3];		// filtered derivative terms
+
+		// Position controller
+		float PosTargetZ;
+		float RateZIntegral;
+		float RateZPreError;
+		float RateZDerivative;
+
+		// Engine controller
+		float RotationRequest[3];		// rad/s^2, into the mixer
+		float ThrottleRequest;
+		float EngineMixPercent[MaxEngines];
+		float EngineSpeed[MaxEngines];
+		float EngineThrust[3];			// of the last rate loop tick
+		float EngineTorque[3];
+
+		// Applied over the step
+		float Thrust[3];
+		float Torque[3];
+
+		// Scheduler
+		float SchedulerAccumulator;
+		uint32_t Reserved0;
+		uint64_t SchedulerTickCount;
+	};
+
+	static_assert(sizeof(FFlightRecord) == 1368, "FFlightRecord is a file format, keep its layout");
+	static_assert(sizeof(FFlightRecordFileHeader) <= FlightRecordHeaderBytes, "Header must fit its page");
+
+
+	// One ring per producing thread, as telemetry (ETelemetryProducer)
+	typedef TSpscRing<FFlightRecord, 8192> FFlightRecordRing;
+
+
+
+	/*--- Copy the controller state into a record and back ---*/
+
+	inline void StoreFlightRecordVec(float* Out, const FVec3& V) { Out[0] = V.X; Out[1] = V.Y; Out[2] = V.Z; }
+	inline void StoreFlightRecordVec(float* Out, const FVec4& V) { Out[0] = V.X; Out[1] = V.Y; Out[2] = V.Z; Out[3] = V.W; }
+	inline void StoreFlightRecordQuat(float* Out, const FQuatf& Q) { Out[0] = Q.X; Out[1] = Q.Y; Out[2] = Q.Z; Out[3] = Q.W; }
+	inline FVec3 LoadFlightRecordVec3(const float* In) { return FVec3(In[0], In[1], In[2]); }
+	inline FVec4 LoadFlightRecordVec4(const float* In) { return FVec4(In[0], In[1], In[2], In[3]); }
+	inline FQuatf LoadFlightRecordQuat(const float* In) { return FQuatf(In[0], In[1], In[2], In[3]); }
+
+
+	// DeltaTime of the physics step, Body the snapshot it ran on, Thrust / Torque what was applied.
+	// SimTime, VehicleId and Step are left to the caller
+	inline void FillFlightRecord(FFlightRecord& R, const FFlightModelRefs& M, float DeltaTime, const FBodyState& Body, bool bMultiRate,
+		const FVec3& Thrust, const FVec3& Torque)
+	{
+		std::memset(&R, 0, sizeof(R));
+
+		const FInputCore& Input = *M.PilotInput;
+		const FAHRSCore& AHRS = *M.AHRS;
+		const FAttitudeCore& Attitude = *M.AttitudeController;
+		const FPositionCore& Position = *M.PositionController;
+		const FEngineCore& Engine = *M.EngineController;
+
+		R.DeltaTime = DeltaTime;
+		R.FlightMode = static_cast<uint8_t>(Attitude.FlightMode);
+		R.RotationControlLoop = static_cast<uint8_t>(Attitude.RotationControlLoop);
+		R.NumEngines = static_cast<uint8_t>(Engine.GetNumEngines());
+		R.Flags = (bMultiRate ? FlightRecordMultiRate : 0) | (Position.bIsLockedZ ? FlightRecordPositionLockedZ : 0)
+			| (AHRS.Sensors.bHasLast ? FlightRecordSensorsStarted : 0) | (AHRS.Sensors.bBaroValid ? FlightRecordBaroValid : 0)
+			| (AHRS.Estimator.bInitialized ? FlightRecordEstimatorAligned : 0);
+
+		StoreFlightRecordQuat(R.Rotation, Body.Rotation);
+		StoreFlightRecordVec(R.Position, Body.Position);
+		StoreFlightRecordVec(R.LinearVelocity, Body.LinearVelocity);
+		StoreFlightRecordVec(R.AngularVelocity, Body.AngularVelocity);
+
+		R.PilotAxisInput[0] = Input.RollAxisInput;
+		R.PilotAxisInput[1] = Input.PitchAxisInput;
+		R.PilotAxisInput[2] = Input.YawAxisInput;
+		R.PilotAxisInput[3] = Input.ThrottleAxisInput;
+		StoreFlightRecordVec(R.DesiredPilotInput, Input.DesiredPilotInput);
+
+		StoreFlightRecordVec(R.AHRSPosition, AHRS.Position);
+		R.AHRSRotation[0] = AHRS.Rotation.Pitch;
+		R.AHRSRotation[1] = AHRS.Rotation.Yaw;
+		R.AHRSRotation[2] = AHRS.Rotation.Roll;
+		R.AHRSLinearVelocity = AHRS.LinearVelocity;
+		StoreFlightRecordVec(R.AHRSVelocityVector, AHRS.VelocityVector);
+		R.AHRSLinearVelocity2D = AHRS.LinearVelocity2D;
+		R.AHRSLinearVelocityX = AHRS.LinearVelocityX;
+		StoreFlightRecordVec(R.AHRSAngularVelocity, AHRS.AngularVelocity);
+		R.AHRSLinearAcceleration = AHRS.LinearAcceleration;
+		StoreFlightRecordVec(R.AHRSLinearAccelerationVector, AHRS.LinearAccelerationVector);
+		StoreFlightRecordVec(R.AHRSAngularAcceleration, AHRS.AngularAcceleration);
+		StoreFlightRecordQuat(R.AHRSWorldRotation, AHRS.WorldRotationQuat);
+		StoreFlightRecordVec(R.AHRSWorldTranslation, AHRS.WorldTranslationVect);
+		StoreFlightRecordVec(R.AHRSBodyAngularVelocity, AHRS.BodyAngularVelocityVect);
+		AHRS.GyroFilter.SaveState(R.AHRSGyroFilterState);
+		AHRS.AccelerationFilter.SaveState(R.AHRSAccelerationFilterState);
+
+		const FSensorCore& Sensors = AHRS.Sensors;
+		R.SensorImuTimer = Sensors.ImuTimer;
+		R.SensorBaroTimer = Sensors.BaroTimer;
+		R.SensorImuIndex = Sensors.ImuIndex;
+		R.SensorBaroIndex = Sensors.BaroIndex;
+		for (int a = 0; a < 3; a++)
+		{
+			R.SensorGyroBias[a] = Sensors.GyroBias[a];
+			R.SensorAccelerometerBias[a] = Sensors.AccelerometerBias[a];
+		}
+		R.SensorBaroBias = Sensors.BaroBias;
+		R.SensorBaroAltitude = Sensors.BaroAltitude;
+		for (int i = 0; i < MaxEngines; i++)
+		{
+			R.SensorVibrationPhase[i] = Sensors.VibrationPhase[i];
+		}
+		if (Sensors.bHasLast)
+		{
+			StoreFlightRecordQuat(R.SensorLastRotation, Sensors.LastRotation);
+			StoreFlightRecordVec(R.SensorLastAngularVelocity, Sensors.LastAngularVelocity);
+			StoreFlightRecordVec(R.SensorLastVelocity, Sensors.LastVelocity);
+		}
+		R.SensorPositionTimer = Sensors.PositionTimer;
+		R.SensorPositionIndex = Sensors.PositionIndex;
+
+		const FEstimatorCore& Estimator = AHRS.Estimator;
+		if (Estimator.bInitialized)
+		{
+			StoreFlightRecordQuat(R.EstimatorRotation, Estimator.Rotation);
+			StoreFlightRecordVec(R.EstimatorVelocity, Estimator.Velocity);
+			StoreFlightRecordVec(R.EstimatorPosition, Estimator.Position);
+			StoreFlightRecordVec(R.EstimatorGyroBias, Estimator.GyroBias);
+			StoreFlightRecordVec(R.EstimatorAccelerometerBias, Estimator.AccelerometerBias);
+			Estimator.SaveCovariance(R.EstimatorCovariance);
+		}
+		R.EstimatorRejected = Estimator.NumRejected;
+
+		StoreFlightRecordQuat(R.AttitudeTarget, Attitude.AttitudeTargetQuat);
+		for (int a = 0; a < 3; a++)
+		{
+			R.RateIntegral[a] = Attitude.RatePid.Integral[a];
+			R.RatePreError[a] = Attitude.RatePid.PreError[a];
+			R.RateDerivative[a] = Attitude.RatePid.Derivative[a];
+		}
+
+		R.PosTargetZ = Position.PosTargetZ;
+		R.RateZIntegral = Position.RateZPid.Integral[0];
+		R.RateZPreError = Position.RateZPid.PreError[0];
+		R.RateZDerivative = Position.RateZPid.Derivative[0];
+
+		StoreFlightRecordVec(R.RotationRequest, Engine.RotationRequest);
+		R.ThrottleRequest = Engine.ThrottleRequest;
+		for (int i = 0; i < R.NumEngines; i++)
+		{
+			R.EngineMixPercent[i] = Engine.EngineMixPercent[i];
+			R.EngineSpeed[i] = Engine.EngineSpeed[i];
+		}
+		StoreFlightRecordVec(R.EngineThrust, Engine.TotalThrust);
+		StoreFlightRecordVec(R.EngineTorque, Engine.TotalTorque);
+
+		StoreFlightRecordVec(R.Thrust, Thrust);
+		StoreFlightRecordVec(R.Torque, Torque);
+
+		R.SchedulerAccumulator = M.Scheduler->Accumulator;
+		R.SchedulerTickCount = M.Scheduler->TickCount;
+	}
+
+
+	// Put the controllers back into the state after the step of R. Parameters are not part of a record
+	inline void RestoreFlightRecordState(const FFlightRecord& R, const FFlightModelRefs& M)
+	{
+		FInputCore& Input = *M.PilotInput;
+		FAHRSCore& AHRS = *M.AHRS;
+		FAttitudeCore& Attitude = *M.AttitudeController;
+		FPositionCore& Position = *M.PositionController;
+		FEngineCore& Engine = *M.EngineController;
+
+		Input.RollAxisInput = R.PilotAxisInput[0];
+		Input.PitchAxisInput = R.PilotAxisInput[1];
+		Input.YawAxisInput = R.PilotAxisInput[2];
+		Input.ThrottleAxisInput = R.PilotAxisInput[3];
+		Input.DesiredPilotInput = LoadFlightRecordVec4(R.DesiredPilotInput);
+
+		AHRS.Position = LoadFlightRecordVec3(R.AHRSPosition);
+		AHRS.Rotation = FRotatorf(R.AHRSRotation[0], R.AHRSRotation[1], R.AHRSRotation[2]);
+		AHRS.LinearVelocity = R.AHRSLinearVelocity;
+		AHRS.VelocityVector = LoadFlightRecordVec3(R.AHRSVelocityVector);
+		AHRS.LinearVelocity2D = R.AHRSLinearVelocity2D;
+		AHRS.LinearVelocityX = R.AHRSLinearVelocityX;
+		AHRS.AngularVelocity = LoadFlightRecordVec3(R.AHRSAngularVelocity);
+		AHRS.LinearAcceleration = R.AHRSLinearAcceleration;
+		AHRS.LinearAccelerationVector = LoadFlightRecordVec3(R.AHRSLinearAccelerationVector);
+		AHRS.AngularAcceleration = LoadFlightRecordVec3(R.AHRSAngularAcceleration);
+		AHRS.WorldRotationQuat = LoadFlightRecordQuat(R.AHRSWorldRotation);
+		AHRS.WorldTranslationVect = LoadFlightRecordVec3(R.AHRSWorldTranslation);
+		AHRS.BodyAngularVelocityVect = LoadFlightRecordVec3(R.AHRSBodyAngularVelocity);
+		AHRS.GyroFilter.LoadState(R.AHRSGyroFilterState);
+		AHRS.AccelerationFilter.LoadState(R.AHRSAccelerationFilterState);
+
+		FSensorCore& Sensors = AHRS.Sensors;
+		Sensors.ImuTimer = R.SensorImuTimer;
+		Sensors.BaroTimer = R.SensorBaroTimer;
+		Sensors.ImuIndex = R.SensorImuIndex;
+		Sensors.BaroIndex = R.SensorBaroIndex;
+		for (int a = 0; a < 3; a++)
+		{
+			Sensors.GyroBias[a] = R.SensorGyroBias[a];
+			Sensors.AccelerometerBias[a] = R.SensorAccelerometerBias[a];
+		}
+		Sensors.BaroBias = R.SensorBaroBias;
+		Sensors.BaroAltitude = R.SensorBaroAltitude;
+		Sensors.bBaroValid = (R.Flags & FlightRecordBaroValid) != 0;
+		for (int i = 0; i < MaxEngines; i++)
+		{
+			Sensors.VibrationPhase[i] = R.SensorVibrationPhase[i];
+		}
+		Sensors.bHasLast = (R.Flags & FlightRecordSensorsStarted) != 0;
+		if (Sensors.bHasLast)
+		{
+			Sensors.LastRotation = LoadFlightRecordQuat(R.SensorLastRotation);
+			Sensors.LastAngularVelocity = LoadFlightRecordVec3(R.SensorLastAngularVelocity);
+			Sensors.LastVelocity = LoadFlightRecordVec3(R.SensorLastVelocity);
+		}
+		Sensors.PositionTimer = R.SensorPositionTimer;
+		Sensors.PositionIndex = R.SensorPositionIndex;
+
+		FEstimatorCore& Estimator = AHRS.Estimator;
+		Estimator.bInitialized = (R.Flags & FlightRecordEstimatorAligned) != 0;
+		if (Estimator.bInitialized)
+		{
+			Estimator.Rotation = LoadFlightRecordQuat(R.EstimatorRotation);
+			Estimator.Velocity = LoadFlightRecordVec3(R.EstimatorVelocity);
+			Estimator.Position = LoadFlightRecordVec3(R.EstimatorPosition);
+			Estimator.GyroBias = LoadFlightRecordVec3(R.EstimatorGyroBias);
+			Estimator.AccelerometerBias = LoadFlightRecordVec3(R.EstimatorAccelerometerBias);
+			Estimator.LoadCovariance(R.EstimatorCovariance);
+		}
+		Estimator.NumRejected = R.EstimatorRejected;
+
+		Attitude.AttitudeTargetQuat = LoadFlightRecordQuat(R.AttitudeTarget);
+		for (int a = 0; a < 3; a++)
+		{
+			Attitude.RatePid.Integral[a] = R.RateIntegral[a];
+			Attitude.RatePid.PreError[a] = R.RatePreError[a];
+			Attitude.RatePid.Derivative[a] = R.RateDerivative[a];
+		}
+
+		Position.PosTargetZ = R.PosTargetZ;
+		Position.bIsLockedZ = (R.Flags & FlightRecordPositionLockedZ) != 0;
+		Position.RateZPid.Integral[0] = R.RateZIntegral;
+		Position.RateZPid.PreError[0] = R.RateZPreError;
+		Position.RateZPid.Derivative[0] = R.RateZDerivative;
+		if (!(R.Flags & FlightRecordMultiRate))
+		{
+			// Single rate runs the Z controller before the position stage takes the step's DeltaTime (former order)
+			Position.DeltaTime = R.DeltaTime;
+		}
+
+		Engine.RotationRequest = LoadFlightRecordVec3(R.RotationRequest);
+		Engine.ThrottleRequest = R.ThrottleRequest;
+		for (int i = 0; i < MaxEngines; i++)
+		{
+			Engine.EngineMixPercent[i] = R.EngineMixPercent[i];
+			Engine.EngineSpeed[i] = R.EngineSpeed[i];
+		}
+		Engine.TotalThrust = LoadFlightRecordVec3(R.EngineThrust);
+		Engine.TotalTorque = LoadFlightRecordVec3(R.EngineTorque);
+
+		M.Scheduler->Accumulator = R.SchedulerAccumulator;
+		M.Scheduler->TickCount = R.SchedulerTickCount;
+	}
+
+
+
+	/*--- Read only view of a mapped (or loaded) recorder file ---*/
+	class FFlightRecordView
+	{
+	public:
+
+		// Returns false for foreign, newer or truncated files
+		bool Parse(const void* Data, size_t Size)
+		{
+			Header = nullptr;
+			Records = nullptr;
+			if (Size < sizeof(FFlightRecordFileHeader))
+			{
+				return false;
+			}
+
+			const FFlightRecordFileHeader* H = static_cast<const FFlightRecordFileHeader*>(Data);
+			if (H->Magic != FlightRecordMagic || H->Version != FlightRecordVersion || H->RecordBytes != sizeof(FFlightRecord))
+			{
+				return false;
+			}
+			if (H->HeaderBytes < sizeof(FFlightRecordFileHeader) || H->NumRecords > H->Capacity
+				|| H->HeaderBytes + H->NumRecords * H->RecordBytes > Size)
+			{
+				return false;
+			}
+
+			Header = H;
+			Records = reinterpret_cast<const FFlightRecord*>(static_cast<const uint8_t*>(Data) + H->HeaderBytes);
+			return true;
+		}
+
+		bool IsValid() const { return Header != nullptr; }
+		uint64_t Num() const { return Header ? Header->NumRecords : 0; }
+		uint64_t GetDropped() const { return Header ? Header->DroppedRecords : 0; }
+		const FFlightRecord& operator[](uint64_t Index) const { return Records[Index]; }
+
+	private:
+		const FFlightRecordFileHeader* Header = nullptr;
+		const FFlightRecord* Records = nullptr;
+	};
+
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "QFMCoreFlightRecord.h"
+#include "QFMCoreMappedFile.h"
+#include "QFMCoreTelemetry.h"
+
+
+namespace QFM
+{
+
+	/*--- Consumer side of the flight data recorder ---*/
+	// Producers (physics thread, game thread) push FFlightRecords into their ring, a few ns and never blocking.
+	// One flush thread calls Drain() in a loop: it copies the records into the mapped file, commits NumRecords
+	// and hands the written pages to the OS. Nothing here allocates after Open().
+	// Holds the rings inline (a few MB): allocate it on the heap.
+	class FFlightRecorderCore
+	{
+	public:
+
+		static constexpr int NumProducers = TelemetryProducerNum;
+
+		// The rings are aligned to 64, more than new guarantees before C++17 (and than some engine allocators):
+		// over-allocate and align here. The offset to the allocation is kept in the byte before the object
+		static void* operator new(size_t Size)
+		{
+			const size_t Alignment = alignof(FFlightRecorderCore);
+			uint8_t* Raw = static_cast<uint8_t*>(::operator new(Size + Alignment));
+			uint8_t* Aligned = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(Raw) + Alignment) & ~(uintptr_t)(Alignment - 1));
+			Aligned[-1] = static_cast<uint8_t>(Aligned - Raw);
+			return Aligned;
+		}
+
+		static void operator delete(void* Ptr)
+		{
+			if (Ptr)
+			{
+				uint8_t* Aligned = static_cast<uint8_t*>(Ptr);
+				::operator delete(Aligned - Aligned[-1]);
+			}
+		}
+
+		// Preallocates the file for Capacity records. Only while no flush thread runs
+		bool Open(const char* Path, uint64_t Capacity)
+		{
+			Close();
+			if (Capacity == 0 || !File.Create(Path, FlightRecordHeaderBytes + static_cast<size_t>(Capacity) * sizeof(FFlightRecord)))
+			{
+				return false;
+			}
+
+			Header = static_cast<FFlightRecordFileHeader*>(File.GetData());
+			*Header = FFlightRecordFileHeader();
+			Header->RecordBytes = sizeof(FFlightRecord);
+			Header->Capacity = Capacity;
+			Records = reinterpret_cast<FFlightRecord*>(static_cast<uint8_t*>(File.GetData()) + FlightRecordHeaderBytes);
+			NumRecords = 0;
+			FlushedRecords = 0;
+			DroppedRecords = 0;
+			CommittedDroppedRecords = 0;
+			for (int i = 0; i < NumProducers; i++)
+			{
+				RingDropsAtOpen[i] = Rings[i].GetDropped();
+			}
+			return true;
+		}
+
+		// Writes the final header and unmaps. Only while no flush thread runs
+		void Close()
+		{
+			if (!Header)
+			{
+				return;
+			}
+			Drain();
+			Commit();
+			File.FlushAsync(0, FlightRecordHeaderBytes + static_cast<size_t>(NumRecords) * sizeof(FFlightRecord));
+			File.Close();
+			Header = nullptr;
+			Records = nullptr;
+		}
+
+		bool IsOpen() const { return Header != nullptr; }
+
+
+		/*--- Producer side ---*/
+
+		bool Push(ETelemetryProducer Producer, const FFlightRecord& Record)
+		{
+			return Rings[Producer].Push(Record);
+		}
+
+		FFlightRecordRing* GetRing(ETelemetryProducer Producer) { return &Rings[Producer]; }
+
+
+		/*--- Flush thread side ---*/
+
+		// Copy everything queued into the file. Returns the number of records taken from the rings
+		uint32_t Drain()
+		{
+			uint32_t Total = 0;
+			for (FFlightRecordRing& Ring : Rings)
+			{
+				uint32_t Count;
+				while ((Count = Ring.Pop(Batch, BatchSize)) > 0)
+				{
+					Total += Count;
+					if (!Header)
+					{
+						continue;
+					}
+					const uint64_t Room = Header->Capacity - NumRecords;
+					const uint32_t Fit = Count < Room ? Count : static_cast<uint32_t>(Room);
+					std::memcpy(Records + NumRecords, Batch, Fit * sizeof(FFlightRecord));
+					NumRecords += Fit;
+					DroppedRecords += Count - Fit;
+				}
+			}
+			return Total;
+		}
+
+		// Publish the written records in the header and start writing their pages back
+		void Commit()
+		{
+			if (!Header)
+			{
+				return;
+			}
+			uint64_t RingDrops = 0;
+			for (int i = 0; i < NumProducers; i++)
+			{
+				RingDrops += Rings[i].GetDropped() - RingDropsAtOpen[i];
+			}
+			CommittedDroppedRecords = DroppedRecords + RingDrops;
+			Header->DroppedRecords = CommittedDroppedRecords;
+			Header->NumRecords = NumRecords;
+
+			const size_t Offset = FlightRecordHeaderBytes + static_cast<size_t>(FlushedRecords) * sizeof(FFlightRecord);
+			File.FlushAsync(Offset, static_cast<size_t>(NumRecords - FlushedRecords) * sizeof(FFlightRecord));
+			File.FlushAsync(0, FlightRecordHeaderBytes);
+			FlushedRecords = NumRecords;
+		}
+
+		uint64_t GetNumRecords() const { return NumRecords; }
+		uint64_t GetCapacity() const { return Header ? Header->Capacity : 0; }
+		uint64_t GetDroppedRecords() const { return CommittedDroppedRecords; }
+
+
+	private:
+
+		static constexpr uint32_t BatchSize = 256;
+
+		FFlightRecordRing Rings[NumProducers];
+		uint64_t RingDropsAtOpen[NumProducers] = {};
+
+		// Flush thread only
+		FMappedFile File;
+		FFlightRecordFileHeader* Header = nullptr;
+		FFlightRecord* Records = nullptr;
+		uint64_t NumRecords = 0;
+		uint64_t FlushedRecords = 0;
+		uint64_t DroppedRecords = 0;
+		uint64_t CommittedDroppedRecords = 0;
+		FFlightRecord Batch[BatchSize];
+	};
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "QFMCoreTypes.h"
+
+
+namespace QFM
+{
+
+	/*--- Pilot Input mapping ---*/
+	struct FInputCore
+	{
+		// Raw stick values as delivered by the input system
+		float RollAxisInput = 0.0f;
+		float PitchAxisInput = 0.0f;
+		float YawAxisInput = 0.0f;
+		float ThrottleAxisInput = 0.0f;
+
+		// Min/Max values of the sticks
+		FVec2 RollAxisInputInterval = FVec2(-1.0f, 1.0f);
+		FVec2 PitchAxisInputInterval = FVec2(-1.0f, 1.0f);
+		FVec2 YawAxisInputInterval = FVec2(-1.0f, 1.0f);
+		FVec2 ThrottleAxisInputInterval = FVec2(-1.0f, 1.0f);
+
+		// Scale Axis R,P,Y,T. Negative to invert
+		FVec4 InputAxisScale = FVec4(-1.0f, -1.0f, 1.0f, 1.0f);
+
+		// Resulting Desired PilotInput (R,P,Y: -1..1, T 0..1)
+		FVec4 DesiredPilotInput;
+
+		float DeltaTime = 0.0f;
+
+
+		void Reset()
+		{
+			DesiredPilotInput = FVec4(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+
+
+		void Tock(float DeltaTimeIn)
+		{
+			DeltaTime = DeltaTimeIn;
+
+			// Convert Pilot Input to standard intervals (R,P,Y: -1..1, T 0..1)
+			DesiredPilotInput = FVec4(
+				GetMappedAndClampedValueNormal(RollAxisInputInterval, RollAxisInput * InputAxisScale.X),
+				GetMappedAndClampedValueNormal(PitchAxisInputInterval, PitchAxisInput * InputAxisScale.Y),
+				GetMappedAndClampedValueNormal(YawAxisInputInterval, YawAxisInput * InputAxisScale.Z),
+				GetMappedAndClampedValueNormal(ThrottleAxisInputInterval, ThrottleAxisInput * InputAxisScale.W)
+			);
+
+			// Normalize Throttle input to [0..1]
+			DesiredPilotInput.W = DesiredPilotInput.W / 2.0f + 0.5f;
+		}
+
+
+		FVec4 GetDesiredInput() const
+		{
+			return DesiredPilotInput;
+		}
+
+		float GetThrottleMidStick() const
+		{
+			return 0.5f;
+		}
+
+		// Helper Function to Map Pilot Input to [-1..1]
+		static float GetMappedAndClampedValueNormal(const FVec2& InputRange, const float Value)
+		{
+			return ((Value - InputRange.X) / (InputRange.Y - InputRange.X)) * 2.0f - 1.0f;
+		}
+
+		// Inverse of the mapping in Tock: raw stick value that gives Desired (-1..1) on an axis with Scale
+		static float GetRawValueForDesired(const FVec2& InputRange, float Scale, float Desired)
+		{
+			return ((Desired + 1.0f) * 0.5f * (InputRange.Y - InputRange.X) + InputRange.X) / Scale;
+		}
+
+		// Helper Function to Map Pilot Input to [OutRange]
+		static float GetMappedAndClampedValue(const FVec2& InputRange, const FVec2& OutputRange, const float Value)
+		{
+			return ((Value - InputRange.X) / (InputRange.Y - InputRange.X)) * (OutputRange.Y - OutputRange.X) + OutputRange.X;
+		}
+	};
+
+}
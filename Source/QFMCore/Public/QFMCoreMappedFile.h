@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+// Pulls in the platform headers: include it only from translation units that map files.
+// Unreal code wraps it in Windows/AllowWindowsPlatformTypes.h, see QFMFlightRecorder.cpp
+
+namespace QFM
+{
+
+	/*--- File mapped into memory, read only or read / write with a fixed size ---*/
+	class FMappedFile
+	{
+	public:
+
+		FMappedFile() {}
+		~FMappedFile() { Close(); }
+
+		FMappedFile(const FMappedFile&) = delete;
+		FMappedFile& operator=(const FMappedFile&) = delete;
+
+
+		// Create (or truncate) Path with Bytes allocated on disk and map it writable
+		bool Create(const char* Path, size_t Bytes)
+		{
+			Close();
+#if defined(_WIN32)
+			File = CreateFileA(Path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (File == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+			LARGE_INTEGER FileSize;
+			FileSize.QuadPart = static_cast<LONGLONG>(Bytes);
+			Mapping = CreateFileMappingA(File, nullptr, PAGE_READWRITE, FileSize.HighPart, FileSize.LowPart, nullptr);
+			Data = Mapping ? MapViewOfFile(Mapping, FILE_MAP_WRITE, 0, 0, Bytes) : nullptr;
+#else
+			Fd = open(Path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if (Fd < 0)
+			{
+				return false;
+			}
+			// Blocks on disk now, not page by page while recording. ftruncate alone leaves a sparse file
+	#if defined(__linux__)
+			if (posix_fallocate(Fd, 0, static_cast<off_t>(Bytes)) != 0 && ftruncate(Fd, static_cast<off_t>(Bytes)) != 0)
+	#else
+			if (ftruncate(Fd, static_cast<off_t>(Bytes)) != 0)
+	#endif
+			{
+				Close();
+				return false;
+			}
+			void* Mapped = mmap(nullptr, Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0);
+			Data = Mapped != MAP_FAILED ? Mapped : nullptr;
+#endif
+			Size = Bytes;
+			if (!Data)
+			{
+				Close();
+				return false;
+			}
+			return true;
+		}
+
+
+		// Map an existing file read only
+		bool OpenRead(const char* Path)
+		{
+			Close();
+#if defined(_WIN32)
+			File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			LARGE_INTEGER FileSize;
+			if (File == INVALID_HANDLE_VALUE || !GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+			{
+				Close();
+				return false;
+			}
+			Size = static_cast<size_t>(FileSize.QuadPart);
+			Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			Data = Mapping ? MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+			Fd = open(Path, O_RDONLY);
+			struct stat Stat;
+			if (Fd < 0 || fstat(Fd, &Stat) != 0 || Stat.st_size == 0)
+			{
+				Close();
+				return false;
+			}
+			Size = static_cast<size_t>(Stat.st_size);
+			void* Mapped = mmap(nullptr, Size, PROT_READ, MAP_SHARED, Fd, 0);
+			Data = Mapped != MAP_FAILED ? Mapped : nullptr;
+#endif
+			if (!Data)
+			{
+				Close();
+				return false;
+			}
+			return true;
+		}
+
+
+		// Start writing dirty pages back, without waiting for them
+		void FlushAsync(size_t Offset, size_t Bytes)
+		{
+			if (!Data || Bytes == 0)
+			{
+				return;
+			}
+#if defined(_WIN32)
+			FlushViewOfFile(static_cast<uint8_t*>(Data) + Offset, Bytes);
+#else
+			// msync wants a page aligned start
+			const size_t PageMask = static_cast<size_t>(sysconf(_SC_PAGESIZE)) - 1;
+			const size_t Start = Offset & ~PageMask;
+			msync(static_cast<uint8_t*>(Data) + Start, Offset + Bytes - Start, MS_ASYNC);
+#endif
+		}
+
+
+		void Close()
+		{
+#if defined(_WIN32)
+			if (Data) { UnmapViewOfFile(Data); }
+			if (Mapping) { CloseHandle(Mapping); }
+			if (File != INVALID_HANDLE_VALUE) { CloseHandle(File); }
+			Mapping = nullptr;
+			File = INVALID_HANDLE_VALUE;
+#else
+			if (Data) { munmap(Data, Size); }
+			if (Fd >= 0) { close(Fd); }
+			Fd = -1;
+#endif
+			Data = nullptr;
+			Size = 0;
+		}
+
+		bool IsOpen() const { return Data != nullptr; }
+		void* GetData() const { return Data; }
+		size_t GetSize() const { return Size; }
+
+	private:
+		void* Data = nullptr;
+		size_t Size = 0;
+#if defined(_WIN32)
+		HANDLE File = INVALID_HANDLE_VALUE;
+		HANDLE Mapping = nullptr;
+#else
+		int Fd = -1;
+#endif
+	};
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreSimd.h"
+
+
+namespace QFM
+{
+
+	/*--- Fixed size matrix ---*/
+	// Rows x Cols floats in place, no heap. Rows are padded to a multiple of SimdWidth (the padding stays 0), so a row
+	// can be processed in FSimdFloat lanes with LoadUnaligned / StoreUnaligned. The products are plain loops for small
+	// matrices and references: hot paths with a known sparsity (QFMCoreEstimator.h) work on the rows directly.
+	template <int NumRows, int NumCols>
+	struct TMatrix
+	{
+		static constexpr int Rows = NumRows;
+		static constexpr int Cols = NumCols;
+		static constexpr int Stride = (NumCols + SimdWidth - 1) / SimdWidth * SimdWidth;
+
+		float M[NumRows][Stride] = {};
+
+
+		float& operator()(int Row, int Col) { return M[Row][Col]; }
+		float operator()(int Row, int Col) const { return M[Row][Col]; }
+
+		static TMatrix Zero() { return TMatrix(); }
+
+		static TMatrix Identity()
+		{
+			TMatrix Out;
+			for (int i = 0; i < NumRows && i < NumCols; i++)
+			{
+				Out.M[i][i] = 1.0f;
+			}
+			return Out;
+		}
+
+		TMatrix operator+(const TMatrix& B) const
+		{
+			TMatrix Out;
+			for (int r = 0; r < NumRows; r++)
+			{
+				for (int c = 0; c < NumCols; c++)
+				{
+					Out.M[r][c] = M[r][c] + B.M[r][c];
+				}
+			}
+			return Out;
+		}
+
+		TMatrix operator-(const TMatrix& B) const
+		{
+			TMatrix Out;
+			for (int r = 0; r < NumRows; r++)
+			{
+				for (int c = 0; c < NumCols; c++)
+				{
+					Out.M[r][c] = M[r][c] - B.M[r][c];
+				}
+			}
+			return Out;
+		}
+
+		TMatrix operator*(float S) const
+		{
+			TMatrix Out;
+			for (int r = 0; r < NumRows; r++)
+			{
+				for (int c = 0; c < NumCols; c++)
+				{
+					Out.M[r][c] = M[r][c] * S;
+				}
+			}
+			return Out;
+		}
+
+		template <int OtherCols>
+		TMatrix<NumRows, OtherCols> operator*(const TMatrix<NumCols, OtherCols>& B) const
+		{
+			TMatrix<NumRows, OtherCols> Out;
+			for (int r = 0; r < NumRows; r++)
+			{
+				for (int k = 0; k < NumCols; k++)
+				{
+					const float A = M[r][k];
+					for (int c = 0; c < OtherCols; c++)
+					{
+						Out.M[r][c] += A * B.M[k][c];
+					}
+				}
+			}
+			return Out;
+		}
+
+		TMatrix<NumCols, NumRows> Transposed() const
+		{
+			TMatrix<NumCols, NumRows> Out;
+			for (int r = 0; r < NumRows; r++)
+			{
+				for (int c = 0; c < NumCols; c++)
+				{
+					Out.M[c][r] = M[r][c];
+				}
+			}
+			return Out;
+		}
+
+		// Square only: mean of the matrix and its transpose, written to both halves, so it is exactly symmetric
+		void Symmetrize()
+		{
+			static_assert(NumRows == NumCols, "Symmetrize needs a square matrix");
+			for (int r = 0; r < NumRows; r++)
+			{
+				for (int c = r + 1; c < NumCols; c++)
+				{
+					const float Mean = 0.5f * (M[r][c] + M[c][r]);
+					M[r][c] = Mean;
+					M[c][r] = Mean;
+				}
+			}
+		}
+	};
+
+	typedef TMatrix<3, 3> FMatrix3;
+
+
+	// Rotation matrix of Q: M * V == Q.RotateVector(V)
+	inline FMatrix3 RotationMatrix(const FQuatf& Q)
+	{
+		const float XX = Q.X * Q.X, YY = Q.Y * Q.Y, ZZ = Q.Z * Q.Z;
+		const float XY = Q.X * Q.Y, XZ = Q.X * Q.Z, YZ = Q.Y * Q.Z;
+		const float WX = Q.W * Q.X, WY = Q.W * Q.Y, WZ = Q.W * Q.Z;
+
+		FMatrix3 Out;
+		Out.M[0][0] = 1.0f - 2.0f * (YY + ZZ); Out.M[0][1] = 2.0f * (XY - WZ); Out.M[0][2] = 2.0f * (XZ + WY);
+		Out.M[1][0] = 2.0f * (XY + WZ); Out.M[1][1] = 1.0f - 2.0f * (XX + ZZ); Out.M[1][2] = 2.0f * (YZ - WX);
+		Out.M[2][0] = 2.0f * (XZ - WY); Out.M[2][1] = 2.0f * (YZ + WX); Out.M[2][2] = 1.0f - 2.0f * (XX + YY);
+		return Out;
+	}
+
+}
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <cmath>
+
+#include "QFMCoreTypes.h"
+
+
+namespace QFM
+{
+
+	// Roll right = +
+	// pitch down = +
+	// yaw right = +
+
+	constexpr int MaxEngines = 8;
+
+	// Rows of a wrench / columns of a mixer: Throttle (thrust along body Z), Roll, Pitch, Yaw
+	constexpr int NumWrenchAxes = 4;
+
+
+
+	/*--- Motor geometry ---*/
+
+	struct FMotorGeometry
+	{
+		FVec3 Position;							// in m, body space (X forward, Y right, Z up)
+		FVec3 ThrustAxis = FVec3(0.0f, 0.0f, 1.0f);	// unit vector, body space
+		float SpinDirection = 1.0f;				// +1: reaction torque yaws right, -1: yaws left
+	};
+
+
+	struct FFrameGeometry
+	{
+		int NumMotors = 0;
+		FMotorGeometry Motors[MaxEngines];
+
+
+		// Motor on an arm AngleDeg clockwise from forward (seen from above), Height above the arm plane
+		void AddMotor(float AngleDeg, float ArmLength, float SpinDirection, float Height = 0.0f)
+		{
+			if (NumMotors >= MaxEngines)
+			{
+				return;
+			}
+			const float Angle = DegreesToRadians(AngleDeg);
+			FMotorGeometry& Motor = Motors[NumMotors++];
+			Motor.Position = FVec3(SnapToZero(std::cos(Angle)) * ArmLength, SnapToZero(std::sin(Angle)) * ArmLength, Height);
+			Motor.ThrustAxis = FVec3(0.0f, 0.0f, 1.0f);
+			Motor.SpinDirection = SpinDirection;
+		}
+
+		void AddMotor(const FMotorGeometry& Motor)
+		{
+			if (NumMotors < MaxEngines)
+			{
+				Motors[NumMotors++] = Motor;
+			}
+		}
+
+	private:
+
+		// cos(90 deg) is not exactly 0 in float
+		static float SnapToZero(float X)
+		{
+			return std::fabs(X) < 1.e-6f ? 0.0f : X;
+		}
+	};
+
+
+	// Preset frames, motor 1 first then clockwise. Same motor order and spin as the former quad mixer tables.
+	// Custom returns an empty frame, the caller fills it.
+	inline FFrameGeometry MakeFrameGeometry(EFrameMode FrameMode, float ArmLength)
+	{
+		FFrameGeometry Frame;
+		const float CoaxHeight = 0.1f * ArmLength;
+
+		switch (FrameMode)
+		{
+		case EFrameMode::Cross:
+			Frame.AddMotor(45.0f, ArmLength, -1.0f);		// RF
+			Frame.AddMotor(135.0f, ArmLength, +1.0f);		// RB
+			Frame.AddMotor(225.0f, ArmLength, -1.0f);		// LB
+			Frame.AddMotor(315.0f, ArmLength, +1.0f);		// LF
+			break;
+
+		case EFrameMode::Plus:
+			Frame.AddMotor(0.0f, ArmLength, -1.0f);			// F
+			Frame.AddMotor(90.0f, ArmLength, +1.0f);		// R
+			Frame.AddMotor(180.0f, ArmLength, -1.0f);		// B
+			Frame.AddMotor(270.0f, ArmLength, +1.0f);		// L
+			break;
+
+		case EFrameMode::HexaX:
+			for (int i = 0; i < 6; i++)
+			{
+				Frame.AddMotor(30.0f + 60.0f * i, ArmLength, (i & 1) ? +1.0f : -1.0f);
+			}
+			break;
+
+		case EFrameMode::OctoX:
+			for (int i = 0; i < 8; i++)
+			{
+				Frame.AddMotor(22.5f + 45.0f * i, ArmLength, (i & 1) ? +1.0f : -1.0f);
+			}
+			break;
+
+		case EFrameMode::CoaxX8:
+			// Cross quad arms, upper and lower motor spin against each other
+			for (int i = 0; i < 4; i++)
+			{
+				const float Spin = (i & 1) ? +1.0f : -1.0f;
+				Frame.AddMotor(45.0f + 90.0f * i, ArmLength, Spin, CoaxHeight);
+				Frame.AddMotor(45.0f + 90.0f * i, ArmLength, -Spin, -CoaxHeight);
+			}
+			break;
+
+		case EFrameMode::Y6:
+			// Two front arms, one rear arm, coaxial pairs
+			{
+				const float Angles[3] = { 60.0f, 180.0f, 300.0f };
+				for (int i = 0; i < 3; i++)
+				{
+					Frame.AddMotor(Angles[i], ArmLength, -1.0f, CoaxHeight);
+					Frame.AddMotor(Angles[i], ArmLength, +1.0f, -CoaxHeight);
+				}
+			}
+			break;
+
+		case EFrameMode::Custom:
+			break;
+		}
+		return Frame;
+	}
+
+
+
+	/*--- Control allocation ---*/
+	// Compiled once from the frame geometry: the effectiveness matrix (motor outputs -> wrench) and
+	// the mixer (wrench request -> motor commands) derived from its pseudo-inverse.
+	// Per step both directions are a small dense matrix-vector product, no trig and no branching on the frame.
+	struct FControlAllocation
+	{
+		int NumMotors = 0;
+
+		// Wrench per unit of speed^Engine_Q (thrust, lever arm torques) and per unit of speed^Engine_QQ (reaction torque).
+		// Geometry only, see SetCoefficients for the scaled versions
+		float UnitThrust[NumWrenchAxes][MaxEngines] = {};
+		float UnitDrag[NumWrenchAxes][MaxEngines] = {};
+
+		// Scaled by Engine_K and Engine_B
+		float ThrustEffect[NumWrenchAxes][MaxEngines] = {};
+		float DragEffect[NumWrenchAxes][MaxEngines] = {};
+		float WrenchEffect[NumWrenchAxes][MaxEngines] = {};	// sum of both, for Engine_Q == Engine_QQ
+
+		// Motor command per unit Throttle/Roll/Pitch/Yaw request. Columns scaled to a max factor of 1,
+		// which gives exactly the former +-1 tables for quads
+		float Mixer[MaxEngines][NumWrenchAxes] = {};
+
+		float K = 0.0f;
+		float B = 0.0f;
+
+
+		void Compile(const FFrameGeometry& Frame, float EngineK, float EngineB)
+		{
+			NumMotors = Frame.NumMotors;
+
+			for (int i = 0; i < MaxEngines; i++)
+			{
+				for (int r = 0; r < NumWrenchAxes; r++)
+				{
+					UnitThrust[r][i] = 0.0f;
+					UnitDrag[r][i] = 0.0f;
+				}
+			}
+
+			for (int i = 0; i < NumMotors; i++)
+			{
+				const FMotorGeometry& Motor = Frame.Motors[i];
+
+				// Lever arm torque r x F, and the reaction torque along the thrust axis.
+				// To control axes: positive X torque rolls left, so roll flips sign
+				const FVec3 Lever = FVec3::Cross(Motor.Position, Motor.ThrustAxis);
+				const FVec3 Reaction = Motor.ThrustAxis * Motor.SpinDirection;
+
+				UnitThrust[0][i] = Motor.ThrustAxis.Z;
+				UnitThrust[1][i] = -Lever.X;
+				UnitThrust[2][i] = Lever.Y;
+				UnitThrust[3][i] = Lever.Z;
+
+				UnitDrag[1][i] = -Reaction.X;
+				UnitDrag[2][i] = Reaction.Y;
+				UnitDrag[3][i] = Reaction.Z;
+			}
+
+			SetCoefficients(EngineK, EngineB);
+		}
+
+
+		// Rescale the effectiveness and rebuild the mixer. Only needed when K or B change
+		void SetCoefficients(float EngineK, float EngineB)
+		{
+			K = EngineK;
+			B = EngineB;
+
+			for (int r = 0; r < NumWrenchAxes; r++)
+			{
+				for (int i = 0; i < MaxEngines; i++)
+				{
+					ThrustEffect[r][i] = UnitThrust[r][i] * K;
+					DragEffect[r][i] = UnitDrag[r][i] * B;
+					WrenchEffect[r][i] = ThrustEffect[r][i] + DragEffect[r][i];
+				}
+			}
+
+			BuildMixer();
+		}
+
+
+		// Motor commands for a Throttle/Roll/Pitch/Yaw request
+		void Mix(const float Request[NumWrenchAxes], float* Out) const
+		{
+			for (int i = 0; i < NumMotors; i++)
+			{
+				Out[i] = Mixer[i][0] * Request[0] + Mixer[i][1] * Request[1] + Mixer[i][2] * Request[2] + Mixer[i][3] * Request[3];
+			}
+		}
+
+
+		// Wrench from per motor speed^Engine_Q and speed^Engine_QQ
+		void Evaluate(const float* SpeedToThrust, const float* SpeedToTorque, float Wrench[NumWrenchAxes]) const
+		{
+			for (int r = 0; r < NumWrenchAxes; r++)
+			{
+				float Sum = 0.0f;
+				for (int i = 0; i < NumMotors; i++)
+				{
+					Sum += ThrustEffect[r][i] * SpeedToThrust[i] + DragEffect[r][i] * SpeedToTorque[i];
+				}
+				Wrench[r] = Sum;
+			}
+		}
+
+		// Same, when thrust and torque share the exponent
+		void Evaluate(const float* SpeedToThrust, float Wrench[NumWrenchAxes]) const
+		{
+			for (int r = 0; r < NumWrenchAxes; r++)
+			{
+				float Sum = 0.0f;
+				for (int i = 0; i < NumMotors; i++)
+				{
+					Sum += WrenchEffect[r][i] * SpeedToThrust[i];
+				}
+				Wrench[r] = Sum;
+			}
+		}
+
+		// Thrust only, from per motor speed^Engine_Q
+		float EvaluateThrust(const float* SpeedToThrust) const
+		{
+			float Sum = 0.0f;
+			for (int i = 0; i < NumMotors; i++)
+			{
+				Sum += ThrustEffect[0][i] * SpeedToThrust[i];
+			}
+			return Sum;
+		}
+
+
+	private:
+
+		// Mixer = pinv(E) = E^T (E E^T)^-1, columns normalized. A frame that cannot produce an axis
+		// (singular E E^T) gets a slightly damped inverse and a zero column for that axis
+		void BuildMixer()
+		{
+			float A[NumWrenchAxes][NumWrenchAxes];
+			float Trace = 0.0f;
+			for (int r = 0; r < NumWrenchAxes; r++)
+			{
+				for (int c = 0; c < NumWrenchAxes; c++)
+				{
+					float Sum = 0.0f;
+					for (int i = 0; i < NumMotors; i++)
+					{
+						Sum += WrenchEffect[r][i] * WrenchEffect[c][i];
+					}
+					A[r][c] = Sum;
+				}
+				Trace += A[r][r];
+			}
+			const float Damping = 1.e-6f * (Trace > 0.0f ? Trace : 1.0f);
+			for (int r = 0; r < NumWrenchAxes; r++)
+			{
+				A[r][r] += Damping;
+			}
+
+			// Solve A X = E with Gauss-Jordan, X is the transposed pseudo-inverse
+			float X[NumWrenchAxes][MaxEngines];
+			for (int r = 0; r < NumWrenchAxes; r++)
+			{
+				for (int i = 0; i < MaxEngines; i++)
+				{
+					X[r][i] = WrenchEffect[r][i];
+				}
+			}
+			for (int p = 0; p < NumWrenchAxes; p++)
+			{
+				int Pivot = p;
+				for (int r = p + 1; r < NumWrenchAxes; r++)
+				{
+					if (std::fabs(A[r][p]) > std::fabs(A[Pivot][p])) { Pivot = r; }
+				}
+				if (Pivot != p)
+				{
+					for (int c = 0; c < NumWrenchAxes; c++) { const float T = A[p][c]; A[p][c] = A[Pivot][c]; A[Pivot][c] = T; }
+					for (int i = 0; i < MaxEngines; i++) { const float T = X[p][i]; X[p][i] = X[Pivot][i]; X[Pivot][i] = T; }
+				}
+
+				const float InvPivot = 1.0f / A[p][p];
+				for (int c = 0; c < NumWrenchAxes; c++) { A[p][c] *= InvPivot; }
+				for (int i = 0; i < MaxEngines; i++) { X[p][i] *= InvPivot; }
+
+				for (int r = 0; r < NumWrenchAxes; r++)
+				{
+					const float F = A[r][p];
+					if (r == p || F == 0.0f)
+					{
+						continue;
+					}
+					for (int c = 0; c < NumWrenchAxes; c++) { A[r][c] -= F * A[p][c]; }
+					for (int i = 0; i < MaxEngines; i++) { X[r][i] -= F * X[p][i]; }
+				}
+			}
+
+			for (int c = 0; c < NumWrenchAxes; c++)
+			{
+				float MaxFactor = 0.0f;
+				for (int i = 0; i < NumMotors; i++)
+				{
+					MaxFactor = std::fmax(MaxFactor, std::fabs(X[c][i]));
+				}
+				const float Scale = MaxFactor > 1.e-6f ? 1.0f / MaxFactor : 0.0f;
+				for (int i = 0; i < MaxEngines; i++)
+				{
+					Mixer[i][c] = i < NumMotors ? X[c][i] * Scale : 0.0f;
+				}
+			}
+		}
+	};
+
+}
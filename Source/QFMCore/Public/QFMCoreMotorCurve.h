@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cmath>
+
+#include "QFMCoreTypes.h"
+
+
+namespace QFM
+{
+
+	/*--- One point of a measured static thrust curve ---*/
+	struct FMotorCurvePoint
+	{
+		float RPM = 0.0f;
+		float Thrust = 0.0f;		// in N
+		float Torque = 0.0f;		// reaction torque in N*m
+	};
+
+	constexpr int MaxMotorCurvePoints = 32;
+
+
+
+	/*--- Motor thrust and torque over normalized speed 0..1 ---*/
+	// Baked once into uniformly sampled tables, evaluated for all motors of a frame per step.
+	// Parametric curves give speed^Engine_Q and speed^Engine_QQ (scaled by Engine_K / Engine_B in the mixer),
+	// measured curves give N and N*m directly (mixer scale 1).
+	// Exponent exactly 2 skips the table: speed * speed.
+	struct FMotorCurve
+	{
+		static constexpr int NumIntervals = 256;
+		static constexpr int NumSamples = NumIntervals + 1;
+
+		float ThrustTable[NumSamples + 1] = {};	// one extra sample so speed 1 needs no clamp of the upper index
+		float TorqueTable[NumSamples + 1] = {};
+
+		bool bQuadraticThrust = true;
+		bool bQuadraticTorque = true;
+		bool bMeasured = false;
+
+		// What the tables were baked from
+		float Q = 2.0f;
+		float QQ = 2.0f;
+
+
+		void BakeParametric(float EngineQ, float EngineQQ)
+		{
+			Q = EngineQ;
+			QQ = EngineQQ;
+			bMeasured = false;
+			bQuadraticThrust = (Q == 2.0f);
+			bQuadraticTorque = (QQ == 2.0f);
+
+			for (int i = 0; i < NumSamples; i++)
+			{
+				const float Speed = static_cast<float>(i) / NumIntervals;
+				ThrustTable[i] = std::pow(Speed, Q);
+				TorqueTable[i] = std::pow(Speed, QQ);
+			}
+			ThrustTable[NumSamples] = ThrustTable[NumIntervals];
+			TorqueTable[NumSamples] = TorqueTable[NumIntervals];
+		}
+
+
+		// Points sorted by RPM. Resampled with a monotone cubic (Fritsch-Carlson), so bench data with few points
+		// does not get kinks between them. Below the first point thrust and torque fall linearly to 0 at 0 RPM,
+		// above the last one they are held.
+		bool BakeMeasured(const FMotorCurvePoint* Points, int NumPoints, float MaxRPM)
+		{
+			if (NumPoints < 2 || MaxRPM <= 0.0f)
+			{
+				return false;
+			}
+			NumPoints = NumPoints < MaxMotorCurvePoints ? NumPoints : MaxMotorCurvePoints;
+
+			Q = 0.0f;
+			QQ = 0.0f;
+			bMeasured = true;
+			bQuadraticThrust = false;
+			bQuadraticTorque = false;
+
+			float Slope[2][MaxMotorCurvePoints];
+			for (int k = 0; k < 2; k++)
+			{
+				MonotoneSlopes(Points, NumPoints, k, Slope[k]);
+			}
+
+			for (int i = 0; i < NumSamples; i++)
+			{
+				const float RPM = MaxRPM * i / NumIntervals;
+				ThrustTable[i] = Resample(Points, NumPoints, Slope[0], 0, RPM);
+				TorqueTable[i] = Resample(Points, NumPoints, Slope[1], 1, RPM);
+			}
+			ThrustTable[NumSamples] = ThrustTable[NumIntervals];
+			TorqueTable[NumSamples] = TorqueTable[NumIntervals];
+			return true;
+		}
+
+
+		// Thrust and torque factors of NumMotors speeds (0..1). Linear interpolation, no branches per motor
+		void Evaluate(const float* Speed, int NumMotors, float* OutThrust, float* OutTorque) const
+		{
+			Lookup(ThrustTable, bQuadraticThrust, Speed, NumMotors, OutThrust);
+			Lookup(TorqueTable, bQuadraticTorque, Speed, NumMotors, OutTorque);
+		}
+
+		void EvaluateThrust(const float* Speed, int NumMotors, float* OutThrust) const
+		{
+			Lookup(ThrustTable, bQuadraticThrust, Speed, NumMotors, OutThrust);
+		}
+
+		// Torque uses the same curve, one lookup is enough
+		bool IsTorqueSameAsThrust() const
+		{
+			return !bMeasured && Q == QQ;
+		}
+
+
+		// Speed (0..1) that gives Thrust, by inverting the table. Thrust in table units
+		float InverseThrust(float Thrust) const
+		{
+			if (!bMeasured)
+			{
+				return std::pow(Thrust, 1.0f / Q);
+			}
+			if (Thrust <= ThrustTable[0])
+			{
+				return 0.0f;
+			}
+			for (int i = 1; i < NumSamples; i++)
+			{
+				if (ThrustTable[i] >= Thrust)
+				{
+					const float Alpha = (Thrust - ThrustTable[i - 1]) / (ThrustTable[i] - ThrustTable[i - 1]);
+					return (i - 1 + Alpha) / NumIntervals;
+				}
+			}
+			return 1.0f;
+		}
+
+
+	private:
+
+		static void Lookup(const float* Table, bool bQuadratic, const float* Speed, int NumMotors, float* Out)
+		{
+			if (bQuadratic)
+			{
+				for (int i = 0; i < NumMotors; i++)
+				{
+					Out[i] = Speed[i] * Speed[i];
+				}
+				return;
+			}
+			for (int i = 0; i < NumMotors; i++)
+			{
+				const float X = Clamp(Speed[i], 0.0f, 1.0f) * NumIntervals;
+				const int Index = static_cast<int>(X);
+				const float Alpha = X - Index;
+				Out[i] = Table[Index] + Alpha * (Table[Index + 1] - Table[Index]);
+			}
+		}
+
+
+		static float Value(const FMotorCurvePoint& P, int Which)
+		{
+			return Which == 0 ? P.Thrust : P.Torque;
+		}
+
+		static void MonotoneSlopes(const FMotorCurvePoint* Points, int NumPoints, int Which, float* Slope)
+		{
+			float Secant[MaxMotorCurvePoints] = {};
+			for (int i = 0; i < NumPoints - 1; i++)
+			{
+				const float H = Points[i + 1].RPM - Points[i].RPM;
+				Secant[i] = H > 0.0f ? (Value(Points[i + 1], Which) - Value(Points[i], Which)) / H : 0.0f;
+			}
+
+			Slope[0] = Secant[0];
+			Slope[NumPoints - 1] = Secant[NumPoints - 2];
+			for (int i = 1; i < NumPoints - 1; i++)
+			{
+				Slope[i] = (Secant[i - 1] * Secant[i] <= 0.0f) ? 0.0f : 0.5f * (Secant[i - 1] + Secant[i]);
+			}
+
+			for (int i = 0; i < NumPoints - 1; i++)
+			{
+				if (Secant[i] == 0.0f)
+				{
+					Slope[i] = 0.0f;
+					Slope[i + 1] = 0.0f;
+					continue;
+				}
+				const float A = Slope[i] / Secant[i];
+				const float B = Slope[i + 1] / Secant[i];
+				const float S = A * A + B * B;
+				if (S > 9.0f)
+				{
+					const float T = 3.0f / std::sqrt(S);
+					Slope[i] = T * A * Secant[i];
+					Slope[i + 1] = T * B * Secant[i];
+				}
+			}
+		}
+
+		static float Resample(const FMotorCurvePoint* Points, int NumPoints, const float* Slope, int Which, float RPM)
+		{
+			if (RPM <= Points[0].RPM)
+			{
+				return Points[0].RPM > 0.0f ? Value(Points[0], Which) * RPM / Points[0].RPM : Value(Points[0], Which);
+			}
+			if (RPM >= Points[NumPoints - 1].RPM)
+			{
+				return Value(Points[NumPoints - 1], Which);
+			}
+
+			int i = 0;
+			while (RPM > Points[i + 1].RPM)
+			{
+				i++;
+			}
+
+			// Cubic Hermite on [i, i+1]
+			const float H = Points[i + 1].RPM - Points[i].RPM;
+			const float T = (RPM - Points[i].RPM) / H;
+			const float T2 = T * T;
+			const float T3 = T2 * T;
+			return (2.0f * T3 - 3.0f * T2 + 1.0f) * Value(Points[i], Which)
+				+ (T3 - 2.0f * T2 + T) * H * Slope[i]
+				+ (-2.0f * T3 + 3.0f * T2) * Value(Points[i + 1], Which)
+				+ (T3 - T2) * H * Slope[i + 1];
+		}
+	};
+
+}
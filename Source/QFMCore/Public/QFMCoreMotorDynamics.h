@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cmath>
+#include <cfloat>
+
+#include "QFMCoreTypes.h"
+
+
+namespace QFM
+{
+
+	/*--- Motor / ESC response settings ---*/
+	struct FMotorDynamicsSettings
+	{
+		bool Enabled = false;					// false: speed follows the mixer instantly (former behaviour)
+		float SpinUpTimeConstant = 0.03f;		// in s, 0 = instant
+		float SpinDownTimeConstant = 0.06f;		// in s, 0 = instant. Props brake slower than they accelerate
+		float MaxSpinUpRate = 0.0f;				// in speed (0..1) per s, 0 = unlimited
+		float MaxSpinDownRate = 0.0f;			// in speed (0..1) per s, 0 = unlimited
+		float IdleSpeed = 0.0f;					// floor of the commanded speed (0..1), keeps armed motors spinning
+	};
+
+
+
+	/*--- Per DeltaTime coefficients of the motor lag ---*/
+	// First order lag Speed' = (Command - Speed) / Tau with the command held over the step, solved exactly:
+	// Speed += (1 - exp(-Dt / Tau)) * (Command - Speed). Alpha stays in [0, 1] for every Dt, so the update is
+	// stable at any substep length. The rate limits are applied on top as a clamp of the step.
+	struct FMotorLagCoefficients
+	{
+		float AlphaUp = 1.0f;
+		float AlphaDown = 1.0f;
+		float MaxStepUp = FLT_MAX;
+		float MaxStepDown = FLT_MAX;
+		float IdleSpeed = 0.0f;
+
+		static float Alpha(float DeltaTime, float TimeConstant)
+		{
+			return TimeConstant > 0.0f ? 1.0f - std::exp(-DeltaTime / TimeConstant) : 1.0f;
+		}
+
+		static float MaxStep(float DeltaTime, float Rate)
+		{
+			return Rate > 0.0f ? Rate * DeltaTime : FLT_MAX;
+		}
+
+		void Compute(const FMotorDynamicsSettings& Settings, float DeltaTime)
+		{
+			AlphaUp = Alpha(DeltaTime, Settings.SpinUpTimeConstant);
+			AlphaDown = Alpha(DeltaTime, Settings.SpinDownTimeConstant);
+			MaxStepUp = MaxStep(DeltaTime, Settings.MaxSpinUpRate);
+			MaxStepDown = MaxStep(DeltaTime, Settings.MaxSpinDownRate);
+			IdleSpeed = Settings.IdleSpeed;
+		}
+
+		// New speed of one motor
+		float Step(float Command, float Speed) const
+		{
+			const float Delta = (Command > IdleSpeed ? Command : IdleSpeed) - Speed;
+			const float Alpha = Delta > 0.0f ? AlphaUp : AlphaDown;
+			return Speed + Clamp(Alpha * Delta, -MaxStepDown, MaxStepUp);
+		}
+	};
+
+
+
+	/*--- Motor lag of all motors of one vehicle ---*/
+	// The coefficients only depend on DeltaTime and the settings, so they are recomputed only when one of them changes.
+	// With the fixed rate loop DeltaTime repeats every tick and the step is a few multiply-adds per motor.
+	struct FMotorDynamics
+	{
+		FMotorDynamicsSettings Settings;
+		FMotorLagCoefficients Coefficients;
+
+
+		// Speed follows Command, both arrays of NumMotors values in 0..1
+		void Step(const float* Command, float* Speed, int NumMotors, float DeltaTime)
+		{
+			UpdateCoefficients(DeltaTime);
+
+			const FMotorLagCoefficients C = Coefficients;
+			for (int i = 0; i < NumMotors; i++)
+			{
+				Speed[i] = C.Step(Command[i], Speed[i]);
+			}
+		}
+
+
+	private:
+
+		void UpdateCoefficients(float DeltaTime)
+		{
+			if (DeltaTime == CachedDeltaTime
+				&& Settings.SpinUpTimeConstant == Cached.SpinUpTimeConstant && Settings.SpinDownTimeConstant == Cached.SpinDownTimeConstant
+				&& Settings.MaxSpinUpRate == Cached.MaxSpinUpRate && Settings.MaxSpinDownRate == Cached.MaxSpinDownRate
+				&& Settings.IdleSpeed == Cached.IdleSpeed)
+			{
+				return;
+			}
+			Coefficients.Compute(Settings, DeltaTime);
+			CachedDeltaTime = DeltaTime;
+			Cached = Settings;
+		}
+
+		float CachedDeltaTime = -1.0f;
+		FMotorDynamicsSettings Cached;
+	};
+
+}
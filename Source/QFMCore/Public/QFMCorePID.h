@@ -0,0 +1,233 @@
+#pragma once
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreSimd.h"
+
+
+namespace QFM
+{
+
+	/*--- Implementation of the PID Controllers ---*/
+	struct FPIDCore
+	{
+		float Max = 1.0f;
+		float Min = -1.0f;
+		float Kp = 0.0f;
+		float Ki = 0.0f;
+		float Kd = 0.0f;
+
+		float PreError = 0.0f;
+		float Integral = 0.0f;
+
+
+		void Init(float MinIn, float MaxIn, float KpIn, float KiIn, float KdIn)
+		{
+			Min = MinIn;
+			Max = MaxIn;
+			Kp = KpIn;
+			Ki = KiIn;
+			Kd = KdIn;
+			Integral = 0.0f;
+			PreError = 0.0f;
+		}
+
+		void Reset()
+		{
+			Integral = 0.0f;
+			PreError = 0.0f;
+		}
+
+		void ResetI()
+		{
+			Integral = 0.0f;
+		}
+
+
+		float Calculate(float Setpoint, float PresentValue, float DeltaTime)
+		{
+			// Calculate error
+			float Error = Setpoint - PresentValue;
+
+			// Proportional term
+			float POut = Kp * Error;
+
+			// Integral term
+			Integral += Error * DeltaTime;
+			float IOut = Ki * Integral;
+
+			// Derivative term
+			float Derivative = (Error - PreError) / DeltaTime;
+			float DOut = Kd * Derivative;
+
+			// Calculate total output
+			float Output = POut + IOut + DOut;
+
+			// Restrict to max/min
+			if (Output > Max)
+				Output = Max;
+			else if (Output < Min)
+				Output = Min;
+
+			// Save error to previous error
+			PreError = Error;
+
+			return Output;
+		}
+	};
+
+
+	/*--- PID controller for NumAxes axes at once ---*/
+	// Gains and state are SIMD lanes (QFMCoreSimd.h), one Calculate updates all axes: 3 for the body rates,
+	// 1 for the Z acceleration, later the velocity loops. Per axis it is FPIDCore with
+	//  - normalization: setpoint and measurement are divided by InputRange, the output is multiplied by OutputRange.
+	//    Both are kept as factors, set them with SetNormalization when the range changes
+	//  - feed-forward: Kff * normalized setpoint
+	//  - derivative on the error (FPIDCore) or on minus the measurement (no kick on setpoint steps), low passed
+	//    with a first order filter of DFilterHz (0: off). The filter is exact for any DeltaTime
+	//  - back-calculation anti-windup: the integral is pulled back by AntiWindup * (saturated - unsaturated output)
+	// Integral and PreError mean the same as in FPIDCore (PreError holds minus the measurement with
+	// bDerivativeOnMeasurement), so flight records store them the same way. DeltaTime <= 0 leaves the state alone.
+	template <int NumAxes>
+	struct TPIDVecCore
+	{
+		static constexpr int NumLanes = (NumAxes + SimdWidth - 1) / SimdWidth * SimdWidth;
+
+		/*--- PARAMETERS, per axis. Padding lanes stay 0 ---*/
+		float Min[NumLanes] = {};
+		float Max[NumLanes] = {};
+		float Kp[NumLanes] = {};
+		float Ki[NumLanes] = {};
+		float Kd[NumLanes] = {};
+		float Kff[NumLanes] = {};
+		float InputScale[NumLanes] = {};		// 1 / InputRange
+		float OutputScale[NumLanes] = {};		// OutputRange
+
+		// All axes
+		float AntiWindup = 0.0f;				// back-calculation gain, 0: off
+		float DFilterHz = 0.0f;					// derivative low pass, 0: off
+		bool bDerivativeOnMeasurement = false;
+
+		/*--- STATE ---*/
+		float Integral[NumLanes] = {};
+		float PreError[NumLanes] = {};
+		float Derivative[NumLanes] = {};		// filtered, as used in the last output
+
+		// Per DeltaTime, see UpdateStepCoefficients
+		float CachedDeltaTime = -1.0f;
+		float CachedDFilterHz = -1.0f;
+		float InvDeltaTime = 0.0f;
+		float DFilterAlpha = 1.0f;
+
+
+		// As FPIDCore::Init for one axis, normalization 1
+		void Init(int Axis, float MinIn, float MaxIn, float KpIn, float KiIn, float KdIn)
+		{
+			Min[Axis] = MinIn;
+			Max[Axis] = MaxIn;
+			Kp[Axis] = KpIn;
+			Ki[Axis] = KiIn;
+			Kd[Axis] = KdIn;
+			InputScale[Axis] = 1.0f;
+			OutputScale[Axis] = 1.0f;
+			Integral[Axis] = 0.0f;
+			PreError[Axis] = 0.0f;
+			Derivative[Axis] = 0.0f;
+		}
+
+		void SetNormalization(int Axis, float InputRange, float OutputRange)
+		{
+			InputScale[Axis] = 1.0f / InputRange;
+			OutputScale[Axis] = OutputRange;
+		}
+
+		void Reset()
+		{
+			for (int i = 0; i < NumLanes; i++)
+			{
+				Integral[i] = 0.0f;
+				PreError[i] = 0.0f;
+				Derivative[i] = 0.0f;
+			}
+		}
+
+		void ResetI()
+		{
+			for (int i = 0; i < NumLanes; i++)
+			{
+				Integral[i] = 0.0f;
+			}
+		}
+
+
+		// Setpoint, Measurement and Output hold NumAxes values
+		void Calculate(const float* Setpoint, const float* Measurement, float DeltaTime, float* Output)
+		{
+			UpdateStepCoefficients(DeltaTime);
+			const bool bStep = DeltaTime > 0.0f;
+			const bool bFilter = DFilterHz > 0.0f;
+			const bool bAntiWindup = AntiWindup > 0.0f;
+			const FSimdFloat Dt(bStep ? DeltaTime : 0.0f), InvDt(InvDeltaTime), Alpha(DFilterAlpha), AntiWindupDt(AntiWindup * DeltaTime);
+
+			for (int b = 0; b < NumLanes; b += SimdWidth)
+			{
+				const FSimdFloat InScale = FSimdFloat::LoadUnaligned(&InputScale[b]);
+				const FSimdFloat Target = FSimdFloat::LoadPartial(Setpoint + b, NumAxes - b) * InScale;
+				const FSimdFloat Now = FSimdFloat::LoadPartial(Measurement + b, NumAxes - b) * InScale;
+				const FSimdFloat Error = Target - Now;
+				const FSimdFloat DInput = bDerivativeOnMeasurement ? FSimdFloat(0.0f) - Now : Error;
+
+				FSimdFloat I = FSimdFloat::LoadUnaligned(&Integral[b]);
+				FSimdFloat D = FSimdFloat::LoadUnaligned(&Derivative[b]);
+				if (bStep)
+				{
+					I = SimdMulAdd(Error, Dt, I);
+					const FSimdFloat Raw = (DInput - FSimdFloat::LoadUnaligned(&PreError[b])) * InvDt;
+					D = bFilter ? SimdMulAdd(Alpha, Raw - D, D) : Raw;
+				}
+
+				FSimdFloat Out = FSimdFloat::LoadUnaligned(&Kp[b]) * Error;
+				Out = SimdMulAdd(FSimdFloat::LoadUnaligned(&Ki[b]), I, Out);
+				Out = SimdMulAdd(FSimdFloat::LoadUnaligned(&Kd[b]), D, Out);
+				Out = SimdMulAdd(FSimdFloat::LoadUnaligned(&Kff[b]), Target, Out);
+				const FSimdFloat Saturated = SimdClamp(Out, FSimdFloat::LoadUnaligned(&Min[b]), FSimdFloat::LoadUnaligned(&Max[b]));
+
+				if (bStep)
+				{
+					if (bAntiWindup)
+					{
+						// Back-calculation: 0 while the output is inside Min..Max
+						I = SimdMulAdd(AntiWindupDt, Saturated - Out, I);
+					}
+					I.StoreUnaligned(&Integral[b]);
+					D.StoreUnaligned(&Derivative[b]);
+					DInput.StoreUnaligned(&PreError[b]);
+				}
+				(Saturated * FSimdFloat::LoadUnaligned(&OutputScale[b])).StorePartial(Output + b, NumAxes - b);
+			}
+		}
+
+
+	private:
+
+		// 1 / DeltaTime and the derivative filter gain change with the step length only
+		void UpdateStepCoefficients(float DeltaTime)
+		{
+			if (DeltaTime == CachedDeltaTime && DFilterHz == CachedDFilterHz)
+			{
+				return;
+			}
+			CachedDeltaTime = DeltaTime;
+			CachedDFilterHz = DFilterHz;
+			InvDeltaTime = DeltaTime > 0.0f ? 1.0f / DeltaTime : 0.0f;
+
+			// Discrete first order low pass: y += Alpha * (x - y), Alpha = 1 - exp(-DeltaTime / Tau)
+			const float Tau = DFilterHz > 0.0f ? 1.0f / (2.0f * Pi * DFilterHz) : 0.0f;
+			DFilterAlpha = (DeltaTime > 0.0f && Tau > 0.0f) ? 1.0f - std::exp(-DeltaTime / Tau) : 1.0f;
+		}
+	};
+
+
+	typedef TPIDVecCore<3> FPID3Core;
+	typedef TPIDVecCore<1> FPID1Core;
+
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cmath>
+
+#include "QFMCoreTypes.h"
+#include "QFMCorePID.h"
+#include "QFMCoreAHRS.h"
+#include "QFMCoreEngine.h"
+#include "QFMCoreVehicle.h"
+
+
+namespace QFM
+{
+
+	/*--- Implementation of the Position-Controller ---*/
+	struct FPositionCore
+	{
+		/*--- PARAMETERS ---*/
+		bool bIsActiveZ = true;
+		float MaxClimbVelocityZ = 20.0f;	// m/s
+		float MaxDescentVelocityZ = 20.0f;	// m/s
+		float MaxAccelerationZ = 9.8f;		// m/s^2
+		EControlLoop TranslationControlLoop = EControlLoop::P;
+		FVec3 RateZPidSettings = FVec3(0.1f, 0.0f, 0.001f);
+		float RateZPidFeedForward = 0.0f;		// times the normalized acceleration target
+		float RateZPidDFilterHz = 0.0f;			// derivative low pass, 0 = off
+		float RateZPidAntiWindup = 0.0f;		// back-calculation gain, 0 = off
+		bool bRateZPidDOnMeasurement = false;	// derivative of the acceleration instead of the error
+		float SPDDamping = 6.0f;
+		float SPDFrequency = 100.0f;
+
+		/*--- STATE ---*/
+		float PosTargetZ = 0.0f;
+		bool bIsLockedZ = false;
+		FPID1Core RateZPid;
+		float RateZPidRange = NAN;				// MaxAccelerationZ the PID is normalized with
+
+		/*--- INTERFACE DATA ---*/
+		float DeltaTime = 0.0f;
+		const FAHRSCore* AHRS = nullptr;
+		FEngineCore* EngineController = nullptr;
+		const FVehicleCore* Vehicle = nullptr;
+
+
+		void Init(const FAHRSCore* AHRSIn, const FVehicleCore* VehicleIn, FEngineCore* EngineControllerIn)
+		{
+			AHRS = AHRSIn;
+			EngineController = EngineControllerIn;
+			Vehicle = VehicleIn;
+
+			bIsLockedZ = false;
+
+			// Init Pids with min,max = -1..1. We normalize Rates in RunZController, so we allways have values from 0..1
+			RateZPid.Init(0, -1, 1, RateZPidSettings.X, RateZPidSettings.Y, RateZPidSettings.Z);
+			RateZPid.Kff[0] = RateZPidFeedForward;
+			RateZPid.AntiWindup = RateZPidAntiWindup;
+			RateZPid.DFilterHz = RateZPidDFilterHz;
+			RateZPid.bDerivativeOnMeasurement = bRateZPidDOnMeasurement;
+			RateZPidRange = NAN;
+		}
+
+		void Reset()
+		{
+			bIsLockedZ = false;
+			RateZPid.Reset();
+		}
+
+		void Tock(float DeltaTimeIn)
+		{
+			DeltaTime = DeltaTimeIn;
+		}
+
+
+		/* --- Check Active ---*/
+
+		bool IsActiveZ() const
+		{
+			return bIsActiveZ;
+		}
+
+
+		/* --- Set Alt Targets ---*/
+
+		void SetAltTarget(float AltIn)
+		{
+			PosTargetZ = AltIn;
+			bIsLockedZ = true;
+		}
+
+		void SetAltTargetToCurrentAlt()
+		{
+			PosTargetZ = AHRS->GetWorldAltitude();
+			bIsLockedZ = true;
+		}
+
+		void SetAltTargetFromClimbRate(float TargetClimbRate)
+		{
+			TargetClimbRate = Clamp<float>(TargetClimbRate, -MaxDescentVelocityZ, MaxClimbVelocityZ);
+
+			if (std::fabs(TargetClimbRate) < 0.001f)
+			{
+				if (!bIsLockedZ)
+				{
+					SetAltTargetToCurrentAlt(); // Will lock bIsLockedZ
+				}
+				return;
+			}
+			bIsLockedZ = false;
+			PosTargetZ = AHRS->GetWorldAltitude() + TargetClimbRate * DeltaTime;
+		}
+
+
+		/* Set MinMax Values ---*/
+
+		void SetMaxVelocityZ(float SpeedDownIn, float SpeedUpIn)
+		{
+			MaxClimbVelocityZ = SpeedUpIn;
+			MaxDescentVelocityZ = SpeedDownIn;
+		}
+
+		void SetMaxAccelerationZ(float AccelIn)
+		{
+			MaxAccelerationZ = AccelIn;
+		}
+
+
+		/* --- Update Loop ---*/
+
+		void UpdateZController()
+		{
+			// Get current altitude in m
+			float CurrentAlt = AHRS->GetWorldAltitude();
+
+			// get position error in m
+			float PosErrorZ = PosTargetZ - CurrentAlt;
+
+			// calculate Velocity Target for actual position based on PosError using Linear Function
+			float VelocityTargetZ = PosErrorZ / DeltaTime;
+
+			// check speed limits
+			if (VelocityTargetZ > MaxClimbVelocityZ)
+			{
+				VelocityTargetZ = MaxClimbVelocityZ;
+			}
+			if (VelocityTargetZ < -MaxDescentVelocityZ)
+			{
+				VelocityTargetZ = -MaxDescentVelocityZ;
+			}
+
+			// the following section calculates acceleration required to achieve the velocity target
+			float VelocityCurrentZ = AHRS->GetWorldVelocity().Z;
+
+			float AccelerationTargetZ = (VelocityTargetZ - VelocityCurrentZ);
+			float AccelerationCurrentZ = AHRS->GetWorldAccelerationXYZ().Z;
+
+			float ThrottleOut = 0.0f;
+
+			if (TranslationControlLoop == EControlLoop::P)
+			{
+				// P-Controller
+				ThrottleOut = (AccelerationTargetZ - AccelerationCurrentZ) / MaxAccelerationZ;
+			}
+			else if (TranslationControlLoop == EControlLoop::PID)
+			{
+				// PID Controller, normalized by MaxAccelerationZ
+				if (RateZPidRange != MaxAccelerationZ)
+				{
+					RateZPidRange = MaxAccelerationZ;
+					RateZPid.SetNormalization(0, MaxAccelerationZ, 1.0f);
+				}
+				RateZPid.Calculate(&AccelerationTargetZ, &AccelerationCurrentZ, DeltaTime, &ThrottleOut);
+				ThrottleOut += EngineController->GetThrottleHover();
+			}
+			else if (TranslationControlLoop == EControlLoop::SPD)
+			{
+				// FPD-Controller
+				ThrottleOut = StepAccelZSpd(AccelerationTargetZ / MaxAccelerationZ, AccelerationCurrentZ / MaxAccelerationZ);
+			}
+
+			// Sanity Check
+			ThrottleOut = Clamp(ThrottleOut, 0.0f, 1.0f);
+
+			EngineController->SetDesiredThrottlePercent(ThrottleOut);
+		}
+
+
+		// Run the Translational Z Acceleration FPD controller and return the output detla w -1..1
+		float StepAccelZSpd(float Target, float Current) const
+		{
+			float kp = SPDFrequency * SPDFrequency * 9.0f;
+			float kd = 4.5f * SPDFrequency * SPDDamping;
+			float dt = DeltaTime;
+
+			float g = 1.0f / (1.0f + kd * dt + kp * dt * dt);
+			float kpg = kp * g;
+			float kdg = (kd + kp * dt) * g;
+
+			return (kpg * Target - kdg * Current);
+		}
+	};
+
+}
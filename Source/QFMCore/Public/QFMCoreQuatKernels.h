@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cstddef>
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreSimd.h"
+
+
+namespace QFM
+{
+
+	/*--- Quaternion kernels of the attitude loop ---*/
+	// Replace what RunQuat did with FQuatf: Inverse, product, Normalize and ToAxisAndAngle (acos, two sqrt,
+	// divisions). Every kernel has a scalar form on FQuatf and a SimdWidth wide form on FSimdQuat (8 lanes with
+	// AVX2, 4 with SSE2) doing the same operations, and a loop over SoA arrays padded to SimdWidth.
+	//
+	// Max errors, measured by QFMQuatBench against double precision over the whole input range:
+	//   QuatRelative, QuatRelativeShortest   2.5e-7 per component, the rounding of the product
+	//   QuatNormalizeFast                    |1 - |Q|| < 6e-7 for |1 - |Q|^2| < 1e-3 (one Newton step)
+	//   QuatNormalize                        |1 - |Q|| < 4e-7
+	//   QuatToRotationVector                 2.5e-7 * angle + 1 ulp, for any angle and any |Q| > 0
+	//   QuatFromRotationVector               2.5e-7 per component for angles up to Pi
+	//   GetAttitudeErrors                    1e-6 rad, length of the error of the rotation vector, angles up to Pi
+	// ToAxisAndAngle is off by up to 3e-4 rad around zero: acos of a float close to 1.
+
+
+	/*--- Polynomials ---*/
+
+	// atan(r) / r as a polynomial in r^2, 0 <= r <= 1. Minimax, error 9e-8
+	inline float QuatAtanOverX(float R2)
+	{
+		float P = -0.004780219f;
+		P = P * R2 + 0.024556318f;
+		P = P * R2 - 0.059903637f;
+		P = P * R2 + 0.099426880f;
+		P = P * R2 - 0.140293956f;
+		P = P * R2 + 0.199713722f;
+		P = P * R2 - 0.333320946f;
+		return P * R2 + 0.999999940f;
+	}
+
+	// sin(h) / h and cos(h) as polynomials in h^2, 0 <= h <= Pi / 2. Minimax, errors 5e-9 and 5e-8
+	inline float QuatSinOverX(float H2)
+	{
+		float P = 2.6052248e-6f;
+		P = P * H2 - 1.9809075e-4f;
+		P = P * H2 + 8.3330506e-3f;
+		P = P * H2 - 0.16666658f;
+		return P * H2 + 1.0f;
+	}
+
+	inline float QuatCos(float H2)
+	{
+		float P = 2.3153931e-5f;
+		P = P * H2 - 1.3853704e-3f;
+		P = P * H2 + 4.1663583e-2f;
+		P = P * H2 - 0.49999905f;
+		return P * H2 + 0.99999994f;
+	}
+
+
+	/*--- Scalar kernels ---*/
+
+	// A * B.Inverse() for unit B without the inverse: rotation from B to A. W is A | B
+	inline FQuatf QuatRelative(const FQuatf& A, const FQuatf& B)
+	{
+		return FQuatf(
+			A.X * B.W - A.W * B.X - A.Y * B.Z + A.Z * B.Y,
+			A.Y * B.W - A.W * B.Y + A.X * B.Z - A.Z * B.X,
+			A.Z * B.W - A.W * B.Z - A.X * B.Y + A.Y * B.X,
+			A.W * B.W + A.X * B.X + A.Y * B.Y + A.Z * B.Z);
+	}
+
+	// QuatRelative the short way round, W >= 0. Same as RunQuat's (A * Direction) * B.Inverse()
+	inline FQuatf QuatRelativeShortest(const FQuatf& A, const FQuatf& B)
+	{
+		const FQuatf Q = QuatRelative(A, B);
+		return Q.W >= 0.0f ? Q : Q * -1.0f;
+	}
+
+	// For quaternions near unit length, e.g. after a product of unit quaternions: a Newton step of 1 / sqrt around 1
+	inline FQuatf QuatNormalizeFast(const FQuatf& Q)
+	{
+		return Q * (1.5f - 0.5f * (Q | Q));
+	}
+
+	// Any length > 0
+	inline FQuatf QuatNormalize(const FQuatf& Q)
+	{
+		return Q * (1.0f / std::sqrt(Q | Q));
+	}
+
+	// Rotation axis times angle (rad, -Pi..Pi), the short way round: the attitude error of RunQuat. Q need not be
+	// normalized. atan2(|V|, |W|) from the smaller over the larger one, so there is no division by a small |V|
+	inline FVec3 QuatToRotationVector(const FQuatf& Q)
+	{
+		const float Sign = Q.W >= 0.0f ? 1.0f : -1.0f;
+		const float W = Q.W * Sign;
+		const float S = std::sqrt(Q.X * Q.X + Q.Y * Q.Y + Q.Z * Q.Z);
+		const bool bSmall = S <= W;
+		const float Den = bSmall ? W : S;
+		const float R = (bSmall ? S : W) / Den;
+		const float P = QuatAtanOverX(R * R);
+		// 2 atan(S / W) / S, or (Pi - 2 atan(W / S)) / S. 2 atan(R) / R is 2 P
+		const float Angle = bSmall ? 2.0f * P : Pi - 2.0f * R * P;
+		const float Scale = Sign * Angle / Den;
+		return FVec3(Q.X * Scale, Q.Y * Scale, Q.Z * Scale);
+	}
+
+	// Exponential map: rotation about V by |V| rad, e.g. the step of an angular velocity times DeltaTime.
+	// Unit length up to the error above, |V| <= Pi
+	inline FQuatf QuatFromRotationVector(const FVec3& V)
+	{
+		const float H2 = 0.25f * (V.X * V.X + V.Y * V.Y + V.Z * V.Z);
+		const float Scale = 0.5f * QuatSinOverX(H2);
+		return FQuatf(V.X * Scale, V.Y * Scale, V.Z * Scale, QuatCos(H2));
+	}
+
+
+
+	/*--- SimdWidth quaternions at once ---*/
+
+	struct FSimdQuat
+	{
+		FSimdFloat X, Y, Z, W;
+
+		// Lanes Index..Index + SimdWidth of SoA arrays, Index aligned to SimdWidth
+		static FSimdQuat Load(const float* const Q[4], size_t Index)
+		{
+			return FSimdQuat{ FSimdFloat::Load(Q[0] + Index), FSimdFloat::Load(Q[1] + Index), FSimdFloat::Load(Q[2] + Index), FSimdFloat::Load(Q[3] + Index) };
+		}
+
+		void Store(float* const Q[4], size_t Index) const
+		{
+			X.Store(Q[0] + Index);
+			Y.Store(Q[1] + Index);
+			Z.Store(Q[2] + Index);
+			W.Store(Q[3] + Index);
+		}
+	};
+
+	struct FSimdVec3
+	{
+		FSimdFloat X, Y, Z;
+
+		void Store(float* const V[3], size_t Index) const
+		{
+			X.Store(V[0] + Index);
+			Y.Store(V[1] + Index);
+			Z.Store(V[2] + Index);
+		}
+	};
+
+
+	inline FSimdFloat QuatAtanOverX(FSimdFloat R2)
+	{
+		FSimdFloat P(-0.004780219f);
+		P = SimdMulAdd(P, R2, FSimdFloat(0.024556318f));
+		P = SimdMulAdd(P, R2, FSimdFloat(-0.059903637f));
+		P = SimdMulAdd(P, R2, FSimdFloat(0.099426880f));
+		P = SimdMulAdd(P, R2, FSimdFloat(-0.140293956f));
+		P = SimdMulAdd(P, R2, FSimdFloat(0.199713722f));
+		P = SimdMulAdd(P, R2, FSimdFloat(-0.333320946f));
+		return SimdMulAdd(P, R2, FSimdFloat(0.999999940f));
+	}
+
+	inline FSimdFloat QuatSinOverX(FSimdFloat H2)
+	{
+		FSimdFloat P(2.6052248e-6f);
+		P = SimdMulAdd(P, H2, FSimdFloat(-1.9809075e-4f));
+		P = SimdMulAdd(P, H2, FSimdFloat(8.3330506e-3f));
+		P = SimdMulAdd(P, H2, FSimdFloat(-0.16666658f));
+		return SimdMulAdd(P, H2, FSimdFloat(1.0f));
+	}
+
+	inline FSimdFloat QuatCos(FSimdFloat H2)
+	{
+		FSimdFloat P(2.3153931e-5f);
+		P = SimdMulAdd(P, H2, FSimdFloat(-1.3853704e-3f));
+		P = SimdMulAdd(P, H2, FSimdFloat(4.1663583e-2f));
+		P = SimdMulAdd(P, H2, FSimdFloat(-0.49999905f));
+		return SimdMulAdd(P, H2, FSimdFloat(0.99999994f));
+	}
+
+
+	inline FSimdQuat QuatRelative(const FSimdQuat& A, const FSimdQuat& B)
+	{
+		return FSimdQuat{
+			A.X * B.W - A.W * B.X - A.Y * B.Z + A.Z * B.Y,
+			A.Y * B.W - A.W * B.Y + A.X * B.Z - A.Z * B.X,
+			A.Z * B.W - A.W * B.Z - A.X * B.Y + A.Y * B.X,
+			A.W * B.W + A.X * B.X + A.Y * B.Y + A.Z * B.Z };
+	}
+
+	inline FSimdQuat QuatRelativeShortest(const FSimdQuat& A, const FSimdQuat& B)
+	{
+		const FSimdQuat Q = QuatRelative(A, B);
+		const FSimdFloat Sign = SimdSelect(SimdLess(Q.W, FSimdFloat(0.0f)), FSimdFloat(-1.0f), FSimdFloat(1.0f));
+		return FSimdQuat{ Q.X * Sign, Q.Y * Sign, Q.Z * Sign, Q.W * Sign };
+	}
+
+	inline FSimdQuat QuatNormalizeFast(const FSimdQuat& Q)
+	{
+		const FSimdFloat SquareSum = Q.X * Q.X + Q.Y * Q.Y + Q.Z * Q.Z + Q.W * Q.W;
+		const FSimdFloat Scale = SimdMulAdd(FSimdFloat(-0.5f), SquareSum, FSimdFloat(1.5f));
+		return FSimdQuat{ Q.X * Scale, Q.Y * Scale, Q.Z * Scale, Q.W * Scale };
+	}
+
+	inline FSimdQuat QuatNormalize(const FSimdQuat& Q)
+	{
+		const FSimdFloat Scale = SimdRsqrt(Q.X * Q.X + Q.Y * Q.Y + Q.Z * Q.Z + Q.W * Q.W);
+		return FSimdQuat{ Q.X * Scale, Q.Y * Scale, Q.Z * Scale, Q.W * Scale };
+	}
+
+	inline FSimdVec3 QuatToRotationVector(const FSimdQuat& Q)
+	{
+		const FSimdFloat Sign = SimdSelect(SimdLess(Q.W, FSimdFloat(0.0f)), FSimdFloat(-1.0f), FSimdFloat(1.0f));
+		const FSimdFloat W = Q.W * Sign;
+		const FSimdFloat S = SimdSqrt(Q.X * Q.X + Q.Y * Q.Y + Q.Z * Q.Z);
+		const FSimdFloat Large = SimdGreater(S, W);
+		const FSimdFloat Den = SimdMax(S, W);
+		const FSimdFloat R = SimdMin(S, W) / Den;
+		const FSimdFloat P = QuatAtanOverX(R * R);
+		const FSimdFloat Angle = SimdSelect(Large, FSimdFloat(Pi) - FSimdFloat(2.0f) * R * P, FSimdFloat(2.0f) * P);
+		const FSimdFloat Scale = Sign * Angle / Den;
+		return FSimdVec3{ Q.X * Scale, Q.Y * Scale, Q.Z * Scale };
+	}
+
+	inline FSimdQuat QuatFromRotationVector(const FSimdVec3& V)
+	{
+		const FSimdFloat H2 = FSimdFloat(0.25f) * (V.X * V.X + V.Y * V.Y + V.Z * V.Z);
+		const FSimdFloat Scale = FSimdFloat(0.5f) * QuatSinOverX(H2);
+		return FSimdQuat{ V.X * Scale, V.Y * Scale, V.Z * Scale, QuatCos(H2) };
+	}
+
+
+
+	/*--- Loops over SoA arrays: X, Y, Z(, W) pointers, padded to SimdWidth and aligned ---*/
+
+	// Attitude error of RunQuat: rotation vector from Current to Target, the short way round
+	inline void GetAttitudeErrors(const float* const Target[4], const float* const Current[4], float* const Error[3], size_t Count)
+	{
+		const size_t Padded = SimdPadded(Count);
+		for (size_t i = 0; i < Padded; i += SimdWidth)
+		{
+			QuatToRotationVector(QuatRelative(FSimdQuat::Load(Target, i), FSimdQuat::Load(Current, i))).Store(Error, i);
+		}
+	}
+
+	// Q = QuatNormalizeFast(exp(Rate * DeltaTime) * Q): body rates integrated in world space
+	inline void IntegrateRotations(float* const Q[4], const float* const Rate[3], float DeltaTime, size_t Count)
+	{
+		const FSimdFloat Dt(DeltaTime);
+		const size_t Padded = SimdPadded(Count);
+		for (size_t i = 0; i < Padded; i += SimdWidth)
+		{
+			const FSimdVec3 Step = { FSimdFloat::Load(Rate[0] + i) * Dt, FSimdFloat::Load(Rate[1] + i) * Dt, FSimdFloat::Load(Rate[2] + i) * Dt };
+			const FSimdQuat E = QuatFromRotationVector(Step);
+			const FSimdQuat R = FSimdQuat::Load(Q, i);
+			const FSimdQuat Product = {
+				E.W * R.X + E.X * R.W + E.Y * R.Z - E.Z * R.Y,
+				E.W * R.Y - E.X * R.Z + E.Y * R.W + E.Z * R.X,
+				E.W * R.Z + E.X * R.Y - E.Y * R.X + E.Z * R.W,
+				E.W * R.W - E.X * R.X - E.Y * R.Y - E.Z * R.Z };
+			QuatNormalizeFast(Product).Store(Q, i);
+		}
+	}
+
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "QFMCoreSimd.h"
+
+
+namespace QFM
+{
+
+	/*--- Counter-based random numbers (Philox4x32-10, Salmon et al. 2011) ---*/
+	// The output is a pure function of key and counter, there is no state to carry between draws.
+	// Campaign runs key a stream with (seed, run), so run N draws the same numbers on any thread,
+	// in any order and whatever ran before it.
+
+	struct FPhilox4x32
+	{
+		static void Generate(const uint32_t KeyIn[2], const uint32_t CounterIn[4], uint32_t Out[4])
+		{
+			uint32_t Key[2] = { KeyIn[0], KeyIn[1] };
+			uint32_t C[4] = { CounterIn[0], CounterIn[1], CounterIn[2], CounterIn[3] };
+			for (int Round = 0; Round < 10; Round++)
+			{
+				const uint64_t P0 = static_cast<uint64_t>(0xD2511F53u) * C[0];
+				const uint64_t P1 = static_cast<uint64_t>(0xCD9E8D57u) * C[2];
+				const uint32_t Next[4] = {
+					static_cast<uint32_t>(P1 >> 32) ^ C[1] ^ Key[0],
+					static_cast<uint32_t>(P1),
+					static_cast<uint32_t>(P0 >> 32) ^ C[3] ^ Key[1],
+					static_cast<uint32_t>(P0) };
+				C[0] = Next[0]; C[1] = Next[1]; C[2] = Next[2]; C[3] = Next[3];
+				Key[0] += 0x9E3779B9u;
+				Key[1] += 0xBB67AE85u;
+			}
+			Out[0] = C[0]; Out[1] = C[1]; Out[2] = C[2]; Out[3] = C[3];
+		}
+	};
+
+
+	/*--- Normal numbers for many counters at once ---*/
+	// Lane i runs Philox on Counter with Counter[0] + i (carry into Counter[1]) and turns its 4 words into 4 normal
+	// numbers Out[0..3][i], two Box-Muller pairs. The quadrant of an angle comes from the 2 low bits of its word and
+	// the angle inside it from the high 24 bits, so sin and cos are short polynomials. The rounds run on 8 (AVX2) or 4
+	// (SSE2) counters at once, the float part is FSimdFloat. Lane i only depends on key and its counter.
+
+	constexpr int PhiloxLanes = 16;
+
+	// The 10 rounds of FPhilox4x32::Generate on the first Lanes (a multiple of SimdWidth) counters, word w of lane i in Cw[i]
+	inline void PhiloxRounds(const uint32_t Key[2], uint32_t* C0, uint32_t* C1, uint32_t* C2, uint32_t* C3, int Lanes)
+	{
+#if QFM_SIMD_AVX2
+		// 32 x 32 -> 64 bit products of the even lanes, then of the odd ones shifted down; low and high halves blended back
+		const __m256i M0 = _mm256_set1_epi32(static_cast<int>(0xD2511F53u));
+		const __m256i M1 = _mm256_set1_epi32(static_cast<int>(0xCD9E8D57u));
+		for (int i = 0; i < Lanes; i += 8)
+		{
+			__m256i X0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(C0 + i));
+			__m256i X1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(C1 + i));
+			__m256i X2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(C2 + i));
+			__m256i X3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(C3 + i));
+			uint32_t K0 = Key[0];
+			uint32_t K1 = Key[1];
+			for (int Round = 0; Round < 10; Round++)
+			{
+				const __m256i Even0 = _mm256_mul_epu32(X0, M0);
+				const __m256i Odd0 = _mm256_mul_epu32(_mm256_srli_epi64(X0, 32), M0);
+				const __m256i Even1 = _mm256_mul_epu32(X2, M1);
+				const __m256i Odd1 = _mm256_mul_epu32(_mm256_srli_epi64(X2, 32), M1);
+				const __m256i Lo0 = _mm256_blend_epi32(Even0, _mm256_slli_epi64(Odd0, 32), 0xAA);
+				const __m256i Hi0 = _mm256_blend_epi32(_mm256_srli_epi64(Even0, 32), Odd0, 0xAA);
+				const __m256i Lo1 = _mm256_blend_epi32(Even1, _mm256_slli_epi64(Odd1, 32), 0xAA);
+				const __m256i Hi1 = _mm256_blend_epi32(_mm256_srli_epi64(Even1, 32), Odd1, 0xAA);
+				X0 = _mm256_xor_si256(_mm256_xor_si256(Hi1, X1), _mm256_set1_epi32(static_cast<int>(K0)));
+				X2 = _mm256_xor_si256(_mm256_xor_si256(Hi0, X3), _mm256_set1_epi32(static_cast<int>(K1)));
+				X1 = Lo1;
+				X3 = Lo0;
+				K0 += 0x9E3779B9u;
+				K1 += 0xBB67AE85u;
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(C0 + i), X0);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(C1 + i), X1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(C2 + i), X2);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(C3 + i), X3);
+		}
+#elif QFM_SIMD_SSE2
+		const __m128i M0 = _mm_set1_epi32(static_cast<int>(0xD2511F53u));
+		const __m128i M1 = _mm_set1_epi32(static_cast<int>(0xCD9E8D57u));
+		const __m128i EvenMask = _mm_set_epi32(0, -1, 0, -1);
+		for (int i = 0; i < Lanes; i += 4)
+		{
+			__m128i X0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(C0 + i));
+			__m128i X1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(C1 + i));
+			__m128i X2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(C2 + i));
+			__m128i X3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(C3 + i));
+			uint32_t K0 = Key[0];
+			uint32_t K1 = Key[1];
+			for (int Round = 0; Round < 10; Round++)
+			{
+				const __m128i Even0 = _mm_mul_epu32(X0, M0);
+				const __m128i Odd0 = _mm_mul_epu32(_mm_srli_epi64(X0, 32), M0);
+				const __m128i Even1 = _mm_mul_epu32(X2, M1);
+				const __m128i Odd1 = _mm_mul_epu32(_mm_srli_epi64(X2, 32), M1);
+				const __m128i Lo0 = _mm_or_si128(_mm_and_si128(Even0, EvenMask), _mm_slli_epi64(Odd0, 32));
+				const __m128i Hi0 = _mm_or_si128(_mm_srli_epi64(Even0, 32), _mm_andnot_si128(EvenMask, Odd0));
+				const __m128i Lo1 = _mm_or_si128(_mm_and_si128(Even1, EvenMask), _mm_slli_epi64(Odd1, 32));
+				const __m128i Hi1 = _mm_or_si128(_mm_srli_epi64(Even1, 32), _mm_andnot_si128(EvenMask, Odd1));
+				X0 = _mm_xor_si128(_mm_xor_si128(Hi1, X1), _mm_set1_epi32(static_cast<int>(K0)));
+				X2 = _mm_xor_si128(_mm_xor_si128(Hi0, X3), _mm_set1_epi32(static_cast<int>(K1)));
+				X1 = Lo1;
+				X3 = Lo0;
+				K0 += 0x9E3779B9u;
+				K1 += 0xBB67AE85u;
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(C0 + i), X0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(C1 + i), X1);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(C2 + i), X2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(C3 + i), X3);
+		}
+#else
+		for (int i = 0; i < Lanes; i++)
+		{
+			const uint32_t Counter[4] = { C0[i], C1[i], C2[i], C3[i] };
+			uint32_t Out[4];
+			FPhilox4x32::Generate(Key, Counter, Out);
+			C0[i] = Out[0]; C1[i] = Out[1]; C2[i] = Out[2]; C3[i] = Out[3];
+		}
+#endif
+	}
+
+	inline void GenerateNormals(const uint32_t Key[2], const uint32_t Counter[4], int Count, float* const Out[4])
+	{
+		static_assert(PhiloxLanes % SimdWidth == 0, "Lanes are processed SimdWidth at a time");
+
+		for (int First = 0; First < Count; First += PhiloxLanes)
+		{
+			// A short last block only runs the SIMD groups it needs
+			const int Num = Count - First < PhiloxLanes ? Count - First : PhiloxLanes;
+			const int Active = static_cast<int>(SimdPadded(Num));
+
+			uint32_t C0[PhiloxLanes], C1[PhiloxLanes], C2[PhiloxLanes], C3[PhiloxLanes];
+			for (int i = 0; i < Active; i++)
+			{
+				C0[i] = Counter[0] + static_cast<uint32_t>(First + i);
+				C1[i] = Counter[1] + (C0[i] < Counter[0] ? 1u : 0u);
+				C2[i] = Counter[2];
+				C3[i] = Counter[3];
+			}
+
+			PhiloxRounds(Key, C0, C1, C2, C3, Active);
+
+			// Pair p: radius from word 2p as U in (0, 1], angle from word 2p + 1
+			const uint32_t* RadiusWord[2] = { C0, C2 };
+			const uint32_t* AngleWord[2] = { C1, C3 };
+			float U[2][PhiloxLanes], Fraction[2][PhiloxLanes], CosSign[2][PhiloxLanes], SinSign[2][PhiloxLanes];
+			for (int p = 0; p < 2; p++)
+			{
+				for (int i = 0; i < Active; i++)
+				{
+					U[p][i] = static_cast<float>((RadiusWord[p][i] >> 8) + 1) * (1.0f / 16777216.0f);
+					Fraction[p][i] = static_cast<float>(AngleWord[p][i] >> 8) * (1.0f / 16777216.0f);
+					CosSign[p][i] = (AngleWord[p][i] & 1) ? -1.0f : 1.0f;
+					SinSign[p][i] = (AngleWord[p][i] & 2) ? -1.0f : 1.0f;
+				}
+			}
+
+			float Normals[4][PhiloxLanes];
+			for (int p = 0; p < 2; p++)
+			{
+				for (int i = 0; i < Active; i += SimdWidth)
+				{
+					const FSimdFloat Radius = SimdSqrt(FSimdFloat(-2.0f) * SimdLog(FSimdFloat::LoadUnaligned(&U[p][i])));
+
+					// Half of the angle in the quadrant, [0, pi / 4): Taylor to the 8th order is exact to float
+					const FSimdFloat H = FSimdFloat::LoadUnaligned(&Fraction[p][i]) * FSimdFloat(0.785398163f);
+					const FSimdFloat H2 = H * H;
+					FSimdFloat Sin = SimdMulAdd(H2, FSimdFloat(-1.0f / 5040.0f), FSimdFloat(1.0f / 120.0f));
+					Sin = SimdMulAdd(Sin, H2, FSimdFloat(-1.0f / 6.0f));
+					Sin = H * SimdMulAdd(Sin, H2, FSimdFloat(1.0f));
+					FSimdFloat Cos = SimdMulAdd(H2, FSimdFloat(1.0f / 40320.0f), FSimdFloat(-1.0f / 720.0f));
+					Cos = SimdMulAdd(Cos, H2, FSimdFloat(1.0f / 24.0f));
+					Cos = SimdMulAdd(Cos, H2, FSimdFloat(-0.5f));
+					Cos = SimdMulAdd(Cos, H2, FSimdFloat(1.0f));
+
+					const FSimdFloat CosAngle = Cos * Cos - Sin * Sin;
+					const FSimdFloat SinAngle = FSimdFloat(2.0f) * Sin * Cos;
+					(Radius * CosAngle * FSimdFloat::LoadUnaligned(&CosSign[p][i])).StoreUnaligned(&Normals[2 * p][i]);
+					(Radius * SinAngle * FSimdFloat::LoadUnaligned(&SinSign[p][i])).StoreUnaligned(&Normals[2 * p + 1][i]);
+				}
+			}
+
+			for (int w = 0; w < 4; w++)
+			{
+				for (int i = 0; i < Num; i++)
+				{
+					Out[w][First + i] = Normals[w][i];
+				}
+			}
+		}
+	}
+
+
+	// One independent stream: Seed and Stream form the key, Substream separates uses within it
+	// (parameter sampling, sensor noise, ...) so adding draws to one does not shift the others
+	class FRandomStream
+	{
+	public:
+
+		FRandomStream(uint32_t Seed, uint32_t Stream, uint32_t Substream = 0)
+		{
+			Key[0] = Stream;
+			Key[1] = Seed;
+			Counter[0] = 0;
+			Counter[1] = 0;
+			Counter[2] = Substream;
+			Counter[3] = 0;
+		}
+
+		uint32_t NextUInt()
+		{
+			if (Used == 4)
+			{
+				FPhilox4x32::Generate(Key, Counter, Block);
+				if (++Counter[0] == 0) { Counter[1]++; }
+				Used = 0;
+			}
+			return Block[Used++];
+		}
+
+		// [0, 1), 24 bit resolution
+		float Uniform()
+		{
+			return static_cast<float>(NextUInt() >> 8) * (1.0f / 16777216.0f);
+		}
+
+		float Uniform(float Min, float Max)
+		{
+			return Min + (Max - Min) * Uniform();
+		}
+
+		// Box-Muller, the second value is kept for the next call
+		float Normal()
+		{
+			if (bHasSpareNormal)
+			{
+				bHasSpareNormal = false;
+				return SpareNormal;
+			}
+			const float U1 = 1.0f - Uniform();	// (0, 1]
+			const float U2 = Uniform();
+			const float Radius = std::sqrt(-2.0f * std::log(U1));
+			const float Angle = 6.28318530718f * U2;
+			SpareNormal = Radius * std::sin(Angle);
+			bHasSpareNormal = true;
+			return Radius * std::cos(Angle);
+		}
+
+		float Normal(float Mean, float StdDev)
+		{
+			return Mean + StdDev * Normal();
+		}
+
+	private:
+		uint32_t Key[2];
+		uint32_t Counter[4];
+		uint32_t Block[4] = {};
+		int Used = 4;
+		float SpareNormal = 0.0f;
+		bool bHasSpareNormal = false;
+	};
+
+}
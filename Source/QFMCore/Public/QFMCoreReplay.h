@@ -0,0 +1,363 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "QFMCoreFlightModel.h"
+#include "QFMCoreFlightRecord.h"
+#include "QFMCoreFlightConfig.h"
+
+
+namespace QFM
+{
+
+	/*--- Outputs a replay compares ---*/
+	// Everything the controllers compute in a step. Body and pilot axes are inputs and are fed from the record
+
+	struct FReplayField
+	{
+		const char* Name;
+		size_t Offset;
+		int Num;
+	};
+
+	#define QFM_REPLAY_FIELD(Member, Num) { #Member, offsetof(FFlightRecord, Member), Num }
+
+	static const FReplayField ReplayFields[] =
+	{
+		QFM_REPLAY_FIELD(DesiredPilotInput, 4),
+		QFM_REPLAY_FIELD(AHRSPosition, 3),
+		QFM_REPLAY_FIELD(AHRSRotation, 3),
+		QFM_REPLAY_FIELD(AHRSLinearVelocity, 1),
+		QFM_REPLAY_FIELD(AHRSVelocityVector, 3),
+		QFM_REPLAY_FIELD(AHRSLinearVelocity2D, 1),
+		QFM_REPLAY_FIELD(AHRSLinearVelocityX, 1),
+		QFM_REPLAY_FIELD(AHRSAngularVelocity, 3),
+		QFM_REPLAY_FIELD(AHRSLinearAcceleration, 1),
+		QFM_REPLAY_FIELD(AHRSLinearAccelerationVector, 3),
+		QFM_REPLAY_FIELD(AHRSAngularAcceleration, 3),
+		QFM_REPLAY_FIELD(AHRSWorldRotation, 4),
+		QFM_REPLAY_FIELD(AHRSWorldTranslation, 3),
+		QFM_REPLAY_FIELD(AHRSBodyAngularVelocity, 3),
+		QFM_REPLAY_FIELD(AHRSGyroFilterState, FAHRSCore::FGyroFilter::NumStateValues),
+		QFM_REPLAY_FIELD(AHRSAccelerationFilterState, FAHRSCore::FAccelerationFilter::NumStateValues),
+		QFM_REPLAY_FIELD(SensorImuTimer, 1),
+		QFM_REPLAY_FIELD(SensorBaroTimer, 1),
+		QFM_REPLAY_FIELD(SensorGyroBias, 3),
+		QFM_REPLAY_FIELD(SensorAccelerometerBias, 3),
+		QFM_REPLAY_FIELD(SensorBaroBias, 1),
+		QFM_REPLAY_FIELD(SensorBaroAltitude, 1),
+		QFM_REPLAY_FIELD(SensorVibrationPhase, MaxEngines),
+		QFM_REPLAY_FIELD(SensorLastRotation, 4),
+		QFM_REPLAY_FIELD(SensorLastAngularVelocity, 3),
+		QFM_REPLAY_FIELD(SensorLastVelocity, 3),
+		QFM_REPLAY_FIELD(SensorPositionTimer, 1),
+		QFM_REPLAY_FIELD(EstimatorRotation, 4),
+		QFM_REPLAY_FIELD(EstimatorVelocity, 3),
+		QFM_REPLAY_FIELD(EstimatorPosition, 3),
+		QFM_REPLAY_FIELD(EstimatorGyroBias, 3),
+		QFM_REPLAY_FIELD(EstimatorAccelerometerBias, 3),
+		QFM_REPLAY_FIELD(EstimatorCovariance, FEstimatorCore::NumCovarianceValues),
+		QFM_REPLAY_FIELD(AttitudeTarget, 4),
+		QFM_REPLAY_FIELD(RateIntegral, 3),
+		QFM_REPLAY_FIELD(RatePreError, 3),
+		QFM_REPLAY_FIELD(RateDerivative, 3),
+		QFM_REPLAY_FIELD(PosTargetZ, 1),
+		QFM_REPLAY_FIELD(RateZIntegral, 1),
+		QFM_REPLAY_FIELD(RateZPreError, 1),
+		QFM_REPLAY_FIELD(RateZDerivative, 1),
+		QFM_REPLAY_FIELD(RotationRequest, 3),
+		QFM_REPLAY_FIELD(ThrottleRequest, 1),
+		QFM_REPLAY_FIELD(EngineMixPercent, MaxEngines),
+		QFM_REPLAY_FIELD(EngineSpeed, MaxEngines),
+		QFM_REPLAY_FIELD(EngineThrust, 3),
+		QFM_REPLAY_FIELD(EngineTorque, 3),
+		QFM_REPLAY_FIELD(Thrust, 3),
+		QFM_REPLAY_FIELD(Torque, 3),
+		QFM_REPLAY_FIELD(SchedulerAccumulator, 1),
+	};
+
+	#undef QFM_REPLAY_FIELD
+
+
+	// Where a replayed step first left the recording
+	struct FReplayDivergence
+	{
+		uint64_t RecordIndex = 0;		// in the file
+		uint32_t VehicleId = 0;
+		uint32_t Step = 0;
+		double SimTime = 0.0;
+		const char* Field = nullptr;	// ReplayFields name, "Flags", "SchedulerTickCount", "SensorImuIndex", "SensorBaroIndex", "SensorPositionIndex" or "EstimatorRejected"
+		int Component = 0;
+		double Recorded = 0.0;
+		double Replayed = 0.0;
+	};
+
+
+	struct FReplayVehicleResult
+	{
+		uint32_t VehicleId = 0;
+		uint64_t Steps = 0;				// replayed and compared
+		uint64_t Gaps = 0;				// lost records, the replay restarted from the next one
+		uint64_t DivergedSteps = 0;
+		float MaxError = 0.0f;
+		bool bConfigured = false;		// found its section in the config file
+		bool bDiverged = false;
+		FReplayDivergence First;
+	};
+
+
+
+	/*--- Deterministic offline replay of a flight record ---*/
+	// Feeds the recorded body snapshots, pilot axes and step lengths through a fresh FFlightModelCore per vehicle
+	// and compares what the controllers compute with what was recorded, one pass over the mapped file.
+	// Reseed: every step starts from the recorded state of the step before, so each divergence is one step's own.
+	// Free running: the state is only taken from the first record (and after gaps), errors add up as in flight.
+	// Bit exact only with the same compiler settings as the recording binary (FMA contraction), see Tolerance.
+	class FFlightReplayCore
+	{
+	public:
+
+		// Absolute tolerance, relative above magnitude 1. 0 = bit exact
+		float Tolerance = 0.0f;
+		bool bReseedEveryStep = true;
+
+
+		// Recorder config file (QFMCoreFlightConfig.h). Vehicles without a section keep the default parameters.
+		// Returns the number of unknown parameter names
+		int SetConfig(const std::string& ConfigFileText)
+		{
+			Config = ParseFlightConfigFile(ConfigFileText);
+
+			int Unknown = 0;
+			for (const auto& Section : Config)
+			{
+				FFlightModelCore Probe;
+				Unknown += ApplyFlightModelConfig(Section.second, Probe.GetRefs());
+			}
+			return Unknown;
+		}
+
+
+		void Run(const FFlightRecordView& View)
+		{
+			Vehicles.clear();
+			Results.clear();
+
+			const uint64_t Num = View.Num();
+			for (uint64_t i = 0; i < Num; i++)
+			{
+				const FFlightRecord& R = View[i];
+				FVehicleReplay& V = FindVehicle(R);
+
+				if (!V.Previous || R.Step != V.Previous->Step + 1)
+				{
+					// First record or one after a gap: nothing to replay, take its state
+					if (V.Previous)
+					{
+						Results[V.ResultIndex].Gaps++;
+					}
+					RestoreFlightRecordState(R, V.Model.GetRefs());
+					V.Previous = &R;
+					continue;
+				}
+
+				if (bReseedEveryStep)
+				{
+					RestoreFlightRecordState(*V.Previous, V.Model.GetRefs());
+				}
+				Step(V, R);
+				Compare(V, R, i);
+				V.Previous = &R;
+			}
+		}
+
+
+		const std::vector<FReplayVehicleResult>& GetResults() const { return Results; }
+
+		uint64_t GetSteps() const
+		{
+			uint64_t Steps = 0;
+			for (const FReplayVehicleResult& Result : Results)
+			{
+				Steps += Result.Steps;
+			}
+			return Steps;
+		}
+
+		// Earliest divergence in the file, over all vehicles
+		bool GetFirstDivergence(FReplayDivergence& Out) const
+		{
+			bool bFound = false;
+			for (const FReplayVehicleResult& Result : Results)
+			{
+				if (Result.bDiverged && (!bFound || Result.First.RecordIndex < Out.RecordIndex))
+				{
+					Out = Result.First;
+					bFound = true;
+				}
+			}
+			return bFound;
+		}
+
+
+	private:
+
+		struct FVehicleReplay
+		{
+			FFlightModelCore Model;
+			const FFlightRecord* Previous = nullptr;
+			size_t ResultIndex = 0;
+		};
+
+		std::map<uint32_t, std::string> Config;
+		std::map<uint32_t, std::unique_ptr<FVehicleReplay>> Vehicles;
+		std::vector<FReplayVehicleResult> Results;
+
+
+		FVehicleReplay& FindVehicle(const FFlightRecord& R)
+		{
+			std::unique_ptr<FVehicleReplay>& Slot = Vehicles[R.VehicleId];
+			if (!Slot)
+			{
+				Slot.reset(new FVehicleReplay());
+				Slot->ResultIndex = Results.size();
+				Results.emplace_back();
+				Results.back().VehicleId = R.VehicleId;
+
+				const auto Section = Config.find(R.VehicleId);
+				if (Section != Config.end())
+				{
+					ApplyFlightModelConfig(Section->second, Slot->Model.GetRefs());
+					Results.back().bConfigured = true;
+				}
+				Slot->Model.Init(RecordBody(R));
+			}
+			return *Slot;
+		}
+
+
+		static FBodyState RecordBody(const FFlightRecord& R)
+		{
+			FBodyState Body;
+			Body.Rotation = LoadFlightRecordQuat(R.Rotation);
+			Body.Position = LoadFlightRecordVec3(R.Position);
+			Body.LinearVelocity = LoadFlightRecordVec3(R.LinearVelocity);
+			Body.AngularVelocity = LoadFlightRecordVec3(R.AngularVelocity);
+			return Body;
+		}
+
+
+		static void Step(FVehicleReplay& V, const FFlightRecord& R)
+		{
+			FFlightModelCore& Model = V.Model;
+			Model.PilotInput.RollAxisInput = R.PilotAxisInput[0];
+			Model.PilotInput.PitchAxisInput = R.PilotAxisInput[1];
+			Model.PilotInput.YawAxisInput = R.PilotAxisInput[2];
+			Model.PilotInput.ThrottleAxisInput = R.PilotAxisInput[3];
+
+			if (R.Flags & FlightRecordMultiRate)
+			{
+				Model.SimulateMultiRate(RecordBody(R), R.DeltaTime);
+			}
+			else
+			{
+				Model.Simulate(RecordBody(R), R.DeltaTime);
+			}
+		}
+
+
+		void Compare(FVehicleReplay& V, const FFlightRecord& R, uint64_t RecordIndex)
+		{
+			FFlightModelCore& Model = V.Model;
+			FFlightRecord Replayed;
+			FillFlightRecord(Replayed, Model.GetRefs(), R.DeltaTime, RecordBody(R), (R.Flags & FlightRecordMultiRate) != 0,
+				Model.GetTotalThrust(), Model.GetTotalTorque());
+
+			FReplayVehicleResult& Result = Results[V.ResultIndex];
+			Result.Steps++;
+
+			FReplayDivergence Divergence;
+			bool bDiverged = false;
+
+			if (Replayed.Flags != R.Flags)
+			{
+				SetDivergence(Divergence, bDiverged, "Flags", 0, R.Flags, Replayed.Flags);
+			}
+			if (Replayed.SchedulerTickCount != R.SchedulerTickCount)
+			{
+				SetDivergence(Divergence, bDiverged, "SchedulerTickCount", 0, static_cast<double>(R.SchedulerTickCount), static_cast<double>(Replayed.SchedulerTickCount));
+			}
+			if (Replayed.SensorImuIndex != R.SensorImuIndex || Replayed.SensorBaroIndex != R.SensorBaroIndex)
+			{
+				const bool bImu = Replayed.SensorImuIndex != R.SensorImuIndex;
+				SetDivergence(Divergence, bDiverged, bImu ? "SensorImuIndex" : "SensorBaroIndex", 0,
+					bImu ? R.SensorImuIndex : R.SensorBaroIndex, bImu ? Replayed.SensorImuIndex : Replayed.SensorBaroIndex);
+			}
+			if (Replayed.SensorPositionIndex != R.SensorPositionIndex)
+			{
+				SetDivergence(Divergence, bDiverged, "SensorPositionIndex", 0, R.SensorPositionIndex, Replayed.SensorPositionIndex);
+			}
+			if (Replayed.EstimatorRejected != R.EstimatorRejected)
+			{
+				SetDivergence(Divergence, bDiverged, "EstimatorRejected", 0, R.EstimatorRejected, Replayed.EstimatorRejected);
+			}
+
+			const uint8_t* RecordedBytes = reinterpret_cast<const uint8_t*>(&R);
+			const uint8_t* ReplayedBytes = reinterpret_cast<const uint8_t*>(&Replayed);
+			for (const FReplayField& Field : ReplayFields)
+			{
+				const float* A = reinterpret_cast<const float*>(RecordedBytes + Field.Offset);
+				const float* B = reinterpret_cast<const float*>(ReplayedBytes + Field.Offset);
+				for (int c = 0; c < Field.Num; c++)
+				{
+					const float Error = std::fabs(A[c] - B[c]);
+					const bool bNaN = std::isnan(A[c]) || std::isnan(B[c]);
+					if (bNaN ? std::isnan(A[c]) != std::isnan(B[c]) : Error > Tolerance * std::fmax(1.0f, std::fabs(A[c])))
+					{
+						SetDivergence(Divergence, bDiverged, Field.Name, c, A[c], B[c]);
+					}
+					if (!bNaN && Error > Result.MaxError)
+					{
+						Result.MaxError = Error;
+					}
+				}
+			}
+
+			if (bDiverged)
+			{
+				Result.DivergedSteps++;
+				if (!Result.bDiverged)
+				{
+					Divergence.RecordIndex = RecordIndex;
+					Divergence.VehicleId = R.VehicleId;
+					Divergence.Step = R.Step;
+					Divergence.SimTime = R.SimTime;
+					Result.First = Divergence;
+					Result.bDiverged = true;
+				}
+			}
+		}
+
+
+		// Keeps the first field of a step
+		static void SetDivergence(FReplayDivergence& Out, bool& bDiverged, const char* Field, int Component, double Recorded, double Replayed)
+		{
+			if (bDiverged)
+			{
+				return;
+			}
+			Out.Field = Field;
+			Out.Component = Component;
+			Out.Recorded = Recorded;
+			Out.Replayed = Replayed;
+			bDiverged = true;
+		}
+	};
+
+}
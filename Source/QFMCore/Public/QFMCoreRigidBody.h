@@ -0,0 +1,48 @@
+#pragma once
+
+#include "QFMCoreTypes.h"
+
+
+namespace QFM
+{
+
+	/*--- Rigid body for offline tools, integrated the way the physics engine sees our forces ---*/
+	// UQuadcopterFlightModel::AddLocalForceZ applies Thrust.Z along the up vector, AddLocalTorque scales the
+	// local torque by the inertia tensor before handing it over. So thrust / Mass is the linear and the torque
+	// itself the angular acceleration (rad/s^2, local). The inertia tensor only acts on external disturbances.
+	// Semi-implicit Euler like the physics engine: velocities first, then positions with the new velocities.
+	struct FRigidBodyCore
+	{
+		FBodyState Body;
+		float Mass = 30.0f;									// in kg
+		FVec3 InertiaTensor = FVec3(200000.0f, 200000.0f, 400000.0f);	// in kg * cm^2, mass space
+		float Gravity = -9.81f;								// in m/s^2, world Z
+
+
+		// Thrust / Torque as FEngineCore::GetTotalThrust / GetTotalTorque. Disturbances in N and N*m, world space
+		void Step(const FVec3& Thrust, const FVec3& Torque, float DeltaTime,
+			const FVec3& DisturbanceForce = FVec3(), const FVec3& DisturbanceTorque = FVec3())
+		{
+			const FVec3 Acceleration = Body.Rotation.GetUpVector() * (Thrust.Z / Mass) + DisturbanceForce * (1.0f / Mass) + FVec3(0.0f, 0.0f, Gravity);
+
+			// kg * cm^2 -> kg * m^2
+			const FVec3 DisturbanceLocal = Body.Rotation.UnrotateVector(DisturbanceTorque);
+			const FVec3 AngularAccelerationLocal = Torque + FVec3(
+				DisturbanceLocal.X * 10000.0f / InertiaTensor.X,
+				DisturbanceLocal.Y * 10000.0f / InertiaTensor.Y,
+				DisturbanceLocal.Z * 10000.0f / InertiaTensor.Z);
+
+			Body.LinearVelocity = Body.LinearVelocity + Acceleration * DeltaTime;
+			Body.AngularVelocity = Body.AngularVelocity + Body.Rotation.RotateVector(AngularAccelerationLocal) * DeltaTime;
+			Body.Position = Body.Position + Body.LinearVelocity * DeltaTime;
+
+			const float Rate = Body.AngularVelocity.Size();
+			if (Rate > SmallNumber)
+			{
+				Body.Rotation = FQuatf(Body.AngularVelocity * (1.0f / Rate), Rate * DeltaTime) * Body.Rotation;
+				Body.Rotation.Normalize();
+			}
+		}
+	};
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace QFM
+{
+
+	/*--- Lock-free single producer / single consumer ring ---*/
+	// One thread pushes, one other thread pops. Never blocks, never allocates: a full ring drops the new item.
+	// Capacity must be a power of two. Head and Tail are free running counters.
+	template <typename T, uint32_t Capacity>
+	class TSpscRing
+	{
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+
+		// Producer side. Returns false (and counts the drop) if the ring is full
+		bool Push(const T& Item)
+		{
+			const uint32_t H = Head.load(std::memory_order_relaxed);
+			if (H - CachedTail >= Capacity)
+			{
+				// Only touch the consumers cache line when our cached view says full
+				CachedTail = Tail.load(std::memory_order_acquire);
+				if (H - CachedTail >= Capacity)
+				{
+					Dropped.store(Dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					return false;
+				}
+			}
+			Items[H & Mask] = Item;
+			Head.store(H + 1, std::memory_order_release);
+			return true;
+		}
+
+
+		// Consumer side. Copies up to MaxCount items to Out, returns how many
+		uint32_t Pop(T* Out, uint32_t MaxCount)
+		{
+			const uint32_t T0 = Tail.load(std::memory_order_relaxed);
+			const uint32_t Available = Head.load(std::memory_order_acquire) - T0;
+			const uint32_t Count = Available < MaxCount ? Available : MaxCount;
+			for (uint32_t i = 0; i < Count; i++)
+			{
+				Out[i] = Items[(T0 + i) & Mask];
+			}
+			Tail.store(T0 + Count, std::memory_order_release);
+			return Count;
+		}
+
+
+		// Approximate when called concurrently
+		uint32_t Num() const
+		{
+			return Head.load(std::memory_order_acquire) - Tail.load(std::memory_order_acquire);
+		}
+
+		uint64_t GetDropped() const
+		{
+			return Dropped.load(std::memory_order_relaxed);
+		}
+
+		static constexpr uint32_t GetCapacity() { return Capacity; }
+
+
+	private:
+
+		static constexpr uint32_t Mask = Capacity - 1;
+
+		// Producer owned
+		alignas(64) std::atomic<uint32_t> Head{ 0 };
+		uint32_t CachedTail = 0;
+		std::atomic<uint64_t> Dropped{ 0 };
+
+		// Consumer owned
+		alignas(64) std::atomic<uint32_t> Tail{ 0 };
+
+		alignas(64) T Items[Capacity];
+	};
+
+}
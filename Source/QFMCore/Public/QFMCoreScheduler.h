@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "QFMCoreTypes.h"
+
+
+namespace QFM
+{
+
+	// Stages of one controller step, in execution order
+	enum class EControlStage : int
+	{
+		Input = 0,
+		AHRS,
+		Attitude,	// attitude + rate loop
+		Position,
+		Engine,
+		Num
+	};
+
+
+
+	/*--- Multi-rate fixed-step scheduler ---*/
+	// The rate loop (attitude + engine) is the base tick and runs at RateLoopHz.
+	// Every other stage runs on every Nth base tick, N = round(RateLoopHz / StageHz), so all stages stay phase locked.
+	// Physics hands in variable DeltaTimes, an accumulator turns them into a whole number of base ticks.
+	//
+	//	const int Ticks = Scheduler.Advance(DeltaTime);
+	//	for (int i = 0; i < Ticks; i++, Scheduler.NextTick())
+	//		if (Scheduler.IsDue(EControlStage::Input)) { ... Tock(Scheduler.GetStageDeltaTime(EControlStage::Input)) }
+	struct FMultiRateSchedulerCore
+	{
+		/*--- PARAMETERS ---*/
+		float RateLoopHz = 1000.0f;
+		float InputHz = 100.0f;
+		float AHRSHz = 500.0f;
+		float PositionHz = 50.0f;
+		int MaxTicksPerStep = 64;		// Time beyond this is dropped instead of spiralling on long frames
+
+		/*--- STATE ---*/
+		float TickPeriod = 0.001f;
+		float Accumulator = 0.0f;
+		uint64_t TickCount = 0;
+		uint64_t DroppedTicks = 0;
+		int Divider[(int)EControlStage::Num] = { 1, 1, 1, 1, 1 };
+
+
+		void Init()
+		{
+			RateLoopHz = RateLoopHz > 1.0f ? RateLoopHz : 1.0f;
+			TickPeriod = 1.0f / RateLoopHz;
+
+			Divider[(int)EControlStage::Input] = GetDivider(InputHz);
+			Divider[(int)EControlStage::AHRS] = GetDivider(AHRSHz);
+			Divider[(int)EControlStage::Attitude] = 1;
+			Divider[(int)EControlStage::Position] = GetDivider(PositionHz);
+			Divider[(int)EControlStage::Engine] = 1;
+
+			Reset();
+		}
+
+
+		void Reset()
+		{
+			Accumulator = 0.0f;
+			TickCount = 0;
+			DroppedTicks = 0;
+		}
+
+
+		// Add elapsed physics time, returns the number of base ticks to run now
+		int Advance(float DeltaTime)
+		{
+			if (DeltaTime <= 0.0f) { return 0; }
+
+			Accumulator += DeltaTime;
+			int Ticks = static_cast<int>(Accumulator / TickPeriod);
+			Accumulator -= Ticks * TickPeriod;
+
+			// float rounding may leave a tick just below the boundary
+			if (Accumulator > TickPeriod - TickPeriod * 1e-4f)
+			{
+				Ticks++;
+				Accumulator = 0.0f;
+			}
+
+			if (Ticks > MaxTicksPerStep)
+			{
+				DroppedTicks += Ticks - MaxTicksPerStep;
+				Ticks = MaxTicksPerStep;
+			}
+			return Ticks;
+		}
+
+
+		void NextTick()
+		{
+			TickCount++;
+		}
+
+
+		bool IsDue(EControlStage Stage) const
+		{
+			return (TickCount % Divider[(int)Stage]) == 0;
+		}
+
+
+		// Fixed delta time the stage integrates over
+		float GetStageDeltaTime(EControlStage Stage) const
+		{
+			return TickPeriod * Divider[(int)Stage];
+		}
+
+
+		float GetStageRateHz(EControlStage Stage) const
+		{
+			return 1.0f / GetStageDeltaTime(Stage);
+		}
+
+
+	private:
+
+		int GetDivider(float StageHz) const
+		{
+			if (StageHz <= 0.0f || StageHz >= RateLoopHz) { return 1; }
+			return static_cast<int>(std::floor(RateLoopHz / StageHz + 0.5f));
+		}
+	};
+
+
+
+	// Propagate the body state of the physics step start to a rate loop tick inside the step,
+	// assuming constant linear and angular velocity. Gives the substeps a moving attitude to control.
+	inline FBodyState PredictBodyState(const FBodyState& Body, float Elapsed)
+	{
+		if (Elapsed <= 0.0f) { return Body; }
+
+		FBodyState Predicted = Body;
+		Predicted.Position = Body.Position + Body.LinearVelocity * Elapsed;
+
+		const float Rate = Body.AngularVelocity.Size();
+		if (Rate > SmallNumber)
+		{
+			// World space angular velocity -> rotate in world frame
+			Predicted.Rotation = FQuatf(Body.AngularVelocity * (1.0f / Rate), Rate * Elapsed) * Body.Rotation;
+			Predicted.Rotation.Normalize();
+		}
+		return Predicted;
+	}
+
+}
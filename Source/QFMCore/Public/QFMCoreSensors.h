@@ -0,0 +1,406 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreSimd.h"
+#include "QFMCoreRandom.h"
+#include "QFMCoreEngine.h"
+
+
+namespace QFM
+{
+
+	constexpr float MinImuRateHz = 1000.0f;
+	constexpr float MaxImuRateHz = 8000.0f;
+	constexpr int MaxImuBatch = 512;			// samples per AHRS step, 8 kHz down to a 16 Hz AHRS
+	constexpr int MaxImuLatency = 64;			// samples of delay, power of 2
+	constexpr int ImuChunk = 32;				// samples generated together on the stack, multiple of PhiloxLanes
+
+
+	/*--- Error model of one inertial sensor (3 axes) ---*/
+	// Units of the sensor: rad/s for the gyro, m/s^2 for the accelerometer. All 0 is a perfect sensor
+	struct FInertialSensorSettings
+	{
+		float NoiseDensity = 0.0f;		// white noise per sqrt(Hz), std dev of a sample is NoiseDensity * sqrt(ImuRateHz)
+		float BiasRandomWalk = 0.0f;	// bias drift per sqrt(s)
+		float InitialBias = 0.0f;		// std dev of the turn-on bias, drawn at Reset
+		float Resolution = 0.0f;		// LSB, 0 = not quantized
+		float Range = 0.0f;				// saturates at +-Range, 0 = unlimited
+		float Vibration = 0.0f;			// amplitude at full engine speed, rotating with every motor in the body XY plane
+	};
+
+
+	/*--- IMU, barometer and position sensor ---*/
+	struct FSensorSettings
+	{
+		bool Enabled = false;				// false: the AHRS reads the body state (former behaviour)
+		float ImuRateHz = 2000.0f;			// internal sample rate, 1 to 8 kHz
+		float LatencySeconds = 0.0f;		// sample delay, up to MaxImuLatency - 1 samples
+		int Seed = 1;						// of the noise streams
+		float Gravity = -9.81f;				// in m/s^2, world Z, the accelerometer measures the specific force
+		FInertialSensorSettings Gyro;
+		FInertialSensorSettings Accelerometer;
+		float BaroRateHz = 50.0f;			// 0 = no barometer, the AHRS keeps the body altitude
+		float BaroNoise = 0.0f;				// std dev of a reading in m
+		float BaroBiasRandomWalk = 0.0f;	// in m per sqrt(s)
+		float BaroResolution = 0.0f;		// in m, 0 = not quantized
+		float PositionRateHz = 0.0f;		// position fixes (GNSS like) per s, 0 = no position sensor
+		float PositionNoise = 0.0f;			// std dev of a fix per axis in m
+		float HeadingNoise = 0.0f;			// std dev of the heading (yaw) that comes with a fix, in rad
+	};
+
+
+	// IMU samples since the last AHRS step, oldest first, body frame
+	struct FImuBatch
+	{
+		int Count = 0;
+		float SamplePeriod = 0.0f;					// s
+		float Gyro[3][MaxImuBatch];					// rad/s
+		float Accelerometer[3][MaxImuBatch];		// m/s^2, specific force: -Gravity on the body Z axis at rest
+		bool bBaroValid = false;
+		bool bBaroNew = false;						// BaroAltitude was read in this step
+		float BaroAltitude = 0.0f;					// m, the latest reading
+		bool bPositionNew = false;					// a position fix in this step
+		FVec3 Position;								// m, world
+		float Heading = 0.0f;						// rad, yaw of the body X axis as FRotatorf::Yaw
+	};
+
+
+
+	/*--- Simulated IMU, barometer and position sensor ---*/
+	// Generates the samples of a sensor running at ImuRateHz between two AHRS steps. The body state is only known at
+	// the steps, so the true body rate and specific force are taken at both ends of the step in the body frame and
+	// interpolated linearly (exact for a constant rate and acceleration). On top come the rotating imbalance of every
+	// motor (EngineSpeed^2 at its rotation frequency), bias with random walk, white noise, saturation and quantization.
+	// Noise is counter based: sample N draws counter N of its stream (GenerateNormals), whatever the batch sizes were.
+	// The latency ring is not part of the flight record, a replay with latency needs to start at the first record.
+	struct FSensorCore
+	{
+		// Substreams of the Seed key
+		enum ESubstream : uint32_t { SubstreamImu = 1, SubstreamBaro = 2, SubstreamTurnOn = 3, SubstreamPosition = 4 };
+
+		/*--- PARAMETERS ---*/
+		FSensorSettings Settings;
+
+		/*--- STATE ---*/
+		float ImuTimer = 0.0f;				// s since the last IMU sample
+		float BaroTimer = 0.0f;				// s since the last baro reading
+		float PositionTimer = 0.0f;			// s since the last position fix
+		uint32_t ImuIndex = 0;				// IMU samples drawn, noise counter
+		uint32_t BaroIndex = 0;
+		uint32_t PositionIndex = 0;
+		float GyroBias[3] = {};
+		float AccelerometerBias[3] = {};
+		float BaroBias = 0.0f;
+		float BaroAltitude = 0.0f;
+		bool bBaroValid = false;
+		float VibrationPhase[MaxEngines] = {};	// rad, of the next sample
+
+		// Body state of the last step, the start of the next interpolation
+		bool bHasLast = false;
+		FQuatf LastRotation;
+		FVec3 LastAngularVelocity;			// rad/s, world
+		FVec3 LastVelocity;					// m/s, world
+
+		// Measured samples on their way to the AHRS
+		float Delay[6][MaxImuLatency];
+		int DelayHead = 0;
+		bool bDelayPrimed = false;
+
+
+		void Reset()
+		{
+			ImuTimer = 0.0f;
+			BaroTimer = 0.0f;
+			PositionTimer = 0.0f;
+			ImuIndex = 0;
+			BaroIndex = 0;
+			PositionIndex = 0;
+			BaroBias = 0.0f;
+			BaroAltitude = 0.0f;
+			bBaroValid = false;
+			for (int m = 0; m < MaxEngines; m++)
+			{
+				VibrationPhase[m] = 0.0f;
+			}
+			bHasLast = false;
+			DelayHead = 0;
+			bDelayPrimed = false;
+
+			FRandomStream TurnOn(static_cast<uint32_t>(Settings.Seed), 0, SubstreamTurnOn);
+			for (int a = 0; a < 3; a++)
+			{
+				GyroBias[a] = Settings.Gyro.InitialBias * TurnOn.Normal();
+				AccelerometerBias[a] = Settings.Accelerometer.InitialBias * TurnOn.Normal();
+			}
+		}
+
+
+		// Samples from the end of the last step to Body, DeltaTime later. Engine (optional) drives the vibration
+		void Sample(const FBodyState& Body, float DeltaTime, const FEngineCore* Engine, FImuBatch& Out)
+		{
+			const float Rate = Clamp(Settings.ImuRateHz, MinImuRateHz, MaxImuRateHz);
+			const float Period = 1.0f / Rate;
+			Out.Count = 0;
+			Out.SamplePeriod = Period;
+			Out.bBaroNew = false;
+			Out.bPositionNew = false;
+			if (DeltaTime <= 0.0f)
+			{
+				return;
+			}
+			if (!bHasLast)
+			{
+				LastRotation = Body.Rotation;
+				LastAngularVelocity = Body.AngularVelocity;
+				LastVelocity = Body.LinearVelocity;
+				bHasLast = true;
+			}
+
+			// True rate and specific force in the body frame at both ends of the step
+			const FVec3 SpecificForce = (Body.LinearVelocity - LastVelocity) * (1.0f / DeltaTime) - FVec3(0.0f, 0.0f, Settings.Gravity);
+			const FVec3 StartRate = LastRotation.UnrotateVector(LastAngularVelocity);
+			const FVec3 EndRate = Body.Rotation.UnrotateVector(Body.AngularVelocity);
+			const FVec3 StartForce = LastRotation.UnrotateVector(SpecificForce);
+			const FVec3 EndForce = Body.Rotation.UnrotateVector(SpecificForce);
+			const float Start[6] = { StartRate.X, StartRate.Y, StartRate.Z, StartForce.X, StartForce.Y, StartForce.Z };
+			const float End[6] = { EndRate.X, EndRate.Y, EndRate.Z, EndForce.X, EndForce.Y, EndForce.Z };
+
+			LastRotation = Body.Rotation;
+			LastAngularVelocity = Body.AngularVelocity;
+			LastVelocity = Body.LinearVelocity;
+
+			// Samples every Period after the last one up to the end of the step. A sample due within 1/1000 of a period
+			// is taken now, so rounding of the timer does not drop one. Only the newest MaxImuBatch are kept
+			const float StartTimer = ImuTimer;
+			const float Elapsed = ImuTimer + DeltaTime;
+			const int Num = static_cast<int>(Elapsed * Rate + 0.001f);
+			ImuTimer = Elapsed - Num * Period;
+			if (ImuTimer < 0.0f)
+			{
+				ImuTimer = 0.0f;
+			}
+			const int Skip = Num > MaxImuBatch ? Num - MaxImuBatch : 0;
+			ImuIndex += static_cast<uint32_t>(Skip);
+
+			for (int First = Skip; First < Num; First += ImuChunk)
+			{
+				const int Count = Num - First < ImuChunk ? Num - First : ImuChunk;
+				SampleChunk(Start, End, (First + 1) * Period - StartTimer, Period, 1.0f / DeltaTime, Count, Rate, Engine, Out);
+			}
+
+			SampleBaro(Body, DeltaTime, Out);
+			SamplePosition(Body, DeltaTime, Out);
+		}
+
+
+	private:
+
+		static bool HasNoise(const FInertialSensorSettings& Sensor)
+		{
+			return Sensor.NoiseDensity != 0.0f || Sensor.BiasRandomWalk != 0.0f;
+		}
+
+
+		// Count samples, the first At seconds into the step
+		void SampleChunk(const float Start[6], const float End[6], float At, float Period, float InvDeltaTime, int Count, float Rate,
+			const FEngineCore* Engine, FImuBatch& Out)
+		{
+			// Per sample: white noise of the 6 channels, then their bias walk. A perfect sensor draws nothing
+			float Noise[12][ImuChunk] = {};
+			if (HasNoise(Settings.Gyro) || HasNoise(Settings.Accelerometer))
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					const uint32_t Key[2] = { 0, static_cast<uint32_t>(Settings.Seed) };
+					const uint32_t Counter[4] = { ImuIndex, 0, SubstreamImu, static_cast<uint32_t>(j) };
+					float* const Words[4] = { Noise[4 * j], Noise[4 * j + 1], Noise[4 * j + 2], Noise[4 * j + 3] };
+					GenerateNormals(Key, Counter, Count, Words);
+				}
+			}
+			ImuIndex += static_cast<uint32_t>(Count);
+
+			alignas(SimdAlignment) float Fraction[ImuChunk] = {};
+			for (int k = 0; k < Count; k++)
+			{
+				const float Time = (At + k * Period) * InvDeltaTime;
+				Fraction[k] = Time < 1.0f ? Time : 1.0f;
+			}
+
+			// Sum of EngineSpeed^2 * (sin, cos) of the motor phases
+			alignas(SimdAlignment) float Vibration[2][ImuChunk] = {};
+			if (Engine && (Settings.Gyro.Vibration != 0.0f || Settings.Accelerometer.Vibration != 0.0f))
+			{
+				const int NumMotors = Engine->GetNumEngines();
+				for (int m = 0; m < NumMotors && m < MaxEngines; m++)
+				{
+					const float Speed = Engine->EngineSpeed[m];
+					const float Amplitude = Speed * Speed;
+					const float Step = 2.0f * Pi * Speed * Engine->EngineMaxRPM / 60.0f * Period;
+					const float StepCos = std::cos(Step);
+					const float StepSin = std::sin(Step);
+					float Cos = std::cos(VibrationPhase[m]);
+					float Sin = std::sin(VibrationPhase[m]);
+					for (int k = 0; k < Count; k++)
+					{
+						Vibration[0][k] += Amplitude * Sin;
+						Vibration[1][k] += Amplitude * Cos;
+						const float NextCos = Cos * StepCos - Sin * StepSin;
+						Sin = Sin * StepCos + Cos * StepSin;
+						Cos = NextCos;
+					}
+					VibrationPhase[m] = std::fmod(VibrationPhase[m] + Count * Step, 2.0f * Pi);
+				}
+			}
+
+			alignas(SimdAlignment) float Measured[6][ImuChunk];
+			for (int c = 0; c < 6; c++)
+			{
+				const FInertialSensorSettings& Sensor = c < 3 ? Settings.Gyro : Settings.Accelerometer;
+				float& Bias = c < 3 ? GyroBias[c] : AccelerometerBias[c - 3];
+
+				alignas(SimdAlignment) float BiasLane[ImuChunk] = {};
+				const float Walk = Sensor.BiasRandomWalk * std::sqrt(Period);
+				for (int k = 0; k < Count; k++)
+				{
+					Bias += Walk * Noise[6 + c][k];
+					BiasLane[k] = Bias;
+				}
+
+				const FSimdFloat StartValue(Start[c]);
+				const FSimdFloat Slope(End[c] - Start[c]);
+				const FSimdFloat Sigma(Sensor.NoiseDensity * std::sqrt(Rate));
+				const FSimdFloat VibrationAmplitude(c % 3 < 2 ? Sensor.Vibration : 0.0f);
+				const float* VibrationLane = Vibration[c % 3 < 2 ? c % 3 : 0];
+				const bool bRange = Sensor.Range > 0.0f;
+				const bool bQuantized = Sensor.Resolution > 0.0f;
+				const FSimdFloat Range(Sensor.Range);
+				const FSimdFloat Resolution(Sensor.Resolution);
+				const FSimdFloat InvResolution(bQuantized ? 1.0f / Sensor.Resolution : 0.0f);
+				const FSimdFloat MaxSteps(4194304.0f);
+
+				for (int k = 0; k < Count; k += SimdWidth)
+				{
+					FSimdFloat Value = SimdMulAdd(Slope, FSimdFloat::Load(&Fraction[k]), StartValue);
+					Value = SimdMulAdd(VibrationAmplitude, FSimdFloat::Load(&VibrationLane[k]), Value);
+					Value = SimdMulAdd(Sigma, FSimdFloat::LoadUnaligned(&Noise[c][k]), Value + FSimdFloat::Load(&BiasLane[k]));
+					if (bRange)
+					{
+						Value = SimdClamp(Value, FSimdFloat(0.0f) - Range, Range);
+					}
+					if (bQuantized)
+					{
+						Value = SimdRound(SimdClamp(Value * InvResolution, FSimdFloat(0.0f) - MaxSteps, MaxSteps)) * Resolution;
+					}
+					Value.Store(&Measured[c][k]);
+				}
+			}
+
+			// Through the latency ring into the batch
+			const int Latency = Clamp(static_cast<int>(Settings.LatencySeconds * Rate + 0.5f), 0, MaxImuLatency - 1);
+			float* const Dst[6] = { Out.Gyro[0] + Out.Count, Out.Gyro[1] + Out.Count, Out.Gyro[2] + Out.Count,
+				Out.Accelerometer[0] + Out.Count, Out.Accelerometer[1] + Out.Count, Out.Accelerometer[2] + Out.Count };
+			if (Latency == 0)
+			{
+				for (int c = 0; c < 6; c++)
+				{
+					for (int k = 0; k < Count; k++)
+					{
+						Dst[c][k] = Measured[c][k];
+					}
+				}
+			}
+			else
+			{
+				if (!bDelayPrimed)
+				{
+					// Until the ring is full the sensor repeats its first sample
+					for (int c = 0; c < 6; c++)
+					{
+						for (int i = 0; i < MaxImuLatency; i++)
+						{
+							Delay[c][i] = Measured[c][0];
+						}
+					}
+					bDelayPrimed = true;
+				}
+				for (int k = 0; k < Count; k++)
+				{
+					const int Read = (DelayHead - Latency) & (MaxImuLatency - 1);
+					for (int c = 0; c < 6; c++)
+					{
+						Delay[c][DelayHead] = Measured[c][k];
+						Dst[c][k] = Delay[c][Read];
+					}
+					DelayHead = (DelayHead + 1) & (MaxImuLatency - 1);
+				}
+			}
+			Out.Count += Count;
+		}
+
+
+		// One reading per BaroRateHz period, at the end of the step that completes it
+		void SampleBaro(const FBodyState& Body, float DeltaTime, FImuBatch& Out)
+		{
+			if (Settings.BaroRateHz > 0.0f)
+			{
+				const float BaroPeriod = 1.0f / Settings.BaroRateHz;
+				BaroTimer += DeltaTime;
+				if (BaroTimer >= BaroPeriod || !bBaroValid)
+				{
+					BaroTimer = std::fmod(BaroTimer, BaroPeriod);
+
+					float Normals[4][1];
+					float* const Words[4] = { Normals[0], Normals[1], Normals[2], Normals[3] };
+					const uint32_t Key[2] = { 0, static_cast<uint32_t>(Settings.Seed) };
+					const uint32_t Counter[4] = { BaroIndex++, 0, SubstreamBaro, 0 };
+					GenerateNormals(Key, Counter, 1, Words);
+
+					BaroBias += Settings.BaroBiasRandomWalk * std::sqrt(BaroPeriod) * Normals[1][0];
+					float Altitude = Body.Position.Z + BaroBias + Settings.BaroNoise * Normals[0][0];
+					if (Settings.BaroResolution > 0.0f)
+					{
+						Altitude = std::nearbyint(Altitude / Settings.BaroResolution) * Settings.BaroResolution;
+					}
+					BaroAltitude = Altitude;
+					bBaroValid = true;
+					Out.bBaroNew = true;
+				}
+			}
+			Out.bBaroValid = bBaroValid;
+			Out.BaroAltitude = BaroAltitude;
+		}
+
+
+		// One fix per PositionRateHz period, at the end of the step that completes it: position and heading with white noise
+		void SamplePosition(const FBodyState& Body, float DeltaTime, FImuBatch& Out)
+		{
+			if (Settings.PositionRateHz <= 0.0f)
+			{
+				return;
+			}
+			const float PositionPeriod = 1.0f / Settings.PositionRateHz;
+			PositionTimer += DeltaTime;
+			if (PositionTimer < PositionPeriod && PositionIndex > 0)
+			{
+				return;
+			}
+			PositionTimer = std::fmod(PositionTimer, PositionPeriod);
+
+			float Normals[4][1];
+			float* const Words[4] = { Normals[0], Normals[1], Normals[2], Normals[3] };
+			const uint32_t Key[2] = { 0, static_cast<uint32_t>(Settings.Seed) };
+			const uint32_t Counter[4] = { PositionIndex++, 0, SubstreamPosition, 0 };
+			GenerateNormals(Key, Counter, 1, Words);
+
+			const FQuatf& Q = Body.Rotation;
+			const float Yaw = std::atan2(2.0f * (Q.W * Q.Z + Q.X * Q.Y), 1.0f - 2.0f * (Q.Y * Q.Y + Q.Z * Q.Z));
+			Out.Position = Body.Position + FVec3(Normals[0][0], Normals[1][0], Normals[2][0]) * Settings.PositionNoise;
+			Out.Heading = Yaw + Settings.HeadingNoise * Normals[3][0];
+			Out.bPositionNew = true;
+		}
+	};
+
+}
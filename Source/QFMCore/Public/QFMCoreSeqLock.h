@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+namespace QFM
+{
+
+	/*--- Seqlock published value ---*/
+	// One writer publishes a trivially copyable value, any number of readers copy it. The writer never waits,
+	// readers never block the writer and retry at most a few times. A read that overlapped a write is detected
+	// by the sequence number and thrown away, so a torn value is never returned.
+	// The payload is stored in relaxed atomic words, which keeps the overlapping accesses well defined.
+	template <typename T>
+	class TSeqLock
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "TSeqLock needs a trivially copyable type");
+
+	public:
+
+		TSeqLock()
+		{
+			Write(T());
+			Sequence.store(0, std::memory_order_relaxed);
+		}
+
+		TSeqLock(const TSeqLock&) = delete;
+		TSeqLock& operator=(const TSeqLock&) = delete;
+
+
+		// Writer side, single thread only
+		void Write(const T& Item)
+		{
+			uint64_t Words[NumWords] = {};
+			std::memcpy(Words, &Item, sizeof(T));
+
+			const uint32_t Seq = Sequence.load(std::memory_order_relaxed);
+			Sequence.store(Seq + 1, std::memory_order_relaxed);		// odd: write in progress
+			std::atomic_thread_fence(std::memory_order_release);
+
+			for (size_t i = 0; i < NumWords; i++)
+			{
+				Data[i].store(Words[i], std::memory_order_relaxed);
+			}
+
+			Sequence.store(Seq + 2, std::memory_order_release);
+		}
+
+
+		// Reader side. Returns false (Out untouched) if a write was in progress or happened during the copy
+		bool TryRead(T& Out) const
+		{
+			const uint32_t Before = Sequence.load(std::memory_order_acquire);
+			if (Before & 1)
+			{
+				return false;
+			}
+
+			uint64_t Words[NumWords];
+			for (size_t i = 0; i < NumWords; i++)
+			{
+				Words[i] = Data[i].load(std::memory_order_relaxed);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (Sequence.load(std::memory_order_relaxed) != Before)
+			{
+				return false;
+			}
+
+			std::memcpy(&Out, Words, sizeof(T));
+			return true;
+		}
+
+		// TryRead with a few retries. Still never waits for the writer: on failure the caller keeps its last copy
+		bool Read(T& Out, int MaxAttempts = 4) const
+		{
+			for (int i = 0; i < MaxAttempts; i++)
+			{
+				if (TryRead(Out))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Number of completed writes. Readers can skip the copy if it did not change
+		uint32_t GetVersion() const
+		{
+			return Sequence.load(std::memory_order_acquire) >> 1;
+		}
+
+
+	private:
+
+		static constexpr size_t NumWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+		alignas(64) std::atomic<uint32_t> Sequence{ 0 };
+		std::atomic<uint64_t> Data[NumWords];
+	};
+
+}
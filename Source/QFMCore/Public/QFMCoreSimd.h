@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#if defined(__AVX2__) && defined(__FMA__)
+	#include <immintrin.h>
+	#define QFM_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define QFM_SIMD_SSE2 1
+#endif
+
+
+/*--- Minimal SIMD float abstraction for the SoA kernels ---*/
+// 8 lanes with AVX2+FMA, 4 lanes with SSE2, 1 lane otherwise.
+// All fleet arrays are padded to QFM::SimdWidth and aligned to QFM::SimdAlignment.
+// Lanes inside a core struct use the Unaligned loads: new does not over-align before C++17.
+// LoadPartial builds a vector from a few scalars in registers: no store forwarding stall right after they were
+// written one by one, no read past the last one.
+
+namespace QFM
+{
+
+#if QFM_SIMD_AVX2
+
+	constexpr int SimdWidth = 8;
+
+	struct FSimdFloat
+	{
+		__m256 V;
+
+		FSimdFloat() {}
+		FSimdFloat(__m256 In) : V(In) {}
+		explicit FSimdFloat(float S) : V(_mm256_set1_ps(S)) {}
+
+		static FSimdFloat Load(const float* P) { return _mm256_load_ps(P); }
+		void Store(float* P) const { _mm256_store_ps(P, V); }
+		static FSimdFloat LoadUnaligned(const float* P) { return _mm256_loadu_ps(P); }
+		void StoreUnaligned(float* P) const { _mm256_storeu_ps(P, V); }
+		// The first Count (< SimdWidth: the rest is 0) of P, lane by lane
+		static FSimdFloat LoadPartial(const float* P, int Count)
+		{
+			return _mm256_setr_ps(Count > 0 ? P[0] : 0.0f, Count > 1 ? P[1] : 0.0f, Count > 2 ? P[2] : 0.0f, Count > 3 ? P[3] : 0.0f,
+				Count > 4 ? P[4] : 0.0f, Count > 5 ? P[5] : 0.0f, Count > 6 ? P[6] : 0.0f, Count > 7 ? P[7] : 0.0f);
+		}
+		void StorePartial(float* P, int Count) const
+		{
+			alignas(32) float Lanes[8];
+			_mm256_store_ps(Lanes, V);
+			for (int i = 0; i < Count && i < 8; i++) { P[i] = Lanes[i]; }
+		}
+	};
+
+	inline FSimdFloat operator+(FSimdFloat A, FSimdFloat B) { return _mm256_add_ps(A.V, B.V); }
+	inline FSimdFloat operator-(FSimdFloat A, FSimdFloat B) { return _mm256_sub_ps(A.V, B.V); }
+	inline FSimdFloat operator*(FSimdFloat A, FSimdFloat B) { return _mm256_mul_ps(A.V, B.V); }
+	inline FSimdFloat operator/(FSimdFloat A, FSimdFloat B) { return _mm256_div_ps(A.V, B.V); }
+	inline FSimdFloat SimdMin(FSimdFloat A, FSimdFloat B) { return _mm256_min_ps(A.V, B.V); }
+	inline FSimdFloat SimdMax(FSimdFloat A, FSimdFloat B) { return _mm256_max_ps(A.V, B.V); }
+	inline FSimdFloat SimdSqrt(FSimdFloat A) { return _mm256_sqrt_ps(A.V); }
+	// 1 / sqrt(A): estimate and one Newton step, relative error < 4e-7
+	inline FSimdFloat SimdRsqrt(FSimdFloat A)
+	{
+		const __m256 Y = _mm256_rsqrt_ps(A.V);
+		const __m256 HalfAYY = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), A.V), _mm256_mul_ps(Y, Y));
+		return _mm256_mul_ps(Y, _mm256_sub_ps(_mm256_set1_ps(1.5f), HalfAYY));
+	}
+	// A * B + C
+	inline FSimdFloat SimdMulAdd(FSimdFloat A, FSimdFloat B, FSimdFloat C) { return _mm256_fmadd_ps(A.V, B.V, C.V); }
+	inline FSimdFloat SimdAbs(FSimdFloat A) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), A.V); }
+	// Mask ? A : B, Mask from the compare functions
+	inline FSimdFloat SimdSelect(FSimdFloat Mask, FSimdFloat A, FSimdFloat B) { return _mm256_blendv_ps(B.V, A.V, Mask.V); }
+	inline FSimdFloat SimdLess(FSimdFloat A, FSimdFloat B) { return _mm256_cmp_ps(A.V, B.V, _CMP_LT_OQ); }
+	inline FSimdFloat SimdGreater(FSimdFloat A, FSimdFloat B) { return _mm256_cmp_ps(A.V, B.V, _CMP_GT_OQ); }
+	// To the nearest integer, ties to even
+	inline FSimdFloat SimdRound(FSimdFloat A) { return _mm256_round_ps(A.V, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+	// A = Mantissa * 2^Exponent, Mantissa in [1, 2), for normal A > 0. Returns the exponent
+	inline FSimdFloat SimdSplitExponent(FSimdFloat A, FSimdFloat& Mantissa)
+	{
+		const __m256i Bits = _mm256_castps_si256(A.V);
+		Mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(Bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)));
+		return _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(Bits, 23), _mm256_set1_epi32(127)));
+	}
+
+#elif QFM_SIMD_SSE2
+
+	constexpr int SimdWidth = 4;
+
+	struct FSimdFloat
+	{
+		__m128 V;
+
+		FSimdFloat() {}
+		FSimdFloat(__m128 In) : V(In) {}
+		explicit FSimdFloat(float S) : V(_mm_set1_ps(S)) {}
+
+		static FSimdFloat Load(const float* P) { return _mm_load_ps(P); }
+		void Store(float* P) const { _mm_store_ps(P, V); }
+		static FSimdFloat LoadUnaligned(const float* P) { return _mm_loadu_ps(P); }
+		void StoreUnaligned(float* P) const { _mm_storeu_ps(P, V); }
+		static FSimdFloat LoadPartial(const float* P, int Count)
+		{
+			return _mm_setr_ps(Count > 0 ? P[0] : 0.0f, Count > 1 ? P[1] : 0.0f, Count > 2 ? P[2] : 0.0f, Count > 3 ? P[3] : 0.0f);
+		}
+		void StorePartial(float* P, int Count) const
+		{
+			alignas(16) float Lanes[4];
+			_mm_store_ps(Lanes, V);
+			for (int i = 0; i < Count && i < 4; i++) { P[i] = Lanes[i]; }
+		}
+	};
+
+	inline FSimdFloat operator+(FSimdFloat A, FSimdFloat B) { return _mm_add_ps(A.V, B.V); }
+	inline FSimdFloat operator-(FSimdFloat A, FSimdFloat B) { return _mm_sub_ps(A.V, B.V); }
+	inline FSimdFloat operator*(FSimdFloat A, FSimdFloat B) { return _mm_mul_ps(A.V, B.V); }
+	inline FSimdFloat operator/(FSimdFloat A, FSimdFloat B) { return _mm_div_ps(A.V, B.V); }
+	inline FSimdFloat SimdMin(FSimdFloat A, FSimdFloat B) { return _mm_min_ps(A.V, B.V); }
+	inline FSimdFloat SimdMax(FSimdFloat A, FSimdFloat B) { return _mm_max_ps(A.V, B.V); }
+	inline FSimdFloat SimdSqrt(FSimdFloat A) { return _mm_sqrt_ps(A.V); }
+	inline FSimdFloat SimdRsqrt(FSimdFloat A)
+	{
+		const __m128 Y = _mm_rsqrt_ps(A.V);
+		const __m128 HalfAYY = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), A.V), _mm_mul_ps(Y, Y));
+		return _mm_mul_ps(Y, _mm_sub_ps(_mm_set1_ps(1.5f), HalfAYY));
+	}
+	inline FSimdFloat SimdMulAdd(FSimdFloat A, FSimdFloat B, FSimdFloat C) { return _mm_add_ps(_mm_mul_ps(A.V, B.V), C.V); }
+	inline FSimdFloat SimdAbs(FSimdFloat A) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), A.V); }
+	inline FSimdFloat SimdSelect(FSimdFloat Mask, FSimdFloat A, FSimdFloat B) { return _mm_or_ps(_mm_and_ps(Mask.V, A.V), _mm_andnot_ps(Mask.V, B.V)); }
+	inline FSimdFloat SimdLess(FSimdFloat A, FSimdFloat B) { return _mm_cmplt_ps(A.V, B.V); }
+	inline FSimdFloat SimdGreater(FSimdFloat A, FSimdFloat B) { return _mm_cmpgt_ps(A.V, B.V); }
+	// Round to nearest is the default MXCSR mode, |A| < 2^31
+	inline FSimdFloat SimdRound(FSimdFloat A) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(A.V)); }
+	inline FSimdFloat SimdSplitExponent(FSimdFloat A, FSimdFloat& Mantissa)
+	{
+		const __m128i Bits = _mm_castps_si128(A.V);
+		Mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(Bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+		return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(Bits, 23), _mm_set1_epi32(127)));
+	}
+
+#else
+
+	constexpr int SimdWidth = 1;
+
+	struct FSimdFloat
+	{
+		float V;
+
+		FSimdFloat() {}
+		explicit FSimdFloat(float S) : V(S) {}
+
+		static FSimdFloat Load(const float* P) { return FSimdFloat(*P); }
+		void Store(float* P) const { *P = V; }
+		static FSimdFloat LoadUnaligned(const float* P) { return FSimdFloat(*P); }
+		void StoreUnaligned(float* P) const { *P = V; }
+		static FSimdFloat LoadPartial(const float* P, int Count) { return FSimdFloat(Count > 0 ? *P : 0.0f); }
+		void StorePartial(float* P, int Count) const { if (Count > 0) { *P = V; } }
+	};
+
+	inline FSimdFloat operator+(FSimdFloat A, FSimdFloat B) { return FSimdFloat(A.V + B.V); }
+	inline FSimdFloat operator-(FSimdFloat A, FSimdFloat B) { return FSimdFloat(A.V - B.V); }
+	inline FSimdFloat operator*(FSimdFloat A, FSimdFloat B) { return FSimdFloat(A.V * B.V); }
+	inline FSimdFloat operator/(FSimdFloat A, FSimdFloat B) { return FSimdFloat(A.V / B.V); }
+	inline FSimdFloat SimdMin(FSimdFloat A, FSimdFloat B) { return FSimdFloat(A.V < B.V ? A.V : B.V); }
+	inline FSimdFloat SimdMax(FSimdFloat A, FSimdFloat B) { return FSimdFloat(A.V > B.V ? A.V : B.V); }
+	inline FSimdFloat SimdSqrt(FSimdFloat A) { return FSimdFloat(std::sqrt(A.V)); }
+	inline FSimdFloat SimdRsqrt(FSimdFloat A) { return FSimdFloat(1.0f / std::sqrt(A.V)); }
+	inline FSimdFloat SimdMulAdd(FSimdFloat A, FSimdFloat B, FSimdFloat C) { return FSimdFloat(A.V * B.V + C.V); }
+	inline FSimdFloat SimdAbs(FSimdFloat A) { return FSimdFloat(std::fabs(A.V)); }
+	// Scalar masks are 0.0f / 1.0f
+	inline FSimdFloat SimdSelect(FSimdFloat Mask, FSimdFloat A, FSimdFloat B) { return Mask.V != 0.0f ? A : B; }
+	inline FSimdFloat SimdLess(FSimdFloat A, FSimdFloat B) { return FSimdFloat(A.V < B.V ? 1.0f : 0.0f); }
+	inline FSimdFloat SimdGreater(FSimdFloat A, FSimdFloat B) { return FSimdFloat(A.V > B.V ? 1.0f : 0.0f); }
+	inline FSimdFloat SimdRound(FSimdFloat A) { return FSimdFloat(std::nearbyint(A.V)); }
+	inline FSimdFloat SimdSplitExponent(FSimdFloat A, FSimdFloat& Mantissa)
+	{
+		int Exponent = 0;
+		Mantissa = FSimdFloat(2.0f * std::frexp(A.V, &Exponent));
+		return FSimdFloat(static_cast<float>(Exponent - 1));
+	}
+
+#endif
+
+	constexpr size_t SimdAlignment = 32;
+
+	inline FSimdFloat SimdClamp(FSimdFloat X, FSimdFloat Min, FSimdFloat Max) { return SimdMin(SimdMax(X, Min), Max); }
+
+	// Natural logarithm of a normal A > 0, relative error < 3e-7. The mantissa is moved to [sqrt(1/2), sqrt(2)),
+	// where log(M) = 2 atanh((M - 1) / (M + 1)) converges after 5 terms
+	inline FSimdFloat SimdLog(FSimdFloat A)
+	{
+		FSimdFloat M;
+		FSimdFloat E = SimdSplitExponent(A, M);
+		const FSimdFloat Upper = SimdGreater(M, FSimdFloat(1.41421356f));
+		M = SimdSelect(Upper, M * FSimdFloat(0.5f), M);
+		E = SimdSelect(Upper, E + FSimdFloat(1.0f), E);
+
+		const FSimdFloat One(1.0f);
+		const FSimdFloat Z = (M - One) / (M + One);
+		const FSimdFloat Z2 = Z * Z;
+		FSimdFloat Series = SimdMulAdd(Z2, FSimdFloat(1.0f / 9.0f), FSimdFloat(1.0f / 7.0f));
+		Series = SimdMulAdd(Series, Z2, FSimdFloat(1.0f / 5.0f));
+		Series = SimdMulAdd(Series, Z2, FSimdFloat(1.0f / 3.0f));
+		Series = SimdMulAdd(Series, Z2, One);
+		return SimdMulAdd(E, FSimdFloat(0.693147181f), FSimdFloat(2.0f) * Z * Series);
+	}
+
+	inline size_t SimdPadded(size_t Count)
+	{
+		return (Count + SimdWidth - 1) / SimdWidth * SimdWidth;
+	}
+
+
+
+	/*--- Aligned, zero initialized float storage for SoA lanes ---*/
+	class FAlignedFloatArray
+	{
+	public:
+		FAlignedFloatArray() {}
+		~FAlignedFloatArray() { std::free(Raw); }
+
+		FAlignedFloatArray(const FAlignedFloatArray&) = delete;
+		FAlignedFloatArray& operator=(const FAlignedFloatArray&) = delete;
+
+		// Grows to at least NewCount elements, keeps existing values, new ones are zero
+		void Reserve(size_t NewCount)
+		{
+			if (NewCount <= Capacity)
+			{
+				return;
+			}
+			void* NewRaw = std::malloc(NewCount * sizeof(float) + SimdAlignment);
+			float* NewData = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(NewRaw) + SimdAlignment - 1) & ~(uintptr_t)(SimdAlignment - 1));
+			std::memset(NewData, 0, NewCount * sizeof(float));
+			if (Data)
+			{
+				std::memcpy(NewData, Data, Capacity * sizeof(float));
+			}
+			std::free(Raw);
+			Raw = NewRaw;
+			Data = NewData;
+			Capacity = NewCount;
+		}
+
+		void Fill(float Value)
+		{
+			for (size_t i = 0; i < Capacity; i++)
+			{
+				Data[i] = Value;
+			}
+		}
+
+		float* GetData() { return Data; }
+		const float* GetData() const { return Data; }
+		float& operator[](size_t Index) { return Data[Index]; }
+		const float& operator[](size_t Index) const { return Data[Index]; }
+
+	private:
+		void* Raw = nullptr;
+		float* Data = nullptr;
+		size_t Capacity = 0;
+	};
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include "QFMCoreRing.h"
+#include "QFMCoreWireFormat.h"
+
+
+namespace QFM
+{
+
+	/*--- Telemetry sample ---*/
+	// Fixed size, trivially copyable. Producers fill one on the stack and push it, the sender thread does the rest.
+	// Samples of the same vehicle and channel set are packed into one datagram, see QFMCoreWireFormat.h
+	constexpr int TelemetryMaxValues = 8;
+
+	struct FTelemetrySample
+	{
+		double SimTime = 0.0;			// s
+		uint32_t VehicleId = 0;
+		uint32_t ChannelBitmap = 0;		// EWireChannel bits, Values are packed lowest bit first
+		float Values[TelemetryMaxValues];
+	};
+
+
+	// One ring per producing thread
+	enum ETelemetryProducer : int
+	{
+		TelemetryProducerGame = 0,
+		TelemetryProducerPhysics = 1,
+		TelemetryProducerNum
+	};
+
+	typedef TSpscRing<FTelemetrySample, 4096> FTelemetryRing;
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace QFM
+{
+
+	/*--- Fixed set of worker threads for batch jobs of the offline tools ---*/
+	// One job at a time: ParallelFor hands out indices in chunks, the calling thread works along and
+	// returns when every index is done. Workers sleep between jobs, so a pool can live as long as its tool.
+	// Not for the game: Unreal code uses ParallelFor / the task graph.
+	class FThreadPool
+	{
+	public:
+
+		// NumThreads including the calling thread, 0 = one per hardware thread
+		explicit FThreadPool(int NumThreads = 0)
+		{
+			if (NumThreads <= 0)
+			{
+				NumThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+			}
+			for (int i = 1; i < NumThreads; i++)
+			{
+				Workers.emplace_back(&FThreadPool::WorkerLoop, this);
+			}
+		}
+
+		~FThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				bShutdown = true;
+			}
+			WakeWorkers.notify_all();
+			for (std::thread& Worker : Workers)
+			{
+				Worker.join();
+			}
+		}
+
+		FThreadPool(const FThreadPool&) = delete;
+		FThreadPool& operator=(const FThreadPool&) = delete;
+
+		int GetNumThreads() const { return static_cast<int>(Workers.size()) + 1; }
+
+
+		// Func(Index) for every Index in [0, Num), in any order and on any thread. Blocks until all returned.
+		// ChunkSize 0 picks about 8 chunks per thread
+		void ParallelFor(int Num, const std::function<void(int)>& Func, int ChunkSize = 0)
+		{
+			if (Num <= 0)
+			{
+				return;
+			}
+			if (ChunkSize <= 0)
+			{
+				ChunkSize = std::max(1, Num / (GetNumThreads() * 8));
+			}
+			if (Workers.empty() || Num <= ChunkSize)
+			{
+				for (int i = 0; i < Num; i++)
+				{
+					Func(i);
+				}
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				Job = &Func;
+				JobNum = Num;
+				JobChunkSize = ChunkSize;
+				NextIndex.store(0, std::memory_order_relaxed);
+				BusyWorkers = static_cast<int>(Workers.size());
+				JobGeneration++;
+			}
+			WakeWorkers.notify_all();
+
+			RunChunks(Func, Num, ChunkSize);
+
+			std::unique_lock<std::mutex> Lock(Mutex);
+			JobDone.wait(Lock, [this]() { return BusyWorkers == 0; });
+			Job = nullptr;
+		}
+
+
+	private:
+
+		std::vector<std::thread> Workers;
+		std::mutex Mutex;
+		std::condition_variable WakeWorkers;
+		std::condition_variable JobDone;
+
+		const std::function<void(int)>* Job = nullptr;
+		int JobNum = 0;
+		int JobChunkSize = 1;
+		uint64_t JobGeneration = 0;
+		int BusyWorkers = 0;
+		bool bShutdown = false;
+		std::atomic<int> NextIndex{ 0 };
+
+
+		void RunChunks(const std::function<void(int)>& Func, int Num, int ChunkSize)
+		{
+			for (;;)
+			{
+				const int Begin = NextIndex.fetch_add(ChunkSize, std::memory_order_relaxed);
+				if (Begin >= Num)
+				{
+					return;
+				}
+				const int End = std::min(Num, Begin + ChunkSize);
+				for (int i = Begin; i < End; i++)
+				{
+					Func(i);
+				}
+			}
+		}
+
+
+		void WorkerLoop()
+		{
+			uint64_t SeenGeneration = 0;
+			for (;;)
+			{
+				const std::function<void(int)>* Func;
+				int Num;
+				int ChunkSize;
+				{
+					std::unique_lock<std::mutex> Lock(Mutex);
+					WakeWorkers.wait(Lock, [this, SeenGeneration]() { return bShutdown || JobGeneration != SeenGeneration; });
+					if (bShutdown)
+					{
+						return;
+					}
+					SeenGeneration = JobGeneration;
+					Func = Job;
+					Num = JobNum;
+					ChunkSize = JobChunkSize;
+				}
+
+				RunChunks(*Func, Num, ChunkSize);
+
+				{
+					std::lock_guard<std::mutex> Lock(Mutex);
+					BusyWorkers--;
+				}
+				JobDone.notify_one();
+			}
+		}
+	};
+
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+
+namespace QFM
+{
+
+	// Timed parts of one physics step
+	enum class ETimedStage : int
+	{
+		ReadPhysicsState = 0,
+		PilotInput,
+		AHRS,
+		AttitudeController,
+		PositionController,
+		EngineController,
+		ApplyForces,
+		Simulate,		// whole step, including all of the above
+		InputToForce,	// from sending a pilot command to the forces of the first step that read it
+		Num
+	};
+
+	inline const char* GetTimedStageName(ETimedStage Stage)
+	{
+		static const char* Names[] = { "ReadPhysicsState", "PilotInput", "AHRS", "AttitudeController", "PositionController", "EngineController", "ApplyForces", "Simulate", "InputToForce" };
+		return Names[(int)Stage];
+	}
+
+
+	struct FTimingSummary
+	{
+		uint64_t Count = 0;
+		double MinNs = 0.0;
+		double MeanNs = 0.0;
+		double P50Ns = 0.0;
+		double P99Ns = 0.0;
+		double MaxNs = 0.0;
+	};
+
+
+
+	/*--- Log-linear histogram of durations in timer ticks ---*/
+	// 8 linear sub buckets per power of two (<= 12.5% bucket width), fixed storage, no allocations.
+	// One thread records, any thread may summarize: counters are relaxed atomics written without lock prefix,
+	// so a summary taken while recording is slightly inconsistent but never torn.
+	class FTimingHistogram
+	{
+	public:
+		static constexpr int SubBucketBits = 3;
+		static constexpr int SubBuckets = 1 << SubBucketBits;
+		static constexpr int NumBuckets = (64 - SubBucketBits + 1) * SubBuckets;
+
+
+		void Add(uint64_t Ticks)
+		{
+			Increment(Buckets[BucketIndex(Ticks)], 1u);
+			Increment(Count, (uint64_t)1);
+			Increment(Sum, Ticks);
+			if (Ticks < Min.load(std::memory_order_relaxed)) { Min.store(Ticks, std::memory_order_relaxed); }
+			if (Ticks > Max.load(std::memory_order_relaxed)) { Max.store(Ticks, std::memory_order_relaxed); }
+		}
+
+
+		void Reset()
+		{
+			for (std::atomic<uint32_t>& Bucket : Buckets)
+			{
+				Bucket.store(0, std::memory_order_relaxed);
+			}
+			Count.store(0, std::memory_order_relaxed);
+			Sum.store(0, std::memory_order_relaxed);
+			Min.store(UINT64_MAX, std::memory_order_relaxed);
+			Max.store(0, std::memory_order_relaxed);
+		}
+
+
+		FTimingSummary Summarize(double NsPerTick) const
+		{
+			FTimingSummary Summary;
+			Summary.Count = Count.load(std::memory_order_relaxed);
+			if (Summary.Count == 0)
+			{
+				return Summary;
+			}
+
+			const double MinTicks = (double)Min.load(std::memory_order_relaxed);
+			const double MaxTicks = (double)Max.load(std::memory_order_relaxed);
+			Summary.MinNs = MinTicks * NsPerTick;
+			Summary.MaxNs = MaxTicks * NsPerTick;
+			Summary.MeanNs = (double)Sum.load(std::memory_order_relaxed) / Summary.Count * NsPerTick;
+			Summary.P50Ns = Percentile(0.50, MinTicks, MaxTicks) * NsPerTick;
+			Summary.P99Ns = Percentile(0.99, MinTicks, MaxTicks) * NsPerTick;
+			return Summary;
+		}
+
+
+	private:
+
+		static int BucketIndex(uint64_t Ticks)
+		{
+			if (Ticks < SubBuckets)
+			{
+				return (int)Ticks;
+			}
+			int Msb = 63;
+			while (!(Ticks >> Msb)) { Msb--; }
+			const int Shift = Msb - SubBucketBits;
+			return (Msb - SubBucketBits + 1) * SubBuckets + (int)((Ticks >> Shift) & (SubBuckets - 1));
+		}
+
+		static double BucketLow(int Index)
+		{
+			const int Octave = Index / SubBuckets;
+			const int Sub = Index % SubBuckets;
+			if (Octave == 0)
+			{
+				return (double)Sub;
+			}
+			return (double)(SubBuckets + Sub) * (double)(1ull << (Octave - 1));
+		}
+
+		static double BucketWidth(int Index)
+		{
+			const int Octave = Index / SubBuckets;
+			return Octave == 0 ? 1.0 : (double)(1ull << (Octave - 1));
+		}
+
+		// Bucket midpoint, clamped to the observed range
+		double Percentile(double Fraction, double MinTicks, double MaxTicks) const
+		{
+			const uint64_t Total = Count.load(std::memory_order_relaxed);
+			const uint64_t Rank = (uint64_t)(Fraction * (double)Total + 0.999999);
+			uint64_t Seen = 0;
+			for (int i = 0; i < NumBuckets; i++)
+			{
+				Seen += Buckets[i].load(std::memory_order_relaxed);
+				if (Seen >= Rank)
+				{
+					const double Mid = BucketLow(i) + 0.5 * BucketWidth(i);
+					return Mid < MinTicks ? MinTicks : (Mid > MaxTicks ? MaxTicks : Mid);
+				}
+			}
+			return MaxTicks;
+		}
+
+		// Single writer: plain load + store, no read-modify-write instruction
+		template <typename T, typename U>
+		static void Increment(std::atomic<T>& Value, U By)
+		{
+			Value.store(Value.load(std::memory_order_relaxed) + By, std::memory_order_relaxed);
+		}
+
+		std::atomic<uint32_t> Buckets[NumBuckets] = {};
+		std::atomic<uint64_t> Count{ 0 };
+		std::atomic<uint64_t> Sum{ 0 };
+		std::atomic<uint64_t> Min{ UINT64_MAX };
+		std::atomic<uint64_t> Max{ 0 };
+	};
+
+
+
+	/*--- One histogram per timed stage ---*/
+	class FStageTimings
+	{
+	public:
+
+		// Length of one timer tick, e.g. FPlatformTime::GetSecondsPerCycle64() * 1e9
+		double NsPerTick = 1.0;
+
+
+		void Record(ETimedStage Stage, uint64_t Ticks)
+		{
+			Histograms[(int)Stage].Add(Ticks);
+		}
+
+		void Reset()
+		{
+			for (FTimingHistogram& Histogram : Histograms)
+			{
+				Histogram.Reset();
+			}
+		}
+
+		FTimingSummary Summarize(ETimedStage Stage) const
+		{
+			return Histograms[(int)Stage].Summarize(NsPerTick);
+		}
+
+
+		// Stage,Count,MinNs,MeanNs,P50Ns,P99Ns,MaxNs. Label goes into an extra first column (e.g. the vehicle name)
+		std::string FormatCsv(const char* Label, bool bHeader) const
+		{
+			std::string Csv;
+			char Line[256];
+			if (bHeader)
+			{
+				Csv += "Vehicle,Stage,Count,MinNs,MeanNs,P50Ns,P99Ns,MaxNs\n";
+			}
+			for (int i = 0; i < (int)ETimedStage::Num; i++)
+			{
+				const FTimingSummary S = Summarize((ETimedStage)i);
+				std::snprintf(Line, sizeof(Line), "%s,%s,%llu,%.1f,%.1f,%.1f,%.1f,%.1f\n", Label, GetTimedStageName((ETimedStage)i),
+					(unsigned long long)S.Count, S.MinNs, S.MeanNs, S.P50Ns, S.P99Ns, S.MaxNs);
+				Csv += Line;
+			}
+			return Csv;
+		}
+
+
+	private:
+		FTimingHistogram Histograms[(int)ETimedStage::Num];
+	};
+
+}
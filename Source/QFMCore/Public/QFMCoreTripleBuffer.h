@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace QFM
+{
+
+	/*--- Lock-free triple buffer ---*/
+	// One thread writes snapshots, one other thread reads the latest one. Neither side ever blocks or allocates,
+	// the writer may publish faster than the reader looks (older snapshots are simply overwritten).
+	// Writer owns one buffer, reader owns one, the third is the hand-over slot swapped with one atomic exchange.
+	template <typename T>
+	class TTripleBuffer
+	{
+	public:
+
+		// Writer side: fill this buffer, then Publish()
+		T& GetWriteBuffer()
+		{
+			return Buffers[WriteIndex];
+		}
+
+		void Publish()
+		{
+			const uint32_t Old = Middle.exchange(WriteIndex | NewFlag, std::memory_order_acq_rel);
+			WriteIndex = Old & IndexMask;
+		}
+
+		void Write(const T& Item)
+		{
+			GetWriteBuffer() = Item;
+			Publish();
+		}
+
+
+		// Reader side: takes the latest published buffer. Returns false (and keeps the old one) if nothing new was published
+		bool Update()
+		{
+			if (!(Middle.load(std::memory_order_relaxed) & NewFlag))
+			{
+				return false;
+			}
+			const uint32_t Old = Middle.exchange(ReadIndex, std::memory_order_acq_rel);
+			ReadIndex = Old & IndexMask;
+			return true;
+		}
+
+		const T& GetReadBuffer() const
+		{
+			return Buffers[ReadIndex];
+		}
+
+
+	private:
+
+		static constexpr uint32_t IndexMask = 3;
+		static constexpr uint32_t NewFlag = 4;
+
+		T Buffers[3] = {};
+
+		// Hand-over slot: buffer index | NewFlag
+		alignas(64) std::atomic<uint32_t> Middle{ 1 };
+
+		// Writer owned
+		alignas(64) uint32_t WriteIndex = 0;
+
+		// Reader owned
+		alignas(64) uint32_t ReadIndex = 2;
+	};
+
+}
@@ -0,0 +1,544 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "QFMCoreFlightModel.h"
+#include "QFMCoreFlightConfig.h"
+#include "QFMCoreRigidBody.h"
+#include "QFMCoreThreadPool.h"
+
+
+namespace QFM
+{
+
+	/*--- Gain tuning: closed loop responses of candidate gain sets, without any engine ---*/
+	// Every candidate flies three scenarios with the complete controller chain on an FRigidBodyCore:
+	//	Step			stick step (roll / pitch angle in Stabilize, climb rate in AltHold)
+	//	Ramp			the same change over one second
+	//	Disturbance		torque (roll / pitch) or vertical force (Z) pulse while hovering
+	// and is scored on rise time, overshoot, control effort, ramp tracking and disturbance peak, all lower = better.
+	// The search is a grid over the gain ranges, refined around the Pareto front, evaluated over an FThreadPool.
+
+	enum class ETuningAxis : uint8_t
+	{
+		Roll,			// AttitudeController rate loop, roll
+		Pitch,			// AttitudeController rate loop, pitch
+		Z				// PositionController acceleration loop
+	};
+
+	constexpr int MaxTuningGains = 3;
+	constexpr int NumTuningObjectives = 5;
+
+
+	// A tuned parameter, by its QFMCoreFlightConfig name
+	struct FTuningParam
+	{
+		const char* Name;
+		float Min;
+		float Max;
+		bool bLog;		// search on a log scale
+	};
+
+
+	struct FTuningScore
+	{
+		float RiseTime = 0.0f;			// s, step to 90 %
+		float Overshoot = 0.0f;			// fraction of the step
+		float Effort = 0.0f;			// RMS of the commanded acceleration (rad/s^2 or m/s^2 above hover), all scenarios
+		float RampError = 0.0f;			// RMS tracking error of the ramp, deg or m/s
+		float DisturbancePeak = 0.0f;	// largest deviation after the pulse, deg or m
+		bool bStable = false;			// settled in every scenario
+
+		float Get(int Objective) const
+		{
+			switch (Objective)
+			{
+			case 0: return RiseTime;
+			case 1: return Overshoot;
+			case 2: return Effort;
+			case 3: return RampError;
+			default: return DisturbancePeak;
+			}
+		}
+	};
+
+
+	struct FTuningCandidate
+	{
+		float Unit[MaxTuningGains] = {};	// position in the search space, 0..1 per gain
+		float Gains[MaxTuningGains] = {};
+		FTuningScore Score;
+		float Rank = 0.0f;					// normalized sum of the objectives within the Pareto front, lower = better
+	};
+
+
+	struct FTuningSettings
+	{
+		ETuningAxis Axis = ETuningAxis::Roll;
+		EControlLoop Controller = EControlLoop::SPD;	// PID or SPD
+
+		float PhysicsHz = 250.0f;			// physics step, the stages run as set in the scheduler of the base model
+		bool bMultiRate = true;				// as UQuadcopterFlightModel with Scheduler.Enabled
+		float Duration = 0.0f;				// s per scenario, 0: 2 s for roll / pitch, 8 s for the slower Z loop
+		float SettleTime = 0.25f;			// s of hover before the input changes
+		float RampTime = 1.0f;				// s
+
+		float StepStick = 0.5f;				// roll / pitch stick, -1..1
+		float StepClimbRate = 2.0f;			// Z, m/s
+		float DisturbanceTorque = 20.0f;	// N*m
+		float DisturbanceForce = 0.5f;		// Z, times the weight, downwards
+		float DisturbanceTime = 0.05f;		// s
+
+		int GridPoints = 0;					// per gain, 0: about 4096 grid candidates
+		int RefineRounds = 4;
+		int RefineSeeds = 24;				// best Pareto members refined per round
+	};
+
+
+
+	class FGainTuner
+	{
+	public:
+
+		// Vehicle (mass, inertia, frame) and every parameter that is not tuned
+		FFlightModelCore Base;
+		FTuningSettings Settings;
+
+
+		int GetNumGains() const { return GetParams(nullptr); }
+
+		const FTuningParam& GetParam(int Index) const
+		{
+			const FTuningParam* Params;
+			GetParams(&Params);
+			return Params[Index];
+		}
+
+
+		// Gains as config lines, for QFMCoreFlightConfig / the editor
+		std::string FormatGains(const float* Gains) const
+		{
+			std::string Text;
+			for (int i = 0; i < GetNumGains(); i++)
+			{
+				char Line[128];
+				std::snprintf(Line, sizeof(Line), "%s=%.9g\n", GetParam(i).Name, Gains[i]);
+				Text += Line;
+			}
+			return Text;
+		}
+
+
+		// Scores one gain set. Thread safe
+		FTuningScore Evaluate(const float* Gains) const
+		{
+			FFlightModelCore Model = Base;
+			Model.AttitudeController.RotationControlLoop = Settings.Axis == ETuningAxis::Z ? Base.AttitudeController.RotationControlLoop : Settings.Controller;
+			Model.PositionController.TranslationControlLoop = Settings.Axis == ETuningAxis::Z ? Settings.Controller : Base.PositionController.TranslationControlLoop;
+			ApplyFlightModelConfig(FormatGains(Gains), Model.GetRefs());
+
+			FTuningScore Score;
+			FScenarioResult Step = RunScenario(Model, EScenario::Step);
+			FScenarioResult Ramp = RunScenario(Model, EScenario::Ramp);
+			FScenarioResult Disturbance = RunScenario(Model, EScenario::Disturbance);
+
+			Score.RiseTime = Step.RiseTime;
+			Score.Overshoot = Step.Overshoot;
+			Score.Effort = std::sqrt((Step.EffortSquared + Ramp.EffortSquared + Disturbance.EffortSquared) / 3.0f);
+			Score.RampError = Ramp.RmsError;
+			Score.DisturbancePeak = Disturbance.Peak;
+			Score.bStable = Step.bSettled && Ramp.bSettled && Disturbance.bSettled;
+			return Score;
+		}
+
+
+		// Grid, then RefineRounds rounds around the front. Returns the Pareto front of the stable candidates, best Rank first
+		std::vector<FTuningCandidate> Run(FThreadPool& Pool)
+		{
+			const int NumGains = GetNumGains();
+			int GridPoints = Settings.GridPoints;
+			if (GridPoints <= 1)
+			{
+				GridPoints = static_cast<int>(std::floor(std::pow(4096.0, 1.0 / NumGains) + 0.5));
+			}
+
+			std::vector<FTuningCandidate> Batch;
+			int GridSize = 1;
+			for (int g = 0; g < NumGains; g++)
+			{
+				GridSize *= GridPoints;
+			}
+			for (int i = 0; i < GridSize; i++)
+			{
+				FTuningCandidate Candidate;
+				for (int g = 0, Rest = i; g < NumGains; g++, Rest /= GridPoints)
+				{
+					Candidate.Unit[g] = static_cast<float>(Rest % GridPoints) / (GridPoints - 1);
+				}
+				Batch.push_back(Candidate);
+			}
+			EvaluateBatch(Pool, Batch);
+			Archive = Batch;
+			std::set<uint64_t> Visited;
+			for (const FTuningCandidate& Candidate : Batch)
+			{
+				Visited.insert(GetSearchKey(Candidate));
+			}
+			std::vector<FTuningCandidate> Front = GetParetoFront(Archive);
+
+			float Spacing = 1.0f / (GridPoints - 1);
+			for (int Round = 0; Round < Settings.RefineRounds; Round++)
+			{
+				Spacing *= 0.5f;
+				Batch.clear();
+
+				const int Seeds = std::min(static_cast<int>(Front.size()), Settings.RefineSeeds);
+				int Neighbours = 1;
+				for (int g = 0; g < NumGains; g++)
+				{
+					Neighbours *= 3;
+				}
+				for (int s = 0; s < Seeds; s++)
+				{
+					for (int n = 0; n < Neighbours; n++)
+					{
+						if (n == Neighbours / 2)
+						{
+							continue;	// the seed itself
+						}
+						FTuningCandidate Candidate;
+						for (int g = 0, Rest = n; g < NumGains; g++, Rest /= 3)
+						{
+							Candidate.Unit[g] = Clamp(Front[s].Unit[g] + (Rest % 3 - 1) * Spacing, 0.0f, 1.0f);
+						}
+						// Neighbours of close seeds and clamped ones coincide
+						if (Visited.insert(GetSearchKey(Candidate)).second)
+						{
+							Batch.push_back(Candidate);
+						}
+					}
+				}
+				EvaluateBatch(Pool, Batch);
+				Archive.insert(Archive.end(), Batch.begin(), Batch.end());
+				Front = GetParetoFront(Archive);
+			}
+			return Front;
+		}
+
+
+		// Every candidate of the last Run
+		const std::vector<FTuningCandidate>& GetArchive() const { return Archive; }
+
+
+		// Non-dominated stable candidates, ranked by their normalized objective sum
+		static std::vector<FTuningCandidate> GetParetoFront(const std::vector<FTuningCandidate>& Candidates)
+		{
+			std::vector<FTuningCandidate> Front;
+			for (size_t i = 0; i < Candidates.size(); i++)
+			{
+				if (!Candidates[i].Score.bStable)
+				{
+					continue;
+				}
+				bool bDominated = false;
+				for (size_t j = 0; j < Candidates.size() && !bDominated; j++)
+				{
+					bDominated = j != i && Candidates[j].Score.bStable && Dominates(Candidates[j].Score, Candidates[i].Score);
+				}
+				if (!bDominated)
+				{
+					Front.push_back(Candidates[i]);
+				}
+			}
+
+			float Min[NumTuningObjectives];
+			float Max[NumTuningObjectives];
+			for (int o = 0; o < NumTuningObjectives; o++)
+			{
+				Min[o] = Max[o] = Front.empty() ? 0.0f : Front[0].Score.Get(o);
+				for (const FTuningCandidate& Candidate : Front)
+				{
+					Min[o] = std::min(Min[o], Candidate.Score.Get(o));
+					Max[o] = std::max(Max[o], Candidate.Score.Get(o));
+				}
+			}
+			for (FTuningCandidate& Candidate : Front)
+			{
+				Candidate.Rank = 0.0f;
+				for (int o = 0; o < NumTuningObjectives; o++)
+				{
+					Candidate.Rank += Max[o] > Min[o] ? (Candidate.Score.Get(o) - Min[o]) / (Max[o] - Min[o]) : 0.0f;
+				}
+			}
+			std::stable_sort(Front.begin(), Front.end(), [](const FTuningCandidate& A, const FTuningCandidate& B) { return A.Rank < B.Rank; });
+			return Front;
+		}
+
+		static bool Dominates(const FTuningScore& A, const FTuningScore& B)
+		{
+			bool bBetter = false;
+			for (int o = 0; o < NumTuningObjectives; o++)
+			{
+				if (A.Get(o) > B.Get(o))
+				{
+					return false;
+				}
+				bBetter |= A.Get(o) < B.Get(o);
+			}
+			return bBetter;
+		}
+
+
+	private:
+
+		enum class EScenario : uint8_t
+		{
+			Step,
+			Ramp,
+			Disturbance
+		};
+
+		struct FScenarioResult
+		{
+			float RiseTime = 0.0f;
+			float Overshoot = 0.0f;
+			float EffortSquared = 0.0f;		// mean
+			float RmsError = 0.0f;
+			float Peak = 0.0f;
+			bool bSettled = false;
+		};
+
+		std::vector<FTuningCandidate> Archive;
+
+
+		// Search position quantized to 1/2^20 per gain
+		static uint64_t GetSearchKey(const FTuningCandidate& Candidate)
+		{
+			uint64_t Key = 0;
+			for (int g = 0; g < MaxTuningGains; g++)
+			{
+				Key = (Key << 21) | static_cast<uint64_t>(Candidate.Unit[g] * (1 << 20) + 0.5f);
+			}
+			return Key;
+		}
+
+
+		int GetParams(const FTuningParam** Out) const
+		{
+			static const FTuningParam RollPid[] = {
+				{ "AttitudeController.RateRollPidSettings.X", 0.01f, 10.0f, true },
+				{ "AttitudeController.RateRollPidSettings.Y", 0.0f, 10.0f, false },
+				{ "AttitudeController.RateRollPidSettings.Z", 0.0f, 0.05f, false } };
+			static const FTuningParam PitchPid[] = {
+				{ "AttitudeController.RatePitchPidSettings.X", 0.01f, 10.0f, true },
+				{ "AttitudeController.RatePitchPidSettings.Y", 0.0f, 10.0f, false },
+				{ "AttitudeController.RatePitchPidSettings.Z", 0.0f, 0.05f, false } };
+			static const FTuningParam RateSpd[] = {
+				{ "AttitudeController.SPDFrequency", 0.02f, 100.0f, true },
+				{ "AttitudeController.SPDDamping", 0.05f, 5.0f, true } };
+			static const FTuningParam ZPid[] = {
+				{ "PositionController.RateZPidSettings.X", 0.01f, 10.0f, true },
+				{ "PositionController.RateZPidSettings.Y", 0.0f, 20.0f, false },
+				{ "PositionController.RateZPidSettings.Z", 0.0f, 0.05f, false } };
+			static const FTuningParam ZSpd[] = {
+				{ "PositionController.SPDFrequency", 0.5f, 500.0f, true },
+				{ "PositionController.SPDDamping", 0.1f, 20.0f, true } };
+
+			const bool bPid = Settings.Controller == EControlLoop::PID;
+			const FTuningParam* Params = RateSpd;
+			int Num = 2;
+			switch (Settings.Axis)
+			{
+			case ETuningAxis::Roll: Params = bPid ? RollPid : RateSpd; Num = bPid ? 3 : 2; break;
+			case ETuningAxis::Pitch: Params = bPid ? PitchPid : RateSpd; Num = bPid ? 3 : 2; break;
+			case ETuningAxis::Z: Params = bPid ? ZPid : ZSpd; Num = bPid ? 3 : 2; break;
+			}
+			if (Out)
+			{
+				*Out = Params;
+			}
+			return Num;
+		}
+
+
+		void EvaluateBatch(FThreadPool& Pool, std::vector<FTuningCandidate>& Batch) const
+		{
+			const int NumGains = GetNumGains();
+			for (FTuningCandidate& Candidate : Batch)
+			{
+				for (int g = 0; g < NumGains; g++)
+				{
+					const FTuningParam& Param = GetParam(g);
+					Candidate.Gains[g] = Param.bLog
+						? Param.Min * std::pow(Param.Max / Param.Min, Candidate.Unit[g])
+						: Param.Min + (Param.Max - Param.Min) * Candidate.Unit[g];
+				}
+			}
+			Pool.ParallelFor(static_cast<int>(Batch.size()), [this, &Batch](int i)
+			{
+				Batch[i].Score = Evaluate(Batch[i].Gains);
+			});
+		}
+
+
+		FScenarioResult RunScenario(const FFlightModelCore& Configured, EScenario Scenario) const
+		{
+			FFlightModelCore Model = Configured;
+			FRigidBodyCore Plant;
+			Plant.Body.Position = FVec3(0.0f, 0.0f, 100.0f);
+			Plant.Mass = Model.Vehicle.Mass;
+			Plant.InertiaTensor = Model.Vehicle.InertiaTensor;
+			Plant.Gravity = Model.Vehicle.Gravity;
+
+			const bool bZ = Settings.Axis == ETuningAxis::Z;
+			Model.AttitudeController.FlightMode = bZ ? EFlightMode::AltHold : EFlightMode::Stabilize;
+			Model.Init(Plant.Body);
+
+			const FInputCore& Input = Model.PilotInput;
+			const FAttitudeCore& Attitude = Model.AttitudeController;
+			const float Weight = Plant.Mass * -Plant.Gravity;
+
+			// Throttle stick: mid for hover, above the AltHold deadband for a climb rate
+			const float DeadbandTop = Input.GetThrottleMidStick() + Clamp(Attitude.ThrottleDeadzone, 0.0f, 0.4f);
+			auto ThrottleStick = [&](float ClimbRate)
+			{
+				const float Throttle = ClimbRate > 0.0f ? DeadbandTop + ClimbRate / Attitude.PilotSpeedUp * (1.0f - DeadbandTop) : Input.GetThrottleMidStick();
+				return FInputCore::GetRawValueForDesired(Input.ThrottleAxisInputInterval, Input.InputAxisScale.W, Throttle * 2.0f - 1.0f);
+			};
+
+			// Reference: roll / pitch angle in deg, climb rate in m/s
+			const float StepReference = bZ ? Settings.StepClimbRate : -Settings.StepStick * Attitude.AngleMax;
+
+			const float Duration = Settings.Duration > 0.0f ? Settings.Duration : (bZ ? 8.0f : 2.0f);
+			const float DeltaTime = 1.0f / Settings.PhysicsHz;
+			const int Steps = static_cast<int>(Duration * Settings.PhysicsHz);
+			const int SettleSteps = std::max(1, Steps / 10);
+
+			FScenarioResult Result;
+			Result.RiseTime = Duration - Settings.SettleTime;
+			float MaxResponse = 0.0f;
+			double ErrorSquared = 0.0;
+			double EffortSquared = 0.0;
+			int ErrorSamples = 0;
+			float FinalError = 0.0f;
+			bool bFinite = true;
+
+			for (int i = 0; i < Steps; i++)
+			{
+				const float Time = (i + 1) * DeltaTime;
+				const float Active = Time - Settings.SettleTime;
+
+				// Command
+				float Fraction = 0.0f;
+				if (Scenario == EScenario::Step && Active >= 0.0f)
+				{
+					Fraction = 1.0f;
+				}
+				else if (Scenario == EScenario::Ramp && Active >= 0.0f)
+				{
+					Fraction = std::min(1.0f, Active / Settings.RampTime);
+				}
+				const float Reference = StepReference * Fraction;
+
+				Model.PilotInput.RollAxisInput = FInputCore::GetRawValueForDesired(Input.RollAxisInputInterval, Input.InputAxisScale.X,
+					Settings.Axis == ETuningAxis::Roll ? Settings.StepStick * Fraction : 0.0f);
+				Model.PilotInput.PitchAxisInput = FInputCore::GetRawValueForDesired(Input.PitchAxisInputInterval, Input.InputAxisScale.Y,
+					Settings.Axis == ETuningAxis::Pitch ? Settings.StepStick * Fraction : 0.0f);
+				Model.PilotInput.YawAxisInput = FInputCore::GetRawValueForDesired(Input.YawAxisInputInterval, Input.InputAxisScale.Z, 0.0f);
+				Model.PilotInput.ThrottleAxisInput = ThrottleStick(bZ ? Settings.StepClimbRate * Fraction : 0.0f);
+
+				if (Settings.bMultiRate)
+				{
+					Model.SimulateMultiRate(Plant.Body, DeltaTime);
+				}
+				else
+				{
+					Model.Simulate(Plant.Body, DeltaTime);
+				}
+
+				// Disturbance pulse
+				FVec3 DisturbanceForce;
+				FVec3 DisturbanceTorque;
+				if (Scenario == EScenario::Disturbance && Active >= 0.0f && Active < Settings.DisturbanceTime)
+				{
+					if (bZ)
+					{
+						DisturbanceForce.Z = -Settings.DisturbanceForce * Weight;
+					}
+					else if (Settings.Axis == ETuningAxis::Roll)
+					{
+						DisturbanceTorque.X = Settings.DisturbanceTorque;
+					}
+					else
+					{
+						DisturbanceTorque.Y = Settings.DisturbanceTorque;
+					}
+				}
+
+				const FVec3 Thrust = Model.GetTotalThrust();
+				const FVec3 Torque = Model.GetTotalTorque();
+				Plant.Step(Thrust, Torque, DeltaTime, DisturbanceForce, DisturbanceTorque);
+
+				// Response
+				const FRotatorf Rotation = Plant.Body.Rotation.Rotator();
+				float Response;
+				float Effort;
+				if (bZ)
+				{
+					Response = Scenario == EScenario::Disturbance ? Plant.Body.Position.Z - 100.0f : Plant.Body.LinearVelocity.Z;
+					Effort = (Thrust.Z - Weight) / Plant.Mass;
+				}
+				else
+				{
+					Response = Settings.Axis == ETuningAxis::Roll ? Rotation.Roll : Rotation.Pitch;
+					Effort = Settings.Axis == ETuningAxis::Roll ? Torque.X : Torque.Y;
+				}
+				bFinite &= std::isfinite(Response) && std::isfinite(Effort);
+				EffortSquared += static_cast<double>(Effort) * Effort;
+
+				if (Active < 0.0f)
+				{
+					continue;
+				}
+
+				const float Error = Response - Reference;
+				ErrorSquared += static_cast<double>(Error) * Error;
+				ErrorSamples++;
+
+				if (Scenario == EScenario::Disturbance)
+				{
+					Result.Peak = std::max(Result.Peak, std::fabs(Response));
+				}
+				else
+				{
+					const float Normalized = Response / StepReference;
+					if (Normalized >= 0.9f && Active < Result.RiseTime)
+					{
+						Result.RiseTime = Active;
+					}
+					MaxResponse = std::max(MaxResponse, Normalized);
+				}
+				if (i >= Steps - SettleSteps)
+				{
+					FinalError = std::max(FinalError, std::fabs(Error));
+				}
+			}
+
+			Result.Overshoot = std::max(0.0f, MaxResponse - 1.0f);
+			Result.EffortSquared = static_cast<float>(EffortSquared / Steps);
+			Result.RmsError = ErrorSamples > 0 ? static_cast<float>(std::sqrt(ErrorSquared / ErrorSamples)) : 0.0f;
+
+			// Settled: back within 10 % of the step (a quarter of the peak after the pulse) over the last tenth
+			const float Tolerance = Scenario == EScenario::Disturbance ? std::max(0.25f * Result.Peak, 1e-3f) : 0.1f * std::fabs(StepReference);
+			Result.bSettled = bFinite && FinalError <= Tolerance;
+			return Result;
+		}
+	};
+
+}
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+
+/*--- Engine independent Flight Model Core ---*/
+// Plain C++ only: no UObject, no GEngine, no PhysX.
+// All math follows the UE4 conventions (left handed, Z up, Rotators in degrees,
+// FQuat multiplication order) so the USTRUCT adapters can pass data through unchanged.
+
+// As FORCEINLINE on FQuat: the quaternion operations are inlined everywhere, whatever the size of the unit. Otherwise
+// the compiler outlines them in some tools and not in others, FMA contraction differs and a replay is no longer bit exact
+#if defined(_MSC_VER)
+#define QFM_FORCEINLINE __forceinline
+#else
+#define QFM_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+namespace QFM
+{
+
+	/*--- Enums. Same order as the UENUMs in QFMTypes.h ---*/
+
+	enum class EFlightMode : uint8_t
+	{
+		Direct,
+		Stabilize,
+		AltHold,
+		Accro
+	};
+
+	enum class EControlLoop : uint8_t
+	{
+		P,
+		PID,
+		SPD
+	};
+
+	enum class EFrameMode : uint8_t
+	{
+		Cross,
+		Plus,
+		HexaX,
+		OctoX,
+		CoaxX8,
+		Y6,
+		Custom
+	};
+
+
+
+	/*--- Scalar Helpers ---*/
+
+	constexpr float Pi = 3.1415926535897932f;
+	constexpr float SmallNumber = 1.e-8f;
+
+	inline float DegreesToRadians(float Deg) { return Deg * (Pi / 180.0f); }
+	inline float RadiansToDegrees(float Rad) { return Rad * (180.0f / Pi); }
+
+	template<typename T>
+	inline T Clamp(const T X, const T Min, const T Max)
+	{
+		return X < Min ? Min : X < Max ? X : Max;
+	}
+
+
+
+	/*--- Vectors ---*/
+
+	struct FVec2
+	{
+		float X = 0.0f;
+		float Y = 0.0f;
+
+		FVec2() {}
+		FVec2(float InX, float InY) : X(InX), Y(InY) {}
+
+		float Size() const { return std::sqrt(X * X + Y * Y); }
+	};
+
+
+	struct FVec3
+	{
+		float X = 0.0f;
+		float Y = 0.0f;
+		float Z = 0.0f;
+
+		FVec3() {}
+		FVec3(float InX, float InY, float InZ) : X(InX), Y(InY), Z(InZ) {}
+
+		FVec3 operator+(const FVec3& V) const { return FVec3(X + V.X, Y + V.Y, Z + V.Z); }
+		FVec3 operator-(const FVec3& V) const { return FVec3(X - V.X, Y - V.Y, Z - V.Z); }
+		FVec3 operator*(const FVec3& V) const { return FVec3(X * V.X, Y * V.Y, Z * V.Z); }
+		FVec3 operator*(float S) const { return FVec3(X * S, Y * S, Z * S); }
+		FVec3 operator/(float S) const { const float R = 1.0f / S; return FVec3(X * R, Y * R, Z * R); }
+		FVec3& operator+=(const FVec3& V) { X += V.X; Y += V.Y; Z += V.Z; return *this; }
+		FVec3& operator*=(const FVec3& V) { X *= V.X; Y *= V.Y; Z *= V.Z; return *this; }
+		FVec3& operator/=(float S) { const float R = 1.0f / S; X *= R; Y *= R; Z *= R; return *this; }
+
+		float SizeSquared() const { return X * X + Y * Y + Z * Z; }
+		float Size() const { return std::sqrt(SizeSquared()); }
+		float Size2D() const { return std::sqrt(X * X + Y * Y); }
+
+		// Same as FVector::Normalize: leaves the vector untouched if it is too small
+		bool Normalize(float Tolerance = SmallNumber)
+		{
+			const float SquareSum = SizeSquared();
+			if (SquareSum > Tolerance)
+			{
+				const float Scale = 1.0f / std::sqrt(SquareSum);
+				X *= Scale; Y *= Scale; Z *= Scale;
+				return true;
+			}
+			return false;
+		}
+
+		static FVec3 Cross(const FVec3& A, const FVec3& B)
+		{
+			return FVec3(A.Y * B.Z - A.Z * B.Y, A.Z * B.X - A.X * B.Z, A.X * B.Y - A.Y * B.X);
+		}
+
+		static float Dot(const FVec3& A, const FVec3& B)
+		{
+			return A.X * B.X + A.Y * B.Y + A.Z * B.Z;
+		}
+	};
+
+	inline FVec3 operator*(float S, const FVec3& V) { return V * S; }
+
+
+	struct FVec4
+	{
+		float X = 0.0f;
+		float Y = 0.0f;
+		float Z = 0.0f;
+		float W = 0.0f;
+
+		FVec4() {}
+		FVec4(float InX, float InY, float InZ, float InW) : X(InX), Y(InY), Z(InZ), W(InW) {}
+	};
+
+
+
+	/*--- Rotator (Pitch, Yaw, Roll in deg) ---*/
+
+	struct FQuatf;
+
+	struct FRotatorf
+	{
+		float Pitch = 0.0f;
+		float Yaw = 0.0f;
+		float Roll = 0.0f;
+
+		FRotatorf() {}
+		FRotatorf(float InPitch, float InYaw, float InRoll) : Pitch(InPitch), Yaw(InYaw), Roll(InRoll) {}
+
+		static float ClampAxis(float Angle)
+		{
+			Angle = std::fmod(Angle, 360.0f);
+			if (Angle < 0.0f)
+			{
+				Angle += 360.0f;
+			}
+			return Angle;
+		}
+
+		static float NormalizeAxis(float Angle)
+		{
+			Angle = ClampAxis(Angle);
+			if (Angle > 180.0f)
+			{
+				Angle -= 360.0f;
+			}
+			return Angle;
+		}
+
+		FRotatorf Clamp() const
+		{
+			return FRotatorf(ClampAxis(Pitch), ClampAxis(Yaw), ClampAxis(Roll));
+		}
+
+		inline FQuatf Quaternion() const;
+	};
+
+
+
+	/*--- Quaternion ---*/
+
+	struct FQuatf
+	{
+		float X = 0.0f;
+		float Y = 0.0f;
+		float Z = 0.0f;
+		float W = 1.0f;
+
+		FQuatf() {}
+		FQuatf(float InX, float InY, float InZ, float InW) : X(InX), Y(InY), Z(InZ), W(InW) {}
+
+		// Axis must be normalized
+		FQuatf(const FVec3& Axis, float AngleRad)
+		{
+			const float HalfA = 0.5f * AngleRad;
+			const float S = std::sin(HalfA);
+			X = S * Axis.X;
+			Y = S * Axis.Y;
+			Z = S * Axis.Z;
+			W = std::cos(HalfA);
+		}
+
+		explicit FQuatf(const FRotatorf& R) { *this = R.Quaternion(); }
+
+		static FQuatf Identity() { return FQuatf(0.0f, 0.0f, 0.0f, 1.0f); }
+
+		// Same order as FQuat: (A * B) applies B first, then A
+		QFM_FORCEINLINE FQuatf operator*(const FQuatf& Q) const
+		{
+			return FQuatf(
+				W * Q.X + X * Q.W + Y * Q.Z - Z * Q.Y,
+				W * Q.Y - X * Q.Z + Y * Q.W + Z * Q.X,
+				W * Q.Z + X * Q.Y - Y * Q.X + Z * Q.W,
+				W * Q.W - X * Q.X - Y * Q.Y - Z * Q.Z);
+		}
+
+		FQuatf operator*(float S) const { return FQuatf(X * S, Y * S, Z * S, W * S); }
+
+		// Dot product
+		float operator|(const FQuatf& Q) const { return X * Q.X + Y * Q.Y + Z * Q.Z + W * Q.W; }
+
+		FQuatf Inverse() const { return FQuatf(-X, -Y, -Z, W); }
+
+		QFM_FORCEINLINE void Normalize(float Tolerance = SmallNumber)
+		{
+			const float SquareSum = X * X + Y * Y + Z * Z + W * W;
+			if (SquareSum >= Tolerance)
+			{
+				const float Scale = 1.0f / std::sqrt(SquareSum);
+				X *= Scale; Y *= Scale; Z *= Scale; W *= Scale;
+			}
+			else
+			{
+				*this = Identity();
+			}
+		}
+
+		FVec3 GetRotationAxis() const
+		{
+			const float S = std::sqrt(W * W < 1.0f ? 1.0f - W * W : 0.0f);
+			if (S >= 0.0001f)
+			{
+				return FVec3(X / S, Y / S, Z / S);
+			}
+			return FVec3(1.0f, 0.0f, 0.0f);
+		}
+
+		void ToAxisAndAngle(FVec3& Axis, float& Angle) const
+		{
+			Angle = 2.0f * std::acos(Clamp(W, -1.0f, 1.0f));
+			Axis = GetRotationAxis();
+		}
+
+		QFM_FORCEINLINE FVec3 RotateVector(const FVec3& V) const
+		{
+			const FVec3 Q(X, Y, Z);
+			const FVec3 T = FVec3::Cross(Q, V) * 2.0f;
+			return V + (T * W) + FVec3::Cross(Q, T);
+		}
+
+		QFM_FORCEINLINE FVec3 UnrotateVector(const FVec3& V) const
+		{
+			const FVec3 Q(-X, -Y, -Z);
+			const FVec3 T = FVec3::Cross(Q, V) * 2.0f;
+			return V + (T * W) + FVec3::Cross(Q, T);
+		}
+
+		FVec3 GetUpVector() const { return RotateVector(FVec3(0.0f, 0.0f, 1.0f)); }
+
+		FRotatorf Rotator() const
+		{
+			const float SingularityTest = Z * X - W * Y;
+			const float YawY = 2.0f * (W * Z + X * Y);
+			const float YawX = (1.0f - 2.0f * (Y * Y + Z * Z));
+			const float SingularityThreshold = 0.4999995f;
+
+			FRotatorf R;
+			if (SingularityTest < -SingularityThreshold)
+			{
+				R.Pitch = -90.0f;
+				R.Yaw = RadiansToDegrees(std::atan2(YawY, YawX));
+				R.Roll = FRotatorf::NormalizeAxis(-R.Yaw - (2.0f * RadiansToDegrees(std::atan2(X, W))));
+			}
+			else if (SingularityTest > SingularityThreshold)
+			{
+				R.Pitch = 90.0f;
+				R.Yaw = RadiansToDegrees(std::atan2(YawY, YawX));
+				R.Roll = FRotatorf::NormalizeAxis(R.Yaw - (2.0f * RadiansToDegrees(std::atan2(X, W))));
+			}
+			else
+			{
+				R.Pitch = RadiansToDegrees(std::asin(2.0f * SingularityTest));
+				R.Yaw = RadiansToDegrees(std::atan2(YawY, YawX));
+				R.Roll = RadiansToDegrees(std::atan2(-2.0f * (W * X + Y * Z), (1.0f - 2.0f * (X * X + Y * Y))));
+			}
+			return R;
+		}
+	};
+
+
+	inline FQuatf FRotatorf::Quaternion() const
+	{
+		const float DivideBy2 = Pi / 180.0f / 2.0f;
+		const float SP = std::sin(Pitch * DivideBy2), CP = std::cos(Pitch * DivideBy2);
+		const float SY = std::sin(Yaw * DivideBy2), CY = std::cos(Yaw * DivideBy2);
+		const float SR = std::sin(Roll * DivideBy2), CR = std::cos(Roll * DivideBy2);
+
+		return FQuatf(
+			 CR * SP * SY - SR * CP * CY,
+			-CR * SP * CY - SR * CP * SY,
+			 CR * CP * SY - SR * SP * CY,
+			 CR * CP * CY + SR * SP * SY);
+	}
+
+
+
+	/*--- Rigid Body State as seen by the controllers (SI units, world space) ---*/
+
+	struct FBodyState
+	{
+		FQuatf Rotation;			// World rotation
+		FVec3 Position;				// in m
+		FVec3 LinearVelocity;		// in m/s
+		FVec3 AngularVelocity;		// in rad/s
+	};
+
+
+
+	/*--- Everything one physics step needs from the rigid body, read once at its start ---*/
+	// AHRS, controllers and force application all work on this copy instead of querying the physics engine.
+
+	struct FPhysicsState
+	{
+		FBodyState Body;			// SI units, world space
+		FVec3 UpVector;				// Body Z axis in world space
+		FVec3 InertiaTensor;		// in kg * cm^2, mass space (as FVehicleCore)
+		float Mass = 0.0f;			// in kg
+	};
+
+
+	inline FPhysicsState MakePhysicsState(const FBodyState& Body, const FVec3& InertiaTensor, float Mass)
+	{
+		FPhysicsState State;
+		State.Body = Body;
+		State.UpVector = Body.Rotation.GetUpVector();
+		State.InertiaTensor = InertiaTensor;
+		State.Mass = Mass;
+		return State;
+	}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "QFMCoreTypes.h"
+#include "QFMCoreMixer.h"
+
+
+namespace QFM
+{
+
+	/*--- Vehicle properties the controllers need ---*/
+	// Filled by FVehicle::Init from PhysX, or directly by headless tools.
+	struct FVehicleCore
+	{
+		EFrameMode FrameMode = EFrameMode::Cross;
+
+		float ArmLength = 0.5f;				// in m
+		float Mass = 30.0f;					// in kg
+		FVec3 InertiaTensor = FVec3(200000.0f, 200000.0f, 400000.0f); // in kg * cm^2
+		FVec3 CenterOfMass;					// in m
+		float Gravity = -9.81f;				// in m/s^2, negative = down
+
+		// Motor layout for EFrameMode::Custom. The presets are generated from FrameMode and ArmLength
+		FFrameGeometry CustomFrame;
+
+		float DeltaTime = 0.0f;
+
+
+		FFrameGeometry GetFrameGeometry() const
+		{
+			return (FrameMode == EFrameMode::Custom) ? CustomFrame : MakeFrameGeometry(FrameMode, ArmLength);
+		}
+
+
+		void Tock(float DeltaTimeIn)
+		{
+			DeltaTime = DeltaTimeIn;
+		}
+
+		float GetGravity() const
+		{
+			return Gravity;
+		}
+	};
+
+}
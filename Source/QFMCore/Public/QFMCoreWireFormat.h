@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace QFM
+{
+
+	/*--- Telemetry wire format, version 1 ---*/
+	// One datagram = one header + RecordCount records of one vehicle and one channel set. All little-endian.
+	//
+	//	Offset	Type	Field
+	//	0		u32		Magic 'QFMT' (0x544D4651)
+	//	4		u16		Version (1)
+	//	6		u16		HeaderBytes (32), records start here
+	//	8		u32		VehicleId
+	//	12		u32		Sequence, per sender, increments with every datagram
+	//	16		f64		SimTime of the first record in s
+	//	24		u32		ChannelBitmap, bit n set = channel n present
+	//	28		u16		RecordCount
+	//	30		u16		RecordBytes = 8 + 4 * popcount(ChannelBitmap)
+	//
+	//	Record:	f64 SimTime, then one f32 per set bit, lowest bit first
+	//
+	// Readers must skip HeaderBytes (later versions may append header fields) and use RecordBytes as stride.
+	// PythonSource/QFMTelemetry.py decodes the same layout.
+
+	constexpr uint32_t WireMagic = 0x544D4651;
+	constexpr uint16_t WireVersion = 1;
+	constexpr uint16_t WireHeaderBytes = 32;
+	constexpr uint16_t WireRecordTimeBytes = 8;
+
+
+	// Value channels. Bit index in ChannelBitmap
+	enum EWireChannel : uint32_t
+	{
+		WireChannelThrustZ = 0,		// N
+		WireChannelTorqueX,			// engine controller units
+		WireChannelTorqueY,
+		WireChannelTorqueZ,
+		WireChannelDebugX,			// FAttitudeCore::UDPDebugOutput
+		WireChannelDebugY,
+		WireChannelDebugZ,
+		WireChannelNum
+	};
+
+	constexpr uint32_t WireChannelBit(EWireChannel Channel) { return 1u << Channel; }
+
+
+	inline int WireCountChannels(uint32_t Bitmap)
+	{
+		int Count = 0;
+		for (; Bitmap; Bitmap &= Bitmap - 1)
+		{
+			Count++;
+		}
+		return Count;
+	}
+
+
+	/*--- Little-endian stores and loads, independent of host byte order and alignment ---*/
+
+	inline void WireStoreU16(uint8_t* P, uint16_t V) { P[0] = (uint8_t)V; P[1] = (uint8_t)(V >> 8); }
+	inline void WireStoreU32(uint8_t* P, uint32_t V) { for (int i = 0; i < 4; i++) { P[i] = (uint8_t)(V >> (8 * i)); } }
+	inline void WireStoreU64(uint8_t* P, uint64_t V) { for (int i = 0; i < 8; i++) { P[i] = (uint8_t)(V >> (8 * i)); } }
+	inline void WireStoreF32(uint8_t* P, float V) { uint32_t U; std::memcpy(&U, &V, 4); WireStoreU32(P, U); }
+	inline void WireStoreF64(uint8_t* P, double V) { uint64_t U; std::memcpy(&U, &V, 8); WireStoreU64(P, U); }
+
+	inline uint16_t WireLoadU16(const uint8_t* P) { return (uint16_t)(P[0] | (P[1] << 8)); }
+	inline uint32_t WireLoadU32(const uint8_t* P) { uint32_t V = 0; for (int i = 3; i >= 0; i--) { V = (V << 8) | P[i]; } return V; }
+	inline uint64_t WireLoadU64(const uint8_t* P) { uint64_t V = 0; for (int i = 7; i >= 0; i--) { V = (V << 8) | P[i]; } return V; }
+	inline float WireLoadF32(const uint8_t* P) { uint32_t U = WireLoadU32(P); float V; std::memcpy(&V, &U, 4); return V; }
+	inline double WireLoadF64(const uint8_t* P) { uint64_t U = WireLoadU64(P); double V; std::memcpy(&V, &U, 8); return V; }
+
+
+
+	/*--- Writer: records go straight into the callers datagram buffer ---*/
+	class FWirePacketWriter
+	{
+	public:
+
+		// Start a packet in Buffer. Returns false if not even one record fits
+		bool Begin(uint8_t* BufferIn, size_t CapacityIn, uint32_t VehicleIdIn, uint32_t Sequence, uint32_t ChannelBitmapIn)
+		{
+			Buffer = BufferIn;
+			Capacity = CapacityIn;
+			VehicleId = VehicleIdIn;
+			ChannelBitmap = ChannelBitmapIn;
+			NumChannels = WireCountChannels(ChannelBitmap);
+			RecordBytes = (uint16_t)(WireRecordTimeBytes + 4 * NumChannels);
+			RecordCount = 0;
+			Bytes = WireHeaderBytes;
+
+			WireStoreU32(Buffer + 0, WireMagic);
+			WireStoreU16(Buffer + 4, WireVersion);
+			WireStoreU16(Buffer + 6, WireHeaderBytes);
+			WireStoreU32(Buffer + 8, VehicleId);
+			WireStoreU32(Buffer + 12, Sequence);
+			WireStoreF64(Buffer + 16, 0.0);
+			WireStoreU32(Buffer + 24, ChannelBitmap);
+			WireStoreU16(Buffer + 28, 0);
+			WireStoreU16(Buffer + 30, RecordBytes);
+
+			return HasRoom();
+		}
+
+		bool IsOpen() const { return Buffer != nullptr; }
+		bool IsEmpty() const { return RecordCount == 0; }
+		bool HasRoom() const { return Bytes + RecordBytes <= Capacity && RecordCount < 0xFFFF; }
+		bool Matches(uint32_t VehicleIdIn, uint32_t ChannelBitmapIn) const { return VehicleId == VehicleIdIn && ChannelBitmap == ChannelBitmapIn; }
+
+		// Values holds one float per channel of the bitmap, lowest bit first
+		void AddRecord(double SimTime, const float* Values)
+		{
+			uint8_t* P = Buffer + Bytes;
+			WireStoreF64(P, SimTime);
+			P += WireRecordTimeBytes;
+			for (int i = 0; i < NumChannels; i++, P += 4)
+			{
+				WireStoreF32(P, Values[i]);
+			}
+			if (RecordCount == 0)
+			{
+				WireStoreF64(Buffer + 16, SimTime);
+			}
+			RecordCount++;
+			Bytes += RecordBytes;
+		}
+
+		// Patch the record count, returns the datagram size. The writer is closed afterwards
+		size_t End()
+		{
+			WireStoreU16(Buffer + 28, RecordCount);
+			const size_t Size = Bytes;
+			Buffer = nullptr;
+			return Size;
+		}
+
+	private:
+		uint8_t* Buffer = nullptr;
+		size_t Capacity = 0;
+		size_t Bytes = 0;
+		uint32_t VehicleId = 0;
+		uint32_t ChannelBitmap = 0;
+		int NumChannels = 0;
+		uint16_t RecordBytes = WireRecordTimeBytes;
+		uint16_t RecordCount = 0;
+	};
+
+
+
+	/*--- Reader: validates the header and reads records in place ---*/
+	class FWirePacketView
+	{
+	public:
+
+		// Returns false for foreign or truncated datagrams
+		bool Parse(const uint8_t* Data, size_t Size)
+		{
+			Buffer = nullptr;
+			if (Size < WireHeaderBytes || WireLoadU32(Data) != WireMagic)
+			{
+				return false;
+			}
+
+			Version = WireLoadU16(Data + 4);
+			HeaderBytes = WireLoadU16(Data + 6);
+			VehicleId = WireLoadU32(Data + 8);
+			Sequence = WireLoadU32(Data + 12);
+			SimTime = WireLoadF64(Data + 16);
+			ChannelBitmap = WireLoadU32(Data + 24);
+			RecordCount = WireLoadU16(Data + 28);
+			RecordBytes = WireLoadU16(Data + 30);
+			NumChannels = WireCountChannels(ChannelBitmap);
+
+			if (HeaderBytes < WireHeaderBytes || RecordBytes < WireRecordTimeBytes + 4 * NumChannels)
+			{
+				return false;
+			}
+			if ((size_t)HeaderBytes + (size_t)RecordCount * RecordBytes > Size)
+			{
+				return false;
+			}
+			Buffer = Data;
+			return true;
+		}
+
+		double GetRecordTime(int Record) const
+		{
+			return WireLoadF64(GetRecord(Record));
+		}
+
+		// Value of the Index-th present channel
+		float GetRecordValue(int Record, int Index) const
+		{
+			return WireLoadF32(GetRecord(Record) + WireRecordTimeBytes + 4 * Index);
+		}
+
+		// Value of a channel by id, Default if the channel is not in this packet
+		float GetChannelValue(int Record, EWireChannel Channel, float Default = 0.0f) const
+		{
+			if (!(ChannelBitmap & WireChannelBit(Channel)))
+			{
+				return Default;
+			}
+			return GetRecordValue(Record, WireCountChannels(ChannelBitmap & (WireChannelBit(Channel) - 1)));
+		}
+
+		uint16_t Version = 0;
+		uint16_t HeaderBytes = 0;
+		uint32_t VehicleId = 0;
+		uint32_t Sequence = 0;
+		double SimTime = 0.0;
+		uint32_t ChannelBitmap = 0;
+		uint16_t RecordCount = 0;
+		uint16_t RecordBytes = 0;
+		int NumChannels = 0;
+
+	private:
+		const uint8_t* GetRecord(int Record) const { return Buffer + HeaderBytes + (size_t)Record * RecordBytes; }
+
+		const uint8_t* Buffer = nullptr;
+	};
+
+}
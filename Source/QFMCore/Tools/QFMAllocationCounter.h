@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+	Heap allocations of the process, for the benchmarks that check a path does not allocate.
+	Replaces the global operator new / delete: include it in the one source file of a tool only.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+
+static std::atomic<uint64_t> HeapAllocations(0);
+
+void* operator new(size_t Size)
+{
+	HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* Ptr = std::malloc(Size ? Size : 1))
+	{
+		return Ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t Size) { return operator new(Size); }
+
+// The replaced new above is malloc, free is its match. GCC pairs the frees with new as declared and warns
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* Ptr) noexcept { std::free(Ptr); }
+void operator delete[](void* Ptr) noexcept { std::free(Ptr); }
+void operator delete(void* Ptr, size_t) noexcept { std::free(Ptr); }
+void operator delete[](void* Ptr, size_t) noexcept { std::free(Ptr); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,188 @@
+/*
+	QFMAttitudeBench
+
+	Compares FAttitudeCore::UpdateAngleTarget (quaternion algebra) with the former rotator based UpdateAngleTargetRotator:
+	the error of one step of either against the former algorithm in double precision, and the time per call.
+	Usage: QFMAttitudeBench [Iterations] [ToleranceDeg]
+	Exit code 1 if a step of UpdateAngleTarget is off by more than ToleranceDeg.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "QFMCoreAttitude.h"
+#include "QFMCoreRandom.h"
+
+
+struct FTargetInput
+{
+	float Roll;
+	float Pitch;
+	float YawRate;
+	float DeltaTime;
+};
+
+
+/*--- The former algorithm in double: rotator yaw, axis / angle by atan2 ---*/
+
+struct FQuatd
+{
+	double X = 0.0, Y = 0.0, Z = 0.0, W = 1.0;
+
+	FQuatd() {}
+	FQuatd(double InX, double InY, double InZ, double InW) : X(InX), Y(InY), Z(InZ), W(InW) {}
+	explicit FQuatd(const QFM::FQuatf& Q) : X(Q.X), Y(Q.Y), Z(Q.Z), W(Q.W) {}
+
+	FQuatd operator*(const FQuatd& Q) const
+	{
+		return FQuatd(
+			W * Q.X + X * Q.W + Y * Q.Z - Z * Q.Y,
+			W * Q.Y - X * Q.Z + Y * Q.W + Z * Q.X,
+			W * Q.Z + X * Q.Y - Y * Q.X + Z * Q.W,
+			W * Q.W - X * Q.X - Y * Q.Y - Z * Q.Z);
+	}
+
+	FQuatd Scaled(double S) const { return FQuatd(X * S, Y * S, Z * S, W * S); }
+	FQuatd Inverse() const { return FQuatd(-X, -Y, -Z, W); }
+	double Dot(const FQuatd& Q) const { return X * Q.X + Y * Q.Y + Z * Q.Z + W * Q.W; }
+	FQuatd Normalized() const { return Scaled(1.0 / std::sqrt(Dot(*this))); }
+
+	// As FRotatorf::Quaternion, angles in deg
+	static FQuatd FromRotator(double Pitch, double Yaw, double Roll)
+	{
+		const double DivideBy2 = 3.14159265358979 / 360.0;
+		const double SP = std::sin(Pitch * DivideBy2), CP = std::cos(Pitch * DivideBy2);
+		const double SY = std::sin(Yaw * DivideBy2), CY = std::cos(Yaw * DivideBy2);
+		const double SR = std::sin(Roll * DivideBy2), CR = std::cos(Roll * DivideBy2);
+		return FQuatd(CR * SP * SY - SR * CP * CY, -CR * SP * CY - SR * CP * SY, CR * CP * SY - SR * SP * CY, CR * CP * CY + SR * SP * SY);
+	}
+};
+
+
+static FQuatd UpdateAngleTargetReference(FQuatd Target, const FTargetInput& In, float AccroRollPitchPGain)
+{
+	Target = (FQuatd::FromRotator(0.0, static_cast<double>(In.YawRate) * In.DeltaTime, 0.0) * Target).Normalized();
+
+	const double Yaw = std::atan2(2.0 * (Target.W * Target.Z + Target.X * Target.Y), 1.0 - 2.0 * (Target.Y * Target.Y + Target.Z * Target.Z)) * 180.0 / 3.14159265358979;
+	const FQuatd Desired = FQuatd::FromRotator(-In.Pitch, Yaw, -In.Roll);
+
+	const double Direction = Desired.Dot(Target) >= 0.0 ? 1.0 : -1.0;
+	const FQuatd Delta = (Desired.Scaled(Direction) * Target.Inverse()).Normalized();
+	const double Sin = std::sqrt(Delta.X * Delta.X + Delta.Y * Delta.Y + Delta.Z * Delta.Z);
+	const double Angle = 2.0 * std::atan2(Sin, Delta.W);
+	const double MaxAngle = static_cast<double>(AccroRollPitchPGain) * In.DeltaTime * 3.14159265358979 / 180.0;
+	if (Angle <= MaxAngle || Sin == 0.0)
+	{
+		return Desired.Scaled(Direction);
+	}
+	const double Scale = std::sin(0.5 * MaxAngle) / Sin;
+	return (FQuatd(Delta.X * Scale, Delta.Y * Scale, Delta.Z * Scale, std::cos(0.5 * MaxAngle)) * Target).Normalized();
+}
+
+
+// Angle between two rotations in deg
+static double GetAngleDeg(const FQuatd& A, const FQuatd& B)
+{
+	const FQuatd D = A * B.Inverse();
+	const double Sin = std::sqrt(D.X * D.X + D.Y * D.Y + D.Z * D.Z);
+	return 2.0 * std::atan2(Sin, std::fabs(D.W)) * 180.0 / 3.14159265358979;
+}
+
+
+// A new stick position every Hold substeps (4: every physics step of the multi-rate scheduler). The step length
+// changes now and then
+static std::vector<FTargetInput> MakeInputs(QFM::FRandomStream& Random, int Num, int Hold)
+{
+	static const float DeltaTimes[] = { 1.0f / 1000.0f, 1.0f / 250.0f, 1.0f / 60.0f, 1.0f / 30.0f };
+	std::vector<FTargetInput> Inputs(Num);
+	FTargetInput Held = {};
+	for (int i = 0; i < Num; i++)
+	{
+		if (i % 1024 == 0)
+		{
+			Held.DeltaTime = DeltaTimes[Random.NextUInt() % 4];
+		}
+		if (i % Hold == 0)
+		{
+			Held.Roll = Random.Uniform(-45.0f, 45.0f);
+			Held.Pitch = Random.Uniform(-45.0f, 45.0f);
+			Held.YawRate = Random.Uniform(-200.0f, 200.0f);
+		}
+		Inputs[i] = Held;
+	}
+	return Inputs;
+}
+
+
+static QFM::FQuatf RandomRotation(QFM::FRandomStream& Random)
+{
+	return QFM::FQuatf(QFM::FRotatorf(Random.Uniform(-80.0f, 80.0f), Random.Uniform(-180.0f, 180.0f), Random.Uniform(-80.0f, 80.0f)));
+}
+
+
+int main(int argc, char** argv)
+{
+	const int Iterations = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+	const double Tolerance = (argc > 2) ? std::atof(argv[2]) : 0.001;
+
+	QFM::FRandomStream Random(1, 0);
+	const std::vector<FTargetInput> Inputs = MakeInputs(Random, Iterations, 4);
+	const std::vector<FTargetInput> HeldInputs = MakeInputs(Random, Iterations, 1024);
+
+	// Per step from the same target: the error of both against the former algorithm in double
+	QFM::FAttitudeCore Quat;
+	QFM::FAttitudeCore Rotator;
+	double MaxQuatError = 0.0;
+	double MaxRotatorError = 0.0;
+	for (int i = 0; i < Iterations; i++)
+	{
+		if (i % 64 == 0)
+		{
+			Quat.AttitudeTargetQuat = RandomRotation(Random);
+		}
+		const FTargetInput& In = Inputs[i];
+		const FQuatd Reference = UpdateAngleTargetReference(FQuatd(Quat.AttitudeTargetQuat), In, Quat.AccroRollPitchPGain);
+		Rotator.AttitudeTargetQuat = Quat.AttitudeTargetQuat;
+		Quat.DeltaTime = Rotator.DeltaTime = In.DeltaTime;
+		Quat.UpdateAngleTarget(In.Roll, In.Pitch, In.YawRate);
+		Rotator.UpdateAngleTargetRotator(In.Roll, In.Pitch, In.YawRate);
+		MaxQuatError = std::max(MaxQuatError, GetAngleDeg(FQuatd(Quat.AttitudeTargetQuat), Reference));
+		MaxRotatorError = std::max(MaxRotatorError, GetAngleDeg(FQuatd(Rotator.AttitudeTargetQuat), Reference));
+	}
+
+	// Time per call, the targets run freely. Stick steps keep the rate limit busy, a held stick is reached mostly
+	auto Time = [](const std::vector<FTargetInput>& Sequence, QFM::FAttitudeCore& Core, void (QFM::FAttitudeCore::*Update)(float, float, float))
+	{
+		Core.AttitudeTargetQuat = QFM::FQuatf();
+		const auto Start = std::chrono::steady_clock::now();
+		for (const FTargetInput& In : Sequence)
+		{
+			Core.DeltaTime = In.DeltaTime;
+			(Core.*Update)(In.Roll, In.Pitch, In.YawRate);
+		}
+		const auto End = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(End - Start).count() / Sequence.size();
+	};
+	const double RotatorNs = Time(Inputs, Rotator, &QFM::FAttitudeCore::UpdateAngleTargetRotator);
+	const double QuatNs = Time(Inputs, Quat, &QFM::FAttitudeCore::UpdateAngleTarget);
+	const double RotatorHeldNs = Time(HeldInputs, Rotator, &QFM::FAttitudeCore::UpdateAngleTargetRotator);
+	const double QuatHeldNs = Time(HeldInputs, Quat, &QFM::FAttitudeCore::UpdateAngleTarget);
+
+	std::printf("Iterations: %d\n", Iterations);
+	std::printf("%-12s %14s %14s %14s\n", "", "Stick steps", "Held stick", "Max error");
+	std::printf("%-12s %11.1f ns %11.1f ns %10.6f deg\n", "Rotator", RotatorNs, RotatorHeldNs, MaxRotatorError);
+	std::printf("%-12s %11.1f ns %11.1f ns %10.6f deg\n", "Quaternion", QuatNs, QuatHeldNs, MaxQuatError);
+	std::printf("%-12s %13.1fx %13.1fx\n", "Speedup", RotatorNs / QuatNs, RotatorHeldNs / QuatHeldNs);
+	std::printf("Checksum: %f\n", Quat.AttitudeTargetQuat.W + Rotator.AttitudeTargetQuat.W);
+
+	if (MaxQuatError > Tolerance)
+	{
+		std::printf("Error above %g deg\n", Tolerance);
+		return 1;
+	}
+	return 0;
+}
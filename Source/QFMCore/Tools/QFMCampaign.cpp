@@ -0,0 +1,149 @@
+/*
+	QFMCampaign
+
+	Monte-Carlo robustness campaign: flies Runs randomized vehicles (mass, inertia, Engine_K, motor lag, sensor noise)
+	and writes one row per run to a column file, failed runs flagged.
+	Usage: QFMCampaign [Runs] [Seed] [OutFile] [Threads] [ConfigFile]
+	       QFMCampaign record Run RecordFile [Seed] [ConfigFile]
+	The second form flies one run again, bit exact, with the flight recorder attached: RecordFile and RecordFile.cfg
+	are ready for QFMReplay. ConfigFile: parameters of the vehicle, e.g. the .cfg of a flight record.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "QFMCoreCampaign.h"
+#include "QFMCoreMappedFile.h"
+#include "QFMCoreReplay.h"
+
+
+// Failed runs to list
+static const int PrintedFailures = 10;
+
+
+static void LoadConfig(QFM::FCampaignRunner& Runner, const char* Path)
+{
+	// First section of a recorder config, or plain Name=Value lines
+	std::ifstream File(Path);
+	std::stringstream Text;
+	Text << File.rdbuf();
+	const std::map<uint32_t, std::string> Sections = QFM::ParseFlightConfigFile(Text.str());
+	QFM::ApplyFlightModelConfig(Sections.empty() ? Text.str() : Sections.begin()->second, Runner.Base.GetRefs());
+}
+
+
+static int RecordRun(QFM::FCampaignRunner& Runner, uint32_t Run, const char* RecordFile)
+{
+	// The rings need 64 byte alignment, FFlightRecorderCore::operator new provides it
+	std::unique_ptr<QFM::FFlightRecorderCore> Recorder(new QFM::FFlightRecorderCore());
+	const uint64_t Steps = static_cast<uint64_t>(Runner.Settings.Duration * Runner.Settings.PhysicsHz);
+	if (!Recorder->Open(RecordFile, Steps))
+	{
+		std::printf("Cannot create %s\n", RecordFile);
+		return 1;
+	}
+
+	QFM::FFlightModelCore Model;
+	QFM::FCampaignTruth Truth;
+	float Values[QFM::MaxCampaignParams];
+	Runner.Sample(Run, Model, Truth, Values);
+	const std::string Config = QFM::FormatFlightConfigSection(0, Model.GetRefs());
+	std::ofstream(std::string(RecordFile) + ".cfg") << Config;
+
+	const QFM::FCampaignResult Result = Runner.Fly(Run, Recorder.get());
+	Recorder->Close();
+
+	std::printf("Run %u: failure %u, %llu records in %s\n", Result.Run, Result.Failure, (unsigned long long)Recorder->GetNumRecords(), RecordFile);
+	for (size_t p = 0; p < Runner.Params.size() && p < QFM::MaxCampaignParams; p++)
+	{
+		std::printf("  %-52s %g\n", Runner.Params[p].Name.c_str(), Result.Values[p]);
+	}
+	for (int m = 0; m < QFM::CampaignMetricNum; m++)
+	{
+		std::printf("  %-52s %g\n", QFM::GetCampaignMetricName(m), Result.Metrics[m]);
+	}
+
+	// Replayed by this binary the record is bit exact. QFMReplay may be compiled with other contractions of the
+	// float math, see the README
+	QFM::FMappedFile File;
+	QFM::FFlightRecordView View;
+	if (!File.OpenRead(RecordFile) || !View.Parse(File.GetData(), File.GetSize()))
+	{
+		std::printf("Cannot read %s back\n", RecordFile);
+		return 1;
+	}
+	QFM::FFlightReplayCore Replay;
+	Replay.bReseedEveryStep = false;
+	Replay.SetConfig(Config);
+	Replay.Run(View);
+	QFM::FReplayDivergence Divergence;
+	const bool bDiverged = Replay.GetFirstDivergence(Divergence);
+	std::printf("Replay: %s\n", bDiverged ? "diverged" : "bit exact");
+	return bDiverged ? 1 : 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	QFM::FCampaignRunner Runner;
+
+	if (argc > 3 && std::strcmp(argv[1], "record") == 0)
+	{
+		if (argc > 4) { Runner.Settings.Seed = static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10)); }
+		if (argc > 5) { LoadConfig(Runner, argv[5]); }
+		return RecordRun(Runner, static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)), argv[3]);
+	}
+
+	const uint32_t Runs = (argc > 1) ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1000;
+	if (argc > 2) { Runner.Settings.Seed = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)); }
+	const char* OutFile = (argc > 3) ? argv[3] : "Campaign.qfmc";
+	const int Threads = (argc > 4) ? std::atoi(argv[4]) : 0;
+	if (argc > 5) { LoadConfig(Runner, argv[5]); }
+
+	if (Runner.GetNumUnknownParams() > 0)
+	{
+		std::printf("Warning: %d sampled parameters name no parameter\n", Runner.GetNumUnknownParams());
+	}
+
+	QFM::FColumnFileWriter Out;
+	Runner.AddColumns(Out);
+	if (!Out.Open(OutFile))
+	{
+		std::printf("Cannot create %s\n", OutFile);
+		return 1;
+	}
+
+	QFM::FThreadPool Pool(Threads);
+	uint32_t FailureCounts[4] = {};
+	const auto Start = std::chrono::steady_clock::now();
+	const std::vector<uint32_t> Failed = Runner.Run(Pool, 0, Runs, &Out, [&FailureCounts](const std::vector<QFM::FCampaignResult>& Batch)
+	{
+		for (const QFM::FCampaignResult& Result : Batch)
+		{
+			for (int b = 0; b < 4; b++)
+			{
+				FailureCounts[b] += (Result.Failure >> b) & 1;
+			}
+		}
+	});
+	const auto End = std::chrono::steady_clock::now();
+	Out.Close();
+
+	const double Seconds = std::chrono::duration<double>(End - Start).count();
+	std::printf("Runs: %u (seed %u) on %d threads in %f s, %.0f per second\n", Runs, Runner.Settings.Seed, Pool.GetNumThreads(), Seconds, Runs / Seconds);
+	std::printf("Failed: %zu (non finite %u, flip %u, attitude %u, altitude %u)\n", Failed.size(),
+		FailureCounts[0], FailureCounts[1], FailureCounts[2], FailureCounts[3]);
+	std::printf("Results: %s\n", OutFile);
+	for (size_t i = 0; i < Failed.size() && i < PrintedFailures; i++)
+	{
+		std::printf("  QFMCampaign record %u Run%u.qfmr %u%s%s\n", Failed[i], Failed[i], Runner.Settings.Seed,
+			argc > 5 ? " " : "", argc > 5 ? argv[5] : "");
+	}
+	return 0;
+}
@@ -0,0 +1,536 @@
+/*
+	QFMEstimatorBench
+
+	Error state EKF of the AHRS (QFMCoreEstimator.h): the sparse covariance propagation against F P F^T + Q in double
+	precision, the sequential scalar updates against one joint update, and flights of the complete AHRS (sensors and
+	estimator) along a manoeuvring trajectory over several seeds: attitude, velocity and position errors of the
+	published values and the normalized estimation error squared (NEES, 1 = consistent). Then the time per estimator
+	step for a fleet of vehicles, IMU only and with every measurement, against the dense propagation, and the heap
+	allocations while stepping.
+	Usage: QFMEstimatorBench [Vehicles] [Seconds] [RateHz]
+	Exit code 1 if a value is off by more than the bounds below or stepping allocates.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "QFMCoreAHRS.h"
+#include "QFMCoreEstimator.h"
+#include "QFMCoreMatrix.h"
+#include "QFMCoreRandom.h"
+
+#include "QFMAllocationCounter.h"
+
+
+// Bounds
+static const double MaxPropagationError = 1e-5;		// sparse against dense, relative to the largest covariance
+static const double MaxSequentialError = 1e-4;		// sequential against joint update, relative
+static const double MaxAttitudeRms = 1.0;			// deg
+static const double MaxVelocityRms = 0.3;			// m/s
+static const double MaxPositionRms = 0.5;			// m
+
+static const int NumStates = QFM::FEstimatorCore::NumErrorStates;
+
+
+static double NsPer(std::chrono::high_resolution_clock::duration Time, double Count)
+{
+	return std::chrono::duration<double, std::nano>(Time).count() / Count;
+}
+
+
+
+/*--- Double precision helpers ---*/
+
+typedef std::vector<double> FDense;		// NumStates x NumStates, row major
+
+static FDense Multiply(const FDense& A, const FDense& B, int N)
+{
+	FDense Out(N * N, 0.0);
+	for (int r = 0; r < N; r++)
+	{
+		for (int k = 0; k < N; k++)
+		{
+			for (int c = 0; c < N; c++)
+			{
+				Out[r * N + c] += A[r * N + k] * B[k * N + c];
+			}
+		}
+	}
+	return Out;
+}
+
+static FDense Transpose(const FDense& A, int N)
+{
+	FDense Out(N * N);
+	for (int r = 0; r < N; r++)
+	{
+		for (int c = 0; c < N; c++)
+		{
+			Out[c * N + r] = A[r * N + c];
+		}
+	}
+	return Out;
+}
+
+// Solves A x = B (N x N, Gaussian elimination with partial pivoting), B is overwritten with x
+static bool Solve(FDense A, double* B, int N)
+{
+	for (int c = 0; c < N; c++)
+	{
+		int Pivot = c;
+		for (int r = c + 1; r < N; r++)
+		{
+			if (std::fabs(A[r * N + c]) > std::fabs(A[Pivot * N + c])) { Pivot = r; }
+		}
+		if (std::fabs(A[Pivot * N + c]) < 1e-300) { return false; }
+		for (int k = 0; k < N; k++) { std::swap(A[c * N + k], A[Pivot * N + k]); }
+		std::swap(B[c], B[Pivot]);
+		for (int r = c + 1; r < N; r++)
+		{
+			const double F = A[r * N + c] / A[c * N + c];
+			for (int k = c; k < N; k++) { A[r * N + k] -= F * A[c * N + k]; }
+			B[r] -= F * B[c];
+		}
+	}
+	for (int r = N - 1; r >= 0; r--)
+	{
+		for (int k = r + 1; k < N; k++) { B[r] -= A[r * N + k] * B[k]; }
+		B[r] /= A[r * N + r];
+	}
+	return true;
+}
+
+static FDense ToDense(const QFM::FEstimatorCore::FCovariance& P)
+{
+	FDense Out(NumStates * NumStates);
+	for (int r = 0; r < NumStates; r++)
+	{
+		for (int c = 0; c < NumStates; c++)
+		{
+			Out[r * NumStates + c] = P.M[r][c];
+		}
+	}
+	return Out;
+}
+
+static double RelativeError(const QFM::FEstimatorCore::FCovariance& P, const FDense& Reference)
+{
+	double Error = 0.0, Scale = 0.0;
+	for (int r = 0; r < NumStates; r++)
+	{
+		for (int c = 0; c < NumStates; c++)
+		{
+			Error = std::max(Error, std::fabs(P.M[r][c] - Reference[r * NumStates + c]));
+			Scale = std::max(Scale, std::fabs(Reference[r * NumStates + c]));
+		}
+	}
+	return Error / Scale;
+}
+
+
+// Random symmetric positive definite covariance with the magnitudes of a running filter
+static QFM::FEstimatorCore::FCovariance RandomCovariance(QFM::FRandomStream& Random)
+{
+	const double Sigma[5] = { 0.01, 0.1, 0.5, 0.002, 0.05 };
+	FDense L(NumStates * NumStates, 0.0);
+	for (int r = 0; r < NumStates; r++)
+	{
+		for (int c = 0; c <= r; c++)
+		{
+			L[r * NumStates + c] = Sigma[r / 3] * (r == c ? 1.0 + 0.5 * Random.Uniform() : 0.4 * (Random.Uniform() - 0.5));
+		}
+	}
+	const FDense P = Multiply(L, Transpose(L, NumStates), NumStates);
+	QFM::FEstimatorCore::FCovariance Out;
+	for (int r = 0; r < NumStates; r++)
+	{
+		for (int c = 0; c < NumStates; c++)
+		{
+			Out.M[r][c] = static_cast<float>(P[r * NumStates + c]);
+		}
+	}
+	Out.Symmetrize();
+	return Out;
+}
+
+
+
+/*--- Trajectory: circle with climbs, rolling, pitching and turning, all derivatives exact ---*/
+
+struct FQuatD { double X, Y, Z, W; };
+
+static FQuatD Mul(const FQuatD& A, const FQuatD& B)
+{
+	return { A.W * B.X + A.X * B.W + A.Y * B.Z - A.Z * B.Y, A.W * B.Y - A.X * B.Z + A.Y * B.W + A.Z * B.X,
+		A.W * B.Z + A.X * B.Y - A.Y * B.X + A.Z * B.W, A.W * B.W - A.X * B.X - A.Y * B.Y - A.Z * B.Z };
+}
+
+// FRotatorf::Quaternion in double, angles in rad
+static FQuatD FromRotator(double Pitch, double Yaw, double Roll)
+{
+	const double SP = std::sin(Pitch / 2), CP = std::cos(Pitch / 2);
+	const double SY = std::sin(Yaw / 2), CY = std::cos(Yaw / 2);
+	const double SR = std::sin(Roll / 2), CR = std::cos(Roll / 2);
+	return { CR * SP * SY - SR * CP * CY, -CR * SP * CY - SR * CP * SY, CR * CP * SY - SR * SP * CY, CR * CP * CY + SR * SP * SY };
+}
+
+static FQuatD TrueAttitude(double T)
+{
+	return FromRotator(0.2 * std::sin(0.7 * T), 0.3 * std::sin(0.2 * T) + 0.1 * T, 0.25 * std::sin(0.9 * T + 1.0));
+}
+
+static QFM::FBodyState TrueBody(double T)
+{
+	const double A = 20.0, W = 0.25, H = 3.0, WZ = 0.4;
+	QFM::FBodyState Body;
+	const FQuatD Q = TrueAttitude(T);
+	Body.Rotation = QFM::FQuatf(static_cast<float>(Q.X), static_cast<float>(Q.Y), static_cast<float>(Q.Z), static_cast<float>(Q.W));
+	Body.Position = QFM::FVec3(static_cast<float>(A * std::sin(W * T)), static_cast<float>(A * (1.0 - std::cos(W * T))),
+		static_cast<float>(10.0 + H * std::sin(WZ * T)));
+	Body.LinearVelocity = QFM::FVec3(static_cast<float>(A * W * std::cos(W * T)), static_cast<float>(A * W * std::sin(W * T)),
+		static_cast<float>(H * WZ * std::cos(WZ * T)));
+
+	// World angular velocity 2 dq/dt q^-1
+	const double Step = 1e-5;
+	const FQuatD Plus = TrueAttitude(T + Step), Minus = TrueAttitude(T - Step);
+	const FQuatD Rate = { (Plus.X - Minus.X) / (2 * Step), (Plus.Y - Minus.Y) / (2 * Step), (Plus.Z - Minus.Z) / (2 * Step), (Plus.W - Minus.W) / (2 * Step) };
+	const FQuatD Omega = Mul(Rate, { -Q.X, -Q.Y, -Q.Z, Q.W });
+	Body.AngularVelocity = QFM::FVec3(static_cast<float>(2 * Omega.X), static_cast<float>(2 * Omega.Y), static_cast<float>(2 * Omega.Z));
+	return Body;
+}
+
+
+// A good MEMS IMU, baro, 10 Hz position fixes with heading, and an estimator tuned to them
+static void Configure(QFM::FAHRSCore& AHRS, int Seed)
+{
+	QFM::FSensorSettings& Sensors = AHRS.Sensors.Settings;
+	Sensors.Enabled = true;
+	Sensors.ImuRateHz = 2000.0f;
+	Sensors.Seed = Seed;
+	Sensors.Gyro.NoiseDensity = 0.003f;
+	Sensors.Gyro.BiasRandomWalk = 0.0001f;
+	Sensors.Gyro.InitialBias = 0.005f;
+	Sensors.Accelerometer.NoiseDensity = 0.02f;
+	Sensors.Accelerometer.BiasRandomWalk = 0.001f;
+	Sensors.Accelerometer.InitialBias = 0.05f;
+	Sensors.BaroRateHz = 50.0f;
+	Sensors.BaroNoise = 0.3f;
+	Sensors.PositionRateHz = 10.0f;
+	Sensors.PositionNoise = 0.3f;
+	Sensors.HeadingNoise = 0.02f;
+
+	QFM::FEstimatorSettings& Estimator = AHRS.Estimator.Settings;
+	Estimator.Enabled = true;
+	Estimator.GyroNoise = 0.003f;
+	Estimator.AccelerometerNoise = 0.02f;
+	Estimator.GyroBiasRandomWalk = 0.0001f;
+	Estimator.AccelerometerBiasRandomWalk = 0.001f;
+	Estimator.BaroNoise = 0.3f;
+	Estimator.PositionNoise = 0.3f;
+	Estimator.HeadingNoise = 0.02f;
+	Estimator.InitialGyroBias = 0.01f;
+	Estimator.InitialAccelerometerBias = 0.1f;
+}
+
+
+
+int main(int argc, char** argv)
+{
+	const int Vehicles = (argc > 1) ? std::max(1, std::atoi(argv[1])) : 256;
+	const float Seconds = (argc > 2) ? static_cast<float>(std::atof(argv[2])) : 60.0f;
+	const float RateHz = (argc > 3) ? static_cast<float>(std::atof(argv[3])) : 1000.0f;
+	const float DeltaTime = 1.0f / RateHz;
+	const int Steps = std::max(100, static_cast<int>(Seconds * RateHz));
+	bool bPass = true;
+
+	std::printf("%d error states, estimator at %.0f Hz, SIMD width %d, %zu bytes per estimator\n",
+		NumStates, RateHz, QFM::SimdWidth, sizeof(QFM::FEstimatorCore));
+
+	/*--- Covariance propagation: sparse float against dense double ---*/
+	{
+		QFM::FRandomStream Random(5, 0, 0);
+		double Worst = 0.0;
+		for (int Trial = 0; Trial < 1000; Trial++)
+		{
+			QFM::FEstimatorCore Estimator;
+			Estimator.Covariance = RandomCovariance(Random);
+			const QFM::FVec3 Rate(Random.Normal() * 2.0f, Random.Normal() * 2.0f, Random.Normal() * 2.0f);
+			const QFM::FVec3 Force(Random.Normal() * 3.0f, Random.Normal() * 3.0f, 9.81f + Random.Normal() * 3.0f);
+			QFM::FQuatf Rotation(Random.Normal(), Random.Normal(), Random.Normal(), Random.Normal());
+			Rotation.Normalize();
+			const QFM::FMatrix3 R = QFM::RotationMatrix(Rotation);
+			const float T = 0.001f + 0.01f * Random.Uniform();
+
+			// F as described in QFMCoreEstimator.h
+			FDense F(NumStates * NumStates, 0.0);
+			for (int i = 0; i < NumStates; i++) { F[i * NumStates + i] = 1.0; }
+			const double W[3] = { Rate.X, Rate.Y, Rate.Z }, Fv[3] = { Force.X, Force.Y, Force.Z };
+			const double Skew[2][3][3] = {
+				{ { 0, -W[2], W[1] }, { W[2], 0, -W[0] }, { -W[1], W[0], 0 } },
+				{ { 0, -Fv[2], Fv[1] }, { Fv[2], 0, -Fv[0] }, { -Fv[1], Fv[0], 0 } } };
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					F[r * NumStates + c] -= T * Skew[0][r][c];
+					double RF = 0.0;
+					for (int k = 0; k < 3; k++) { RF += R.M[r][k] * Skew[1][k][c]; }
+					F[(3 + r) * NumStates + c] = -T * RF;
+					F[(3 + r) * NumStates + 12 + c] = -T * R.M[r][c];
+				}
+				F[r * NumStates + 9 + r] = -T;
+				F[(6 + r) * NumStates + 3 + r] = T;
+			}
+			FDense Reference = Multiply(Multiply(F, ToDense(Estimator.Covariance), NumStates), Transpose(F, NumStates), NumStates);
+			const double Noise[5] = {
+				double(Estimator.Settings.GyroNoise) * Estimator.Settings.GyroNoise * T,
+				double(Estimator.Settings.AccelerometerNoise) * Estimator.Settings.AccelerometerNoise * T, 0.0,
+				double(Estimator.Settings.GyroBiasRandomWalk) * Estimator.Settings.GyroBiasRandomWalk * T,
+				double(Estimator.Settings.AccelerometerBiasRandomWalk) * Estimator.Settings.AccelerometerBiasRandomWalk * T };
+			for (int i = 0; i < NumStates; i++) { Reference[i * NumStates + i] += Noise[i / 3]; }
+
+			Estimator.PropagateCovariance(Rate, Force, R, T);
+			Worst = std::max(Worst, RelativeError(Estimator.Covariance, Reference));
+		}
+		std::printf("Propagation         1000 random P, F    max err %9.3g   bound %9.3g\n", Worst, MaxPropagationError);
+		bPass &= Worst <= MaxPropagationError;
+	}
+
+	/*--- Sequential scalar updates against one joint update of a position fix ---*/
+	{
+		QFM::FRandomStream Random(6, 0, 0);
+		double Worst = 0.0;
+		for (int Trial = 0; Trial < 1000; Trial++)
+		{
+			QFM::FEstimatorCore Estimator;
+			Estimator.Settings.InnovationGate = 0.0f;
+			Estimator.Covariance = RandomCovariance(Random);
+			const float Sigma = 0.2f + Random.Uniform();
+			const float Measured[3] = { Random.Normal(), Random.Normal(), Random.Normal() };
+
+			// Joint: K = P H^T (H P H^T + R)^-1, dx = K y, P' = P - K H P
+			const FDense P = ToDense(Estimator.Covariance);
+			FDense S(9);
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					S[r * 3 + c] = P[(6 + r) * NumStates + 6 + c] + (r == c ? double(Sigma) * Sigma : 0.0);
+				}
+			}
+			double Correction[NumStates];
+			FDense Reference = P;
+			double Innovation[3] = { Measured[0], Measured[1], Measured[2] };
+			Solve(S, Innovation, 3);
+			for (int i = 0; i < NumStates; i++)
+			{
+				Correction[i] = 0.0;
+				for (int k = 0; k < 3; k++) { Correction[i] += P[i * NumStates + 6 + k] * Innovation[k]; }
+			}
+			for (int j = 0; j < NumStates; j++)
+			{
+				double Column[3] = { P[6 * NumStates + j], P[7 * NumStates + j], P[8 * NumStates + j] };
+				Solve(S, Column, 3);
+				for (int i = 0; i < NumStates; i++)
+				{
+					for (int k = 0; k < 3; k++) { Reference[i * NumStates + j] -= P[i * NumStates + 6 + k] * Column[k]; }
+				}
+			}
+
+			// Sequential, every residual against the state the axis before corrected
+			Estimator.FuseAxis(QFM::FEstimatorCore::ErrorPosition, Measured[0] - Estimator.Position.X, Sigma);
+			Estimator.FuseAxis(QFM::FEstimatorCore::ErrorPosition + 1, Measured[1] - Estimator.Position.Y, Sigma);
+			Estimator.FuseAxis(QFM::FEstimatorCore::ErrorPosition + 2, Measured[2] - Estimator.Position.Z, Sigma);
+
+			Worst = std::max(Worst, RelativeError(Estimator.Covariance, Reference));
+			const double Got[6] = { Estimator.Velocity.X, Estimator.Velocity.Y, Estimator.Velocity.Z,
+				Estimator.Position.X, Estimator.Position.Y, Estimator.Position.Z };
+			double Error = 0.0, Scale = 1e-3;
+			for (int i = 0; i < 6; i++)
+			{
+				Error = std::max(Error, std::fabs(Got[i] - Correction[3 + i]));
+				Scale = std::max(Scale, std::fabs(Correction[3 + i]));
+			}
+			Worst = std::max(Worst, Error / Scale);
+		}
+		std::printf("Sequential update   1000 position fixes   max err %9.3g   bound %9.3g\n", Worst, MaxSequentialError);
+		bPass &= Worst <= MaxSequentialError;
+	}
+
+	/*--- Flights of the AHRS with sensors and estimator, published values against the truth ---*/
+	std::vector<QFM::FImuBatch> Batches;
+	{
+		const int Seeds = 8;
+		const int Settle = static_cast<int>(RateHz);		// the first second is not counted
+		double Attitude2 = 0.0, Velocity2 = 0.0, Position2 = 0.0, Nees = 0.0;
+		double AttitudeMax = 0.0, PositionMax = 0.0;
+		double Count = 0.0;
+		uint32_t Rejected = 0;
+
+		for (int Seed = 1; Seed <= Seeds; Seed++)
+		{
+			std::vector<QFM::FAHRSCore> Holder(1);		// too big for the stack
+			QFM::FAHRSCore& AHRS = Holder[0];
+			Configure(AHRS, Seed);
+			AHRS.Init(nullptr);
+
+			for (int n = 1; n <= Steps; n++)
+			{
+				const QFM::FBodyState Body = TrueBody(n * static_cast<double>(DeltaTime));
+				AHRS.Tock(Body, DeltaTime);
+				if (Seed == 1 && n <= 2000)
+				{
+					Batches.push_back(AHRS.SensorBatch);
+				}
+				if (n <= Settle)
+				{
+					continue;
+				}
+
+				const QFM::FQuatf Estimated = AHRS.GetWorldRotationQuat();
+				QFM::FQuatf Error = Estimated.Inverse() * Body.Rotation;
+				const float Sign = Error.W < 0.0f ? -2.0f : 2.0f;
+				const QFM::FVec3 AttitudeError(Error.X * Sign, Error.Y * Sign, Error.Z * Sign);
+				const QFM::FVec3 VelocityError = Body.LinearVelocity - AHRS.GetWorldVelocity();
+				const QFM::FVec3 PositionError = Body.Position - AHRS.GetWorldTranslationVect();
+				const float AltitudeError = Body.Position.Z - AHRS.GetWorldAltitude();
+
+				const double Angle = QFM::RadiansToDegrees(AttitudeError.Size());
+				Attitude2 += Angle * Angle;
+				Velocity2 += VelocityError.SizeSquared();
+				Position2 += PositionError.SizeSquared();
+				AttitudeMax = std::max(AttitudeMax, Angle);
+				PositionMax = std::max(PositionMax, static_cast<double>(PositionError.Size()));
+				PositionMax = std::max(PositionMax, static_cast<double>(std::fabs(AltitudeError)));
+
+				// NEES of attitude, velocity and position
+				const FDense Full = ToDense(AHRS.Estimator.Covariance);
+				FDense P9(81);
+				for (int r = 0; r < 9; r++)
+				{
+					for (int c = 0; c < 9; c++) { P9[r * 9 + c] = Full[r * NumStates + c]; }
+				}
+				const double E[9] = { AttitudeError.X, AttitudeError.Y, AttitudeError.Z, VelocityError.X, VelocityError.Y, VelocityError.Z,
+					PositionError.X, PositionError.Y, PositionError.Z };
+				double X[9];
+				std::copy(E, E + 9, X);
+				if (Solve(P9, X, 9))
+				{
+					double Sum = 0.0;
+					for (int i = 0; i < 9; i++) { Sum += E[i] * X[i]; }
+					Nees += Sum / 9.0;
+				}
+				Count += 1.0;
+			}
+			Rejected += AHRS.Estimator.NumRejected;
+		}
+
+		const double AttitudeRms = std::sqrt(Attitude2 / Count);
+		const double VelocityRms = std::sqrt(Velocity2 / Count);
+		const double PositionRms = std::sqrt(Position2 / Count);
+		std::printf("Flight              %d seeds x %.0f s   attitude rms %.3f deg (max %.3f)   bound %.3f\n",
+			Seeds, Seconds, AttitudeRms, AttitudeMax, MaxAttitudeRms);
+		std::printf("                    velocity rms %.3f m/s   bound %.3f   position rms %.3f m (max %.3f)   bound %.3f\n",
+			VelocityRms, MaxVelocityRms, PositionRms, PositionMax, MaxPositionRms);
+		std::printf("                    NEES / state %.2f (1 = consistent)   rejected measurements %u\n", Nees / Count, Rejected);
+		bPass &= AttitudeRms <= MaxAttitudeRms && VelocityRms <= MaxVelocityRms && PositionRms <= MaxPositionRms;
+	}
+
+	/*--- Time per estimator step over a fleet, IMU only and with every measurement ---*/
+	{
+		const QFM::FBodyState Start = TrueBody(DeltaTime);
+		std::vector<QFM::FEstimatorCore> Fleet(Vehicles);
+		for (QFM::FEstimatorCore& Estimator : Fleet)
+		{
+			Estimator.Settings.InnovationGate = 0.0f;
+			Estimator.Align(Start);
+		}
+		const int Samples = Batches[0].Count;
+		const float Gravity = -9.81f;
+
+		double Ns[2] = { 1e30, 1e30 };
+		uint64_t Allocated = 0;
+		float Sink = 0.0f;
+		for (int Pass = 0; Pass < 2; Pass++)
+		{
+			for (QFM::FImuBatch& Batch : Batches)
+			{
+				Batch.bBaroNew = Pass == 1;
+				Batch.bPositionNew = Pass == 1;
+			}
+			for (int Run = 0; Run < 3; Run++)
+			{
+				const uint64_t Before = HeapAllocations.load(std::memory_order_relaxed);
+				const auto Begin = std::chrono::high_resolution_clock::now();
+				for (const QFM::FImuBatch& Batch : Batches)
+				{
+					for (QFM::FEstimatorCore& Estimator : Fleet)
+					{
+						Estimator.Step(Batch, Start, Gravity);
+					}
+				}
+				Ns[Pass] = std::min(Ns[Pass], NsPer(std::chrono::high_resolution_clock::now() - Begin, double(Batches.size()) * Vehicles));
+				Allocated += HeapAllocations.load(std::memory_order_relaxed) - Before;
+				for (QFM::FEstimatorCore& Estimator : Fleet)
+				{
+					Sink += Estimator.Position.Z;
+					Estimator.Align(Start);
+				}
+			}
+		}
+
+		// Covariance alone, sparse against dense F P F^T
+		QFM::FRandomStream Random(7, 0, 0);
+		QFM::FEstimatorCore Estimator;
+		const QFM::FEstimatorCore::FCovariance P = RandomCovariance(Random);
+		const QFM::FMatrix3 R = QFM::RotationMatrix(QFM::FQuatf::Identity());
+		const QFM::FVec3 Rate(0.1f, 0.2f, 0.3f), Force(0.5f, -0.2f, 9.81f);
+		QFM::FEstimatorCore::FCovariance F = QFM::FEstimatorCore::FCovariance::Identity();
+		QFM::FEstimatorCore::ApplyTransition(QFM::FEstimatorCore::FCovariance::Identity(), F, Rate, Force, R, DeltaTime);
+		const int Repeats = 200000;
+		double SparseNs = 1e30, DenseNs = 1e30;
+		for (int Run = 0; Run < 3; Run++)
+		{
+			Estimator.Covariance = P;
+			auto Begin = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < Repeats; i++)
+			{
+				Estimator.PropagateCovariance(Rate, Force, R, DeltaTime);
+				Estimator.Covariance.M[0][0] = P.M[0][0];
+			}
+			SparseNs = std::min(SparseNs, NsPer(std::chrono::high_resolution_clock::now() - Begin, Repeats));
+			Sink += Estimator.Covariance.M[3][4];
+
+			QFM::FEstimatorCore::FCovariance Dense = P;
+			const QFM::FEstimatorCore::FCovariance Ft = F.Transposed();
+			Begin = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < Repeats; i++)
+			{
+				Dense = F * Dense * Ft;
+				Dense.M[0][0] = P.M[0][0];
+			}
+			DenseNs = std::min(DenseNs, NsPer(std::chrono::high_resolution_clock::now() - Begin, Repeats));
+			Sink += Dense.M[3][4];
+		}
+
+		const double Worst = std::max(Ns[0], Ns[1]);
+		std::printf("ns per step         %d vehicles, %d samples   IMU only %8.1f   baro + position + heading %8.1f\n",
+			Vehicles, Samples, Ns[0], Ns[1]);
+		std::printf("ns per propagation  sparse %8.1f   dense F P F^T %8.1f (%.1fx)\n", SparseNs, DenseNs, DenseNs / SparseNs);
+		std::printf("Vehicles per core   at %.0f Hz, every measurement every step: %.0f\n", RateHz, 1e9 / (RateHz * Worst));
+		std::printf("Heap allocations    while stepping: %llu\n", static_cast<unsigned long long>(Allocated));
+		std::printf("Checksum: %f\n", Sink);
+		bPass &= Allocated == 0;
+	}
+
+	if (!bPass)
+	{
+		std::printf("Estimator off by more than its bound\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,291 @@
+/*
+	QFMFilterBench
+
+	Biquad filters (QFMCoreFilter.h): coefficients against double precision, the response of the low pass, notch and
+	RPM tracking notch to sines, FFilterBank (3 axes x N vehicles, SIMD) against one TFilterChain per vehicle, and
+	the time per vehicle step of both.
+	Usage: QFMFilterBench [Vehicles] [Steps] [RateHz]
+	Exit code 1 if a coefficient, a gain or the bank is off by more than the bounds below.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "QFMCoreFilter.h"
+#include "QFMCoreRandom.h"
+
+
+// Bounds
+static const double MaxCoefficientError = 2e-6;		// relative to the largest coefficient
+static const double MaxPassbandDb = 0.1;				// low pass a decade below the cutoff, notch two octaves off
+static const double MaxCutoffErrorDb = 0.1;			// low pass at the cutoff, against -20 log10(sqrt(2)) for Q 0.7071
+static const double MinStopbandDb = 38.0;			// low pass a decade above the cutoff (40 dB per decade)
+static const double MinNotchDb = 30.0;				// at the center
+static const double MinRpmNotchDb = 20.0;			// tracking a motor that spins up
+static const double MaxBankError = 1e-5;				// bank against the chains, relative to the amplitude
+
+
+/*--- Double precision reference: RBJ cookbook with sin and cos ---*/
+
+static void ReferenceBiquad(QFM::EBiquadType Type, double Hz, double Q, double DeltaTime, double Out[5])
+{
+	const double W0 = 2.0 * 3.14159265358979323846 * Hz * DeltaTime;
+	const double Alpha = std::sin(W0) / (2.0 * Q);
+	const double CosW = std::cos(W0);
+	const double A0 = 1.0 + Alpha;
+	if (Type == QFM::EBiquadType::LowPass)
+	{
+		Out[0] = (1.0 - CosW) / 2.0 / A0;
+		Out[1] = (1.0 - CosW) / A0;
+		Out[2] = Out[0];
+	}
+	else
+	{
+		Out[0] = 1.0 / A0;
+		Out[1] = -2.0 * CosW / A0;
+		Out[2] = Out[0];
+	}
+	Out[3] = -2.0 * CosW / A0;
+	Out[4] = (1.0 - Alpha) / A0;
+}
+
+
+// Gain in dB of a chain for a sine of Hz, from the amplitude after it settled
+template <typename FChain>
+static double MeasureGainDb(FChain& Chain, double Hz, double DeltaTime)
+{
+	Chain.Reset();
+	const int Settle = static_cast<int>(std::max(2.0, 20.0 / (Hz * DeltaTime)) + 2000);
+	const int Measure = static_cast<int>(std::max(2.0, 10.0 / (Hz * DeltaTime)) + 1000);
+	double SumIn = 0.0, SumOut = 0.0;
+	for (int n = 0; n < Settle + Measure; n++)
+	{
+		const double X = std::sin(2.0 * 3.14159265358979323846 * Hz * DeltaTime * n);
+		float Values[1] = { static_cast<float>(X) };
+		Chain.Step(Values, static_cast<float>(DeltaTime));
+		if (n >= Settle)
+		{
+			SumIn += X * X;
+			SumOut += static_cast<double>(Values[0]) * Values[0];
+		}
+	}
+	return 10.0 * std::log10(SumOut / SumIn);
+}
+
+
+static double NsPer(std::chrono::high_resolution_clock::duration Time, double Count)
+{
+	return std::chrono::duration<double, std::nano>(Time).count() / Count;
+}
+
+
+int main(int argc, char** argv)
+{
+	const int NumVehicles = (argc > 1) ? std::max(1, std::atoi(argv[1])) : 1024;
+	const int Steps = (argc > 2) ? std::max(1, std::atoi(argv[2])) : 2000;
+	const float RateHz = (argc > 3) ? static_cast<float>(std::atof(argv[3])) : 1000.0f;
+	const float DeltaTime = 1.0f / RateHz;
+	bool bPass = true;
+
+	std::printf("Biquads at %.0f Hz, SIMD width %d\n", RateHz, QFM::SimdWidth);
+
+	/*--- Coefficients, scalar and SIMD, from 0.1 Hz to just below Nyquist ---*/
+
+	double CoefficientError[2] = { 0.0, 0.0 };
+	for (int t = 0; t < 2; t++)
+	{
+		const QFM::EBiquadType Type = t == 0 ? QFM::EBiquadType::LowPass : QFM::EBiquadType::Notch;
+		for (float Hz = 0.1f; Hz < 0.48f * RateHz; Hz *= 1.01f)
+		{
+			for (float Q : { 0.5f, 0.7071f, 3.0f, 10.0f })
+			{
+				double Reference[5];
+				ReferenceBiquad(Type, Hz, Q, DeltaTime, Reference);
+				const QFM::FBiquadCoefficients C = QFM::ComputeBiquad(Type, Hz, Q, DeltaTime);
+				QFM::FSimdFloat B[5];
+				QFM::ComputeBiquad(Type, QFM::FSimdFloat(Hz), Q, DeltaTime, B);
+				float Lanes[5][QFM::SimdWidth];
+				for (int k = 0; k < 5; k++)
+				{
+					B[k].StoreUnaligned(Lanes[k]);
+				}
+
+				const float Scalar[5] = { C.B0, C.B1, C.B2, C.A1, C.A2 };
+				double Largest = 0.0;
+				for (int k = 0; k < 5; k++)
+				{
+					Largest = std::max(Largest, std::fabs(Reference[k]));
+				}
+				for (int k = 0; k < 5; k++)
+				{
+					CoefficientError[0] = std::max(CoefficientError[0], std::fabs(Scalar[k] - Reference[k]) / Largest);
+					CoefficientError[1] = std::max(CoefficientError[1], std::fabs(Lanes[k][0] - Reference[k]) / Largest);
+				}
+			}
+		}
+	}
+	std::printf("Coefficients        scalar err %9.3g   SIMD err %9.3g   bound %9.3g\n", CoefficientError[0], CoefficientError[1], MaxCoefficientError);
+	bPass &= CoefficientError[0] <= MaxCoefficientError && CoefficientError[1] <= MaxCoefficientError;
+
+	/*--- Responses of one channel ---*/
+
+	const float CutoffHz = RateHz / 20.0f;
+	QFM::TFilterChain<1, 1> LowPass;
+	LowPass.Settings.LowPassHz = CutoffHz;
+	const double Pass = MeasureGainDb(LowPass, CutoffHz / 10.0, DeltaTime);
+	const double Cutoff = MeasureGainDb(LowPass, CutoffHz, DeltaTime);
+	const double Stop = MeasureGainDb(LowPass, std::min(CutoffHz * 10.0, 0.45 * RateHz), DeltaTime);
+	std::printf("Low pass %6.1f Hz   passband %7.3f dB   cutoff %7.3f dB   decade above %7.2f dB\n", CutoffHz, Pass, Cutoff, Stop);
+	bPass &= std::fabs(Pass) <= MaxPassbandDb && std::fabs(Cutoff + 3.0103) <= MaxCutoffErrorDb && -Stop >= MinStopbandDb;
+
+	const float NotchHz = RateHz / 8.0f;
+	QFM::TFilterChain<1, 1> Notch;
+	Notch.Settings.NotchHz = NotchHz;
+	Notch.Settings.NotchQ = 3.0f;
+	const double Center = MeasureGainDb(Notch, NotchHz, DeltaTime);
+	const double Below = MeasureGainDb(Notch, NotchHz / 4.0, DeltaTime);
+	const double Above = MeasureGainDb(Notch, std::min(NotchHz * 4.0, 0.45 * RateHz), DeltaTime);
+	std::printf("Notch    %6.1f Hz   center %7.2f dB   2 octaves below %7.3f dB   above %7.3f dB\n", NotchHz, Center, Below, Above);
+	bPass &= -Center >= MinNotchDb && std::fabs(Below) <= MaxPassbandDb && std::fabs(Above) <= 1.0;
+
+	/*--- RPM notch: a motor spinning up from 30% to 90%, the vibration on its rotation frequency ---*/
+
+	{
+		const float MaxRPM = 0.4f * RateHz * 60.0f;		// full speed at 0.4 of the sample rate
+		QFM::TFilterChain<1, QFM::MaxFilterStages> Rpm;
+		Rpm.Settings.bRpmNotch = true;
+		Rpm.Settings.RpmNotchQ = 5.0f;
+		const int Num = 20 * static_cast<int>(RateHz);
+		double Phase = 0.0, SumIn = 0.0, SumOut = 0.0;
+		for (int n = 0; n < Num; n++)
+		{
+			const float Speed[4] = { 0.3f + 0.6f * n / Num, 0.0f, 0.0f, 0.0f };
+			Phase += 2.0 * 3.14159265358979323846 * Speed[0] * MaxRPM / 60.0 * DeltaTime;
+			float Values[1] = { static_cast<float>(std::sin(Phase)) };
+			Rpm.Step(Values, DeltaTime, Speed, 1, MaxRPM / 60.0f);
+			if (n >= Num / 10)
+			{
+				SumIn += std::sin(Phase) * std::sin(Phase);
+				SumOut += static_cast<double>(Values[0]) * Values[0];
+			}
+		}
+		const double Gain = 10.0 * std::log10(SumOut / SumIn);
+		std::printf("RPM notch %.0f..%.0f Hz sweep   %7.2f dB\n", 0.3f * MaxRPM / 60.0f, 0.9f * MaxRPM / 60.0f, Gain);
+		bPass &= -Gain >= MinRpmNotchDb;
+	}
+
+	/*--- Bank of 3 axes x N vehicles against one chain per vehicle: low pass, notch and 4 RPM notches ---*/
+
+	QFM::FFilterChainSettings Settings;
+	Settings.LowPassHz = RateHz / 10.0f;
+	Settings.NotchHz = RateHz / 6.0f;
+	Settings.bRpmNotch = true;
+	Settings.RpmNotchMinHz = 0.05f * RateHz;
+
+	const size_t Stride = QFM::SimdPadded(NumVehicles);
+	QFM::FFilterBank Bank;
+	Bank.Settings = Settings;
+	Bank.Resize(NumVehicles);
+	std::vector<QFM::TFilterChain<3, QFM::MaxFilterStages>> Chains(NumVehicles);
+	for (auto& Chain : Chains)
+	{
+		Chain.Settings = Settings;
+	}
+
+	QFM::FAlignedFloatArray Rates[3], Filtered[3], Speeds[4], SpeedToHz;
+	for (int a = 0; a < 3; a++)
+	{
+		Rates[a].Reserve(Stride);
+		Filtered[a].Reserve(Stride);
+	}
+	for (int m = 0; m < 4; m++)
+	{
+		Speeds[m].Reserve(Stride);
+	}
+	SpeedToHz.Reserve(Stride);
+
+	QFM::FRandomStream Random(1, 0);
+	for (int i = 0; i < NumVehicles; i++)
+	{
+		SpeedToHz[i] = Random.Uniform(0.2f, 0.45f) * RateHz;
+	}
+
+	auto SetInputs = [&](int Step)
+	{
+		for (int i = 0; i < NumVehicles; i++)
+		{
+			for (int m = 0; m < 4; m++)
+			{
+				Speeds[m][i] = 0.5f + 0.3f * std::sin(0.002f * Step * (m + 1) + i);
+			}
+			for (int a = 0; a < 3; a++)
+			{
+				Rates[a][i] = std::sin(0.05f * Step * (a + 1) + i) + 0.1f * Random.Normal();
+			}
+		}
+	};
+
+	const float* In[3] = { Rates[0].GetData(), Rates[1].GetData(), Rates[2].GetData() };
+	float* const Out[3] = { Filtered[0].GetData(), Filtered[1].GetData(), Filtered[2].GetData() };
+	const float* SpeedPtr[4] = { Speeds[0].GetData(), Speeds[1].GetData(), Speeds[2].GetData(), Speeds[3].GetData() };
+
+	double BankError = 0.0;
+	for (int n = 0; n < Steps; n++)
+	{
+		SetInputs(n);
+		Bank.Step(In, Out, DeltaTime, SpeedPtr, 4, SpeedToHz.GetData());
+		for (int i = 0; i < NumVehicles; i++)
+		{
+			float Values[3] = { Rates[0][i], Rates[1][i], Rates[2][i] };
+			const float Speed[4] = { Speeds[0][i], Speeds[1][i], Speeds[2][i], Speeds[3][i] };
+			Chains[i].Step(Values, DeltaTime, Speed, 4, SpeedToHz[i]);
+			for (int a = 0; a < 3; a++)
+			{
+				BankError = std::max(BankError, static_cast<double>(std::fabs(Values[a] - Filtered[a][i])));
+			}
+		}
+	}
+	std::printf("Bank vs chains      %d vehicles x %d steps   max err %9.3g   bound %9.3g\n", NumVehicles, Steps, BankError, MaxBankError);
+	bPass &= BankError <= MaxBankError;
+
+	/*--- Time per vehicle step, inputs set once ---*/
+
+	float Sink = 0.0f;
+	double BankNs = 1e30, ChainNs = 1e30;
+	for (int Run = 0; Run < 5; Run++)
+	{
+		auto Start = std::chrono::high_resolution_clock::now();
+		for (int n = 0; n < Steps; n++)
+		{
+			Bank.Step(In, Out, DeltaTime, SpeedPtr, 4, SpeedToHz.GetData());
+			Sink += Out[0][0];
+		}
+		BankNs = std::min(BankNs, NsPer(std::chrono::high_resolution_clock::now() - Start, static_cast<double>(Steps) * NumVehicles));
+
+		Start = std::chrono::high_resolution_clock::now();
+		for (int n = 0; n < Steps; n++)
+		{
+			for (int i = 0; i < NumVehicles; i++)
+			{
+				float Values[3] = { Rates[0][i], Rates[1][i], Rates[2][i] };
+				const float Speed[4] = { Speeds[0][i], Speeds[1][i], Speeds[2][i], Speeds[3][i] };
+				Chains[i].Step(Values, DeltaTime, Speed, 4, SpeedToHz[i]);
+				Sink += Values[0];
+			}
+		}
+		ChainNs = std::min(ChainNs, NsPer(std::chrono::high_resolution_clock::now() - Start, static_cast<double>(Steps) * NumVehicles));
+	}
+	std::printf("ns per vehicle step (3 axes, 6 stages)   bank %7.2f   chain %7.2f\n", BankNs, ChainNs);
+	std::printf("Checksum: %f\n", Sink);
+
+	if (!bPass)
+	{
+		std::printf("Filter off by more than its bound\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,196 @@
+/*
+	QFMFleetBench
+
+	Steps fleets of N vehicles through FFleetCore and reports vehicles stepped per millisecond,
+	once through the SIMD path and once through the per vehicle reference path.
+	Then steps a fleet next to one FFlightModelCore per vehicle (FAttitudeCore::TockRateLoop, FEngineCore with
+	UseMixerTorque) with the same sticks and body rates and compares thrust and torque of every step.
+	Usage: QFMFleetBench [Steps] [ControlLoop 0..2]
+	Exit code 1 if the fleet is off from the flight models by more than the bound below.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "QFMCoreFleet.h"
+
+
+// Bounds
+// Fleet against the flight models, relative to full thrust / torque scale. Both round differently and the rate loop
+// request is divided by DeltaTime (the PID derivative once more), so the rounding shows in the motor speeds ~1e4 times larger
+static const float MaxModelError = 2e-3f;
+static const int ModelCheckVehicles = 64;
+static const int ModelCheckSteps = 2000;
+
+
+// Vehicle i of a fleet, with a little variation between vehicles
+static void SetupModel(QFM::FFlightModelCore& Model, int Index, QFM::EControlLoop ControlLoop)
+{
+	Model.AttitudeController.FlightMode = QFM::EFlightMode::Accro;
+	Model.AttitudeController.RotationControlLoop = ControlLoop;
+	Model.AttitudeController.RateRollPidSettings = QFM::FVec3(1.0f, 0.5f, 0.01f);
+	Model.AttitudeController.RatePitchPidSettings = QFM::FVec3(1.0f, 0.5f, 0.01f);
+	Model.AttitudeController.RateYawPidSettings = QFM::FVec3(1.0f, 0.1f, 0.0f);
+	Model.AttitudeController.SPDFrequency = 10.0f;
+	Model.AttitudeController.AccroRollPitchPGain = 150.0f + (Index % 7) * 10.0f;
+	Model.EngineController.UseMixerTorque = true;
+	Model.Vehicle.Mass = 1.0f + 0.001f * (Index % 100);
+	Model.Vehicle.FrameMode = (Index & 1) ? QFM::EFrameMode::Plus : QFM::EFrameMode::Cross;
+}
+
+
+static void SetupFleet(QFM::FFleetCore& Fleet, int Count, QFM::EControlLoop ControlLoop)
+{
+	Fleet.RateControlLoop = ControlLoop;
+
+	for (int i = 0; i < Count; i++)
+	{
+		QFM::FFlightModelCore Model;
+		SetupModel(Model, i, ControlLoop);
+		Fleet.AddVehicle(Model);
+	}
+}
+
+
+static float GetPhase(int Step, int Index)
+{
+	return static_cast<float>((Step + Index * 37) % 4096) / 4096.0f;
+}
+
+
+static void FeedFleet(QFM::FFleetCore& Fleet, int Step)
+{
+	for (int i = 0; i < Fleet.Num(); i++)
+	{
+		const float Phase = GetPhase(Step, i);
+		Fleet.SetStickInput(i, Phase - 0.5f, 0.5f - Phase, 0.25f, Phase);
+		Fleet.SetBodyRates(i, QFM::FVec3(0.1f * Phase, -0.1f * Phase, 0.5f));
+	}
+}
+
+
+// Returns vehicles per millisecond
+template <typename TStep>
+static double RunFleet(QFM::FFleetCore& Fleet, int Steps, TStep StepFunction)
+{
+	const float DeltaTime = 1.0f / 1000.0f;
+	double Seconds = 0.0;
+
+	for (int s = 0; s < Steps; s++)
+	{
+		FeedFleet(Fleet, s);
+
+		const auto Start = std::chrono::steady_clock::now();
+		StepFunction(Fleet, DeltaTime);
+		Seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	}
+	return static_cast<double>(Fleet.Num()) * Steps / (Seconds * 1000.0);
+}
+
+
+// Error of the fleet against one flight model per vehicle with the same inputs, over every step
+// (relative to full thrust / torque scale)
+static float CheckAgainstModels(QFM::EControlLoop ControlLoop, float DeltaTime)
+{
+	QFM::FFleetCore Fleet;
+	SetupFleet(Fleet, ModelCheckVehicles, ControlLoop);
+
+	std::vector<QFM::FFlightModelCore> Models(ModelCheckVehicles);
+	QFM::FBodyState Body;
+	for (int i = 0; i < ModelCheckVehicles; i++)
+	{
+		SetupModel(Models[i], i, ControlLoop);
+		Models[i].Init(Body);
+	}
+
+	float MaxError = 0.0f;
+	for (int s = 0; s < ModelCheckSteps; s++)
+	{
+		// Sweeps the whole stick range, through saturated and unsaturated mixes
+		const int Step = s * 4096 / ModelCheckSteps;
+		FeedFleet(Fleet, Step);
+		Fleet.Step(DeltaTime);
+
+		for (int i = 0; i < ModelCheckVehicles; i++)
+		{
+			QFM::FFlightModelCore& Model = Models[i];
+			const float Phase = GetPhase(Step, i);
+			Model.PilotInput.RollAxisInput = Phase - 0.5f;
+			Model.PilotInput.PitchAxisInput = 0.5f - Phase;
+			Model.PilotInput.YawAxisInput = 0.25f;
+			Model.PilotInput.ThrottleAxisInput = Phase;
+			Body.AngularVelocity = QFM::FVec3(0.1f * Phase, -0.1f * Phase, 0.5f);
+
+			Model.PilotInput.Tock(DeltaTime);
+			Model.AttitudeController.TockRateLoop(DeltaTime, Body);
+			Model.EngineController.Tock(DeltaTime);
+
+			const float Thrust = Model.EngineController.GetTotalThrust().Z;
+			const float ThrustScale = std::max(1.0f, std::fabs(Thrust));
+			MaxError = std::max(MaxError, std::fabs(Fleet.GetThrust(i) - Thrust) / ThrustScale);
+
+			const QFM::FVec3 A = Fleet.GetTorque(i);
+			const QFM::FVec3 B = Model.EngineController.GetTotalTorque();
+			const float TorqueScale = std::max(1.0f, std::fabs(B.X) + std::fabs(B.Y) + std::fabs(B.Z));
+			MaxError = std::max(MaxError, (std::fabs(A.X - B.X) + std::fabs(A.Y - B.Y) + std::fabs(A.Z - B.Z)) / TorqueScale);
+		}
+	}
+	return MaxError;
+}
+
+
+int main(int argc, char** argv)
+{
+	const long long VehicleSteps = (argc > 1) ? std::atoll(argv[1]) : 20000000;
+	const QFM::EControlLoop ControlLoop = static_cast<QFM::EControlLoop>((argc > 2) ? std::atoi(argv[2]) : 1);
+	const int FleetSizes[] = { 1, 64, 1024, 16384 };
+
+	std::printf("SIMD width: %d\n", QFM::SimdWidth);
+	std::printf("%8s %18s %18s %8s %12s\n", "N", "SIMD veh/ms", "Scalar veh/ms", "Speedup", "Max error");
+
+	for (int Count : FleetSizes)
+	{
+		const int Steps = static_cast<int>(std::max<long long>(VehicleSteps / Count, 10));
+
+		QFM::FFleetCore SimdFleet;
+		QFM::FFleetCore ScalarFleet;
+		SetupFleet(SimdFleet, Count, ControlLoop);
+		SetupFleet(ScalarFleet, Count, ControlLoop);
+
+		const double SimdRate = RunFleet(SimdFleet, Steps, [](QFM::FFleetCore& Fleet, float Dt) { Fleet.Step(Dt); });
+		const double ScalarRate = RunFleet(ScalarFleet, Steps, [](QFM::FFleetCore& Fleet, float Dt) { Fleet.StepScalar(Dt); });
+
+		// Both fleets saw identical inputs, compare the last step (relative to full thrust / torque scale)
+		float MaxError = 0.0f;
+		for (int i = 0; i < Count; i++)
+		{
+			const float ThrustScale = std::max(1.0f, std::fabs(ScalarFleet.GetThrust(i)));
+			MaxError = std::max(MaxError, std::fabs(SimdFleet.GetThrust(i) - ScalarFleet.GetThrust(i)) / ThrustScale);
+
+			const QFM::FVec3 A = SimdFleet.GetTorque(i);
+			const QFM::FVec3 B = ScalarFleet.GetTorque(i);
+			const float TorqueScale = std::max(1.0f, std::fabs(B.X) + std::fabs(B.Y) + std::fabs(B.Z));
+			MaxError = std::max(MaxError, (std::fabs(A.X - B.X) + std::fabs(A.Y - B.Y) + std::fabs(A.Z - B.Z)) / TorqueScale);
+		}
+
+		std::printf("%8d %18.0f %18.0f %7.2fx %12.2e\n", Count, SimdRate, ScalarRate, SimdRate / ScalarRate, MaxError);
+	}
+
+	// Same sticks and body rates through FFlightModelCore, every rate loop
+	bool Ok = true;
+	const char* LoopNames[] = { "P", "PID", "SPD" };
+	std::printf("\nFleet against %d flight models over %d steps (max %.0e):\n", ModelCheckVehicles, ModelCheckSteps, MaxModelError);
+	for (int Loop = 0; Loop < 3; Loop++)
+	{
+		const float ModelError = CheckAgainstModels(static_cast<QFM::EControlLoop>(Loop), 1.0f / 1000.0f);
+		const bool LoopOk = ModelError <= MaxModelError;
+		std::printf("%8s %12.2e %s\n", LoopNames[Loop], ModelError, LoopOk ? "ok" : "FAILED");
+		Ok = Ok && LoopOk;
+	}
+
+	return Ok ? 0 : 1;
+}
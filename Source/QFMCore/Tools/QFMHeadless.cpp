@@ -0,0 +1,167 @@
+/*
+	QFMHeadless
+
+	Steps the flight model controller chain without any engine running.
+	Usage: QFMHeadless [Iterations] [FlightMode 0..3] [ControlLoop 0..2] [PhysicsHz] [FrameMode 0..5] [RecordFile] [ConfigFile]
+	With PhysicsHz the multi-rate scheduler runs the stages, fed with physics steps of 1/PhysicsHz.
+	With RecordFile every step goes to a flight record file, written by a second thread as in the game,
+	and the parameters to RecordFile.cfg. QFMReplay replays it. RecordFile "-" records nothing.
+	ConfigFile: further parameters (e.g. AHRS.Sensors.*), first section of a recorder config or Name=Value lines.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "QFMCoreFlightConfig.h"
+#include "QFMCoreFlightModel.h"
+#include "QFMCoreFlightRecorder.h"
+
+
+// Flush loop of the recorder, see FQFMFlightRecorder::Run
+static void RunFlightRecorder(QFM::FFlightRecorderCore* Recorder, const std::atomic<bool>* bRecording)
+{
+	auto LastCommit = std::chrono::steady_clock::now();
+	while (bRecording->load(std::memory_order_acquire))
+	{
+		const uint32_t Records = Recorder->Drain();
+
+		const auto Now = std::chrono::steady_clock::now();
+		if (Now - LastCommit >= std::chrono::milliseconds(50))
+		{
+			Recorder->Commit();
+			LastCommit = Now;
+		}
+
+		if (Records == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	const long long Iterations = (argc > 1) ? std::atoll(argv[1]) : 1000000;
+	const int FlightMode = (argc > 2) ? std::atoi(argv[2]) : 1;
+	const int ControlLoop = (argc > 3) ? std::atoi(argv[3]) : 0;
+	const float PhysicsHz = (argc > 4) ? static_cast<float>(std::atof(argv[4])) : 0.0f;
+	const int FrameMode = (argc > 5) ? std::atoi(argv[5]) : 0;
+	const char* RecordFile = (argc > 6 && std::string(argv[6]) != "-") ? argv[6] : nullptr;
+	const char* ConfigFile = (argc > 7) ? argv[7] : nullptr;
+
+	QFM::FFlightModelCore Model;
+	Model.Vehicle.FrameMode = static_cast<QFM::EFrameMode>(FrameMode);
+	Model.AttitudeController.FlightMode = static_cast<QFM::EFlightMode>(FlightMode);
+	Model.AttitudeController.RotationControlLoop = static_cast<QFM::EControlLoop>(ControlLoop);
+	Model.PositionController.TranslationControlLoop = static_cast<QFM::EControlLoop>(ControlLoop);
+	if (ConfigFile)
+	{
+		std::ifstream File(ConfigFile);
+		std::stringstream Text;
+		Text << File.rdbuf();
+		const std::map<uint32_t, std::string> Sections = QFM::ParseFlightConfigFile(Text.str());
+		const int Unknown = QFM::ApplyFlightModelConfig(Sections.empty() ? Text.str() : Sections.begin()->second, Model.GetRefs());
+		if (!File || Unknown > 0)
+		{
+			std::fprintf(stderr, "%s: %s\n", ConfigFile, File ? "unknown parameters" : "cannot read");
+			return 1;
+		}
+	}
+
+	QFM::FBodyState Body;
+	Body.Position = QFM::FVec3(0.0f, 0.0f, 10.0f);
+	Model.Init(Body);
+
+	// Synthetic trajectory: slow yaw spin with a small wobble, sticks moving
+	const bool bMultiRate = PhysicsHz > 0.0f;
+	const float DeltaTime = bMultiRate ? 1.0f / PhysicsHz : 1.0f / 1000.0f;
+	const QFM::FQuatf Spin(QFM::FVec3(0.0f, 0.0f, 1.0f), 0.5f * DeltaTime);
+	double Checksum = 0.0;
+
+	std::unique_ptr<QFM::FFlightRecorderCore> Recorder;
+	std::atomic<bool> bRecording(false);
+	std::thread FlushThread;
+	if (RecordFile)
+	{
+		Recorder.reset(new QFM::FFlightRecorderCore());
+		if (!Recorder->Open(RecordFile, static_cast<uint64_t>(Iterations)))
+		{
+			std::fprintf(stderr, "Cannot create %s\n", RecordFile);
+			return 1;
+		}
+		std::ofstream(std::string(RecordFile) + ".cfg") << QFM::FormatFlightConfigSection(0, Model.GetRefs());
+		bRecording.store(true);
+		FlushThread = std::thread(RunFlightRecorder, Recorder.get(), &bRecording);
+	}
+	double SimTime = 0.0;
+
+	const auto Start = std::chrono::steady_clock::now();
+	for (long long i = 0; i < Iterations; i++)
+	{
+		const float Phase = static_cast<float>(i % 4096) / 4096.0f;
+
+		Model.PilotInput.RollAxisInput = Phase - 0.5f;
+		Model.PilotInput.PitchAxisInput = 0.5f - Phase;
+		Model.PilotInput.YawAxisInput = 0.25f;
+		Model.PilotInput.ThrottleAxisInput = Phase;
+
+		Body.Rotation = Spin * Body.Rotation;
+		Body.AngularVelocity = QFM::FVec3(0.0f, 0.0f, 0.5f);
+		Body.LinearVelocity = QFM::FVec3(1.0f, 0.0f, Phase - 0.5f);
+		Body.Position = Body.Position + Body.LinearVelocity * DeltaTime;
+
+		if (bMultiRate)
+		{
+			Model.SimulateMultiRate(Body, DeltaTime);
+		}
+		else
+		{
+			Model.Simulate(Body, DeltaTime);
+		}
+		Checksum += Model.GetTotalThrust().Z + Model.GetTotalTorque().Z;
+		SimTime += DeltaTime;
+
+		if (Recorder)
+		{
+			QFM::FFlightRecord Record;
+			QFM::FillFlightRecord(Record, Model.GetRefs(), DeltaTime, Body, bMultiRate, Model.GetTotalThrust(), Model.GetTotalTorque());
+			Record.SimTime = SimTime;
+			Record.Step = static_cast<uint32_t>(i);
+			Recorder->Push(QFM::TelemetryProducerPhysics, Record);
+		}
+	}
+	const auto End = std::chrono::steady_clock::now();
+
+	if (Recorder)
+	{
+		bRecording.store(false, std::memory_order_release);
+		FlushThread.join();
+		Recorder->Close();
+	}
+
+	const double Seconds = std::chrono::duration<double>(End - Start).count();
+	std::printf("Iterations: %lld\n", Iterations);
+	std::printf("Engines: %d\n", Model.EngineController.GetNumEngines());
+	std::printf("Time (s): %f\n", Seconds);
+	std::printf("Iterations per second: %.0f\n", Iterations / Seconds);
+	std::printf("ns per iteration: %.2f\n", Seconds * 1e9 / Iterations);
+	std::printf("Checksum: %f\n", Checksum);
+	if (bMultiRate)
+	{
+		std::printf("Rate loop ticks: %llu (dropped %llu)\n", (unsigned long long)Model.Scheduler.TickCount, (unsigned long long)Model.Scheduler.DroppedTicks);
+	}
+	if (Recorder)
+	{
+		std::printf("Flight records: %llu (dropped %llu) in %s\n", (unsigned long long)Recorder->GetNumRecords(), (unsigned long long)Recorder->GetDroppedRecords(), RecordFile);
+	}
+
+	return 0;
+}
@@ -0,0 +1,380 @@
+/*
+	QFMQuatBench
+
+	Quaternion kernels (QFMCoreQuatKernels.h) against the FQuatf code they replace: the max error of the scalar and
+	the SimdWidth wide form against double precision, and the time per quaternion.
+	Usage: QFMQuatBench [Count] [Repeats]
+	Exit code 1 if a kernel is off by more than the error documented in QFMCoreQuatKernels.h.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "QFMCoreQuatKernels.h"
+#include "QFMCoreRandom.h"
+
+
+/*--- Double precision references ---*/
+
+struct FQuatd
+{
+	double X, Y, Z, W;
+};
+
+static FQuatd ToDouble(const QFM::FQuatf& Q) { return FQuatd{ Q.X, Q.Y, Q.Z, Q.W }; }
+
+// A * B.Inverse(), the short way round
+static FQuatd RelativeReference(const QFM::FQuatf& A, const QFM::FQuatf& B)
+{
+	const FQuatd a = ToDouble(A), b = ToDouble(B);
+	const FQuatd d = {
+		a.X * b.W - a.W * b.X - a.Y * b.Z + a.Z * b.Y,
+		a.Y * b.W - a.W * b.Y + a.X * b.Z - a.Z * b.X,
+		a.Z * b.W - a.W * b.Z - a.X * b.Y + a.Y * b.X,
+		a.W * b.W + a.X * b.X + a.Y * b.Y + a.Z * b.Z };
+	const double Sign = d.W >= 0.0 ? 1.0 : -1.0;
+	return FQuatd{ d.X * Sign, d.Y * Sign, d.Z * Sign, d.W * Sign };
+}
+
+static void RotationVectorReference(const FQuatd& Q, double Out[3])
+{
+	const double Sign = Q.W >= 0.0 ? 1.0 : -1.0;
+	const double S = std::sqrt(Q.X * Q.X + Q.Y * Q.Y + Q.Z * Q.Z);
+	const double Scale = S > 0.0 ? Sign * 2.0 * std::atan2(S, Q.W * Sign) / S : 2.0 / std::fabs(Q.W);
+	Out[0] = Q.X * Scale;
+	Out[1] = Q.Y * Scale;
+	Out[2] = Q.Z * Scale;
+}
+
+static double Distance(const double A[3], const QFM::FVec3& B)
+{
+	return std::sqrt((A[0] - B.X) * (A[0] - B.X) + (A[1] - B.Y) * (A[1] - B.Y) + (A[2] - B.Z) * (A[2] - B.Z));
+}
+
+static double MaxDifference(const FQuatd& A, const QFM::FQuatf& B)
+{
+	return std::max({ std::fabs(A.X - B.X), std::fabs(A.Y - B.Y), std::fabs(A.Z - B.Z), std::fabs(A.W - B.W) });
+}
+
+static double UnitError(const QFM::FQuatf& Q)
+{
+	const FQuatd q = ToDouble(Q);
+	return std::fabs(1.0 - std::sqrt(q.X * q.X + q.Y * q.Y + q.Z * q.Z + q.W * q.W));
+}
+
+
+/*--- The FQuatf code the kernels replace ---*/
+
+static QFM::FQuatf RelativeFQuat(const QFM::FQuatf& A, const QFM::FQuatf& B)
+{
+	const float Direction = ((A | B) >= 0) ? 1.0f : -1.0f;
+	return (A * Direction) * B.Inverse();
+}
+
+static QFM::FVec3 RotationVectorFQuat(QFM::FQuatf DeltaQuat)
+{
+	DeltaQuat.Normalize();
+	QFM::FVec3 Axis;
+	float Angle = 0.0f;
+	DeltaQuat.ToAxisAndAngle(Axis, Angle);
+	Axis.Normalize();
+	return Axis * Angle;
+}
+
+static QFM::FQuatf FromRotationVectorFQuat(const QFM::FVec3& V)
+{
+	const float Angle = V.Size();
+	return Angle > 0.0f ? QFM::FQuatf(V / Angle, Angle) : QFM::FQuatf();
+}
+
+
+/*--- Inputs ---*/
+
+static QFM::FQuatf RandomRotation(QFM::FRandomStream& Random)
+{
+	QFM::FQuatf Q(Random.Normal(), Random.Normal(), Random.Normal(), Random.Normal());
+	Q.Normalize();
+	return Q;
+}
+
+// Angle log-uniform from 1e-7 rad to MaxAngle, so the small errors of an attitude loop get as many samples as the large
+static QFM::FVec3 RandomRotationVector(QFM::FRandomStream& Random, float MaxAngle)
+{
+	QFM::FVec3 Axis(Random.Normal(), Random.Normal(), Random.Normal());
+	Axis.Normalize();
+	return Axis * std::min(std::exp(Random.Uniform(std::log(1e-7f), std::log(MaxAngle))), MaxAngle);
+}
+
+
+// SoA arrays padded to SimdWidth
+template<int N>
+struct FSoA
+{
+	QFM::FAlignedFloatArray Arrays[N];
+	float* Ptr[N];
+
+	explicit FSoA(size_t Count)
+	{
+		for (int c = 0; c < N; c++)
+		{
+			Arrays[c].Reserve(QFM::SimdPadded(Count));
+			Ptr[c] = Arrays[c].GetData();
+		}
+	}
+
+	const float* const* In() const { return Ptr; }
+};
+
+using FSoAQuats = FSoA<4>;
+using FSoAVecs = FSoA<3>;
+
+static void Set(FSoAQuats& A, size_t i, const QFM::FQuatf& Q) { A.Ptr[0][i] = Q.X; A.Ptr[1][i] = Q.Y; A.Ptr[2][i] = Q.Z; A.Ptr[3][i] = Q.W; }
+static QFM::FQuatf Get(const FSoAQuats& A, size_t i) { return QFM::FQuatf(A.Ptr[0][i], A.Ptr[1][i], A.Ptr[2][i], A.Ptr[3][i]); }
+static void Set(FSoAVecs& A, size_t i, const QFM::FVec3& V) { A.Ptr[0][i] = V.X; A.Ptr[1][i] = V.Y; A.Ptr[2][i] = V.Z; }
+static QFM::FVec3 Get(const FSoAVecs& A, size_t i) { return QFM::FVec3(A.Ptr[0][i], A.Ptr[1][i], A.Ptr[2][i]); }
+
+static QFM::FSimdVec3 LoadVec(const FSoAVecs& A, size_t i)
+{
+	return QFM::FSimdVec3{ QFM::FSimdFloat::Load(A.Ptr[0] + i), QFM::FSimdFloat::Load(A.Ptr[1] + i), QFM::FSimdFloat::Load(A.Ptr[2] + i) };
+}
+
+
+// One row of the table: time per quaternion and max error of the FQuatf code, the scalar and the SIMD kernel
+struct FRow
+{
+	const char* Name;
+	double Bound;
+	double Ns[3];
+	double Error[3];
+};
+
+template<typename FunctionType>
+static double TimeNs(int Repeats, size_t Count, FunctionType&& Function)
+{
+	const auto Start = std::chrono::steady_clock::now();
+	for (int r = 0; r < Repeats; r++)
+	{
+		Function();
+	}
+	const auto End = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(End - Start).count() / (double(Repeats) * Count);
+}
+
+
+int main(int argc, char** argv)
+{
+	const size_t Count = (argc > 1) ? static_cast<size_t>(std::atoi(argv[1])) : 4096;
+	const int Repeats = (argc > 2) ? std::atoi(argv[2]) : 200;
+	const size_t Padded = QFM::SimdPadded(Count);
+
+	// Targets and currents either sign (a quaternion and its negative are the same rotation), errors from 1e-7 to
+	// Pi, near unit quaternions as after a product, quaternions of any length, steps up to Pi
+	QFM::FRandomStream Random(1, 0);
+	FSoAQuats Target(Count), Current(Count), Delta(Count), NearUnit(Count), AnyLength(Count);
+	FSoAVecs Steps(Count);
+	for (size_t i = 0; i < Count; i++)
+	{
+		const QFM::FQuatf C = RandomRotation(Random);
+		const QFM::FVec3 Error = RandomRotationVector(Random, QFM::Pi);
+		Set(Target, i, (QFM::FQuatf(Error / Error.Size(), Error.Size()) * C) * (Random.Uniform() < 0.5f ? 1.0f : -1.0f));
+		Set(Current, i, C);
+		Set(Delta, i, QFM::QuatRelativeShortest(Get(Target, i), C));
+		Set(NearUnit, i, C * std::sqrt(1.0f + Random.Uniform(-1e-3f, 1e-3f)));
+		Set(AnyLength, i, C * Random.Uniform(0.1f, 10.0f));
+		Set(Steps, i, RandomRotationVector(Random, QFM::Pi));
+	}
+
+	FRow Rows[] = {
+		{ "Relative rotation", 2.5e-7, {}, {} },
+		{ "Rotation vector (rel)", 2.5e-7, {}, {} },
+		{ "Attitude error", 1e-6, {}, {} },
+		{ "Exponential step", 2.5e-7, {}, {} },
+		{ "Normalize near unit", 6e-7, {}, {} },
+		{ "Normalize", 4e-7, {}, {} }
+	};
+	FSoAQuats OutQuats(Count);
+	FSoAVecs OutVecs(Count);
+	float Sink = 0.0f;
+
+	/*--- Errors against double, the SIMD kernels on SoA arrays ---*/
+
+	auto RotationVectorError = [](const FQuatd& Reference, const QFM::FVec3& V, bool bRelative)
+	{
+		double R[3];
+		RotationVectorReference(Reference, R);
+		const double Angle = std::sqrt(R[0] * R[0] + R[1] * R[1] + R[2] * R[2]);
+		// Relative to the angle, 1 ulp of it allowed
+		return bRelative ? std::max(Distance(R, V) - std::ldexp(1.0, std::ilogb(Angle) - 23), 0.0) / Angle : Distance(R, V);
+	};
+
+	for (size_t i = 0; i < Padded; i += QFM::SimdWidth)
+	{
+		QFM::QuatRelativeShortest(QFM::FSimdQuat::Load(Target.In(), i), QFM::FSimdQuat::Load(Current.In(), i)).Store(OutQuats.Ptr, i);
+	}
+	for (size_t i = 0; i < Count; i++)
+	{
+		const FQuatd Reference = RelativeReference(Get(Target, i), Get(Current, i));
+		const QFM::FQuatf Results[3] = { RelativeFQuat(Get(Target, i), Get(Current, i)), QFM::QuatRelativeShortest(Get(Target, i), Get(Current, i)), Get(OutQuats, i) };
+		for (int k = 0; k < 3; k++)
+		{
+			Rows[0].Error[k] = std::max(Rows[0].Error[k], MaxDifference(Reference, Results[k]));
+		}
+	}
+
+	for (size_t i = 0; i < Padded; i += QFM::SimdWidth)
+	{
+		QFM::QuatToRotationVector(QFM::FSimdQuat::Load(Delta.In(), i)).Store(OutVecs.Ptr, i);
+	}
+	for (size_t i = 0; i < Count; i++)
+	{
+		const FQuatd Reference = ToDouble(Get(Delta, i));
+		const QFM::FVec3 Results[3] = { RotationVectorFQuat(Get(Delta, i)), QFM::QuatToRotationVector(Get(Delta, i)), Get(OutVecs, i) };
+		for (int k = 0; k < 3; k++)
+		{
+			Rows[1].Error[k] = std::max(Rows[1].Error[k], RotationVectorError(Reference, Results[k], true));
+		}
+	}
+
+	QFM::GetAttitudeErrors(Target.In(), Current.In(), OutVecs.Ptr, Count);
+	for (size_t i = 0; i < Count; i++)
+	{
+		const FQuatd Reference = RelativeReference(Get(Target, i), Get(Current, i));
+		const QFM::FVec3 Results[3] = {
+			RotationVectorFQuat(RelativeFQuat(Get(Target, i), Get(Current, i))),
+			QFM::QuatToRotationVector(QFM::QuatRelative(Get(Target, i), Get(Current, i))),
+			Get(OutVecs, i) };
+		for (int k = 0; k < 3; k++)
+		{
+			Rows[2].Error[k] = std::max(Rows[2].Error[k], RotationVectorError(Reference, Results[k], false));
+		}
+	}
+
+	for (size_t i = 0; i < Padded; i += QFM::SimdWidth)
+	{
+		QFM::QuatFromRotationVector(LoadVec(Steps, i)).Store(OutQuats.Ptr, i);
+	}
+	for (size_t i = 0; i < Count; i++)
+	{
+		const QFM::FVec3 V = Get(Steps, i);
+		const double H = 0.5 * std::sqrt(double(V.X) * V.X + double(V.Y) * V.Y + double(V.Z) * V.Z);
+		const double Scale = 0.5 * std::sin(H) / H;
+		const FQuatd Reference = { V.X * Scale, V.Y * Scale, V.Z * Scale, std::cos(H) };
+		const QFM::FQuatf Results[3] = { FromRotationVectorFQuat(V), QFM::QuatFromRotationVector(V), Get(OutQuats, i) };
+		for (int k = 0; k < 3; k++)
+		{
+			Rows[3].Error[k] = std::max(Rows[3].Error[k], MaxDifference(Reference, Results[k]));
+		}
+	}
+
+	FSoAQuats* const NormalizeInputs[2] = { &NearUnit, &AnyLength };
+	for (int n = 0; n < 2; n++)
+	{
+		const FSoAQuats& In = *NormalizeInputs[n];
+		for (size_t i = 0; i < Padded; i += QFM::SimdWidth)
+		{
+			const QFM::FSimdQuat Q = QFM::FSimdQuat::Load(In.In(), i);
+			(n == 0 ? QFM::QuatNormalizeFast(Q) : QFM::QuatNormalize(Q)).Store(OutQuats.Ptr, i);
+		}
+		for (size_t i = 0; i < Count; i++)
+		{
+			QFM::FQuatf Normalized = Get(In, i);
+			Normalized.Normalize();
+			const QFM::FQuatf Results[3] = { Normalized, n == 0 ? QFM::QuatNormalizeFast(Get(In, i)) : QFM::QuatNormalize(Get(In, i)), Get(OutQuats, i) };
+			for (int k = 0; k < 3; k++)
+			{
+				Rows[4 + n].Error[k] = std::max(Rows[4 + n].Error[k], UnitError(Results[k]));
+			}
+		}
+	}
+
+	/*--- Time per quaternion ---*/
+
+	Rows[0].Ns[0] = TimeNs(Repeats, Count, [&]() { for (size_t i = 0; i < Count; i++) { Sink += RelativeFQuat(Get(Target, i), Get(Current, i)).X; } });
+	Rows[0].Ns[1] = TimeNs(Repeats, Count, [&]() { for (size_t i = 0; i < Count; i++) { Sink += QFM::QuatRelativeShortest(Get(Target, i), Get(Current, i)).X; } });
+	Rows[0].Ns[2] = TimeNs(Repeats, Count, [&]()
+	{
+		for (size_t i = 0; i < Padded; i += QFM::SimdWidth)
+		{
+			QFM::QuatRelativeShortest(QFM::FSimdQuat::Load(Target.In(), i), QFM::FSimdQuat::Load(Current.In(), i)).Store(OutQuats.Ptr, i);
+		}
+		Sink += OutQuats.Ptr[0][0];
+	});
+
+	Rows[1].Ns[0] = TimeNs(Repeats, Count, [&]() { for (size_t i = 0; i < Count; i++) { Sink += RotationVectorFQuat(Get(Delta, i)).X; } });
+	Rows[1].Ns[1] = TimeNs(Repeats, Count, [&]() { for (size_t i = 0; i < Count; i++) { Sink += QFM::QuatToRotationVector(Get(Delta, i)).X; } });
+	Rows[1].Ns[2] = TimeNs(Repeats, Count, [&]()
+	{
+		for (size_t i = 0; i < Padded; i += QFM::SimdWidth)
+		{
+			QFM::QuatToRotationVector(QFM::FSimdQuat::Load(Delta.In(), i)).Store(OutVecs.Ptr, i);
+		}
+		Sink += OutVecs.Ptr[0][0];
+	});
+
+	Rows[2].Ns[0] = TimeNs(Repeats, Count, [&]() { for (size_t i = 0; i < Count; i++) { Sink += RotationVectorFQuat(RelativeFQuat(Get(Target, i), Get(Current, i))).X; } });
+	Rows[2].Ns[1] = TimeNs(Repeats, Count, [&]() { for (size_t i = 0; i < Count; i++) { Sink += QFM::QuatToRotationVector(QFM::QuatRelative(Get(Target, i), Get(Current, i))).X; } });
+	Rows[2].Ns[2] = TimeNs(Repeats, Count, [&]() { QFM::GetAttitudeErrors(Target.In(), Current.In(), OutVecs.Ptr, Count); Sink += OutVecs.Ptr[0][0]; });
+
+	Rows[3].Ns[0] = TimeNs(Repeats, Count, [&]() { for (size_t i = 0; i < Count; i++) { Sink += FromRotationVectorFQuat(Get(Steps, i)).W; } });
+	Rows[3].Ns[1] = TimeNs(Repeats, Count, [&]() { for (size_t i = 0; i < Count; i++) { Sink += QFM::QuatFromRotationVector(Get(Steps, i)).W; } });
+	Rows[3].Ns[2] = TimeNs(Repeats, Count, [&]()
+	{
+		for (size_t i = 0; i < Padded; i += QFM::SimdWidth)
+		{
+			QFM::QuatFromRotationVector(LoadVec(Steps, i)).Store(OutQuats.Ptr, i);
+		}
+		Sink += OutQuats.Ptr[3][0];
+	});
+
+	for (int n = 0; n < 2; n++)
+	{
+		const FSoAQuats& In = *NormalizeInputs[n];
+		Rows[4 + n].Ns[0] = TimeNs(Repeats, Count, [&]()
+		{
+			for (size_t i = 0; i < Count; i++)
+			{
+				QFM::FQuatf Q = Get(In, i);
+				Q.Normalize();
+				Sink += Q.W;
+			}
+		});
+		Rows[4 + n].Ns[1] = TimeNs(Repeats, Count, [&]()
+		{
+			for (size_t i = 0; i < Count; i++)
+			{
+				Sink += (n == 0 ? QFM::QuatNormalizeFast(Get(In, i)) : QFM::QuatNormalize(Get(In, i))).W;
+			}
+		});
+		Rows[4 + n].Ns[2] = TimeNs(Repeats, Count, [&]()
+		{
+			for (size_t i = 0; i < Padded; i += QFM::SimdWidth)
+			{
+				const QFM::FSimdQuat Q = QFM::FSimdQuat::Load(In.In(), i);
+				(n == 0 ? QFM::QuatNormalizeFast(Q) : QFM::QuatNormalize(Q)).Store(OutQuats.Ptr, i);
+			}
+			Sink += OutQuats.Ptr[3][0];
+		});
+	}
+
+	std::printf("Quaternions: %zu x %d, SIMD width %d\n", Count, Repeats, QFM::SimdWidth);
+	std::printf("%-22s %9s %9s %9s   %10s %10s %10s %10s\n", "ns per quaternion", "FQuatf", "Scalar", "SIMD", "FQuatf err", "Scalar err", "SIMD err", "Bound");
+	bool bBoundsHold = true;
+	for (const FRow& Row : Rows)
+	{
+		std::printf("%-22s %9.2f %9.2f %9.2f   %10.3g %10.3g %10.3g %10.3g\n", Row.Name, Row.Ns[0], Row.Ns[1], Row.Ns[2],
+			Row.Error[0], Row.Error[1], Row.Error[2], Row.Bound);
+		bBoundsHold &= Row.Error[1] <= Row.Bound && Row.Error[2] <= Row.Bound;
+	}
+	std::printf("Errors: max abs of a component, relative to the angle for the rotation vector, length in rad for the attitude error, |1 - |Q|| for the normalizations\n");
+	std::printf("Checksum: %f\n", Sink);
+
+	if (!bBoundsHold)
+	{
+		std::printf("Error above the documented bound\n");
+		return 1;
+	}
+	return 0;
+}
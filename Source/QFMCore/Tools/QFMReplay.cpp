@@ -0,0 +1,91 @@
+/*
+	QFMReplay
+
+	Replays a flight record through the controller chain without any engine running and reports
+	the first step where the recomputed controller outputs leave the recording.
+	Usage: QFMReplay RecordFile [ConfigFile] [Tolerance] [Mode reseed|free]
+	ConfigFile defaults to (or "" means) RecordFile.cfg, written by the recorder. Tolerance 0 (default) is bit exact.
+	reseed (default) starts every step from the recorded state, free only from the first record.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "QFMCoreMappedFile.h"
+#include "QFMCoreReplay.h"
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "Usage: QFMReplay RecordFile [ConfigFile] [Tolerance] [Mode reseed|free]\n");
+		return 2;
+	}
+	const char* RecordFile = argv[1];
+	const std::string ConfigFile = (argc > 2 && argv[2][0]) ? argv[2] : std::string(RecordFile) + ".cfg";
+	const float Tolerance = (argc > 3) ? static_cast<float>(std::atof(argv[3])) : 0.0f;
+	const bool bReseed = (argc > 4) ? std::strcmp(argv[4], "free") != 0 : true;
+
+	QFM::FMappedFile File;
+	QFM::FFlightRecordView View;
+	if (!File.OpenRead(RecordFile) || !View.Parse(File.GetData(), File.GetSize()))
+	{
+		std::fprintf(stderr, "%s is not a version %d flight record\n", RecordFile, QFM::FlightRecordVersion);
+		return 2;
+	}
+
+	QFM::FFlightReplayCore Replay;
+	Replay.Tolerance = Tolerance;
+	Replay.bReseedEveryStep = bReseed;
+
+	std::ifstream Config(ConfigFile);
+	if (Config)
+	{
+		std::stringstream Text;
+		Text << Config.rdbuf();
+		const int Unknown = Replay.SetConfig(Text.str());
+		if (Unknown > 0)
+		{
+			std::printf("Config: %d unknown parameters in %s\n", Unknown, ConfigFile.c_str());
+		}
+	}
+	else
+	{
+		std::printf("Config: %s not found, default parameters\n", ConfigFile.c_str());
+	}
+
+	const auto Start = std::chrono::steady_clock::now();
+	Replay.Run(View);
+	const auto End = std::chrono::steady_clock::now();
+
+	const double Seconds = std::chrono::duration<double>(End - Start).count();
+	const uint64_t Steps = Replay.GetSteps();
+	std::printf("Records: %llu (dropped %llu), mode %s, tolerance %g\n", (unsigned long long)View.Num(), (unsigned long long)View.GetDropped(),
+		bReseed ? "reseed" : "free", Tolerance);
+	std::printf("Steps replayed: %llu in %f s, %.0f steps per second\n", (unsigned long long)Steps, Seconds, Seconds > 0.0 ? Steps / Seconds : 0.0);
+
+	for (const QFM::FReplayVehicleResult& Result : Replay.GetResults())
+	{
+		std::printf("Vehicle %u: %llu steps, %llu gaps, %llu diverged, max error %g%s\n", Result.VehicleId,
+			(unsigned long long)Result.Steps, (unsigned long long)Result.Gaps, (unsigned long long)Result.DivergedSteps,
+			Result.MaxError, Result.bConfigured ? "" : ", default parameters");
+	}
+
+	QFM::FReplayDivergence First;
+	if (!Replay.GetFirstDivergence(First))
+	{
+		std::printf("No divergence\n");
+		return 0;
+	}
+
+	std::printf("First divergence: record %llu, vehicle %u, step %u, t=%.6f s, %s[%d] recorded %.9g replayed %.9g\n",
+		(unsigned long long)First.RecordIndex, First.VehicleId, First.Step, First.SimTime,
+		First.Field, First.Component, First.Recorded, First.Replayed);
+	return 1;
+}
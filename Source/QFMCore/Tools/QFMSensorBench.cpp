@@ -0,0 +1,357 @@
+/*
+	QFMSensorBench
+
+	IMU and barometer model (QFMCoreSensors.h): the vectorized normal numbers (GenerateNormals, SimdLog) against a
+	double precision Box-Muller of the same Philox words, their moments, and the sensor statistics on a body at rest
+	(white noise, bias random walk over many seeds, quantization, range, latency, independence of the batch sizes).
+	Then the time per sample and per AHRS step with the sensors against the AHRS on the body state.
+	Usage: QFMSensorBench [ImuRateHz] [PhysicsHz] [Seeds]
+	Exit code 1 if a value is off by more than the bounds below.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "QFMCoreAHRS.h"
+#include "QFMCoreRandom.h"
+#include "QFMCoreSensors.h"
+
+
+// Bounds
+static const double MaxLogError = 3e-7;				// SimdLog, relative
+static const double MaxNormalError = 2e-5;			// GenerateNormals against double precision, absolute
+static const double MaxMomentError = 0.005;			// mean and variance of 1M normals
+static const double MaxNoiseError = 0.03;			// std dev of the white noise, relative
+static const double MaxWalkError = 0.15;			// bias variance after the walk, relative (finite number of seeds)
+
+
+/*--- Double precision reference of one lane, the same quadrant mapping ---*/
+
+static void ReferenceNormals(const uint32_t Key[2], const uint32_t Counter[4], double Out[4])
+{
+	uint32_t Words[4];
+	QFM::FPhilox4x32::Generate(Key, Counter, Words);
+	for (int p = 0; p < 2; p++)
+	{
+		const double U = ((Words[2 * p] >> 8) + 1) / 16777216.0;
+		const double Angle = (Words[2 * p + 1] >> 8) / 16777216.0 * 3.14159265358979323846 / 2.0;
+		const double Radius = std::sqrt(-2.0 * std::log(U));
+		Out[2 * p] = Radius * std::cos(Angle) * ((Words[2 * p + 1] & 1) ? -1.0 : 1.0);
+		Out[2 * p + 1] = Radius * std::sin(Angle) * ((Words[2 * p + 1] & 2) ? -1.0 : 1.0);
+	}
+}
+
+
+// Body at rest, level
+static QFM::FBodyState RestingBody()
+{
+	QFM::FBodyState Body;
+	Body.Position = QFM::FVec3(0.0f, 0.0f, 10.0f);
+	return Body;
+}
+
+
+// Samples of a sensor on Body for Steps steps of DeltaTime, channel by channel
+static void Record(QFM::FSensorCore& Sensor, const QFM::FBodyState& Body, float DeltaTime, int Steps, std::vector<float> Out[6])
+{
+	QFM::FImuBatch Batch;
+	for (int n = 0; n < Steps; n++)
+	{
+		Sensor.Sample(Body, DeltaTime, nullptr, Batch);
+		for (int k = 0; k < Batch.Count; k++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				Out[a].push_back(Batch.Gyro[a][k]);
+				Out[3 + a].push_back(Batch.Accelerometer[a][k]);
+			}
+		}
+	}
+}
+
+
+static double StdDev(const std::vector<float>& Values, double* Mean = nullptr)
+{
+	double Sum = 0.0, Sum2 = 0.0;
+	for (float V : Values)
+	{
+		Sum += V;
+		Sum2 += static_cast<double>(V) * V;
+	}
+	const double M = Sum / Values.size();
+	if (Mean)
+	{
+		*Mean = M;
+	}
+	return std::sqrt(std::max(0.0, Sum2 / Values.size() - M * M));
+}
+
+
+static double NsPer(std::chrono::high_resolution_clock::duration Time, double Count)
+{
+	return std::chrono::duration<double, std::nano>(Time).count() / Count;
+}
+
+
+int main(int argc, char** argv)
+{
+	const float ImuRateHz = (argc > 1) ? static_cast<float>(std::atof(argv[1])) : 8000.0f;
+	const float PhysicsHz = (argc > 2) ? static_cast<float>(std::atof(argv[2])) : 60.0f;
+	const int Seeds = (argc > 3) ? std::max(2, std::atoi(argv[3])) : 200;
+	const float DeltaTime = 1.0f / PhysicsHz;
+	bool bPass = true;
+
+	std::printf("IMU at %.0f Hz, physics at %.0f Hz, SIMD width %d\n", ImuRateHz, PhysicsHz, QFM::SimdWidth);
+
+	/*--- SimdLog over (0, 1] and a few decades above ---*/
+
+	double LogError = 0.0;
+	for (float X = 1e-7f; X < 1e4f; X *= 1.0001f)
+	{
+		float Lanes[QFM::SimdWidth];
+		QFM::SimdLog(QFM::FSimdFloat(X)).StoreUnaligned(Lanes);
+		const double Reference = std::log(static_cast<double>(X));
+		LogError = std::max(LogError, std::fabs(Lanes[0] - Reference) / std::max(1.0, std::fabs(Reference)));
+	}
+	std::printf("SimdLog             max err %9.3g   bound %9.3g\n", LogError, MaxLogError);
+	bPass &= LogError <= MaxLogError;
+
+	/*--- GenerateNormals: lanes against the reference, moments ---*/
+
+	const int NumCounters = 1 << 18;
+	std::vector<float> Normals[4];
+	for (int w = 0; w < 4; w++)
+	{
+		Normals[w].resize(NumCounters);
+	}
+	const uint32_t Key[2] = { 7, 11 };
+	const uint32_t Counter[4] = { 0xFFFFFF00u, 3, 5, 0 };		// carries into Counter[1] on the way
+	float* const Words[4] = { Normals[0].data(), Normals[1].data(), Normals[2].data(), Normals[3].data() };
+	QFM::GenerateNormals(Key, Counter, NumCounters, Words);
+
+	double NormalError = 0.0, Sum = 0.0, Sum2 = 0.0, Tail = 0.0;
+	for (int i = 0; i < NumCounters; i++)
+	{
+		uint32_t LaneCounter[4] = { Counter[0] + static_cast<uint32_t>(i), Counter[1], Counter[2], Counter[3] };
+		if (LaneCounter[0] < Counter[0])
+		{
+			LaneCounter[1]++;
+		}
+		double Reference[4];
+		ReferenceNormals(Key, LaneCounter, Reference);
+		for (int w = 0; w < 4; w++)
+		{
+			const double V = Normals[w][i];
+			NormalError = std::max(NormalError, std::fabs(V - Reference[w]));
+			Sum += V;
+			Sum2 += V * V;
+			Tail += std::fabs(V) > 3.0 ? 1.0 : 0.0;
+		}
+	}
+	const double Count = 4.0 * NumCounters;
+	const double Mean = Sum / Count;
+	const double Variance = Sum2 / Count - Mean * Mean;
+	std::printf("GenerateNormals     max err %9.3g   bound %9.3g   mean %8.5f   variance %8.5f   |x| > 3: %.5f (0.00270)\n",
+		NormalError, MaxNormalError, Mean, Variance, Tail / Count);
+	bPass &= NormalError <= MaxNormalError && std::fabs(Mean) <= MaxMomentError && std::fabs(Variance - 1.0) <= MaxMomentError;
+
+	/*--- White noise and specific force at rest ---*/
+
+	const QFM::FBodyState Body = RestingBody();
+	{
+		QFM::FSensorCore Sensor;
+		Sensor.Settings.Enabled = true;
+		Sensor.Settings.ImuRateHz = ImuRateHz;
+		Sensor.Settings.Gyro.NoiseDensity = 0.003f;
+		Sensor.Settings.Accelerometer.NoiseDensity = 0.02f;
+		Sensor.Reset();
+		std::vector<float> Samples[6];
+		Record(Sensor, Body, DeltaTime, static_cast<int>(10.0f * PhysicsHz), Samples);
+
+		double Worst = 0.0, GravityMean = 0.0;
+		for (int c = 0; c < 6; c++)
+		{
+			double M = 0.0;
+			const double Expected = (c < 3 ? 0.003 : 0.02) * std::sqrt(static_cast<double>(QFM::Clamp(ImuRateHz, QFM::MinImuRateHz, QFM::MaxImuRateHz)));
+			Worst = std::max(Worst, std::fabs(StdDev(Samples[c], &M) / Expected - 1.0));
+			if (c == 5)
+			{
+				GravityMean = M;
+			}
+		}
+		std::printf("White noise         %zu samples   worst std dev err %7.4f   bound %7.4f   accel Z mean %.4f\n", Samples[0].size(), Worst, MaxNoiseError, GravityMean);
+		bPass &= Worst <= MaxNoiseError && std::fabs(GravityMean - 9.81) < 0.01 && Samples[0].size() >= static_cast<size_t>(9.99f * QFM::Clamp(ImuRateHz, QFM::MinImuRateHz, QFM::MaxImuRateHz));
+	}
+
+	/*--- Bias random walk: variance after 10 s over the seeds ---*/
+
+	{
+		const float Walk = 0.001f;
+		const float Seconds = 10.0f;
+		double Sum2Bias = 0.0;
+		for (int s = 0; s < Seeds; s++)
+		{
+			QFM::FSensorCore Sensor;
+			Sensor.Settings.ImuRateHz = 1000.0f;
+			Sensor.Settings.Seed = s + 1;
+			Sensor.Settings.Gyro.BiasRandomWalk = Walk;
+			Sensor.Reset();
+			QFM::FImuBatch Batch;
+			for (int n = 0; n < static_cast<int>(Seconds * PhysicsHz); n++)
+			{
+				Sensor.Sample(Body, DeltaTime, nullptr, Batch);
+			}
+			for (int a = 0; a < 3; a++)
+			{
+				Sum2Bias += static_cast<double>(Sensor.GyroBias[a]) * Sensor.GyroBias[a];
+			}
+		}
+		const double Ratio = Sum2Bias / (3.0 * Seeds) / (static_cast<double>(Walk) * Walk * Seconds);
+		std::printf("Bias random walk    %d seeds   variance / expected %7.4f   bound %7.4f\n", Seeds, Ratio, MaxWalkError);
+		bPass &= std::fabs(Ratio - 1.0) <= MaxWalkError;
+	}
+
+	/*--- Quantization, range and batch sizes: the same samples for any physics rate ---*/
+
+	{
+		QFM::FSensorSettings Settings;
+		Settings.ImuRateHz = ImuRateHz;
+		Settings.Gyro.NoiseDensity = 0.01f;
+		Settings.Gyro.Resolution = 0.001f;
+		Settings.Accelerometer.NoiseDensity = 0.5f;
+		Settings.Accelerometer.Range = 10.0f;
+		QFM::FSensorCore A, B;
+		A.Settings = Settings;
+		B.Settings = Settings;
+		A.Reset();
+		B.Reset();
+		std::vector<float> SamplesA[6], SamplesB[6];
+		Record(A, Body, 1.0f / 64.0f, 64, SamplesA);
+		Record(B, Body, 1.0f / 1024.0f, 1024, SamplesB);
+
+		bool bSame = SamplesA[0].size() == SamplesB[0].size();
+		double Quantization = 0.0;
+		float Largest = 0.0f;
+		for (int c = 0; c < 6 && bSame; c++)
+		{
+			bSame = SamplesA[c] == SamplesB[c];
+			for (float V : SamplesA[c])
+			{
+				if (c < 3)
+				{
+					Quantization = std::max(Quantization, std::fabs(V / 0.001 - std::nearbyint(V / 0.001)));
+				}
+				else
+				{
+					Largest = std::max(Largest, std::fabs(V));
+				}
+			}
+		}
+		std::printf("Batches             64 and 1024 per second %s   off the LSB grid %.3g   largest accel %.3f (range 10)\n",
+			bSame ? "identical" : "DIFFER", Quantization, Largest);
+		bPass &= bSame && Quantization < 1e-3 && Largest <= 10.0f;
+	}
+
+	/*--- Latency: a rate step shows up Latency samples later ---*/
+
+	{
+		const int Delay = 7;
+		QFM::FSensorCore Sensor;
+		Sensor.Settings.ImuRateHz = 1000.0f;
+		Sensor.Settings.LatencySeconds = Delay / 1000.0f;
+		Sensor.Reset();
+		QFM::FImuBatch Batch;
+		QFM::FBodyState Turning = Body;
+		int Seen = -1;
+		int Index = 0;
+		for (int n = 0; n < 40 && Seen < 0; n++)
+		{
+			Turning.AngularVelocity = QFM::FVec3(0.0f, 0.0f, n >= 10 ? 1.0f : 0.0f);
+			Sensor.Sample(Turning, 0.001f, nullptr, Batch);
+			for (int k = 0; k < Batch.Count; k++, Index++)
+			{
+				if (Seen < 0 && Batch.Gyro[2][k] > 0.5f)
+				{
+					Seen = Index;
+				}
+			}
+		}
+		std::printf("Latency             step at sample 10, seen at %d (expected %d)\n", Seen, 10 + Delay);
+		bPass &= Seen == 10 + Delay;
+	}
+
+	/*--- Time: sensors on a flight with every error on, against the AHRS on the body state ---*/
+
+	{
+		QFM::FEngineCore Engine;
+		QFM::FVehicleCore Vehicle;
+		Engine.Init(&Vehicle);
+		for (int m = 0; m < Engine.GetNumEngines(); m++)
+		{
+			Engine.EngineSpeed[m] = 0.5f + 0.05f * m;
+		}
+
+		QFM::FAHRSCore Plain, Sensed;
+		Plain.Init(&Engine);
+		QFM::FSensorSettings& S = Sensed.Sensors.Settings;
+		S.Enabled = true;
+		S.ImuRateHz = ImuRateHz;
+		S.LatencySeconds = 0.001f;
+		S.Gyro = { 0.003f, 0.001f, 0.01f, 0.001f, 35.0f, 0.2f };
+		S.Accelerometer = { 0.02f, 0.005f, 0.05f, 0.005f, 160.0f, 2.0f };
+		S.BaroNoise = 0.1f;
+		Sensed.Init(&Engine);
+
+		const int Steps = static_cast<int>(20.0f * PhysicsHz);
+		std::vector<QFM::FBodyState> Bodies(Steps);
+		QFM::FBodyState Moving = Body;
+		const QFM::FQuatf Spin(QFM::FVec3(0.0f, 0.0f, 1.0f), 0.5f * DeltaTime);
+		for (int n = 0; n < Steps; n++)
+		{
+			Moving.Rotation = Spin * Moving.Rotation;
+			Moving.AngularVelocity = QFM::FVec3(0.0f, 0.0f, 0.5f);
+			Moving.LinearVelocity = QFM::FVec3(1.0f, 0.0f, std::sin(0.01f * n));
+			Moving.Position = Moving.Position + Moving.LinearVelocity * DeltaTime;
+			Bodies[n] = Moving;
+		}
+
+		float Sink = 0.0f;
+		double PlainNs = 1e30, SensedNs = 1e30;
+		uint32_t Samples = 0;
+		for (int Run = 0; Run < 5; Run++)
+		{
+			auto Start = std::chrono::high_resolution_clock::now();
+			for (int n = 0; n < Steps; n++)
+			{
+				Plain.Tock(Bodies[n], DeltaTime);
+				Sink += Plain.AngularVelocity.Z;
+			}
+			PlainNs = std::min(PlainNs, NsPer(std::chrono::high_resolution_clock::now() - Start, Steps));
+
+			const uint32_t FirstIndex = Sensed.Sensors.ImuIndex;
+			Start = std::chrono::high_resolution_clock::now();
+			for (int n = 0; n < Steps; n++)
+			{
+				Sensed.Tock(Bodies[n], DeltaTime);
+				Sink += Sensed.AngularVelocity.Z;
+			}
+			SensedNs = std::min(SensedNs, NsPer(std::chrono::high_resolution_clock::now() - Start, Steps));
+			Samples = Sensed.Sensors.ImuIndex - FirstIndex;
+		}
+		const double SamplesPerStep = static_cast<double>(Samples) / Steps;
+		std::printf("ns per AHRS step    body state %8.1f   sensors %8.1f (%.1f samples, %.2f ns per sample)\n",
+			PlainNs, SensedNs, SamplesPerStep, (SensedNs - PlainNs) / SamplesPerStep);
+		std::printf("Checksum: %f\n", Sink);
+	}
+
+	if (!bPass)
+	{
+		std::printf("Sensor model off by more than its bound\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,530 @@
+/*
+	QFMStageBench
+
+	Times every stage of the controller chain on its own and the whole per-vehicle pipeline: ns per call,
+	instructions per call (Linux perf counters, n/a where the kernel or the VM does not offer them) and heap
+	allocations per call. Each call includes loading its inputs from the state of one physics step.
+	The states come from a flight record (the first vehicle in it, parameters from RecordFile.cfg) or, without one,
+	from a synthetic Stabilize flight with random sticks.
+	Usage: QFMStageBench [Iterations] [RecordFile] [BaselineFile] [check|write] [Tolerance]
+	RecordFile "" means synthetic. check (default) compares against BaselineFile: exit code 1 if a stage got more than
+	Tolerance (default 0.10) slower, needs more than 2% more instructions or allocates more. write replaces it.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "QFMCoreFlightConfig.h"
+#include "QFMCoreFlightModel.h"
+#include "QFMCoreFlightRecord.h"
+#include "QFMCoreMappedFile.h"
+#include "QFMCoreRandom.h"
+
+#include "QFMAllocationCounter.h"
+
+
+/*--- Retired instructions of this thread, user space only ---*/
+
+class FInstructionCounter
+{
+public:
+
+	FInstructionCounter()
+	{
+#if defined(__linux__)
+		perf_event_attr Attr;
+		std::memset(&Attr, 0, sizeof(Attr));
+		Attr.type = PERF_TYPE_HARDWARE;
+		Attr.size = sizeof(Attr);
+		Attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		Attr.disabled = 1;
+		Attr.exclude_kernel = 1;
+		Attr.exclude_hv = 1;
+		Fd = static_cast<int>(syscall(__NR_perf_event_open, &Attr, 0, -1, -1, 0));
+#endif
+	}
+
+	~FInstructionCounter()
+	{
+#if defined(__linux__)
+		if (Fd >= 0)
+		{
+			close(Fd);
+		}
+#endif
+	}
+
+	bool IsAvailable() const { return Fd >= 0; }
+
+	void Start()
+	{
+#if defined(__linux__)
+		if (Fd >= 0)
+		{
+			ioctl(Fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(Fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	// Instructions since Start, 0 without a counter
+	uint64_t Stop()
+	{
+		uint64_t Count = 0;
+#if defined(__linux__)
+		if (Fd >= 0)
+		{
+			ioctl(Fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(Fd, &Count, sizeof(Count)) != sizeof(Count))
+			{
+				Count = 0;
+			}
+		}
+#endif
+		return Count;
+	}
+
+private:
+	int Fd = -1;
+};
+
+
+
+/*--- Inputs of every stage in one physics step, taken from a flight record ---*/
+
+struct FStageState
+{
+	QFM::FBodyState Body;
+	float DeltaTime;
+	float PilotAxisInput[4];
+
+	// Attitude
+	QFM::FQuatf AttitudeTarget;
+	float TargetRoll;
+	float TargetPitch;
+	float TargetYawRate;
+	float RateSetpoint;
+	float RatePresent;
+	QFM::FVec3 RateSetpoint3;
+	QFM::FVec3 RatePresent3;
+
+	// Position, AHRS values UpdateZController reads
+	float PosTargetZ;
+	QFM::FVec3 WorldTranslation;
+	QFM::FVec3 WorldVelocity;
+	QFM::FVec3 WorldAcceleration;
+
+	// Engine
+	QFM::FVec3 RotationRequest;
+	float ThrottleRequest;
+	float EngineSpeed[QFM::MaxEngines];
+};
+
+
+static FStageState MakeStageState(const QFM::FFlightRecord& R, QFM::FAttitudeCore& Attitude)
+{
+	FStageState S;
+	S.Body.Rotation = QFM::LoadFlightRecordQuat(R.Rotation);
+	S.Body.Position = QFM::LoadFlightRecordVec3(R.Position);
+	S.Body.LinearVelocity = QFM::LoadFlightRecordVec3(R.LinearVelocity);
+	S.Body.AngularVelocity = QFM::LoadFlightRecordVec3(R.AngularVelocity);
+	S.DeltaTime = R.DeltaTime;
+	std::copy(R.PilotAxisInput, R.PilotAxisInput + 4, S.PilotAxisInput);
+
+	S.AttitudeTarget = QFM::LoadFlightRecordQuat(R.AttitudeTarget);
+	Attitude.GetPilotDesiredLeanAngles(R.DesiredPilotInput[0], R.DesiredPilotInput[1], S.TargetRoll, S.TargetPitch);
+	S.TargetYawRate = Attitude.GetPilotDesiredYawRate(R.DesiredPilotInput[2]);
+	S.RatePresent = R.AHRSBodyAngularVelocity[0];
+	S.RateSetpoint = S.RatePresent + R.RatePreError[0];
+	S.RatePresent3 = QFM::LoadFlightRecordVec3(R.AHRSBodyAngularVelocity);
+	S.RateSetpoint3 = S.RatePresent3 + QFM::LoadFlightRecordVec3(R.RatePreError);
+
+	S.PosTargetZ = R.PosTargetZ;
+	S.WorldTranslation = QFM::LoadFlightRecordVec3(R.AHRSWorldTranslation);
+	S.WorldVelocity = QFM::LoadFlightRecordVec3(R.AHRSVelocityVector);
+	S.WorldAcceleration = QFM::LoadFlightRecordVec3(R.AHRSLinearAccelerationVector);
+
+	S.RotationRequest = QFM::LoadFlightRecordVec3(R.RotationRequest);
+	S.ThrottleRequest = R.ThrottleRequest;
+	std::copy(R.EngineSpeed, R.EngineSpeed + QFM::MaxEngines, S.EngineSpeed);
+	return S;
+}
+
+
+// Stabilize flight with a new random stick position every 250 steps, 1 kHz
+static std::vector<QFM::FFlightRecord> MakeSyntheticRecords(QFM::FFlightModelCore& Model, int Num)
+{
+	QFM::FRandomStream Random(21, 0);
+	QFM::FBodyState Body;
+	Body.Position = QFM::FVec3(0.0f, 0.0f, 10.0f);
+	const float DeltaTime = 1.0f / 1000.0f;
+
+	std::vector<QFM::FFlightRecord> Records(Num);
+	for (int i = 0; i < Num; i++)
+	{
+		if (i % 250 == 0)
+		{
+			Model.PilotInput.RollAxisInput = Random.Uniform(-1.0f, 1.0f);
+			Model.PilotInput.PitchAxisInput = Random.Uniform(-1.0f, 1.0f);
+			Model.PilotInput.YawAxisInput = Random.Uniform(-1.0f, 1.0f);
+			Model.PilotInput.ThrottleAxisInput = Random.Uniform(-1.0f, 1.0f);
+			Body.AngularVelocity = QFM::FVec3(Random.Uniform(-1.0f, 1.0f), Random.Uniform(-1.0f, 1.0f), Random.Uniform(-2.0f, 2.0f));
+			Body.LinearVelocity = QFM::FVec3(Random.Uniform(-5.0f, 5.0f), Random.Uniform(-5.0f, 5.0f), Random.Uniform(-2.0f, 2.0f));
+		}
+		QFM::FVec3 Axis = Body.AngularVelocity;
+		const float Angle = Axis.Size() * DeltaTime;
+		Axis.Normalize();
+		Body.Rotation = QFM::FQuatf(Axis, Angle) * Body.Rotation;
+		Body.Rotation.Normalize();
+		Body.Position = Body.Position + Body.LinearVelocity * DeltaTime;
+
+		Model.Simulate(Body, DeltaTime);
+		QFM::FillFlightRecord(Records[i], Model.GetRefs(), DeltaTime, Body, false, Model.GetTotalThrust(), Model.GetTotalTorque());
+		Records[i].Step = static_cast<uint32_t>(i);
+	}
+	return Records;
+}
+
+
+
+/*--- Measurement ---*/
+
+struct FStageResult
+{
+	std::string Name;
+	double Ns = 0.0;
+	double Instructions = 0.0;	// 0: no counter
+	double Allocations = 0.0;
+};
+
+
+// Best of Repeats runs for the time, one more run for instructions and allocations.
+// Op is inlined into the loop, as the stage is in Simulate
+template <typename FOp>
+static FStageResult MeasureStage(const char* Name, const std::vector<FStageState>& States, long long Iterations, int Repeats,
+	FInstructionCounter& Counter, FOp Op)
+{
+	const size_t Num = States.size();
+	volatile float Sink = 0.0f;
+	auto Run = [&]()
+	{
+		float Sum = 0.0f;
+		size_t s = 0;
+		for (long long i = 0; i < Iterations; i++)
+		{
+			Sum += Op(States[s]);
+			if (++s == Num)
+			{
+				s = 0;
+			}
+		}
+		Sink = Sum;
+	};
+
+	FStageResult Result;
+	Result.Name = Name;
+	Result.Ns = 1e30;
+	for (int r = 0; r < Repeats; r++)
+	{
+		const auto Start = std::chrono::steady_clock::now();
+		Run();
+		const auto End = std::chrono::steady_clock::now();
+		Result.Ns = std::min(Result.Ns, std::chrono::duration<double, std::nano>(End - Start).count() / Iterations);
+	}
+
+	const uint64_t AllocationsBefore = HeapAllocations.load(std::memory_order_relaxed);
+	Counter.Start();
+	Run();
+	const uint64_t Instructions = Counter.Stop();
+	Result.Allocations = static_cast<double>(HeapAllocations.load(std::memory_order_relaxed) - AllocationsBefore) / Iterations;
+	Result.Instructions = static_cast<double>(Instructions) / Iterations;
+	(void)Sink;
+	return Result;
+}
+
+
+
+/*--- Baseline file: one line per stage, Name Ns Instructions Allocations ---*/
+
+static std::map<std::string, FStageResult> ReadBaseline(const std::string& File)
+{
+	std::map<std::string, FStageResult> Baseline;
+	std::ifstream In(File);
+	std::string Line;
+	while (std::getline(In, Line))
+	{
+		if (Line.empty() || Line[0] == '#')
+		{
+			continue;
+		}
+		std::istringstream Fields(Line);
+		FStageResult Result;
+		if (Fields >> Result.Name >> Result.Ns >> Result.Instructions >> Result.Allocations)
+		{
+			Baseline[Result.Name] = Result;
+		}
+	}
+	return Baseline;
+}
+
+
+static bool WriteBaseline(const std::string& File, const std::vector<FStageResult>& Results)
+{
+	std::ofstream Out(File);
+	Out << "# QFMStageBench baseline: Stage NsPerCall InstructionsPerCall AllocationsPerCall\n";
+	char Line[256];
+	for (const FStageResult& Result : Results)
+	{
+		std::snprintf(Line, sizeof(Line), "%s %.3f %.1f %.3f\n", Result.Name.c_str(), Result.Ns, Result.Instructions, Result.Allocations);
+		Out << Line;
+	}
+	return static_cast<bool>(Out);
+}
+
+
+
+int main(int argc, char** argv)
+{
+	const long long Iterations = (argc > 1) ? std::atoll(argv[1]) : 1000000;
+	const char* RecordFile = (argc > 2 && argv[2][0]) ? argv[2] : nullptr;
+	const char* BaselineFile = (argc > 3 && argv[3][0]) ? argv[3] : nullptr;
+	const bool bWrite = (argc > 4) && std::strcmp(argv[4], "write") == 0;
+	const double Tolerance = (argc > 5) ? std::atof(argv[5]) : 0.10;
+	const int Repeats = 5;
+
+	QFM::FFlightModelCore Model;
+	std::vector<QFM::FFlightRecord> Records;
+	if (RecordFile)
+	{
+		QFM::FMappedFile File;
+		QFM::FFlightRecordView View;
+		if (!File.OpenRead(RecordFile) || !View.Parse(File.GetData(), File.GetSize()) || View.Num() == 0)
+		{
+			std::fprintf(stderr, "%s is not a version %d flight record\n", RecordFile, QFM::FlightRecordVersion);
+			return 2;
+		}
+		const uint32_t VehicleId = View[0].VehicleId;
+		for (uint64_t i = 0; i < View.Num(); i++)
+		{
+			if (View[i].VehicleId == VehicleId)
+			{
+				Records.push_back(View[i]);
+			}
+		}
+
+		std::ifstream Config(std::string(RecordFile) + ".cfg");
+		std::stringstream Text;
+		Text << Config.rdbuf();
+		const auto Sections = QFM::ParseFlightConfigFile(Text.str());
+		const auto Section = Sections.find(VehicleId);
+		if (Section != Sections.end())
+		{
+			QFM::ApplyFlightModelConfig(Section->second, Model.GetRefs());
+		}
+		else
+		{
+			std::printf("Config: no section for vehicle %u, default parameters\n", VehicleId);
+		}
+		Model.Init(QFM::FBodyState());
+	}
+	else
+	{
+		Model.AttitudeController.FlightMode = QFM::EFlightMode::Stabilize;
+		Model.Init(QFM::FBodyState());
+		Records = MakeSyntheticRecords(Model, 4096);
+	}
+
+	std::vector<FStageState> States;
+	States.reserve(Records.size());
+	for (const QFM::FFlightRecord& R : Records)
+	{
+		States.push_back(MakeStageState(R, Model.AttitudeController));
+	}
+	QFM::RestoreFlightRecordState(Records.front(), Model.GetRefs());
+
+	FInstructionCounter Counter;
+	QFM::FInputCore& Input = Model.PilotInput;
+	QFM::FAHRSCore& AHRS = Model.AHRS;
+	QFM::FAttitudeCore& Attitude = Model.AttitudeController;
+	QFM::FPositionCore& Position = Model.PositionController;
+	QFM::FEngineCore& Engine = Model.EngineController;
+	std::vector<FStageResult> Results;
+
+	Results.push_back(MeasureStage("Input.Tock", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		Input.RollAxisInput = S.PilotAxisInput[0];
+		Input.PitchAxisInput = S.PilotAxisInput[1];
+		Input.YawAxisInput = S.PilotAxisInput[2];
+		Input.ThrottleAxisInput = S.PilotAxisInput[3];
+		Input.Tock(S.DeltaTime);
+		return Input.DesiredPilotInput.X;
+	}));
+
+	Results.push_back(MeasureStage("AHRS.Tock", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		AHRS.Tock(S.Body, S.DeltaTime);
+		return AHRS.LinearVelocity;
+	}));
+
+	QFM::FPIDCore Pid;
+	Pid.Init(-1.0f, 1.0f, 1.0f, 0.5f, 0.01f);
+	Results.push_back(MeasureStage("PID.Calculate", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		return Pid.Calculate(S.RateSetpoint, S.RatePresent, S.DeltaTime);
+	}));
+
+	// The body rate PIDs of RunQuat, all three axes with normalization
+	Results.push_back(MeasureStage("Attitude.StepRatePid", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		Attitude.DeltaTime = S.DeltaTime;
+		return Attitude.StepRatePid(S.RatePresent3, S.RateSetpoint3).X;
+	}));
+
+	Results.push_back(MeasureStage("Attitude.RunQuat", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		Attitude.Body = S.Body;
+		Attitude.DeltaTime = S.DeltaTime;
+		Attitude.AttitudeTargetQuat = S.AttitudeTarget;
+		Attitude.RunQuat();
+		return Engine.RotationRequest.X;
+	}));
+
+	Results.push_back(MeasureStage("Attitude.InputAngleRollPitchRateYaw", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		Attitude.Body = S.Body;
+		Attitude.DeltaTime = S.DeltaTime;
+		Attitude.AttitudeTargetQuat = S.AttitudeTarget;
+		Attitude.InputAngleRollPitchRateYaw(S.TargetRoll, S.TargetPitch, S.TargetYawRate);
+		return Engine.RotationRequest.X;
+	}));
+
+	Results.push_back(MeasureStage("Position.UpdateZController", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		AHRS.WorldTranslationVect = S.WorldTranslation;
+		AHRS.VelocityVector = S.WorldVelocity;
+		AHRS.LinearAccelerationVector = S.WorldAcceleration;
+		Position.DeltaTime = S.DeltaTime;
+		Position.PosTargetZ = S.PosTargetZ;
+		Position.UpdateZController();
+		return Engine.ThrottleRequest;
+	}));
+
+	Results.push_back(MeasureStage("Engine.MixEngines", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		Engine.RotationRequest = S.RotationRequest;
+		Engine.ThrottleRequest = S.ThrottleRequest;
+		Engine.MixEngines();
+		return Engine.EngineMixPercent[0];
+	}));
+
+	Results.push_back(MeasureStage("Engine.GetEngineForces", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		std::copy(S.EngineSpeed, S.EngineSpeed + QFM::MaxEngines, Engine.EngineSpeed);
+		Engine.GetEngineForces();
+		return Engine.TotalThrust.Z;
+	}));
+
+	Results.push_back(MeasureStage("Engine.Tock", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		Engine.RotationRequest = S.RotationRequest;
+		Engine.ThrottleRequest = S.ThrottleRequest;
+		Engine.Tock(S.DeltaTime);
+		return Engine.TotalThrust.Z;
+	}));
+
+	// Whole chain, free running over the states as replay does without reseeding
+	QFM::RestoreFlightRecordState(Records.front(), Model.GetRefs());
+	Results.push_back(MeasureStage("Pipeline.Simulate", States, Iterations, Repeats, Counter, [&](const FStageState& S)
+	{
+		Input.RollAxisInput = S.PilotAxisInput[0];
+		Input.PitchAxisInput = S.PilotAxisInput[1];
+		Input.YawAxisInput = S.PilotAxisInput[2];
+		Input.ThrottleAxisInput = S.PilotAxisInput[3];
+		Model.Simulate(S.Body, S.DeltaTime);
+		return Model.GetTotalThrust().Z + Model.GetTotalTorque().Z;
+	}));
+
+	// Same states as physics steps of 4 ms through the multi-rate scheduler
+	QFM::RestoreFlightRecordState(Records.front(), Model.GetRefs());
+	Model.Scheduler.Init();
+	Results.push_back(MeasureStage("Pipeline.SimulateMultiRate", States, std::max(1LL, Iterations / 4), Repeats, Counter, [&](const FStageState& S)
+	{
+		Input.RollAxisInput = S.PilotAxisInput[0];
+		Input.PitchAxisInput = S.PilotAxisInput[1];
+		Input.YawAxisInput = S.PilotAxisInput[2];
+		Input.ThrottleAxisInput = S.PilotAxisInput[3];
+		Model.SimulateMultiRate(S.Body, 4.0f * S.DeltaTime);
+		return Model.GetTotalThrust().Z + Model.GetTotalTorque().Z;
+	}));
+
+	const std::map<std::string, FStageResult> Baseline = (BaselineFile && !bWrite) ? ReadBaseline(BaselineFile) : std::map<std::string, FStageResult>();
+
+	std::printf("States: %zu (%s), iterations: %lld, best of %d\n", States.size(), RecordFile ? RecordFile : "synthetic", Iterations, Repeats);
+	std::printf("%-36s %10s %14s %12s %10s\n", "Stage", "ns/call", "instr/call", "allocs/call", "vs base");
+	int Regressions = 0;
+	for (const FStageResult& Result : Results)
+	{
+		char Instructions[32] = "n/a";
+		if (Counter.IsAvailable())
+		{
+			std::snprintf(Instructions, sizeof(Instructions), "%.1f", Result.Instructions);
+		}
+
+		char Change[32] = "";
+		const auto Base = Baseline.find(Result.Name);
+		if (Base != Baseline.end())
+		{
+			const FStageResult& B = Base->second;
+			std::snprintf(Change, sizeof(Change), "%+.1f%%", (Result.Ns / B.Ns - 1.0) * 100.0);
+
+			const bool bSlower = Result.Ns > B.Ns * (1.0 + Tolerance);
+			const bool bMoreInstructions = Counter.IsAvailable() && B.Instructions > 0.0 && Result.Instructions > B.Instructions * 1.02;
+			const bool bMoreAllocations = Result.Allocations > B.Allocations;
+			if (bSlower || bMoreInstructions || bMoreAllocations)
+			{
+				std::strcat(Change, bSlower ? " SLOWER" : bMoreInstructions ? " INSTR" : " ALLOC");
+				Regressions++;
+			}
+		}
+		std::printf("%-36s %10.2f %14s %12.3f %10s\n", Result.Name.c_str(), Result.Ns, Instructions, Result.Allocations, Change);
+	}
+
+	if (BaselineFile && bWrite)
+	{
+		if (!WriteBaseline(BaselineFile, Results))
+		{
+			std::fprintf(stderr, "Cannot write %s\n", BaselineFile);
+			return 2;
+		}
+		std::printf("Baseline written to %s\n", BaselineFile);
+	}
+	else if (BaselineFile)
+	{
+		if (Baseline.empty())
+		{
+			std::fprintf(stderr, "No baseline in %s\n", BaselineFile);
+			return 2;
+		}
+		std::printf("%d regressions against %s (tolerance %.0f%%)\n", Regressions, BaselineFile, Tolerance * 100.0);
+		if (Regressions > 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
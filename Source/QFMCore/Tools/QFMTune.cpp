@@ -0,0 +1,92 @@
+/*
+	QFMTune
+
+	Searches rate loop (roll / pitch) or Z acceleration loop gains for a vehicle, without any engine running,
+	and prints the Pareto-best gain sets as config lines.
+	Usage: QFMTune [Axis roll|pitch|z] [Controller pid|spd] [Mass] [InertiaX] [InertiaY] [InertiaZ] [Threads] [ConfigFile]
+	Mass in kg, inertia in kg*cm^2 (as FVehicle). ConfigFile: parameters of the vehicle, e.g. the .cfg of a flight record.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "QFMCoreTuning.h"
+
+
+// Rows of the front to print
+static const int PrintedCandidates = 12;
+
+
+int main(int argc, char** argv)
+{
+	QFM::FGainTuner Tuner;
+	QFM::FTuningSettings& Settings = Tuner.Settings;
+	const char* Axis = (argc > 1) ? argv[1] : "roll";
+	Settings.Axis = std::strcmp(Axis, "z") == 0 ? QFM::ETuningAxis::Z : std::strcmp(Axis, "pitch") == 0 ? QFM::ETuningAxis::Pitch : QFM::ETuningAxis::Roll;
+	Settings.Controller = (argc > 2 && std::strcmp(argv[2], "pid") == 0) ? QFM::EControlLoop::PID : QFM::EControlLoop::SPD;
+	const int Threads = (argc > 7) ? std::atoi(argv[7]) : 0;
+
+	if (argc > 8)
+	{
+		// First section of a recorder config, or plain Name=Value lines
+		std::ifstream File(argv[8]);
+		std::stringstream Text;
+		Text << File.rdbuf();
+		const std::map<uint32_t, std::string> Sections = QFM::ParseFlightConfigFile(Text.str());
+		QFM::ApplyFlightModelConfig(Sections.empty() ? Text.str() : Sections.begin()->second, Tuner.Base.GetRefs());
+	}
+	if (argc > 3) { Tuner.Base.Vehicle.Mass = static_cast<float>(std::atof(argv[3])); }
+	if (argc > 4) { Tuner.Base.Vehicle.InertiaTensor.X = static_cast<float>(std::atof(argv[4])); }
+	if (argc > 5) { Tuner.Base.Vehicle.InertiaTensor.Y = static_cast<float>(std::atof(argv[5])); }
+	if (argc > 6) { Tuner.Base.Vehicle.InertiaTensor.Z = static_cast<float>(std::atof(argv[6])); }
+
+	QFM::FThreadPool Pool(Threads);
+
+	const auto Start = std::chrono::steady_clock::now();
+	const std::vector<QFM::FTuningCandidate> Front = Tuner.Run(Pool);
+	const auto End = std::chrono::steady_clock::now();
+
+	const double Seconds = std::chrono::duration<double>(End - Start).count();
+	const size_t Evaluated = Tuner.GetArchive().size();
+	size_t Stable = 0;
+	for (const QFM::FTuningCandidate& Candidate : Tuner.GetArchive())
+	{
+		Stable += Candidate.Score.bStable ? 1 : 0;
+	}
+
+	std::printf("Vehicle: %.3f kg, inertia %.0f %.0f %.0f kg*cm^2\n", Tuner.Base.Vehicle.Mass,
+		Tuner.Base.Vehicle.InertiaTensor.X, Tuner.Base.Vehicle.InertiaTensor.Y, Tuner.Base.Vehicle.InertiaTensor.Z);
+	std::printf("Candidates: %zu (%zu stable) on %d threads in %f s, %.0f per second\n", Evaluated, Stable, Pool.GetNumThreads(), Seconds, Evaluated / Seconds);
+	std::printf("Pareto front: %zu gain sets\n\n", Front.size());
+	if (Front.empty())
+	{
+		std::printf("No stable gain set in the search ranges\n");
+		return 1;
+	}
+
+	const int NumGains = Tuner.GetNumGains();
+	for (int g = 0; g < NumGains; g++)
+	{
+		// Without the core name
+		std::printf("%-24s", std::strchr(Tuner.GetParam(g).Name, '.') + 1);
+	}
+	std::printf("%10s %10s %10s %10s %10s %8s\n", "Rise s", "Overshoot", "Effort", "RampErr", "DistPeak", "Rank");
+	for (size_t i = 0; i < Front.size() && i < PrintedCandidates; i++)
+	{
+		const QFM::FTuningCandidate& Candidate = Front[i];
+		for (int g = 0; g < NumGains; g++)
+		{
+			std::printf("%-24.5g", Candidate.Gains[g]);
+		}
+		std::printf("%10.3f %10.3f %10.3g %10.4g %10.4g %8.3f\n", Candidate.Score.RiseTime, Candidate.Score.Overshoot,
+			Candidate.Score.Effort, Candidate.Score.RampError, Candidate.Score.DisturbancePeak, Candidate.Rank);
+	}
+
+	std::printf("\nBest balanced:\n%s", Tuner.FormatGains(Front[0].Gains).c_str());
+	return 0;
+}